@@ -0,0 +1,132 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/base64.hpp>
+#include <c4/cpu_features.hpp>
+#include <c4/libtest/rng.hpp>
+#include <c4/std/string.hpp>
+#include <string>
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// utilities for use in the benchmarks below
+
+/** random binary data, its base64 encoding, and room for both */
+struct base64_data
+{
+    std::string bin;
+    std::string encoded;
+    std::string encoded_url;
+    std::string out_bin;
+    std::string out_encoded;
+
+    base64_data(size_t num)
+    {
+        uint64_t rng = 12345u;
+        bin.resize(num);
+        for(char &c : bin)
+            c = static_cast<char>(c4::next_rand(&rng) >> 45);
+        encoded.resize(c4::base64_encode({}, c4::cblob(bin.data(), bin.size())));
+        c4::base64_encode(c4::to_substr(encoded), c4::cblob(bin.data(), bin.size()));
+        encoded_url.resize(c4::base64_encode<c4::base64url>({}, c4::cblob(bin.data(), bin.size())));
+        c4::base64_encode<c4::base64url>(c4::to_substr(encoded_url), c4::cblob(bin.data(), bin.size()));
+        out_bin.resize(bin.size());
+        out_encoded.resize(encoded.size());
+    }
+};
+
+base64_data& get_base64_data(int64_t num)
+{
+    static base64_data small(256);
+    static base64_data large(1 << 20);
+    return num <= 256 ? small : large;
+}
+
+typedef size_t (*encode_fn)(c4::substr, c4::cblob);
+typedef size_t (*decode_fn)(c4::csubstr, c4::blob);
+
+void encode(bm::State &st, encode_fn fn)
+{
+    base64_data &data = get_base64_data(st.range(0));
+    for(auto _ : st)
+    {
+        size_t len = fn(c4::to_substr(data.out_encoded), c4::cblob(data.bin.data(), data.bin.size()));
+        bm::DoNotOptimize(len);
+    }
+    st.SetBytesProcessed(static_cast<int64_t>(st.iterations() * data.bin.size()));
+}
+
+void decode(bm::State &st, decode_fn fn, bool url=false)
+{
+    base64_data &data = get_base64_data(st.range(0));
+    c4::csubstr encoded = c4::to_csubstr(url ? data.encoded_url : data.encoded);
+    for(auto _ : st)
+    {
+        size_t len = fn(encoded, c4::blob(&data.out_bin[0], data.out_bin.size()));
+        bm::DoNotOptimize(len);
+    }
+    st.SetBytesProcessed(static_cast<int64_t>(st.iterations() * data.bin.size()));
+}
+
+
+//-----------------------------------------------------------------------------
+
+void base64_encode_dispatch(bm::State &st) { encode(st, &c4::base64_encode); }
+void base64_decode_dispatch(bm::State &st) { decode(st, &c4::base64_decode); }
+void base64_encode_scalar(bm::State &st) { encode(st, &c4::detail::base64_encode_scalar); }
+void base64_decode_scalar(bm::State &st) { decode(st, &c4::detail::base64_decode_scalar); }
+
+void base64url_encode_dispatch(bm::State &st) { encode(st, &c4::base64_encode<c4::base64url>); }
+void base64url_decode_dispatch(bm::State &st) { decode(st, &c4::base64_decode<c4::base64url>, true); }
+
+BENCHMARK(base64_encode_dispatch)->Arg(256)->Arg(1 << 20);
+BENCHMARK(base64url_encode_dispatch)->Arg(256)->Arg(1 << 20);
+BENCHMARK(base64_encode_scalar)->Arg(256)->Arg(1 << 20);
+BENCHMARK(base64_decode_dispatch)->Arg(256)->Arg(1 << 20);
+BENCHMARK(base64url_decode_dispatch)->Arg(256)->Arg(1 << 20);
+BENCHMARK(base64_decode_scalar)->Arg(256)->Arg(1 << 20);
+
+#ifdef C4_BASE64_X86
+void base64_encode_ssse3(bm::State &st)
+{
+    if( ! c4::cpu_has(c4::CPU_SSSE3))
+        st.SkipWithError("ssse3 is not supported");
+    encode(st, &c4::detail::base64_encode_ssse3);
+}
+void base64_decode_ssse3(bm::State &st)
+{
+    if( ! c4::cpu_has(c4::CPU_SSSE3))
+        st.SkipWithError("ssse3 is not supported");
+    decode(st, &c4::detail::base64_decode_ssse3);
+}
+void base64_encode_avx2(bm::State &st)
+{
+    if( ! c4::cpu_has(c4::CPU_AVX2))
+        st.SkipWithError("avx2 is not supported");
+    encode(st, &c4::detail::base64_encode_avx2);
+}
+void base64_decode_avx2(bm::State &st)
+{
+    if( ! c4::cpu_has(c4::CPU_AVX2))
+        st.SkipWithError("avx2 is not supported");
+    decode(st, &c4::detail::base64_decode_avx2);
+}
+BENCHMARK(base64_encode_ssse3)->Arg(256)->Arg(1 << 20);
+BENCHMARK(base64_encode_avx2)->Arg(256)->Arg(1 << 20);
+BENCHMARK(base64_decode_ssse3)->Arg(256)->Arg(1 << 20);
+BENCHMARK(base64_decode_avx2)->Arg(256)->Arg(1 << 20);
+#endif
+
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bm::Initialize(&argc, argv);
+    bm::RunSpecifiedBenchmarks();
+    return 0;
+}
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,156 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/bitvector.hpp>
+#include <c4/libtest/rng.hpp>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// utilities for use in the benchmarks below
+
+/** a bit vector with a quarter of the bits set, with the same bits in
+ * a std::vector<bool>, and random positions to query */
+struct bits_data
+{
+    std::vector<bool> naive;
+    c4::bitvector bits;
+    std::vector<size_t> positions;
+    std::vector<size_t> ones;  //!< the position of every one, the baseline for select
+    std::vector<size_t> ranks; //!< the rank of every 64th position, the baseline for rank
+    size_t num_ones;
+
+    bits_data(size_t num) : naive(num), bits(num), positions(1 << 16), num_ones()
+    {
+        uint64_t rng = 12345u;
+        for(size_t i = 0; i < num; ++i)
+        {
+            if((c4::next_rand(&rng) & 3u) == 0)
+            {
+                naive[i] = true;
+                bits.set(i);
+                ones.push_back(i);
+            }
+        }
+        bits.build_index();
+        num_ones = bits.num_ones();
+        for(size_t &p : positions)
+            p = c4::next_rand(&rng) % num;
+        size_t r = 0;
+        for(size_t i = 0; i < num; ++i)
+        {
+            if(i % 64u == 0)
+                ranks.push_back(r);
+            r += naive[i];
+        }
+    }
+};
+
+bits_data const& get_bits_data(int64_t num)
+{
+    static bits_data small(1 << 16);
+    static bits_data large(size_t(1) << 28);
+    return num <= (1 << 16) ? small : large;
+}
+
+template<class Fn>
+void query(bm::State &st, Fn &&fn)
+{
+    bits_data const& data = get_bits_data(st.range(0));
+    size_t i = 0, sum = 0;
+    for(auto _ : st)
+    {
+        sum += fn(data, data.positions[i]);
+        i = (i + 1) & (data.positions.size() - 1);
+    }
+    bm::DoNotOptimize(sum);
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations()));
+}
+
+
+//-----------------------------------------------------------------------------
+
+/** the baseline: a rank sampled every 64 bits, and a scan of the rest */
+void rank_naive(bm::State &st)
+{
+    query(st, [](bits_data const& d, size_t pos){
+        size_t r = d.ranks[pos / 64u];
+        for(size_t i = pos & ~size_t(63); i < pos; ++i)
+            r += d.naive[i];
+        return r;
+    });
+}
+void rank_bitvector(bm::State &st)
+{
+    query(st, [](bits_data const& d, size_t pos){ return d.bits.rank1(pos); });
+}
+
+/** the baseline: a binary search on the positions of the ones */
+void select_binary_search(bm::State &st)
+{
+    query(st, [](bits_data const& d, size_t pos){
+        const size_t k = pos % d.num_ones;
+        // the position of the one with k ones before it
+        auto it = std::lower_bound(d.ones.begin(), d.ones.end(), k, [&d](size_t const& one, size_t k_){
+            return static_cast<size_t>(&one - d.ones.data()) < k_;
+        });
+        return *it;
+    });
+}
+void select_bitvector(bm::State &st)
+{
+    query(st, [](bits_data const& d, size_t pos){ return d.bits.select1(pos % d.num_ones); });
+}
+
+BENCHMARK(rank_naive)->Arg(1 << 16)->Arg(1 << 28);
+BENCHMARK(rank_bitvector)->Arg(1 << 16)->Arg(1 << 28);
+BENCHMARK(select_binary_search)->Arg(1 << 16)->Arg(1 << 28);
+BENCHMARK(select_bitvector)->Arg(1 << 16)->Arg(1 << 28);
+
+
+//-----------------------------------------------------------------------------
+// bulk membership tests of random positions
+
+void test_loop(bm::State &st)
+{
+    bits_data const& data = get_bits_data(st.range(0));
+    std::vector<char> results(data.positions.size());
+    for(auto _ : st)
+    {
+        for(size_t i = 0; i < data.positions.size(); ++i)
+            results[i] = data.bits.test(data.positions[i]);
+        bm::DoNotOptimize(results.data());
+    }
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations() * data.positions.size()));
+}
+void test_bulk(bm::State &st)
+{
+    bits_data const& data = get_bits_data(st.range(0));
+    std::unique_ptr<bool[]> results(new bool[data.positions.size()]);
+    for(auto _ : st)
+    {
+        data.bits.test(c4::cspan<size_t>(data.positions.data(), data.positions.size()),
+                       c4::span<bool>(results.get(), data.positions.size()));
+        bm::DoNotOptimize(results.get());
+    }
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations() * data.positions.size()));
+}
+
+BENCHMARK(test_loop)->Arg(1 << 16)->Arg(1 << 28);
+BENCHMARK(test_bulk)->Arg(1 << 16)->Arg(1 << 28);
+
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bm::Initialize(&argc, argv);
+    bm::RunSpecifiedBenchmarks();
+    return 0;
+}
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,111 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/bytes.hpp>
+#include <c4/cpu_features.hpp>
+#include <c4/libtest/rng.hpp>
+#include <vector>
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// utilities for use in the benchmarks below
+
+template<class U>
+struct bswap_data
+{
+    std::vector<U> src;
+    std::vector<U> dst;
+
+    bswap_data(size_t num) : src(num), dst(num)
+    {
+        uint64_t rng = 12345u;
+        for(U &v : src)
+            v = static_cast<U>(c4::next_rand(&rng));
+    }
+};
+
+template<class U>
+bswap_data<U>& get_bswap_data(int64_t num)
+{
+    static bswap_data<U> small(256);
+    static bswap_data<U> large(1 << 20);
+    return num <= 256 ? small : large;
+}
+
+template<class U, class Fn>
+void bswap(bm::State &st, Fn &&fn)
+{
+    bswap_data<U> &data = get_bswap_data<U>(st.range(0));
+    for(auto _ : st)
+    {
+        fn(data.dst.data(), data.src.data(), data.src.size());
+        bm::DoNotOptimize(data.dst.data());
+        bm::ClobberMemory();
+    }
+    st.SetBytesProcessed(static_cast<int64_t>(st.iterations() * data.src.size() * sizeof(U)));
+}
+
+
+//-----------------------------------------------------------------------------
+
+/** the baseline: a loop of byteswap() */
+template<class U>
+void bswap_loop(bm::State &st)
+{
+    bswap<U>(st, [](U *dst, U const* src, size_t num){
+        for(size_t i = 0; i < num; ++i)
+            dst[i] = c4::byteswap(src[i]);
+    });
+}
+template<class U>
+void bswap_dispatch(bm::State &st)
+{
+    bswap<U>(st, [](U *dst, U const* src, size_t num){ c4::detail::bswap_n(dst, src, num); });
+}
+template<class U>
+void bswap_scalar(bm::State &st)
+{
+    bswap<U>(st, [](U *dst, U const* src, size_t num){ c4::detail::bswap_n_scalar(dst, src, num); });
+}
+
+#define BSWAP_BENCHMARK(fn) \
+    BENCHMARK_TEMPLATE(fn, uint16_t)->Arg(256)->Arg(1 << 20); \
+    BENCHMARK_TEMPLATE(fn, uint32_t)->Arg(256)->Arg(1 << 20); \
+    BENCHMARK_TEMPLATE(fn, uint64_t)->Arg(256)->Arg(1 << 20)
+
+BSWAP_BENCHMARK(bswap_loop);
+BSWAP_BENCHMARK(bswap_dispatch);
+BSWAP_BENCHMARK(bswap_scalar);
+
+#ifdef C4_BYTES_X86
+template<class U>
+void bswap_ssse3(bm::State &st)
+{
+    if( ! c4::cpu_has(c4::CPU_SSSE3))
+        st.SkipWithError("ssse3 is not supported");
+    bswap<U>(st, [](U *dst, U const* src, size_t num){ c4::detail::bswap_n_ssse3(dst, src, num); });
+}
+template<class U>
+void bswap_avx2(bm::State &st)
+{
+    if( ! c4::cpu_has(c4::CPU_AVX2))
+        st.SkipWithError("avx2 is not supported");
+    bswap<U>(st, [](U *dst, U const* src, size_t num){ c4::detail::bswap_n_avx2(dst, src, num); });
+}
+BSWAP_BENCHMARK(bswap_ssse3);
+BSWAP_BENCHMARK(bswap_avx2);
+#endif
+
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bm::Initialize(&argc, argv);
+    bm::RunSpecifiedBenchmarks();
+    return 0;
+}
+
+#include <c4/c4_pop.hpp>
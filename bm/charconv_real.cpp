@@ -0,0 +1,350 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/std/string.hpp>
+#include <c4/charconv.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if C4_CPP >= 17
+#include <charconv>
+#endif
+
+// benchmarks depending on c++17 features are disabled using the
+// preprocessor, as in charconv.cpp
+#if C4_CPP >= 17 && defined(__cpp_lib_to_chars)
+#define C4_BM_HAVE_TO_CHARS
+#define REAL_BENCHMARK_TOCHARS(fn, ...) REAL_BENCHMARK(fn, __VA_ARGS__)
+#define REAL_BENCHMARK_MODES_TOCHARS(fn, ...) REAL_BENCHMARK_MODES(fn, __VA_ARGS__)
+#else
+#define REAL_BENCHMARK_TOCHARS(...) void shutup_extra_semicolon()
+#define REAL_BENCHMARK_MODES_TOCHARS(...) void shutup_extra_semicolon()
+#endif
+
+// the conversions to string run over each of the format modes
+#define REAL_BENCHMARK_MODES(fn, ...) BENCHMARK_TEMPLATE(fn, __VA_ARGS__)->DenseRange(0, num_modes - 1)
+#define REAL_BENCHMARK(fn, ...) BENCHMARK_TEMPLATE(fn, __VA_ARGS__)
+
+#ifdef __clang__
+#   pragma clang diagnostic push
+#   pragma clang diagnostic ignored "-Wdouble-promotion"
+#   pragma clang diagnostic ignored "-Wformat-nonliteral"
+#elif defined(__GNUC__)
+#   pragma GCC diagnostic push
+#   pragma GCC diagnostic ignored "-Wdouble-promotion"
+#   pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#endif
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// the distributions of values, as they occur in practice. Each fills a
+// ring of values, and gives the number of decimals to print them with
+// FTOA_FLOAT.
+
+struct real_rng
+{
+    uint64_t state = UINT64_C(0x9e3779b97f4a7c15);
+    uint64_t operator() ()
+    {
+        state ^= state << 13u;
+        state ^= state >> 7u;
+        state ^= state << 17u;
+        return state;
+    }
+};
+
+/** amounts with cents, from 0.01 to 100000.00 */
+struct prices
+{
+    enum : int { decimals = 2 };
+    template<class T> static T make(real_rng &rng)
+    {
+        return static_cast<T>(static_cast<double>(rng() % 10000000u + 1u) / 100.);
+    }
+};
+
+/** measurements of any sign and magnitude, from 1e-30 to 1e30 */
+struct scientific
+{
+    enum : int { decimals = 6 };
+    template<class T> static T make(real_rng &rng)
+    {
+        const uint64_t r = rng();
+        const double mantissa = 1. + static_cast<double>(r >> 11) / 9007199254740992.;
+        const double v = mantissa * std::pow(10., static_cast<int>(r % 61u) - 30);
+        return static_cast<T>((r & 1024u) ? -v : v);
+    }
+};
+
+/** integers stored as reals, eg counts and ids in json */
+struct integers
+{
+    enum : int { decimals = 0 };
+    template<class T> static T make(real_rng &rng)
+    {
+        return static_cast<T>(rng() % 16777216u); // exact in a float
+    }
+};
+
+template<class Dist, class T>
+std::vector<T> const& get_values()
+{
+    static const std::vector<T> values = []{
+        std::vector<T> v(4096);
+        real_rng rng;
+        for(T &val : v)
+            val = Dist::template make<T>(rng);
+        return v;
+    }();
+    return values;
+}
+
+/** a ring of values, to be cycled by the benchmarks */
+template<class T>
+struct ring
+{
+    std::vector<T> const& values;
+    size_t curr;
+    ring(std::vector<T> const& v) : values(v), curr(0) {}
+    T const& next() { T const& v = values[curr]; curr = (curr + 1) & (values.size() - 1); return v; }
+};
+
+
+//-----------------------------------------------------------------------------
+// the format modes, selected with the benchmark argument
+
+struct format_mode
+{
+    const char *name;
+    c4::RealFormat_e fmt;
+    int precision; ///< -1 is the default precision
+};
+
+/** the modes: flex with the default precision; flex with enough digits
+ * to round-trip; and the other formats */
+constexpr const int num_modes = 5;
+
+template<class Dist, class T>
+format_mode get_mode(int64_t i)
+{
+    const format_mode modes[num_modes] = {
+        {"flex", c4::FTOA_FLEX, -1},
+        {"flex_roundtrip", c4::FTOA_FLEX, std::numeric_limits<T>::max_digits10},
+        {"float", c4::FTOA_FLOAT, Dist::decimals},
+        {"scient", c4::FTOA_SCIENT, 6},
+        {"hexa", c4::FTOA_HEXA, -1},
+    };
+    return modes[i];
+}
+
+inline size_t xtoa(c4::substr buf, float v, int precision, c4::RealFormat_e fmt) { return c4::ftoa(buf, v, precision, fmt); }
+inline size_t xtoa(c4::substr buf, double v, int precision, c4::RealFormat_e fmt) { return c4::dtoa(buf, v, precision, fmt); }
+inline bool atox(c4::csubstr buf, float *v) { return c4::atof(buf, v); }
+inline bool atox(c4::csubstr buf, double *v) { return c4::atod(buf, v); }
+
+template<class T>
+void report(bm::State &st, size_t num_chars)
+{
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations()));
+    st.SetBytesProcessed(static_cast<int64_t>(num_chars));
+}
+
+
+//-----------------------------------------------------------------------------
+
+template<class Dist, class T>
+void xtoa_c4(bm::State &st)
+{
+    const format_mode mode = get_mode<Dist, T>(st.range(0));
+    ring<T> values(get_values<Dist, T>());
+    char buf[512];
+    size_t num_chars = 0;
+    for(auto _ : st)
+    {
+        const size_t len = xtoa(buf, values.next(), mode.precision, mode.fmt);
+        bm::DoNotOptimize(buf);
+        num_chars += len;
+    }
+    st.SetLabel(mode.name);
+    report<T>(st, num_chars);
+}
+
+template<class Dist, class T>
+void xtoa_snprintf(bm::State &st)
+{
+    const format_mode mode = get_mode<Dist, T>(st.range(0));
+    ring<T> values(get_values<Dist, T>());
+    char fmt[16];
+    if(mode.precision == -1)
+        snprintf(fmt, sizeof(fmt), "%%%c", c4::to_c_fmt(mode.fmt));
+    else
+        snprintf(fmt, sizeof(fmt), "%%.%d%c", mode.precision, c4::to_c_fmt(mode.fmt));
+    char buf[512];
+    size_t num_chars = 0;
+    for(auto _ : st)
+    {
+        const int len = snprintf(buf, sizeof(buf), fmt, values.next());
+        bm::DoNotOptimize(buf);
+        num_chars += static_cast<size_t>(len);
+    }
+    st.SetLabel(mode.name);
+    report<T>(st, num_chars);
+}
+
+#ifdef C4_BM_HAVE_TO_CHARS
+template<class Dist, class T>
+void xtoa_std_to_chars(bm::State &st)
+{
+    const format_mode mode = get_mode<Dist, T>(st.range(0));
+    const std::chars_format fmts[] = {std::chars_format::fixed, std::chars_format::scientific, std::chars_format::general, std::chars_format::hex};
+    const std::chars_format fmt = fmts[mode.fmt];
+    ring<T> values(get_values<Dist, T>());
+    char buf[512];
+    size_t num_chars = 0;
+    for(auto _ : st)
+    {
+        const std::to_chars_result r = mode.precision == -1 ?
+            std::to_chars(buf, buf + sizeof(buf), values.next(), fmt) :
+            std::to_chars(buf, buf + sizeof(buf), values.next(), fmt, mode.precision);
+        bm::DoNotOptimize(buf);
+        num_chars += static_cast<size_t>(r.ptr - buf);
+    }
+    st.SetLabel(mode.name);
+    report<T>(st, num_chars);
+}
+#endif
+
+REAL_BENCHMARK_MODES(xtoa_c4, prices, float);
+REAL_BENCHMARK_MODES(xtoa_snprintf, prices, float);
+REAL_BENCHMARK_MODES_TOCHARS(xtoa_std_to_chars, prices, float);
+REAL_BENCHMARK_MODES(xtoa_c4, prices, double);
+REAL_BENCHMARK_MODES(xtoa_snprintf, prices, double);
+REAL_BENCHMARK_MODES_TOCHARS(xtoa_std_to_chars, prices, double);
+
+REAL_BENCHMARK_MODES(xtoa_c4, scientific, float);
+REAL_BENCHMARK_MODES(xtoa_snprintf, scientific, float);
+REAL_BENCHMARK_MODES_TOCHARS(xtoa_std_to_chars, scientific, float);
+REAL_BENCHMARK_MODES(xtoa_c4, scientific, double);
+REAL_BENCHMARK_MODES(xtoa_snprintf, scientific, double);
+REAL_BENCHMARK_MODES_TOCHARS(xtoa_std_to_chars, scientific, double);
+
+REAL_BENCHMARK_MODES(xtoa_c4, integers, float);
+REAL_BENCHMARK_MODES(xtoa_snprintf, integers, float);
+REAL_BENCHMARK_MODES_TOCHARS(xtoa_std_to_chars, integers, float);
+REAL_BENCHMARK_MODES(xtoa_c4, integers, double);
+REAL_BENCHMARK_MODES(xtoa_snprintf, integers, double);
+REAL_BENCHMARK_MODES_TOCHARS(xtoa_std_to_chars, integers, double);
+
+
+//-----------------------------------------------------------------------------
+// parse the values printed with enough digits to round-trip
+
+template<class Dist, class T>
+std::vector<std::string> const& get_strings()
+{
+    static const std::vector<std::string> strings = []{
+        std::vector<T> const& values = get_values<Dist, T>();
+        std::vector<std::string> s(values.size());
+        char buf[64];
+        for(size_t i = 0; i < values.size(); ++i)
+        {
+            const size_t len = xtoa(buf, values[i], std::numeric_limits<T>::max_digits10, c4::FTOA_FLEX);
+            s[i].assign(buf, len);
+        }
+        return s;
+    }();
+    return strings;
+}
+
+template<class Dist, class T>
+void atox_c4(bm::State &st)
+{
+    ring<std::string> strings(get_strings<Dist, T>());
+    size_t num_chars = 0;
+    T v;
+    for(auto _ : st)
+    {
+        std::string const& s = strings.next();
+        atox(c4::to_csubstr(s), &v);
+        bm::DoNotOptimize(v);
+        num_chars += s.size();
+    }
+    report<T>(st, num_chars);
+}
+
+template<class T> T std_strtox(const char *s, char **end);
+template<> float std_strtox<float>(const char *s, char **end) { return strtof(s, end); }
+template<> double std_strtox<double>(const char *s, char **end) { return strtod(s, end); }
+
+template<class Dist, class T>
+void atox_strtox(bm::State &st)
+{
+    ring<std::string> strings(get_strings<Dist, T>());
+    size_t num_chars = 0;
+    for(auto _ : st)
+    {
+        std::string const& s = strings.next();
+        T v = std_strtox<T>(s.c_str(), nullptr);
+        bm::DoNotOptimize(v);
+        num_chars += s.size();
+    }
+    report<T>(st, num_chars);
+}
+
+#ifdef C4_BM_HAVE_TO_CHARS
+template<class Dist, class T>
+void atox_std_from_chars(bm::State &st)
+{
+    ring<std::string> strings(get_strings<Dist, T>());
+    size_t num_chars = 0;
+    T v;
+    for(auto _ : st)
+    {
+        std::string const& s = strings.next();
+        std::from_chars(s.data(), s.data() + s.size(), v);
+        bm::DoNotOptimize(v);
+        num_chars += s.size();
+    }
+    report<T>(st, num_chars);
+}
+#endif
+
+REAL_BENCHMARK(atox_c4, prices, float);
+REAL_BENCHMARK(atox_strtox, prices, float);
+REAL_BENCHMARK_TOCHARS(atox_std_from_chars, prices, float);
+REAL_BENCHMARK(atox_c4, prices, double);
+REAL_BENCHMARK(atox_strtox, prices, double);
+REAL_BENCHMARK_TOCHARS(atox_std_from_chars, prices, double);
+
+REAL_BENCHMARK(atox_c4, scientific, float);
+REAL_BENCHMARK(atox_strtox, scientific, float);
+REAL_BENCHMARK_TOCHARS(atox_std_from_chars, scientific, float);
+REAL_BENCHMARK(atox_c4, scientific, double);
+REAL_BENCHMARK(atox_strtox, scientific, double);
+REAL_BENCHMARK_TOCHARS(atox_std_from_chars, scientific, double);
+
+REAL_BENCHMARK(atox_c4, integers, float);
+REAL_BENCHMARK(atox_strtox, integers, float);
+REAL_BENCHMARK_TOCHARS(atox_std_from_chars, integers, float);
+REAL_BENCHMARK(atox_c4, integers, double);
+REAL_BENCHMARK(atox_strtox, integers, double);
+REAL_BENCHMARK_TOCHARS(atox_std_from_chars, integers, double);
+
+
+//-----------------------------------------------------------------------------
+
+#if defined(__clang__)
+#   pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#   pragma GCC diagnostic pop
+#endif
+
+#include <c4/c4_pop.hpp>
+
+BENCHMARK_MAIN();
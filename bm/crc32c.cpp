@@ -0,0 +1,70 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/crc32c.hpp>
+#include <c4/cpu_features.hpp>
+#include <c4/libtest/rng.hpp>
+#include <string>
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// utilities for use in the benchmarks below
+
+std::string const& get_crc32c_data(int64_t num)
+{
+    static std::string data;
+    if(data.size() != static_cast<size_t>(num))
+    {
+        uint64_t rng = 12345u;
+        data.resize(static_cast<size_t>(num));
+        for(char &c : data)
+            c = static_cast<char>(c4::next_rand(&rng) >> 45);
+    }
+    return data;
+}
+
+typedef uint32_t (*crc32c_fn)(uint32_t, const void*, size_t);
+
+void checksum(bm::State &st, crc32c_fn fn)
+{
+    std::string const& data = get_crc32c_data(st.range(0));
+    for(auto _ : st)
+    {
+        uint32_t crc = fn(0u, data.data(), data.size());
+        bm::DoNotOptimize(crc);
+    }
+    st.SetBytesProcessed(static_cast<int64_t>(st.iterations() * data.size()));
+}
+
+
+//-----------------------------------------------------------------------------
+
+void crc32c_dispatch(bm::State &st) { checksum(st, &c4::crc32c_update); }
+void crc32c_table(bm::State &st) { checksum(st, &c4::detail::crc32c_update_table); }
+
+BENCHMARK(crc32c_dispatch)->Arg(64)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(crc32c_table)->Arg(64)->Arg(4096)->Arg(1 << 20);
+
+#ifdef C4_CRC32C_SSE42
+void crc32c_sse42(bm::State &st)
+{
+    if( ! c4::cpu_has(c4::CPU_SSE42))
+        st.SkipWithError("sse4.2 is not supported");
+    checksum(st, &c4::detail::crc32c_update_sse42);
+}
+BENCHMARK(crc32c_sse42)->Arg(64)->Arg(4096)->Arg(1 << 20);
+#endif
+
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bm::Initialize(&argc, argv);
+    bm::RunSpecifiedBenchmarks();
+    return 0;
+}
+
+#include <c4/c4_pop.hpp>
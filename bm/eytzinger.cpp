@@ -0,0 +1,160 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/eytzinger.hpp>
+#include <c4/libtest/rng.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// utilities for use in the benchmarks below
+
+/** sorted random keys, and random keys to search for */
+struct search_data
+{
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> queries;
+    c4::eytzinger_set<uint32_t> eytzinger;
+    c4::stree_set<uint32_t> stree;
+
+    search_data(size_t num) : keys(num), queries(1 << 16)
+    {
+        uint64_t rng = 12345u;
+        for(uint32_t &k : keys)
+            k = static_cast<uint32_t>(c4::next_rand(&rng));
+        std::sort(keys.begin(), keys.end());
+        for(uint32_t &q : queries)
+            q = static_cast<uint32_t>(c4::next_rand(&rng));
+        eytzinger.assign(c4::cspan<uint32_t>(keys.data(), keys.size()));
+        stree.assign(c4::cspan<uint32_t>(keys.data(), keys.size()));
+    }
+};
+
+search_data const& get_search_data(int64_t num)
+{
+    static search_data small(1 << 10);
+    static search_data medium(1 << 17);
+    static search_data large(10 << 20);
+    return num <= (1 << 10) ? small : num <= (1 << 17) ? medium : large;
+}
+
+template<class Fn>
+void search(bm::State &st, Fn &&fn)
+{
+    search_data const& data = get_search_data(st.range(0));
+    size_t i = 0, sum = 0;
+    for(auto _ : st)
+    {
+        sum += fn(data, data.queries[i]);
+        i = (i + 1) & (data.queries.size() - 1);
+    }
+    bm::DoNotOptimize(sum);
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations()));
+}
+
+
+//-----------------------------------------------------------------------------
+
+/** the baseline */
+void u32_std_lower_bound(bm::State &st)
+{
+    search(st, [](search_data const& d, uint32_t x){
+        return static_cast<size_t>(std::lower_bound(d.keys.begin(), d.keys.end(), x) - d.keys.begin());
+    });
+}
+void u32_eytzinger(bm::State &st)
+{
+    search(st, [](search_data const& d, uint32_t x){ return d.eytzinger.lower_bound(x); });
+}
+void u32_stree(bm::State &st)
+{
+    search(st, [](search_data const& d, uint32_t x){ return d.stree.lower_bound(x); });
+}
+
+BENCHMARK(u32_std_lower_bound)->Arg(1 << 10)->Arg(1 << 17)->Arg(10 << 20);
+BENCHMARK(u32_eytzinger)->Arg(1 << 10)->Arg(1 << 17)->Arg(10 << 20);
+BENCHMARK(u32_stree)->Arg(1 << 10)->Arg(1 << 17)->Arg(10 << 20);
+
+
+//-----------------------------------------------------------------------------
+
+/** identifiers sharing long prefixes, as the keys of a symbol table */
+struct string_data
+{
+    std::vector<std::string> strs;
+    std::vector<c4::csubstr> keys;
+    std::vector<c4::csubstr> queries;
+    c4::eytzinger_set<c4::csubstr> eytzinger;
+
+    string_data(size_t num) : strs(num)
+    {
+        static const char *const prefixes[] = {"com.example.", "org.project.module.", "net.", "io.service.api."};
+        uint64_t rng = 12345u;
+        for(std::string &s : strs)
+        {
+            s = prefixes[c4::next_rand(&rng) % 4u];
+            const size_t len = 4u + c4::next_rand(&rng) % 16u;
+            for(size_t i = 0; i < len; ++i)
+                s += static_cast<char>('a' + c4::next_rand(&rng) % 26u);
+        }
+        std::sort(strs.begin(), strs.end());
+        for(std::string const& s : strs)
+            keys.push_back(c4::csubstr(s.data(), s.size()));
+        for(size_t i = 0; i < (1u << 16); ++i)
+            queries.push_back(keys[c4::next_rand(&rng) % keys.size()]);
+        eytzinger.assign(c4::cspan<c4::csubstr>(keys.data(), keys.size()));
+    }
+};
+
+string_data const& get_string_data(int64_t num)
+{
+    static string_data small(1 << 10);
+    static string_data large(1 << 20);
+    return num <= (1 << 10) ? small : large;
+}
+
+template<class Fn>
+void search_strings(bm::State &st, Fn &&fn)
+{
+    string_data const& data = get_string_data(st.range(0));
+    size_t i = 0, sum = 0;
+    for(auto _ : st)
+    {
+        sum += fn(data, data.queries[i]);
+        i = (i + 1) & (data.queries.size() - 1);
+    }
+    bm::DoNotOptimize(sum);
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations()));
+}
+
+/** the baseline, with csubstr::compare() */
+void str_std_lower_bound(bm::State &st)
+{
+    search_strings(st, [](string_data const& d, c4::csubstr x){
+        auto it = std::lower_bound(d.keys.begin(), d.keys.end(), x, [](c4::csubstr a, c4::csubstr b){ return a.compare(b) < 0; });
+        return static_cast<size_t>(it - d.keys.begin());
+    });
+}
+void str_eytzinger(bm::State &st)
+{
+    search_strings(st, [](string_data const& d, c4::csubstr x){ return d.eytzinger.lower_bound(x); });
+}
+
+BENCHMARK(str_std_lower_bound)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(str_eytzinger)->Arg(1 << 10)->Arg(1 << 20);
+
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bm::Initialize(&argc, argv);
+    bm::RunSpecifiedBenchmarks();
+    return 0;
+}
+
+#include <c4/c4_pop.hpp>
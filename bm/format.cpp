@@ -0,0 +1,609 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/std/string.hpp>
+#include <c4/format.hpp>
+#include <c4/libtest/rng.hpp>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if C4_CPP >= 17
+#include <charconv>
+#endif
+
+// benchmarks depending on c++17 features are disabled using the
+// preprocessor, as in charconv.cpp
+#if C4_CPP >= 17 && defined(__cpp_lib_to_chars)
+#define C4_BM_HAVE_TO_CHARS
+#define BENCHMARK_TEMPLATE_TOCHARS(fn, ...) BENCHMARK_TEMPLATE(fn, __VA_ARGS__)
+#else
+#define BENCHMARK_TEMPLATE_TOCHARS(...) void shutup_extra_semicolon()
+#endif
+
+#ifdef __clang__
+#   pragma clang diagnostic push
+#   pragma clang diagnostic ignored "-Wdouble-promotion"
+#   pragma clang diagnostic ignored "-Wformat-nonliteral"
+#elif defined(__GNUC__)
+#   pragma GCC diagnostic push
+#   pragma GCC diagnostic ignored "-Wdouble-promotion"
+#   pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#endif
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// the mixes of arguments. Each has a ring of values, the format
+// strings which print them separated by spaces, and apply(), which
+// calls a function with the values as arguments.
+
+struct format_rng
+{
+    uint64_t state = 12345u;
+    uint32_t operator() (uint32_t mod)
+    {
+        return static_cast<uint32_t>(c4::next_rand(&state) % mod);
+    }
+};
+
+struct ints
+{
+    struct values { int32_t a; uint32_t b; int64_t c; uint64_t d; };
+    static const char* c4_fmt() { return "{} {} {} {}"; }
+    static const char* printf_fmt() { return "%" PRId32 " %" PRIu32 " %" PRId64 " %" PRIu64; }
+    static const char* scanf_fmt() { return "%" SCNd32 " %" SCNu32 " %" SCNd64 " %" SCNu64; }
+    static values make(format_rng &rng)
+    {
+        return {static_cast<int32_t>(rng(200000)) - 100000, rng(1000), -static_cast<int64_t>(rng(1u << 24)) * 1000003, uint64_t(rng(1u << 24)) << 20};
+    }
+    template<class Fn>
+    static auto apply(values const& v, Fn &&fn) -> decltype(fn(v.a, v.b, v.c, v.d)) { return fn(v.a, v.b, v.c, v.d); }
+    template<class Fn>
+    static auto apply_out(values &v, Fn &&fn) -> decltype(fn(v.a, v.b, v.c, v.d)) { return fn(v.a, v.b, v.c, v.d); }
+};
+
+struct reals
+{
+    // values with few digits, so that the shortest representation
+    // (std::to_chars) and %g print the same
+    struct values { double a; float b; double c; };
+    static const char* c4_fmt() { return "{} {} {}"; }
+    static const char* printf_fmt() { return "%g %g %g"; }
+    static const char* scanf_fmt() { return "%lf %f %lf"; }
+    static values make(format_rng &rng)
+    {
+        return {rng(100000) / 8., static_cast<float>(rng(1000)) / 4.f, -static_cast<double>(rng(1000000)) / 64.};
+    }
+    template<class Fn>
+    static auto apply(values const& v, Fn &&fn) -> decltype(fn(v.a, v.b, v.c)) { return fn(v.a, v.b, v.c); }
+    template<class Fn>
+    static auto apply_out(values &v, Fn &&fn) -> decltype(fn(v.a, v.b, v.c)) { return fn(v.a, v.b, v.c); }
+};
+
+struct strings
+{
+    struct values { const char *a; const char *b; const char *c; };
+    static const char* c4_fmt() { return "{} {} {}"; }
+    static const char* printf_fmt() { return "%s %s %s"; }
+    static values make(format_rng &rng)
+    {
+        static const char *words[] = {"GET", "POST", "/api/v1/items", "/healthz", "ok", "not found", "application/json", "text/html; charset=utf-8"};
+        return {words[rng(8)], words[rng(8)], words[rng(8)]};
+    }
+    template<class Fn>
+    static auto apply(values const& v, Fn &&fn) -> decltype(fn(v.a, v.b, v.c)) { return fn(v.a, v.b, v.c); }
+};
+
+/** a typical log record */
+struct mixed
+{
+    struct values { const char *user; int32_t id; double latency; const char *path; uint32_t status; };
+    static const char* c4_fmt() { return "{} {} {} {} {}"; }
+    static const char* printf_fmt() { return "%s %" PRId32 " %g %s %" PRIu32; }
+    static values make(format_rng &rng)
+    {
+        static const char *users[] = {"alice", "bob", "carol", "dave"};
+        static const char *paths[] = {"/api/v1/items", "/api/v1/items/8812/reviews", "/healthz", "/static/js/app.3f9a2c.js"};
+        static const uint32_t statuses[] = {200, 204, 304, 404, 500};
+        return {users[rng(4)], static_cast<int32_t>(rng(1000000)), rng(100000) / 16., paths[rng(4)], statuses[rng(5)]};
+    }
+    template<class Fn>
+    static auto apply(values const& v, Fn &&fn) -> decltype(fn(v.user, v.id, v.latency, v.path, v.status))
+    {
+        return fn(v.user, v.id, v.latency, v.path, v.status);
+    }
+};
+
+template<class Mix>
+struct ring
+{
+    std::vector<typename Mix::values> values;
+    size_t curr;
+    ring() : values(), curr(0)
+    {
+        format_rng rng;
+        for(int i = 0; i < 256; ++i)
+            values.push_back(Mix::make(rng));
+    }
+    typename Mix::values const& next() { typename Mix::values const& v = values[curr]; curr = (curr + 1) % values.size(); return v; }
+};
+
+/** report ns/call in the time column, calls/s and output bytes/s */
+void report(bm::State &st, size_t bytes)
+{
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations()));
+    st.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+/** the string buffers are cleared when they grow beyond this, as a
+ * log buffer would be flushed */
+enum : size_t { append_flush_size = 1 << 16 };
+
+
+//-----------------------------------------------------------------------------
+// functors calling the formatting functions with any arguments
+
+struct c4_cat_
+{
+    c4::substr buf;
+    template<class... Args> size_t operator() (Args const& ...args) const { return c4::cat(buf, args...); }
+};
+struct c4_catsep_
+{
+    c4::substr buf;
+    template<class... Args> size_t operator() (Args const& ...args) const { return c4::catsep(buf, ' ', args...); }
+};
+struct c4_format_
+{
+    c4::substr buf;
+    c4::csubstr fmt;
+    template<class... Args> size_t operator() (Args const& ...args) const { return c4::format(buf, fmt, args...); }
+};
+struct c4_catrs_
+{
+    std::string *s;
+    template<class... Args> size_t operator() (Args const& ...args) const { c4::catrs(s, args...); return s->size(); }
+};
+struct c4_catrs_append_
+{
+    std::string *s;
+    template<class... Args> size_t operator() (Args const& ...args) const { return c4::catrs(c4::append, s, args...).len; }
+};
+struct c4_formatrs_
+{
+    std::string *s;
+    c4::csubstr fmt;
+    template<class... Args> size_t operator() (Args const& ...args) const { c4::formatrs(s, fmt, args...); return s->size(); }
+};
+struct c4_formatrs_append_
+{
+    std::string *s;
+    c4::csubstr fmt;
+    template<class... Args> size_t operator() (Args const& ...args) const { return c4::formatrs(c4::append, s, fmt, args...).len; }
+};
+struct snprintf_
+{
+    char *buf;
+    size_t size;
+    const char *fmt;
+    template<class... Args> size_t operator() (Args const& ...args) const { return static_cast<size_t>(snprintf(buf, size, fmt, args...)); }
+};
+struct ostream_
+{
+    std::ostream *os;
+    template<class Arg, class... Args> void operator() (Arg const& a, Args const& ...args) const
+    {
+        *os << a;
+        int dummy[] = {0, ((*os << ' ' << args), 0)...};
+        (void)dummy;
+    }
+};
+struct unformat_
+{
+    c4::csubstr buf;
+    c4::csubstr fmt;
+    template<class... Args> size_t operator() (Args & ...args) const { return c4::unformat(buf, fmt, args...); }
+};
+struct sscanf_
+{
+    const char *buf;
+    const char *fmt;
+    template<class... Args> size_t operator() (Args & ...args) const { return static_cast<size_t>(sscanf(buf, fmt, &args...)); }
+};
+struct istream_
+{
+    std::istream *is;
+    template<class... Args> size_t operator() (Args & ...args) const
+    {
+        int dummy[] = {0, ((*is >> args), 0)...};
+        (void)dummy;
+        return ! is->fail();
+    }
+};
+
+#ifdef C4_BM_HAVE_TO_CHARS
+template<class T>
+char* std_put(char *first, char *last, T v) { return std::to_chars(first, last, v).ptr; }
+char* std_put(char *first, char *last, char c)
+{
+    if(first < last)
+        *first++ = c;
+    return first;
+}
+char* std_put(char *first, char *last, const char *s)
+{
+    size_t len = strlen(s);
+    len = len < static_cast<size_t>(last - first) ? len : static_cast<size_t>(last - first);
+    memcpy(first, s, len);
+    return first + len;
+}
+template<class T>
+const char* std_get(const char *first, const char *last, T *v) { return std::from_chars(first, last, *v).ptr; }
+
+struct to_chars_
+{
+    char *first, *last;
+    template<class Arg, class... Args> size_t operator() (Arg const& a, Args const& ...args) const
+    {
+        char *pos = std_put(first, last, a);
+        int dummy[] = {0, ((pos = std_put(std_put(pos, last, ' '), last, args)), 0)...};
+        (void)dummy;
+        return static_cast<size_t>(pos - first);
+    }
+};
+struct from_chars_
+{
+    const char *first, *last;
+    template<class Arg, class... Args> size_t operator() (Arg & a, Args & ...args) const
+    {
+        const char *pos = std_get(first, last, &a);
+        int dummy[] = {0, ((pos = std_get(pos + 1, last, &args)), 0)...};
+        (void)dummy;
+        return static_cast<size_t>(pos - first);
+    }
+};
+#endif
+
+
+//-----------------------------------------------------------------------------
+// formatting into a fixed buffer
+
+template<class Mix>
+void fixed_c4_cat(bm::State &st)
+{
+    ring<Mix> r;
+    char buf[256];
+    size_t bytes = 0;
+    for(auto _ : st)
+        bytes += Mix::apply(r.next(), c4_cat_{buf});
+    report(st, bytes);
+}
+
+template<class Mix>
+void fixed_c4_catsep(bm::State &st)
+{
+    ring<Mix> r;
+    char buf[256];
+    size_t bytes = 0;
+    for(auto _ : st)
+        bytes += Mix::apply(r.next(), c4_catsep_{buf});
+    report(st, bytes);
+}
+
+template<class Mix>
+void fixed_c4_format(bm::State &st)
+{
+    ring<Mix> r;
+    char buf[256];
+    size_t bytes = 0;
+    for(auto _ : st)
+        bytes += Mix::apply(r.next(), c4_format_{buf, c4::to_csubstr(Mix::c4_fmt())});
+    report(st, bytes);
+}
+
+template<class Mix>
+void fixed_snprintf(bm::State &st)
+{
+    ring<Mix> r;
+    char buf[256];
+    size_t bytes = 0;
+    for(auto _ : st)
+        bytes += Mix::apply(r.next(), snprintf_{buf, sizeof(buf), Mix::printf_fmt()});
+    report(st, bytes);
+}
+
+#ifdef C4_BM_HAVE_TO_CHARS
+template<class Mix>
+void fixed_std_to_chars(bm::State &st)
+{
+    ring<Mix> r;
+    char buf[256];
+    size_t bytes = 0;
+    for(auto _ : st)
+        bytes += Mix::apply(r.next(), to_chars_{buf, buf + sizeof(buf)});
+    report(st, bytes);
+}
+#endif
+
+#define FORMAT_BENCHMARKS(mix)                                  \
+    BENCHMARK_TEMPLATE(fixed_c4_cat, mix);                      \
+    BENCHMARK_TEMPLATE(fixed_c4_catsep, mix);                   \
+    BENCHMARK_TEMPLATE(fixed_c4_format, mix);                   \
+    BENCHMARK_TEMPLATE(fixed_snprintf, mix);                    \
+    BENCHMARK_TEMPLATE_TOCHARS(fixed_std_to_chars, mix)
+
+FORMAT_BENCHMARKS(ints);
+FORMAT_BENCHMARKS(reals);
+FORMAT_BENCHMARKS(strings);
+FORMAT_BENCHMARKS(mixed);
+
+
+//-----------------------------------------------------------------------------
+// formatting into a string, resized as needed and overwritten
+
+template<class Mix>
+void resize_c4_catrs(bm::State &st)
+{
+    ring<Mix> r;
+    std::string s;
+    size_t bytes = 0;
+    for(auto _ : st)
+        bytes += Mix::apply(r.next(), c4_catrs_{&s});
+    report(st, bytes);
+}
+
+template<class Mix>
+void resize_c4_formatrs(bm::State &st)
+{
+    ring<Mix> r;
+    std::string s;
+    size_t bytes = 0;
+    for(auto _ : st)
+        bytes += Mix::apply(r.next(), c4_formatrs_{&s, c4::to_csubstr(Mix::c4_fmt())});
+    report(st, bytes);
+}
+
+/** a new string each time */
+template<class Mix>
+void resize_c4_formatrs_new(bm::State &st)
+{
+    ring<Mix> r;
+    size_t bytes = 0;
+    for(auto _ : st)
+    {
+        std::string s;
+        bytes += Mix::apply(r.next(), c4_formatrs_{&s, c4::to_csubstr(Mix::c4_fmt())});
+        bm::DoNotOptimize(s.data());
+    }
+    report(st, bytes);
+}
+
+template<class Mix>
+void resize_ostringstream(bm::State &st)
+{
+    ring<Mix> r;
+    std::ostringstream os;
+    size_t bytes = 0;
+    for(auto _ : st)
+    {
+        os.str("");
+        Mix::apply(r.next(), ostream_{&os});
+        bytes += static_cast<size_t>(os.tellp());
+    }
+    report(st, bytes);
+}
+
+/** a new stream each time */
+template<class Mix>
+void resize_ostringstream_new(bm::State &st)
+{
+    ring<Mix> r;
+    size_t bytes = 0;
+    for(auto _ : st)
+    {
+        std::ostringstream os;
+        Mix::apply(r.next(), ostream_{&os});
+        std::string s = os.str();
+        bytes += s.size();
+        bm::DoNotOptimize(s.data());
+    }
+    report(st, bytes);
+}
+
+#define RESIZE_BENCHMARKS(mix)                                  \
+    BENCHMARK_TEMPLATE(resize_c4_catrs, mix);                   \
+    BENCHMARK_TEMPLATE(resize_c4_formatrs, mix);                \
+    BENCHMARK_TEMPLATE(resize_c4_formatrs_new, mix);            \
+    BENCHMARK_TEMPLATE(resize_ostringstream, mix);              \
+    BENCHMARK_TEMPLATE(resize_ostringstream_new, mix)
+
+RESIZE_BENCHMARKS(ints);
+RESIZE_BENCHMARKS(reals);
+RESIZE_BENCHMARKS(strings);
+RESIZE_BENCHMARKS(mixed);
+
+
+//-----------------------------------------------------------------------------
+// appending to a string, as to a log buffer
+
+template<class Mix>
+void append_c4_catrs(bm::State &st)
+{
+    ring<Mix> r;
+    std::string s;
+    size_t bytes = 0;
+    for(auto _ : st)
+    {
+        if(s.size() > append_flush_size)
+            s.clear();
+        bytes += Mix::apply(r.next(), c4_catrs_append_{&s});
+    }
+    report(st, bytes);
+}
+
+template<class Mix>
+void append_c4_formatrs(bm::State &st)
+{
+    ring<Mix> r;
+    std::string s;
+    size_t bytes = 0;
+    for(auto _ : st)
+    {
+        if(s.size() > append_flush_size)
+            s.clear();
+        bytes += Mix::apply(r.next(), c4_formatrs_append_{&s, c4::to_csubstr(Mix::c4_fmt())});
+    }
+    report(st, bytes);
+}
+
+template<class Mix>
+void append_snprintf(bm::State &st)
+{
+    ring<Mix> r;
+    char buf[256];
+    std::string s;
+    size_t bytes = 0;
+    for(auto _ : st)
+    {
+        if(s.size() > append_flush_size)
+            s.clear();
+        // print to the stack, then copy
+        size_t len = Mix::apply(r.next(), snprintf_{buf, sizeof(buf), Mix::printf_fmt()});
+        s.append(buf, len);
+        bytes += len;
+    }
+    report(st, bytes);
+}
+
+template<class Mix>
+void append_ostringstream(bm::State &st)
+{
+    ring<Mix> r;
+    std::ostringstream os;
+    size_t bytes = 0;
+    for(auto _ : st)
+    {
+        const std::streamoff pos = os.tellp();
+        if(pos > static_cast<std::streamoff>(append_flush_size))
+            os.str("");
+        const std::streamoff start = os.tellp();
+        Mix::apply(r.next(), ostream_{&os});
+        bytes += static_cast<size_t>(os.tellp() - start);
+    }
+    report(st, bytes);
+}
+
+#define APPEND_BENCHMARKS(mix)                                  \
+    BENCHMARK_TEMPLATE(append_c4_catrs, mix);                   \
+    BENCHMARK_TEMPLATE(append_c4_formatrs, mix);                \
+    BENCHMARK_TEMPLATE(append_snprintf, mix);                   \
+    BENCHMARK_TEMPLATE(append_ostringstream, mix)
+
+APPEND_BENCHMARKS(ints);
+APPEND_BENCHMARKS(reals);
+APPEND_BENCHMARKS(strings);
+APPEND_BENCHMARKS(mixed);
+
+
+//-----------------------------------------------------------------------------
+// parsing the numbers back
+
+/** the values of a ring, printed */
+template<class Mix>
+struct printed
+{
+    std::vector<std::string> lines;
+    size_t bytes;
+    printed() : lines(), bytes(0)
+    {
+        ring<Mix> r;
+        char buf[256];
+        for(size_t i = 0; i < r.values.size(); ++i)
+        {
+            size_t len = Mix::apply(r.next(), c4_format_{buf, c4::to_csubstr(Mix::c4_fmt())});
+            lines.emplace_back(buf, len);
+            bytes += len;
+        }
+    }
+};
+
+template<class Mix, class Fn>
+void parse(bm::State &st, Fn &&fn)
+{
+    printed<Mix> p;
+    typename Mix::values v;
+    size_t i = 0, bytes = 0;
+    for(auto _ : st)
+    {
+        std::string const& line = p.lines[i];
+        i = (i + 1) % p.lines.size();
+        size_t ret = Mix::apply_out(v, fn(line));
+        bm::DoNotOptimize(ret);
+        bm::DoNotOptimize(v);
+        bytes += line.size();
+    }
+    report(st, bytes);
+}
+
+template<class Mix>
+void parse_c4_unformat(bm::State &st)
+{
+    parse<Mix>(st, [](std::string const& line){ return unformat_{c4::to_csubstr(line), c4::to_csubstr(Mix::c4_fmt())}; });
+}
+
+template<class Mix>
+void parse_sscanf(bm::State &st)
+{
+    parse<Mix>(st, [](std::string const& line){ return sscanf_{line.c_str(), Mix::scanf_fmt()}; });
+}
+
+template<class Mix>
+void parse_istringstream(bm::State &st)
+{
+    std::istringstream is;
+    parse<Mix>(st, [&is](std::string const& line){
+        is.clear();
+        is.str(line);
+        return istream_{&is};
+    });
+}
+
+#ifdef C4_BM_HAVE_TO_CHARS
+template<class Mix>
+void parse_std_from_chars(bm::State &st)
+{
+    parse<Mix>(st, [](std::string const& line){ return from_chars_{line.data(), line.data() + line.size()}; });
+}
+#endif
+
+#define PARSE_BENCHMARKS(mix)                                   \
+    BENCHMARK_TEMPLATE(parse_c4_unformat, mix);                 \
+    BENCHMARK_TEMPLATE(parse_sscanf, mix);                      \
+    BENCHMARK_TEMPLATE(parse_istringstream, mix);               \
+    BENCHMARK_TEMPLATE_TOCHARS(parse_std_from_chars, mix)
+
+PARSE_BENCHMARKS(ints);
+PARSE_BENCHMARKS(reals);
+
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bm::Initialize(&argc, argv);
+    bm::RunSpecifiedBenchmarks();
+    return 0;
+}
+
+#ifdef __clang__
+#   pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#   pragma GCC diagnostic pop
+#endif
+
+#include <c4/c4_pop.hpp>
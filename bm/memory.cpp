@@ -0,0 +1,456 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/memory_resource.hpp>
+#include <c4/allocator.hpp>
+#include <c4/histogram.hpp>
+#include <c4/time.hpp>
+#include <c4/libtest/rng.hpp>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if C4_CPP >= 17
+#include <memory_resource>
+#endif
+
+// benchmarks depending on c++17 features are disabled using the
+// preprocessor, as in charconv.cpp
+#if C4_CPP >= 17 && defined(__cpp_lib_memory_resource)
+#define C4_BM_HAVE_PMR
+#define MEMORY_BENCHMARK_PMR(fn, res) MEMORY_BENCHMARK(fn, res)
+#else
+#define MEMORY_BENCHMARK_PMR(...) void shutup_extra_semicolon()
+#endif
+
+// every benchmark runs from 1 thread up to the number of cores. Each
+// thread has its own resource, except for pmr_sync_pool.
+#define MEMORY_BENCHMARK(fn, res) BENCHMARK_TEMPLATE(fn, res)->ThreadRange(1, max_threads())->UseRealTime()
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// utilities for use in the benchmarks below
+
+int max_threads()
+{
+    const unsigned n = std::thread::hardware_concurrency();
+    return n ? static_cast<int>(n) : 1;
+}
+
+/** the blocks are allocated and freed in batches: a batch is
+ * allocated, then freed in reverse order */
+constexpr const size_t batch_size = 64;
+
+/** enough for a batch of the largest blocks of any distribution */
+constexpr const size_t linear_capacity = size_t(8) << 20;
+
+/** the sizes of a distribution, cycled through by each thread */
+struct size_table
+{
+    std::vector<size_t> const& sizes;
+    size_t pos;
+
+    size_table(std::vector<size_t> const& s) : sizes(s), pos(0) {}
+
+    size_t next()
+    {
+        const size_t sz = sizes[pos];
+        pos = (pos + 1) & (sizes.size() - 1);
+        return sz;
+    }
+};
+
+std::vector<size_t> const& fixed_sizes()
+{
+    static const std::vector<size_t> sizes(4096, size_t(64));
+    return sizes;
+}
+
+/** pareto-distributed sizes between 16 bytes and 64KB: mostly small,
+ * with a long tail of large blocks */
+std::vector<size_t> const& powerlaw_sizes()
+{
+    static const std::vector<size_t> sizes = []{
+        std::vector<size_t> s(4096);
+        uint64_t rng = 12345u;
+        for(size_t &sz : s)
+        {
+            // uniform in (0, 1]
+            const double u = (static_cast<double>(c4::next_rand(&rng)) + 1.) / 9007199254740992.;
+            const double v = 16. / std::pow(u, 1. / 1.1);
+            sz = v < 65536. ? static_cast<size_t>(v) : size_t(65536);
+        }
+        return s;
+    }();
+    return sizes;
+}
+
+
+/** latencies of a sample of the calls, in ticks of c4::tsc_clock.
+ * Only one in sample_period calls is timed, so that reading the clock
+ * does not weigh on the throughput; the timed latencies include the
+ * few nanoseconds it takes. */
+struct latency_sampler
+{
+    enum : uint64_t { sample_period = 16 };
+
+    c4::histogram hist;
+    uint64_t num_calls = 0;
+    c4::tsc_clock::ticks_type t0 = 0;
+
+    C4_ALWAYS_INLINE bool start() noexcept
+    {
+        if(++num_calls % sample_period)
+            return false;
+        t0 = c4::tsc_clock::now();
+        return true;
+    }
+
+    C4_ALWAYS_INLINE void stop(bool sampled) noexcept
+    {
+        if(sampled)
+            hist.record(c4::tsc_clock::now_ordered() - t0);
+    }
+
+    void report(bm::State &st, uint64_t num_bytes) const
+    {
+        st.SetItemsProcessed(static_cast<int64_t>(num_calls));
+        st.SetBytesProcessed(static_cast<int64_t>(num_bytes));
+        // percentiles cannot be summed across threads: report the
+        // average of the percentiles of each thread
+        auto pct = [this](double p) {
+            return bm::Counter(static_cast<double>(c4::tsc_clock::to_ns(hist.percentile(p))), bm::Counter::kAvgThreads);
+        };
+        st.counters["p50_ns"] = pct(50.);
+        st.counters["p99_ns"] = pct(99.);
+        st.counters["p99.9_ns"] = pct(99.9);
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+// the resources: each has allocate(), deallocate() and reallocate(),
+// and reset(), which is called after freeing each batch.
+
+struct malloc_
+{
+    void* allocate(size_t sz) { return ::malloc(sz); }
+    void deallocate(void *p, size_t) { ::free(p); }
+    void* reallocate(void *p, size_t, size_t newsz) { return ::realloc(p, newsz); }
+    void reset() {}
+};
+
+/** calls through the c4::MemoryResource interface */
+struct c4_resource_
+{
+    c4::MemoryResource *mr;
+    void* allocate(size_t sz) { return mr->allocate(sz); }
+    void deallocate(void *p, size_t sz) { mr->deallocate(p, sz); }
+    void* reallocate(void *p, size_t oldsz, size_t newsz) { return mr->reallocate(p, oldsz, newsz); }
+};
+
+struct c4_malloc : public c4_resource_
+{
+    c4::MemoryResourceMalloc res;
+    c4_malloc() : c4_resource_{&res} {}
+    void reset() {}
+};
+
+struct c4_linear : public c4_resource_
+{
+    c4::MemoryResourceLinear res;
+    c4_linear() : c4_resource_{&res}, res(linear_capacity) {}
+    void reset() { res.clear(); }
+};
+
+/** the small allocator serves the first 4KB of each batch from its
+ * own buffer, and the rest from the global memory resource. It needs
+ * the blocks to be freed in reverse order, and cannot reallocate. */
+struct c4_small
+{
+    c4::small_allocator<char, 4096, alignof(max_align_t)> alloc;
+    void* allocate(size_t sz) { return alloc.allocate(sz); }
+    void deallocate(void *p, size_t sz) { alloc.deallocate(static_cast<char*>(p), sz); }
+    void reset() {}
+};
+
+#ifdef C4_BM_HAVE_PMR
+/** calls through the std::pmr::memory_resource interface, which has no
+ * reallocation */
+struct pmr_resource_
+{
+    std::pmr::memory_resource *mr;
+    void* allocate(size_t sz) { return mr->allocate(sz, alignof(max_align_t)); }
+    void deallocate(void *p, size_t sz) { mr->deallocate(p, sz, alignof(max_align_t)); }
+    void* reallocate(void *p, size_t oldsz, size_t newsz)
+    {
+        void *q = allocate(newsz);
+        memcpy(q, p, oldsz < newsz ? oldsz : newsz);
+        deallocate(p, oldsz);
+        return q;
+    }
+};
+
+struct pmr_new_delete : public pmr_resource_
+{
+    pmr_new_delete() : pmr_resource_{std::pmr::new_delete_resource()} {}
+    void reset() {}
+};
+
+/** a single pool, shared by all threads */
+struct pmr_sync_pool : public pmr_resource_
+{
+    static std::pmr::synchronized_pool_resource* shared()
+    {
+        static std::pmr::synchronized_pool_resource res;
+        return &res;
+    }
+    pmr_sync_pool() : pmr_resource_{shared()} {}
+    void reset() {}
+};
+
+struct pmr_unsync_pool : public pmr_resource_
+{
+    std::pmr::unsynchronized_pool_resource res;
+    pmr_unsync_pool() : pmr_resource_{&res} {}
+    void reset() {}
+};
+
+/** with an initial buffer as large as that of c4_linear */
+struct pmr_monotonic : public pmr_resource_
+{
+    std::vector<char> buf;
+    std::pmr::monotonic_buffer_resource res;
+    pmr_monotonic() : pmr_resource_{&res}, buf(linear_capacity), res(buf.data(), buf.size()) {}
+    void reset() { res.release(); }
+};
+#endif
+
+
+//-----------------------------------------------------------------------------
+// allocate and free batches of blocks, with their sizes taken from a
+// distribution
+
+template<class Res>
+void alloc_free(bm::State &st, std::vector<size_t> const& sizes)
+{
+    Res res;
+    latency_sampler smp;
+    size_table dist{sizes};
+    void *blocks[batch_size];
+    size_t block_sizes[batch_size];
+    uint64_t num_bytes = 0;
+    for(auto _ : st)
+    {
+        for(size_t i = 0; i < batch_size; ++i)
+        {
+            const size_t sz = dist.next();
+            const bool sampled = smp.start();
+            void *p = res.allocate(sz);
+            smp.stop(sampled);
+            static_cast<char*>(p)[0] = static_cast<char>(i);
+            bm::DoNotOptimize(p);
+            blocks[i] = p;
+            block_sizes[i] = sz;
+            num_bytes += sz;
+        }
+        for(size_t i = batch_size; i > 0; --i)
+        {
+            const bool sampled = smp.start();
+            res.deallocate(blocks[i - 1], block_sizes[i - 1]);
+            smp.stop(sampled);
+        }
+        res.reset();
+    }
+    smp.report(st, num_bytes);
+}
+
+template<class Res> void fixed(bm::State &st) { alloc_free<Res>(st, fixed_sizes()); }
+template<class Res> void powerlaw(bm::State &st) { alloc_free<Res>(st, powerlaw_sizes()); }
+
+
+/** grow each block of a batch from 16 bytes to 4KB, doubling its size
+ * with each reallocation, as when appending to a buffer. Then free the
+ * batch in reverse order. */
+template<class Res>
+void realloc_growth(bm::State &st)
+{
+    constexpr const size_t initial_size = 16;
+    constexpr const size_t final_size = 4096;
+    Res res;
+    latency_sampler smp;
+    void *blocks[batch_size];
+    uint64_t num_bytes = 0;
+    for(auto _ : st)
+    {
+        for(size_t i = 0; i < batch_size; ++i)
+        {
+            bool sampled = smp.start();
+            void *p = res.allocate(initial_size);
+            smp.stop(sampled);
+            static_cast<char*>(p)[0] = static_cast<char>(i);
+            for(size_t sz = initial_size; sz < final_size; sz *= 2)
+            {
+                sampled = smp.start();
+                p = res.reallocate(p, sz, 2 * sz);
+                smp.stop(sampled);
+                static_cast<char*>(p)[2 * sz - 1] = static_cast<char>(i);
+            }
+            bm::DoNotOptimize(p);
+            blocks[i] = p;
+            num_bytes += final_size;
+        }
+        for(size_t i = batch_size; i > 0; --i)
+        {
+            const bool sampled = smp.start();
+            res.deallocate(blocks[i - 1], final_size);
+            smp.stop(sampled);
+        }
+        res.reset();
+    }
+    smp.report(st, num_bytes);
+}
+
+
+MEMORY_BENCHMARK(fixed, malloc_);
+MEMORY_BENCHMARK(fixed, c4_malloc);
+MEMORY_BENCHMARK(fixed, c4_linear);
+MEMORY_BENCHMARK(fixed, c4_small);
+MEMORY_BENCHMARK_PMR(fixed, pmr_new_delete);
+MEMORY_BENCHMARK_PMR(fixed, pmr_sync_pool);
+MEMORY_BENCHMARK_PMR(fixed, pmr_unsync_pool);
+MEMORY_BENCHMARK_PMR(fixed, pmr_monotonic);
+
+MEMORY_BENCHMARK(powerlaw, malloc_);
+MEMORY_BENCHMARK(powerlaw, c4_malloc);
+MEMORY_BENCHMARK(powerlaw, c4_linear);
+MEMORY_BENCHMARK(powerlaw, c4_small);
+MEMORY_BENCHMARK_PMR(powerlaw, pmr_new_delete);
+MEMORY_BENCHMARK_PMR(powerlaw, pmr_sync_pool);
+MEMORY_BENCHMARK_PMR(powerlaw, pmr_unsync_pool);
+MEMORY_BENCHMARK_PMR(powerlaw, pmr_monotonic);
+
+MEMORY_BENCHMARK(realloc_growth, malloc_);
+MEMORY_BENCHMARK(realloc_growth, c4_malloc);
+MEMORY_BENCHMARK(realloc_growth, c4_linear);
+MEMORY_BENCHMARK_PMR(realloc_growth, pmr_new_delete);
+MEMORY_BENCHMARK_PMR(realloc_growth, pmr_sync_pool);
+MEMORY_BENCHMARK_PMR(realloc_growth, pmr_unsync_pool);
+MEMORY_BENCHMARK_PMR(realloc_growth, pmr_monotonic);
+
+
+//-----------------------------------------------------------------------------
+// the allocators inside std containers. Each provider gives the
+// allocator type for the container, and the allocator to construct it
+// with; reset() is called after destroying the container.
+
+struct std_alloc
+{
+    template<class T> using type = std::allocator<T>;
+    template<class T> type<T> get() { return type<T>(); }
+    void reset() {}
+};
+
+/** c4::allocator, with the global memory resource */
+struct c4_alloc
+{
+    template<class T> using type = c4::allocator<T>;
+    template<class T> type<T> get() { return type<T>(); }
+    void reset() {}
+};
+
+/** c4::allocator_mr, with a linear memory resource */
+struct c4_alloc_linear
+{
+    c4::MemoryResourceLinear res{size_t(1) << 20};
+    template<class T> using type = c4::allocator_mr<T>;
+    template<class T> type<T> get() { return type<T>(&res); }
+    void reset() { res.clear(); }
+};
+
+#ifdef C4_BM_HAVE_PMR
+struct pmr_alloc_unsync_pool
+{
+    std::pmr::unsynchronized_pool_resource res;
+    template<class T> using type = std::pmr::polymorphic_allocator<T>;
+    template<class T> type<T> get() { return type<T>(&res); }
+    void reset() {}
+};
+
+struct pmr_alloc_monotonic
+{
+    std::vector<char> buf;
+    std::pmr::monotonic_buffer_resource res;
+    pmr_alloc_monotonic() : buf(size_t(1) << 20), res(buf.data(), buf.size()) {}
+    template<class T> using type = std::pmr::polymorphic_allocator<T>;
+    template<class T> type<T> get() { return type<T>(&res); }
+    void reset() { res.release(); }
+};
+#endif
+
+/** push_back into an empty vector, growing it geometrically */
+template<class Alloc>
+void vector_push_back(bm::State &st)
+{
+    constexpr const int num_elms = 1000;
+    using vector_type = std::vector<int, typename Alloc::template type<int>>;
+    Alloc alloc;
+    for(auto _ : st)
+    {
+        {
+            vector_type v(alloc.template get<int>());
+            for(int i = 0; i < num_elms; ++i)
+                v.push_back(i);
+            bm::DoNotOptimize(v.data());
+        }
+        alloc.reset();
+    }
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations()) * num_elms);
+}
+
+/** insert into an empty map, allocating one node per element */
+template<class Alloc>
+void map_insert(bm::State &st)
+{
+    constexpr const int num_elms = 256;
+    using map_type = std::map<int, int, std::less<int>, typename Alloc::template type<std::pair<const int, int>>>;
+    Alloc alloc;
+    for(auto _ : st)
+    {
+        {
+            map_type m(alloc.template get<std::pair<const int, int>>());
+            uint64_t rng = 12345u;
+            for(int i = 0; i < num_elms; ++i)
+                m.emplace(static_cast<int>(c4::next_rand(&rng) >> 29), i);
+            bm::DoNotOptimize(m.size());
+        }
+        alloc.reset();
+    }
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations()) * num_elms);
+}
+
+MEMORY_BENCHMARK(vector_push_back, std_alloc);
+MEMORY_BENCHMARK(vector_push_back, c4_alloc);
+MEMORY_BENCHMARK(vector_push_back, c4_alloc_linear);
+MEMORY_BENCHMARK_PMR(vector_push_back, pmr_alloc_unsync_pool);
+MEMORY_BENCHMARK_PMR(vector_push_back, pmr_alloc_monotonic);
+
+MEMORY_BENCHMARK(map_insert, std_alloc);
+MEMORY_BENCHMARK(map_insert, c4_alloc);
+MEMORY_BENCHMARK(map_insert, c4_alloc_linear);
+MEMORY_BENCHMARK_PMR(map_insert, pmr_alloc_unsync_pool);
+MEMORY_BENCHMARK_PMR(map_insert, pmr_alloc_monotonic);
+
+
+//-----------------------------------------------------------------------------
+
+#include <c4/c4_pop.hpp>
+
+BENCHMARK_MAIN();
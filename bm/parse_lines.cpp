@@ -0,0 +1,96 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/parse_lines.hpp>
+#include <c4/format.hpp>
+#include <c4/std/string.hpp>
+#include <string>
+#include <vector>
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// utilities for use in the benchmarks below
+
+/** a buffer with one number per line, and room for the parsed values */
+template<class T>
+struct lines_data
+{
+    std::string buf;
+    std::vector<T> out;
+
+    lines_data(size_t num)
+    {
+        char tmp[64];
+        for(size_t i = 0; i < num; ++i)
+        {
+            // scatter the values, so that the lines have different lengths
+            T val = static_cast<T>((i * UINT64_C(2654435761)) % UINT64_C(100000007)) / T(8);
+            c4::substr s = c4::cat_sub(tmp, val, '\n');
+            buf.append(s.str, s.len);
+        }
+        out.resize(num);
+    }
+};
+
+template<class T>
+lines_data<T> const& get_lines_data()
+{
+    static const lines_data<T> data(1000000);
+    return data;
+}
+
+template<class T>
+void report(bm::State &st, lines_data<T> const& data)
+{
+    st.SetBytesProcessed(static_cast<int64_t>(st.iterations() * data.buf.size()));
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations() * data.out.size()));
+}
+
+
+//-----------------------------------------------------------------------------
+
+template<class T>
+void parse_lines_serial(bm::State &st)
+{
+    lines_data<T> const& data = get_lines_data<T>();
+    std::vector<T> out(data.out.size());
+    for(auto _ : st)
+    {
+        c4::parse_lines_result r = c4::parse_lines(c4::to_csubstr(data.buf), c4::span<T>(out.data(), out.size()));
+        bm::DoNotOptimize(r);
+    }
+    report(st, data);
+}
+
+template<class T>
+void parse_lines_parallel(bm::State &st)
+{
+    lines_data<T> const& data = get_lines_data<T>();
+    std::vector<T> out(data.out.size());
+    c4::thread_pool pool(static_cast<size_t>(st.range(0)));
+    for(auto _ : st)
+    {
+        c4::parse_lines_result r = c4::parse_lines_parallel(c4::to_csubstr(data.buf), c4::span<T>(out.data(), out.size()), pool);
+        bm::DoNotOptimize(r);
+    }
+    report(st, data);
+}
+
+BENCHMARK_TEMPLATE(parse_lines_serial, int64_t);
+BENCHMARK_TEMPLATE(parse_lines_parallel, int64_t)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(parse_lines_serial, double);
+BENCHMARK_TEMPLATE(parse_lines_parallel, double)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bm::Initialize(&argc, argv);
+    bm::RunSpecifiedBenchmarks();
+    return 0;
+}
+
+#include <c4/c4_pop.hpp>
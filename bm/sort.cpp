@@ -0,0 +1,157 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/sort.hpp>
+#include <c4/libtest/rng.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// utilities for use in the benchmarks below
+
+template<class T>
+std::vector<T> const& get_vals(size_t num)
+{
+    static std::vector<T> vals;
+    if(vals.size() != num)
+    {
+        vals.resize(num);
+        uint64_t rng = 12345u;
+        for(T &v : vals)
+        {
+            const uint64_t r = c4::next_rand(&rng);
+            memcpy(&v, &r, sizeof(T));
+        }
+    }
+    return vals;
+}
+
+/** lines of text with a few shared prefixes, as from a log or a
+ * listing of paths */
+std::vector<std::string> const& get_strings(size_t num)
+{
+    static std::vector<std::string> strs;
+    if(strs.size() != num)
+    {
+        static const char *const prefixes[] = {"/usr/lib/", "/usr/include/c4/", "/home/user/src/", "/var/log/"};
+        strs.resize(num);
+        uint64_t rng = 12345u;
+        for(std::string &s : strs)
+        {
+            s = prefixes[c4::next_rand(&rng) % 4u];
+            const size_t len = 4u + c4::next_rand(&rng) % 20u;
+            for(size_t i = 0; i < len; ++i)
+                s += static_cast<char>('a' + c4::next_rand(&rng) % 26u);
+        }
+    }
+    return strs;
+}
+
+c4::thread_pool& get_pool()
+{
+    static c4::thread_pool pool;
+    return pool;
+}
+
+template<class T, class Fn>
+void sort_vals(bm::State &st, Fn &&fn)
+{
+    std::vector<T> const& src = get_vals<T>(static_cast<size_t>(st.range(0)));
+    std::vector<T> vals(src.size());
+    for(auto _ : st)
+    {
+        st.PauseTiming();
+        vals = src;
+        st.ResumeTiming();
+        fn(vals);
+        bm::DoNotOptimize(vals.data());
+    }
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations() * src.size()));
+}
+
+template<class Fn>
+void sort_strings(bm::State &st, Fn &&fn)
+{
+    std::vector<std::string> const& strs = get_strings(static_cast<size_t>(st.range(0)));
+    std::vector<c4::csubstr> src;
+    for(std::string const& s : strs)
+        src.push_back(c4::csubstr(s.data(), s.size()));
+    std::vector<c4::csubstr> vals(src.size());
+    for(auto _ : st)
+    {
+        st.PauseTiming();
+        vals = src;
+        st.ResumeTiming();
+        fn(vals);
+        bm::DoNotOptimize(vals.data());
+    }
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations() * src.size()));
+}
+
+
+//-----------------------------------------------------------------------------
+
+/** the baseline */
+template<class T>
+void std_sort(bm::State &st)
+{
+    sort_vals<T>(st, [](std::vector<T> &v){ std::sort(v.begin(), v.end()); });
+}
+template<class T>
+void radix_sort(bm::State &st)
+{
+    sort_vals<T>(st, [](std::vector<T> &v){ c4::radix_sort(c4::span<T>(v.data(), v.size())); });
+}
+template<class T>
+void radix_sort_parallel(bm::State &st)
+{
+    sort_vals<T>(st, [](std::vector<T> &v){ c4::radix_sort(get_pool(), c4::span<T>(v.data(), v.size())); });
+}
+
+#define SORT_BENCHMARK(fn) \
+    BENCHMARK_TEMPLATE(fn, uint32_t)->Arg(1000)->Arg(1 << 20); \
+    BENCHMARK_TEMPLATE(fn, int64_t)->Arg(1000)->Arg(1 << 20); \
+    BENCHMARK_TEMPLATE(fn, double)->Arg(1000)->Arg(1 << 20)
+
+SORT_BENCHMARK(std_sort);
+SORT_BENCHMARK(radix_sort);
+SORT_BENCHMARK(radix_sort_parallel);
+
+
+//-----------------------------------------------------------------------------
+
+/** the baseline, with csubstr::compare() */
+void std_sort_strings(bm::State &st)
+{
+    sort_strings(st, [](std::vector<c4::csubstr> &v){
+        std::sort(v.begin(), v.end(), [](c4::csubstr a, c4::csubstr b){ return a.compare(b) < 0; });
+    });
+}
+void string_sort(bm::State &st)
+{
+    sort_strings(st, [](std::vector<c4::csubstr> &v){ c4::string_sort(c4::span<c4::csubstr>(v.data(), v.size())); });
+}
+void string_sort_parallel(bm::State &st)
+{
+    sort_strings(st, [](std::vector<c4::csubstr> &v){ c4::string_sort(get_pool(), c4::span<c4::csubstr>(v.data(), v.size())); });
+}
+
+BENCHMARK(std_sort_strings)->Arg(1000)->Arg(1 << 18);
+BENCHMARK(string_sort)->Arg(1000)->Arg(1 << 18);
+BENCHMARK(string_sort_parallel)->Arg(1000)->Arg(1 << 18);
+
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bm::Initialize(&argc, argv);
+    bm::RunSpecifiedBenchmarks();
+    return 0;
+}
+
+#include <c4/c4_pop.hpp>
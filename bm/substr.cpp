@@ -0,0 +1,451 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/substr.hpp>
+#include <c4/std/string.hpp>
+#include <c4/libtest/rng.hpp>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#if C4_CPP >= 17
+#include <string_view>
+#endif
+
+#if defined(__GLIBC__) || defined(__APPLE__) || defined(__FreeBSD__)
+#define C4_BM_HAVE_MEMMEM
+#endif
+
+// every benchmark runs over each of the inputs: short, log and adversarial
+#define SUBSTR_BENCHMARK(fn) BENCHMARK(fn)->DenseRange(0, 2)
+
+// benchmarks depending on c++17 features are disabled using the
+// preprocessor, as in charconv.cpp
+#if C4_CPP >= 17
+#define SUBSTR_BENCHMARK_CPP17(fn) SUBSTR_BENCHMARK(fn)
+#else
+#define SUBSTR_BENCHMARK_CPP17(fn) void shutup_extra_semicolon_##fn()
+#endif
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// utilities for use in the benchmarks below
+
+/** a set of inputs, with the needles searched in them. Each benchmark
+ * processes all the inputs in every iteration, and reports the bytes
+ * of the inputs per second. */
+struct substr_data
+{
+    const char *name;
+    std::vector<std::string> inputs;
+    std::vector<std::string> copies; ///< equal to inputs, for comparing
+    char chr;            ///< searched, and used as a separator
+    std::string pattern; ///< searched
+    std::string other;   ///< searched together with pattern
+    std::string chars;   ///< a set of chars to search
+    std::string span;    ///< a set of chars to skip
+    std::string repl;    ///< replaces pattern
+    size_t bytes;
+
+    void finish()
+    {
+        copies = inputs;
+        bytes = 0;
+        for(std::string const& s : inputs)
+            bytes += s.size();
+    }
+};
+
+struct substr_rng
+{
+    uint64_t state = 12345u;
+    uint32_t operator() (uint32_t mod)
+    {
+        return static_cast<uint32_t>(c4::next_rand(&state) % mod);
+    }
+};
+
+/** short configuration keys and values, some padded with blanks */
+substr_data make_short_data()
+{
+    substr_data d;
+    d.name = "short";
+    const char *keys[] = {"port", "host", "db.primary.host", "db.replica.port", "log.level", "timeout_ms",
+                          "tls.cert", "tls.key", "max_conn", "user", "workers", "cache.size.mb"};
+    const char *pads[] = {"", " ", "  ", "\t"};
+    substr_rng rng;
+    for(int i = 0; i < 256; ++i)
+    {
+        std::string s = pads[rng(4)];
+        s += keys[rng(C4_COUNTOF(keys))];
+        s += pads[rng(4)];
+        d.inputs.push_back(s);
+    }
+    d.chr = '.';
+    d.pattern = "port";
+    d.other = "host";
+    d.chars = " \t";
+    d.span = " \t";
+    d.repl = "PORT";
+    d.finish();
+    return d;
+}
+
+/** lines of an access log, around 200 bytes each */
+substr_data make_log_data()
+{
+    substr_data d;
+    d.name = "log";
+    const char *levels[] = {"INFO ", "INFO ", "INFO ", "DEBUG", "WARN ", "ERROR"};
+    const char *paths[] = {"/api/v1/items", "/api/v1/items/8812/reviews", "/healthz", "/static/js/app.3f9a2c.js", "/api/v2/search?q=c4core&page=3"};
+    const int statuses[] = {200, 200, 200, 204, 304, 404, 500};
+    substr_rng rng;
+    char buf[512];
+    for(int i = 0; i < 256; ++i)
+    {
+        int len = snprintf(buf, sizeof(buf),
+                           "2024-05-%02u %02u:%02u:%02u.%03u %s [worker-%u] request id=%08x%08x method=GET path=%s "
+                           "status=%d latency_ms=%u.%u bytes=%u agent=\"Mozilla/5.0 (X11; Linux x86_64) Gecko/20100101 Firefox/125.0\"",
+                           1u + rng(28), rng(24), rng(60), rng(60), rng(1000), levels[rng(C4_COUNTOF(levels))],
+                           rng(16), rng(0xffffffffu), rng(0xffffffffu), paths[rng(C4_COUNTOF(paths))],
+                           statuses[rng(C4_COUNTOF(statuses))], rng(500), rng(10), rng(100000));
+        d.inputs.emplace_back(buf, static_cast<size_t>(len));
+    }
+    d.chr = '=';
+    d.pattern = "status=500";
+    d.other = "ERROR";
+    d.chars = "\"[";
+    d.span = "0123456789-:. ";
+    d.repl = "status=Internal Server Error";
+    d.finish();
+    return d;
+}
+
+/** long runs of a repeated character, with the needles (nearly)
+ * matching everywhere: the worst case of the naive searches */
+substr_data make_adversarial_data()
+{
+    substr_data d;
+    d.name = "adversarial";
+    for(int i = 0; i < 16; ++i)
+        d.inputs.push_back(std::string(4096, 'a') + "b");
+    d.chr = 'b';
+    d.pattern = std::string(31, 'a') + "b";
+    d.other = std::string(31, 'a') + "c";
+    d.chars = "bc";
+    d.span = "a";
+    d.repl = "x";
+    d.finish();
+    return d;
+}
+
+substr_data& get_substr_data(int64_t which)
+{
+    static substr_data short_data = make_short_data();
+    static substr_data log_data = make_log_data();
+    static substr_data adversarial_data = make_adversarial_data();
+    switch(which)
+    {
+    case 0: return short_data;
+    case 1: return log_data;
+    default: return adversarial_data;
+    }
+}
+
+/** run fn(input, data) over all the inputs, and report */
+template<class Fn>
+void run(bm::State &st, Fn &&fn)
+{
+    substr_data &data = get_substr_data(st.range(0));
+    st.SetLabel(data.name);
+    for(auto _ : st)
+    {
+        size_t acc = 0;
+        for(size_t i = 0, e = data.inputs.size(); i < e; ++i)
+            acc += fn(i, data);
+        bm::DoNotOptimize(acc);
+    }
+    st.SetBytesProcessed(static_cast<int64_t>(st.iterations() * data.bytes));
+}
+
+c4::csubstr input(substr_data const& d, size_t i) { return c4::to_csubstr(d.inputs[i]); }
+
+#if C4_CPP >= 17
+std::string_view input_sv(substr_data const& d, size_t i) { return std::string_view(d.inputs[i]); }
+#endif
+
+
+//-----------------------------------------------------------------------------
+// find a char
+
+void find_char_c4(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){ return input(d, i).find(d.chr); });
+}
+void find_char_memchr(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){
+        std::string const& s = d.inputs[i];
+        const void *p = memchr(s.data(), d.chr, s.size());
+        return p ? static_cast<size_t>(static_cast<const char*>(p) - s.data()) : c4::csubstr::npos;
+    });
+}
+#if C4_CPP >= 17
+void find_char_stdsv(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){ return input_sv(d, i).find(d.chr); });
+}
+#endif
+
+SUBSTR_BENCHMARK(find_char_c4);
+SUBSTR_BENCHMARK(find_char_memchr);
+SUBSTR_BENCHMARK_CPP17(find_char_stdsv);
+
+
+//-----------------------------------------------------------------------------
+// find a substring
+
+void find_str_c4(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){ return input(d, i).find(c4::to_csubstr(d.pattern)); });
+}
+#ifdef C4_BM_HAVE_MEMMEM
+void find_str_memmem(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){
+        std::string const& s = d.inputs[i];
+        const void *p = memmem(s.data(), s.size(), d.pattern.data(), d.pattern.size());
+        return p ? static_cast<size_t>(static_cast<const char*>(p) - s.data()) : c4::csubstr::npos;
+    });
+}
+SUBSTR_BENCHMARK(find_str_memmem);
+#endif
+#if C4_CPP >= 17
+void find_str_stdsv(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){ return input_sv(d, i).find(d.pattern); });
+}
+#endif
+
+SUBSTR_BENCHMARK(find_str_c4);
+SUBSTR_BENCHMARK_CPP17(find_str_stdsv);
+
+
+//-----------------------------------------------------------------------------
+// find any of a set of chars
+
+void first_of_c4(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){ return input(d, i).first_of(c4::to_csubstr(d.chars)); });
+}
+void first_of_strcspn(bm::State &st)
+{
+    // the inputs have no null chars, and are null-terminated
+    run(st, [](size_t i, substr_data const& d){ return strcspn(d.inputs[i].c_str(), d.chars.c_str()); });
+}
+#if C4_CPP >= 17
+void first_of_stdsv(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){ return input_sv(d, i).find_first_of(d.chars); });
+}
+#endif
+
+SUBSTR_BENCHMARK(first_of_c4);
+SUBSTR_BENCHMARK(first_of_strcspn);
+SUBSTR_BENCHMARK_CPP17(first_of_stdsv);
+
+void first_not_of_c4(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){ return input(d, i).first_not_of(c4::to_csubstr(d.span)); });
+}
+void first_not_of_strspn(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){ return strspn(d.inputs[i].c_str(), d.span.c_str()); });
+}
+#if C4_CPP >= 17
+void first_not_of_stdsv(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){ return input_sv(d, i).find_first_not_of(d.span); });
+}
+#endif
+
+SUBSTR_BENCHMARK(first_not_of_c4);
+SUBSTR_BENCHMARK(first_not_of_strspn);
+SUBSTR_BENCHMARK_CPP17(first_not_of_stdsv);
+
+
+//-----------------------------------------------------------------------------
+// find the first of several substrings
+
+void first_of_any_c4(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){
+        return input(d, i).first_of_any(c4::to_csubstr(d.pattern), c4::to_csubstr(d.other)).pos;
+    });
+}
+#if C4_CPP >= 17
+void first_of_any_stdsv(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){
+        const size_t p0 = input_sv(d, i).find(d.pattern);
+        const size_t p1 = input_sv(d, i).find(d.other);
+        return p0 < p1 ? p0 : p1;
+    });
+}
+#endif
+
+SUBSTR_BENCHMARK(first_of_any_c4);
+SUBSTR_BENCHMARK_CPP17(first_of_any_stdsv);
+
+
+//-----------------------------------------------------------------------------
+// trim both ends
+
+void trim_c4(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){ return input(d, i).trim(c4::to_csubstr(" \ta")).len; });
+}
+#if C4_CPP >= 17
+void trim_stdsv(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){
+        std::string_view s = input_sv(d, i);
+        const size_t b = s.find_first_not_of(" \ta");
+        if(b == std::string_view::npos)
+            return size_t(0);
+        return s.find_last_not_of(" \ta") + 1 - b;
+    });
+}
+#endif
+
+SUBSTR_BENCHMARK(trim_c4);
+SUBSTR_BENCHMARK_CPP17(trim_stdsv);
+
+
+//-----------------------------------------------------------------------------
+// split on a char
+
+void split_c4(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){
+        size_t acc = 0;
+        for(c4::csubstr part : input(d, i).split(d.chr))
+            acc += part.len ? static_cast<uint8_t>(part.str[0]) : 1u;
+        return acc;
+    });
+}
+void split_c4_next_split(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){
+        size_t acc = 0, pos = 0;
+        c4::csubstr s = input(d, i), part;
+        while(s.next_split(d.chr, &pos, &part))
+            acc += part.len ? static_cast<uint8_t>(part.str[0]) : 1u;
+        return acc;
+    });
+}
+#if C4_CPP >= 17
+void split_stdsv(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){
+        size_t acc = 0, pos = 0;
+        std::string_view s = input_sv(d, i);
+        while(true)
+        {
+            const size_t e = s.find(d.chr, pos);
+            const std::string_view part = s.substr(pos, e == std::string_view::npos ? e : e - pos);
+            acc += part.size() ? static_cast<uint8_t>(part[0]) : 1u;
+            if(e == std::string_view::npos)
+                break;
+            pos = e + 1;
+        }
+        return acc;
+    });
+}
+#endif
+
+SUBSTR_BENCHMARK(split_c4);
+SUBSTR_BENCHMARK(split_c4_next_split);
+SUBSTR_BENCHMARK_CPP17(split_stdsv);
+
+
+//-----------------------------------------------------------------------------
+// compare equal strings (the worst case)
+
+void compare_c4(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){
+        return static_cast<size_t>(input(d, i).compare(c4::to_csubstr(d.copies[i])) == 0);
+    });
+}
+void compare_memcmp(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){
+        std::string const& a = d.inputs[i], &b = d.copies[i];
+        return static_cast<size_t>(a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0);
+    });
+}
+#if C4_CPP >= 17
+void compare_stdsv(bm::State &st)
+{
+    run(st, [](size_t i, substr_data const& d){
+        return static_cast<size_t>(input_sv(d, i).compare(std::string_view(d.copies[i])) == 0);
+    });
+}
+#endif
+
+SUBSTR_BENCHMARK(compare_c4);
+SUBSTR_BENCHMARK(compare_memcmp);
+SUBSTR_BENCHMARK_CPP17(compare_stdsv);
+
+
+//-----------------------------------------------------------------------------
+// replace all the occurrences of a substring
+
+void replace_all_c4(bm::State &st)
+{
+    std::string buf;
+    run(st, [&buf](size_t i, substr_data &d){
+        // replace_all() is only available in (writeable) substr
+        c4::substr s = c4::to_substr(d.inputs[i]);
+        buf.resize(2 * s.len + d.repl.size());
+        return s.replace_all(c4::to_substr(buf), c4::to_csubstr(d.pattern), c4::to_csubstr(d.repl));
+    });
+}
+void replace_all_stdstring(bm::State &st)
+{
+    std::string buf;
+    run(st, [&buf](size_t i, substr_data const& d){
+        std::string const& s = d.inputs[i];
+        buf.clear();
+        size_t pos = 0;
+        while(true)
+        {
+            const size_t e = s.find(d.pattern, pos);
+            if(e == std::string::npos)
+                break;
+            buf.append(s, pos, e - pos);
+            buf.append(d.repl);
+            pos = e + d.pattern.size();
+        }
+        buf.append(s, pos, std::string::npos);
+        return buf.size();
+    });
+}
+
+SUBSTR_BENCHMARK(replace_all_c4);
+SUBSTR_BENCHMARK(replace_all_stdstring);
+
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bm::Initialize(&argc, argv);
+    bm::RunSpecifiedBenchmarks();
+    return 0;
+}
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,104 @@
+#include <benchmark/benchmark.h>
+#include <c4/c4_push.hpp>
+#include <c4/varint.hpp>
+#include <c4/cpu_features.hpp>
+#include <c4/libtest/rng.hpp>
+#include <string>
+#include <vector>
+
+
+namespace bm = benchmark;
+
+
+//-----------------------------------------------------------------------------
+// utilities for use in the benchmarks below
+
+/** random values of up to a number of bits, like the deltas of a
+ * sorted list of ids, and their varints */
+struct varint_data
+{
+    std::vector<uint32_t> vals;
+    std::vector<uint32_t> out;
+    std::string encoded;
+
+    varint_data(size_t num, unsigned max_bits)
+    {
+        uint64_t rng = 12345u;
+        vals.resize(num);
+        for(uint32_t &v : vals)
+        {
+            const unsigned bits = 1u + static_cast<unsigned>(c4::next_rand(&rng) % max_bits);
+            v = static_cast<uint32_t>(c4::next_rand(&rng)) & (UINT32_C(0xffffffff) >> (32u - bits));
+        }
+        c4::cspan<uint32_t> s(vals.data(), vals.size());
+        encoded.resize(c4::varint_encode({}, s));
+        c4::varint_encode(c4::blob(&encoded[0], encoded.size()), s);
+        out.resize(num);
+    }
+};
+
+enum : size_t { num_vals = 1 << 16 };
+
+varint_data& get_varint_data(int64_t max_bits)
+{
+    static varint_data d7(num_vals, 7), d14(num_vals, 14), d21(num_vals, 21), d32(num_vals, 32);
+    return max_bits <= 7 ? d7 : max_bits <= 14 ? d14 : max_bits <= 21 ? d21 : d32;
+}
+
+typedef size_t (*decode_fn)(c4::cblob, c4::span<uint32_t>);
+
+void decode(bm::State &st, decode_fn fn)
+{
+    varint_data &data = get_varint_data(st.range(0));
+    for(auto _ : st)
+    {
+        size_t len = fn(c4::cblob(data.encoded.data(), data.encoded.size()), c4::span<uint32_t>(data.out.data(), data.out.size()));
+        bm::DoNotOptimize(len);
+    }
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations() * data.vals.size()));
+    st.SetBytesProcessed(static_cast<int64_t>(st.iterations() * data.encoded.size()));
+}
+
+
+//-----------------------------------------------------------------------------
+
+void varint_encode(bm::State &st)
+{
+    varint_data &data = get_varint_data(st.range(0));
+    for(auto _ : st)
+    {
+        size_t len = c4::varint_encode(c4::blob(&data.encoded[0], data.encoded.size()), c4::cspan<uint32_t>(data.vals.data(), data.vals.size()));
+        bm::DoNotOptimize(len);
+    }
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations() * data.vals.size()));
+    st.SetBytesProcessed(static_cast<int64_t>(st.iterations() * data.encoded.size()));
+}
+
+void varint_decode_dispatch(bm::State &st) { decode(st, &c4::varint_decode); }
+void varint_decode_scalar(bm::State &st) { decode(st, &c4::detail::varint_decode_scalar); }
+
+BENCHMARK(varint_encode)->Arg(7)->Arg(14)->Arg(21)->Arg(32);
+BENCHMARK(varint_decode_dispatch)->Arg(7)->Arg(14)->Arg(21)->Arg(32);
+BENCHMARK(varint_decode_scalar)->Arg(7)->Arg(14)->Arg(21)->Arg(32);
+
+#ifdef C4_VARINT_X86
+void varint_decode_ssse3(bm::State &st)
+{
+    if( ! c4::cpu_has(c4::CPU_SSSE3))
+        st.SkipWithError("ssse3 is not supported");
+    decode(st, &c4::detail::varint_decode_ssse3);
+}
+BENCHMARK(varint_decode_ssse3)->Arg(7)->Arg(14)->Arg(21)->Arg(32);
+#endif
+
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bm::Initialize(&argc, argv);
+    bm::RunSpecifiedBenchmarks();
+    return 0;
+}
+
+#include <c4/c4_pop.hpp>
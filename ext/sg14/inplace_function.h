@@ -26,6 +26,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <memory>
+#include <new>
 #include <type_traits>
 #include <utility>
 #include <functional>
@@ -41,7 +44,7 @@ template<size_t Cap>
 union aligned_storage_helper {
     struct double1 { double a; };
     struct double4 { double a[4]; };
-    template<class T> using maybe = std::conditional_t<(Cap >= sizeof(T)), T, char>;
+    template<class T> using maybe = typename std::conditional<(Cap >= sizeof(T)), T, char>::type;
     char real_data[Cap];
     maybe<int> a;
     maybe<long> b;
@@ -55,14 +58,15 @@ union aligned_storage_helper {
 
 template<size_t Cap, size_t Align = std::alignment_of<aligned_storage_helper<Cap>>::value>
 struct aligned_storage {
-    using type = std::aligned_storage_t<Cap, Align>;
+    using type = typename std::aligned_storage<Cap, Align>::type;
 };
 
 template<size_t Cap, size_t Align = std::alignment_of<aligned_storage_helper<Cap>>::value>
 using aligned_storage_t = typename aligned_storage<Cap, Align>::type;
 #else
 using std::aligned_storage;
-using std::aligned_storage_t;
+template<size_t Cap, size_t Align = std::alignment_of<typename std::aligned_storage<Cap>::type>::value>
+using aligned_storage_t = typename std::aligned_storage<Cap, Align>::type;
 #endif
 
 template<typename T> struct wrapper
@@ -122,11 +126,13 @@ template<typename R, typename... Args> struct vtable
     ~vtable() = default;
 };
 
+// a function instead of a variable template, to work with C++11
 template<typename R, typename... Args>
-#if __cplusplus >= 201703L
-inline constexpr
-#endif
-vtable<R, Args...> empty_vtable{};
+const vtable<R, Args...>& empty_vtable()
+{
+    static const vtable<R, Args...> vt{};
+    return vt;
+}
 
 template<size_t DstCap, size_t DstAlign, size_t SrcCap, size_t SrcAlign>
 struct is_valid_inplace_dst : std::true_type
@@ -168,16 +174,16 @@ public:
     template <typename, size_t, size_t>	friend class inplace_function;
 
     inplace_function() noexcept :
-        vtable_ptr_{std::addressof(inplace_function_detail::empty_vtable<R, Args...>)}
+        vtable_ptr_{std::addressof(inplace_function_detail::empty_vtable<R, Args...>())}
     {}
 
     template<
         typename T,
-        typename C = std::decay_t<T>,
-        typename = std::enable_if_t<
+        typename C = typename std::decay<T>::type,
+        typename = typename std::enable_if<
             !(std::is_same<C, inplace_function>::value
             || std::is_convertible<C, inplace_function>::value)
-        >
+        >::type
     >
     inplace_function(T&& closure)
     {
@@ -205,7 +211,7 @@ public:
     }
 
     inplace_function(std::nullptr_t) noexcept :
-        vtable_ptr_{std::addressof(inplace_function_detail::empty_vtable<R, Args...>)}
+        vtable_ptr_{std::addressof(inplace_function_detail::empty_vtable<R, Args...>())}
     {}
 
     inplace_function(const inplace_function& other) :
@@ -229,7 +235,7 @@ public:
     inplace_function& operator= (std::nullptr_t) noexcept
     {
         vtable_ptr_->destructor_ptr(std::addressof(storage_));
-        vtable_ptr_ = std::addressof(inplace_function_detail::empty_vtable<R, Args...>);
+        vtable_ptr_ = std::addressof(inplace_function_detail::empty_vtable<R, Args...>());
         return *this;
     }
 
@@ -288,7 +294,7 @@ public:
 
     explicit constexpr operator bool() const noexcept
     {
-        return vtable_ptr_ != std::addressof(inplace_function_detail::empty_vtable<R, Args...>);
+        return vtable_ptr_ != std::addressof(inplace_function_detail::empty_vtable<R, Args...>());
     }
 
     template<size_t Cap, size_t Align>
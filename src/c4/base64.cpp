@@ -1,4 +1,11 @@
 #include "c4/base64.hpp"
+#include "c4/cpu_features.hpp"
+
+#include <string.h>
+
+#ifdef C4_BASE64_X86
+#   include <immintrin.h>
+#endif
 
 #ifdef __clang__
 #   pragma clang diagnostic push
@@ -71,42 +78,59 @@ constexpr static const char base64_char_to_sextet_[128] = {
 } // namespace detail
 
 
-bool base64_valid(csubstr encoded)
+namespace detail {
+
+namespace {
+
+/** the lookup tables of an alphabet, patched from the standard ones */
+template<class Alphabet>
+struct base64_tables
 {
-    if(encoded.len % 4) return false;
-    for(const char c : encoded)
+    char sextet_to_char[64];
+    int8_t char_to_sextet[256]; ///< -1 for chars not in the alphabet
+
+    base64_tables()
     {
-        if(c < 0/* || c >= 128*/) return false;
-        if(c == '=') continue;
-        if(detail::base64_char_to_sextet_[c] == -1) return false;
+        memcpy(sextet_to_char, base64_sextet_to_char_, sizeof(sextet_to_char));
+        for(size_t c = 0; c < 128; ++c)
+            char_to_sextet[c] = static_cast<int8_t>(base64_char_to_sextet_[c]);
+        for(size_t c = 128; c < 256; ++c)
+            char_to_sextet[c] = -1;
+        char_to_sextet[uint8_t('+')] = -1;
+        char_to_sextet[uint8_t('/')] = -1;
+        sextet_to_char[62] = Alphabet::char62;
+        sextet_to_char[63] = Alphabet::char63;
+        char_to_sextet[uint8_t(Alphabet::char62)] = 62;
+        char_to_sextet[uint8_t(Alphabet::char63)] = 63;
     }
-    return true;
-}
 
+    static base64_tables const& get()
+    {
+        static const base64_tables tables;
+        return tables;
+    }
+};
+
+} // anonymous namespace
 
-size_t base64_encode(substr buf, cblob data)
-{
-    #ifdef __clang__
-    #    pragma clang diagnostic push
-    #elif defined(__GNUC__)
-    #    pragma GCC diagnostic push
-    #    pragma GCC diagnostic ignored "-Wstrict-aliasing" // error: dereferencing type-punned pointer will break strict-aliasing rules
-    #endif
 
+template<class Alphabet>
+size_t base64_encode_scalar(substr buf, cblob data)
+{
     #define c4append_(c) { if(pos < buf.len) { buf.str[pos] = (c); } ++pos; }
     #define c4append_idx_(char_idx) \
     {\
-         C4_XASSERT((char_idx) < sizeof(detail::base64_sextet_to_char_));\
-         c4append_(detail::base64_sextet_to_char_[(char_idx)]);\
+         C4_XASSERT((char_idx) < sizeof(t.sextet_to_char));\
+         c4append_(t.sextet_to_char[(char_idx)]);\
     }
 
+    base64_tables<Alphabet> const& t = base64_tables<Alphabet>::get();
     size_t rem, pos = 0;
     constexpr const uint32_t sextet_mask = uint32_t(1 << 6) - 1;
-    const char *C4_RESTRICT d = data.buf;
+    const uint8_t *C4_RESTRICT d = reinterpret_cast<const uint8_t*>(data.buf);
     for(rem = data.len; rem >= 3; rem -= 3, d += 3)
     {
-        const char vb[4] = {d[2], d[1], d[0], 0};
-        uint32_t val = *reinterpret_cast<const uint32_t*>(vb);
+        const uint32_t val = (uint32_t(d[0]) << 16) | (uint32_t(d[1]) << 8) | uint32_t(d[2]);
         c4append_idx_((val >> (3 * 6)) & sextet_mask);
         c4append_idx_((val >> (2 * 6)) & sextet_mask);
         c4append_idx_((val >> (1 * 6)) & sextet_mask);
@@ -115,95 +139,622 @@ size_t base64_encode(substr buf, cblob data)
     C4_ASSERT(rem < 3);
     if(rem == 2)
     {
-        const char vb[4] = {0, d[1], d[0], 0};
-        uint32_t val = *reinterpret_cast<const uint32_t*>(vb);
+        const uint32_t val = (uint32_t(d[0]) << 16) | (uint32_t(d[1]) << 8);
         c4append_idx_((val >> (3 * 6)) & sextet_mask);
         c4append_idx_((val >> (2 * 6)) & sextet_mask);
         c4append_idx_((val >> (1 * 6)) & sextet_mask);
-        c4append_('=');
+        if(Alphabet::padded)
+            c4append_('=');
     }
     else if(rem == 1)
     {
-        const char vb[4] = {0, 0, d[0], 0};
-        uint32_t val = *reinterpret_cast<const uint32_t*>(vb);
+        const uint32_t val = (uint32_t(d[0]) << 16);
         c4append_idx_((val >> (3 * 6)) & sextet_mask);
         c4append_idx_((val >> (2 * 6)) & sextet_mask);
-        c4append_('=');
-        c4append_('=');
+        if(Alphabet::padded)
+        {
+            c4append_('=');
+            c4append_('=');
+        }
     }
     return pos;
 
     #undef c4append_
     #undef c4append_idx_
-
-    #ifdef __clang__
-    #    pragma clang diagnostic pop
-    #elif defined(__GNUC__)
-    #    pragma GCC diagnostic pop
-    #endif
 }
 
 
-size_t base64_decode(csubstr encoded, blob data)
+template<class Alphabet>
+size_t base64_decode_scalar(csubstr encoded, blob data)
 {
     #define c4append_(c) { if(wpos < data.len) { data.buf[wpos] = static_cast<c4::byte>(c); } ++wpos; }
+    // invalid characters give a negative sextet, which is caught by
+    // or-ing all the sextets of a group
     #define c4appendval_(c, shift)\
     {\
-        C4_XASSERT(size_t(c) < sizeof(detail::base64_char_to_sextet_));\
-        val |= static_cast<uint32_t>(detail::base64_char_to_sextet_[(c)]) << ((shift) * 6);\
+        const int32_t sextet_ = t.char_to_sextet[static_cast<uint8_t>(c)];\
+        bad |= sextet_;\
+        val |= static_cast<uint32_t>(sextet_) << ((shift) * 6);\
     }
 
-    C4_ASSERT(base64_valid(encoded));
-    C4_CHECK(encoded.len % 4 == 0);
+    base64_tables<Alphabet> const& t = base64_tables<Alphabet>::get();
+    const size_t partial = encoded.len % 4;
+    if(Alphabet::padded ? partial != 0 : partial == 1)
+        return csubstr::npos;
     size_t wpos = 0;
     const char *C4_RESTRICT d = encoded.str;
+    const char *C4_RESTRICT e = encoded.str + encoded.len;
+    // the last group, which may be padded or partial, is dealt with below
+    const char *C4_RESTRICT last = e - (partial ? partial : (encoded.len ? 4 : 0));
     constexpr const uint32_t full_byte = 0xff;
+    int32_t bad = 0;
     // process every quartet of input 6 bits --> triplet of output bytes
-    for(size_t rpos = 0; rpos < encoded.len; rpos += 4, d += 4)
+    for( ; d < last; d += 4)
     {
-        if(d[2] == '=' || d[3] == '=') // skip the last quartet if it is padded
-        {
-            C4_ASSERT(d + 4 == encoded.str + encoded.len);
-            break;
-        }
         uint32_t val = 0;
         c4appendval_(d[3], 0);
         c4appendval_(d[2], 1);
         c4appendval_(d[1], 2);
         c4appendval_(d[0], 3);
-        static_assert(std::is_same<decltype(val), uint32_t>::value, "sdflkjsdflkjsdf");
-        static_assert(std::is_same<decltype(val >> 1), uint32_t>::value, "sdflkjsdflkjsdf");
-        static_assert(std::is_same<decltype((val >> 1) & full_byte), uint32_t>::value, "sdflkjsdflkjsdf");
+        if(C4_UNLIKELY(bad < 0))
+            return csubstr::npos;
         c4append_((val >> (2 * 8)) & full_byte);
         c4append_((val >> (1 * 8)) & full_byte);
         c4append_((val           ) & full_byte);
     }
-    // deal with the last quartet when it is padded
-    if(d == encoded.str + encoded.len) return wpos;
-    if(d[2] == '=') // 2 padding chars
-    {
-        C4_ASSERT(d + 4 == encoded.str + encoded.len);
-        C4_ASSERT(d[3] == '=');
-        uint32_t val = 0;
-        c4appendval_(d[1], 2);
-        c4appendval_(d[0], 3);
-        c4append_((val >> (2 * 8)) & full_byte);
-    }
-    else if(d[3] == '=') // 1 padding char
-    {
-        C4_ASSERT(d + 4 == encoded.str + encoded.len);
-        uint32_t val = 0;
+    if(d == e)
+        return wpos;
+    size_t num_chars = static_cast<size_t>(e - d);
+    if(Alphabet::padded && d[3] == '=') // '=' elsewhere is rejected below
+        num_chars = d[2] == '=' ? 2 : 3;
+    uint32_t val = 0;
+    if(num_chars > 3)
+        c4appendval_(d[3], 0);
+    if(num_chars > 2)
         c4appendval_(d[2], 1);
-        c4appendval_(d[1], 2);
-        c4appendval_(d[0], 3);
-        c4append_((val >> (2 * 8)) & full_byte);
+    c4appendval_(d[1], 2);
+    c4appendval_(d[0], 3);
+    if(bad < 0)
+        return csubstr::npos;
+    c4append_((val >> (2 * 8)) & full_byte);
+    if(num_chars > 2)
         c4append_((val >> (1 * 8)) & full_byte);
-    }
+    if(num_chars > 3)
+        c4append_((val           ) & full_byte);
     return wpos;
     #undef c4append_
     #undef c4appendval_
 }
 
+} // namespace detail
+
+
+//-----------------------------------------------------------------------------
+// x86 kernels. These follow the approach described by Wojciech Muła
+// and Daniel Lemire in "Faster Base64 Encoding and Decoding using AVX2
+// Instructions" (ACM TWEB 2018): the sextets are moved into place with
+// byte shuffles and multiplies, and translated to/from ascii with
+// nibble-indexed lookups. Invalid characters are detected in the same
+// lookups. The tail of the input is left to the scalar code.
+
+#ifdef C4_BASE64_X86
+
+namespace detail {
+
+namespace {
+
+C4_CPU_TARGET("ssse3") inline __m128i base64_enc_reshuffle_ssse3(__m128i in)
+{
+    // [ccdddddd|bbbbcccc|aaaaaabb] -> [00dddddd|00cccccc|00bbbbbb|00aaaaaa]
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+template<class Alphabet>
+C4_CPU_TARGET("ssse3") inline __m128i base64_enc_translate_ssse3(__m128i sextets)
+{
+    // map each range of sextets to the offset added to get its char:
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    const char c62 = static_cast<char>(Alphabet::char62 - 62);
+    const char c63 = static_cast<char>(Alphabet::char63 - 63);
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, c62,
+                                          c63, 'A', 0, 0);
+    __m128i idx = _mm_subs_epu8(sextets, _mm_set1_epi8(51));
+    const __m128i lt26 = _mm_cmpgt_epi8(_mm_set1_epi8(26), sextets);
+    idx = _mm_or_si128(idx, _mm_and_si128(lt26, _mm_set1_epi8(13)));
+    return _mm_add_epi8(sextets, _mm_shuffle_epi8(offsets, idx));
+}
+
+/** translate chars to sextets.
+ * @return false if any of the chars is not in the alphabet */
+template<class Alphabet>
+C4_CPU_TARGET("ssse3") inline bool base64_dec_translate_ssse3(__m128i *str)
+{
+    const bool url = Alphabet::char62 == '-' && Alphabet::char63 == '_';
+    static_assert(url || (Alphabet::char62 == '+' && Alphabet::char63 == '/'), "no tables for this alphabet");
+    // every char is classified by its low and high nibbles; a char is
+    // valid only when the two classes have no bit in common
+    const __m128i lut_lo = url ?
+        _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                      0x11, 0x11, 0x13, 0x3b, 0x3b, 0x3a, 0x3b, 0x33) :
+        _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = url ?
+        _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x20,
+                      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10) :
+        _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = url ?
+        _mm_setr_epi8(0, 0, 17, 4, -65, -65, -71, -71,
+                      -32, 0, 0, 0, 0, 0, 0, 0) :
+        _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                      0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(*str, 4), mask_2f);
+    const __m128i lo_nibbles = _mm_and_si128(*str, mask_2f);
+    const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    if(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0)
+        return false;
+    __m128i roll;
+    if(url)
+    {
+        // '_' shares its high nibble with 'P'..'Z', so it is moved to
+        // the unused entry 8 = 5^13
+        const __m128i eq_5f = _mm_cmpeq_epi8(*str, _mm_set1_epi8(0x5f));
+        roll = _mm_shuffle_epi8(lut_roll, _mm_xor_si128(hi_nibbles, _mm_and_si128(eq_5f, _mm_set1_epi8(13))));
+    }
+    else
+    {
+        // '/' shares its high nibble with '+', so it gets its own entry
+        const __m128i eq_2f = _mm_cmpeq_epi8(*str, mask_2f);
+        roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+    }
+    *str = _mm_add_epi8(*str, roll);
+    return true;
+}
+
+C4_CPU_TARGET("ssse3") inline __m128i base64_dec_reshuffle_ssse3(__m128i sextets)
+{
+    // [00dddddd|00cccccc|00bbbbbb|00aaaaaa] -> [ccdddddd|bbbbcccc|aaaaaabb]
+    const __m128i ab_bc = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+    const __m128i abc = _mm_madd_epi16(ab_bc, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(abc, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+C4_CPU_TARGET("avx2") inline __m256i base64_enc_reshuffle_avx2(__m256i in)
+{
+    in = _mm256_shuffle_epi8(in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                                 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+    const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+    const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(t1, t3);
+}
+
+template<class Alphabet>
+C4_CPU_TARGET("avx2") inline __m256i base64_enc_translate_avx2(__m256i sextets)
+{
+    const char c62 = static_cast<char>(Alphabet::char62 - 62);
+    const char c63 = static_cast<char>(Alphabet::char63 - 63);
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, c62,
+                                             c63, 'A', 0, 0,
+                                             'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, c62,
+                                             c63, 'A', 0, 0);
+    __m256i idx = _mm256_subs_epu8(sextets, _mm256_set1_epi8(51));
+    const __m256i lt26 = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), sextets);
+    idx = _mm256_or_si256(idx, _mm256_and_si256(lt26, _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(sextets, _mm256_shuffle_epi8(offsets, idx));
+}
+
+template<class Alphabet>
+C4_CPU_TARGET("avx2") inline bool base64_dec_translate_avx2(__m256i *str)
+{
+    const bool url = Alphabet::char62 == '-' && Alphabet::char63 == '_';
+    static_assert(url || (Alphabet::char62 == '+' && Alphabet::char63 == '/'), "no tables for this alphabet");
+    const __m256i lut_lo = url ?
+        _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                         0x11, 0x11, 0x13, 0x3b, 0x3b, 0x3a, 0x3b, 0x33,
+                         0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                         0x11, 0x11, 0x13, 0x3b, 0x3b, 0x3a, 0x3b, 0x33) :
+        _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                         0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+                         0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                         0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lut_hi = url ?
+        _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x20,
+                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                         0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x20,
+                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10) :
+        _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                         0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = url ?
+        _mm256_setr_epi8(0, 0, 17, 4, -65, -65, -71, -71,
+                         -32, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 17, 4, -65, -65, -71, -71,
+                         -32, 0, 0, 0, 0, 0, 0, 0) :
+        _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                         0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 16, 19, 4, -65, -65, -71, -71,
+                         0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(*str, 4), mask_2f);
+    const __m256i lo_nibbles = _mm256_and_si256(*str, mask_2f);
+    const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+    const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+    if( ! _mm256_testz_si256(lo, hi))
+        return false;
+    __m256i roll;
+    if(url)
+    {
+        const __m256i eq_5f = _mm256_cmpeq_epi8(*str, _mm256_set1_epi8(0x5f));
+        roll = _mm256_shuffle_epi8(lut_roll, _mm256_xor_si256(hi_nibbles, _mm256_and_si256(eq_5f, _mm256_set1_epi8(13))));
+    }
+    else
+    {
+        const __m256i eq_2f = _mm256_cmpeq_epi8(*str, mask_2f);
+        roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+    }
+    *str = _mm256_add_epi8(*str, roll);
+    return true;
+}
+
+C4_CPU_TARGET("avx2") inline __m256i base64_dec_reshuffle_avx2(__m256i sextets)
+{
+    const __m256i ab_bc = _mm256_maddubs_epi16(sextets, _mm256_set1_epi32(0x01400140));
+    __m256i abc = _mm256_madd_epi16(ab_bc, _mm256_set1_epi32(0x00011000));
+    abc = _mm256_shuffle_epi8(abc, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    // pack the 12 bytes of each lane into the first 24 bytes
+    return _mm256_permutevar8x32_epi32(abc, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+}
+
+} // anonymous namespace
+
+
+template<class Alphabet>
+C4_CPU_TARGET("ssse3") size_t base64_encode_ssse3_(substr buf, cblob data)
+{
+    const char *C4_RESTRICT d = data.buf;
+    size_t rem = data.len, pos = 0;
+    // each step loads 16 bytes, of which 12 are encoded into 16 chars
+    for( ; rem >= 16 && buf.len - pos >= 16; rem -= 12, d += 12, pos += 16)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d));
+        const __m128i out = base64_enc_translate_ssse3<Alphabet>(base64_enc_reshuffle_ssse3(in));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(buf.str + pos), out);
+    }
+    return pos + base64_encode_scalar<Alphabet>(buf.sub(pos), cblob(d, rem));
+}
+
+template<class Alphabet>
+C4_CPU_TARGET("ssse3") size_t base64_decode_ssse3_(csubstr encoded, blob data)
+{
+    const char *C4_RESTRICT d = encoded.str;
+    size_t rem = encoded.len, wpos = 0;
+    // each step decodes 16 chars into 12 bytes, but stores 16 bytes.
+    // the last group is left to the scalar code, as it may be padded.
+    for( ; rem >= 20 && data.len - wpos >= 16; rem -= 16, d += 16, wpos += 12)
+    {
+        __m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d));
+        if( ! base64_dec_translate_ssse3<Alphabet>(&str))
+            return csubstr::npos;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data.buf + wpos), base64_dec_reshuffle_ssse3(str));
+    }
+    const size_t ret = base64_decode_scalar<Alphabet>(csubstr(d, rem), blob(data.buf + wpos, data.len - wpos));
+    return ret != csubstr::npos ? wpos + ret : csubstr::npos;
+}
+
+template<class Alphabet>
+C4_CPU_TARGET("avx2") size_t base64_encode_avx2_(substr buf, cblob data)
+{
+    const char *C4_RESTRICT d = data.buf;
+    size_t rem = data.len, pos = 0;
+    // each step encodes 24 bytes into 32 chars, loading 12 (out of 16)
+    // bytes into each lane
+    for( ; rem >= 28 && buf.len - pos >= 32; rem -= 24, d += 24, pos += 32)
+    {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + 12));
+        const __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        const __m256i out = base64_enc_translate_avx2<Alphabet>(base64_enc_reshuffle_avx2(in));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(buf.str + pos), out);
+    }
+    // avoid the penalty of mixing avx and legacy sse instructions
+    _mm256_zeroupper();
+    return pos + base64_encode_ssse3_<Alphabet>(buf.sub(pos), cblob(d, rem));
+}
+
+template<class Alphabet>
+C4_CPU_TARGET("avx2") size_t base64_decode_avx2_(csubstr encoded, blob data)
+{
+    const char *C4_RESTRICT d = encoded.str;
+    size_t rem = encoded.len, wpos = 0;
+    // each step decodes 32 chars into 24 bytes, but stores 32 bytes
+    for( ; rem >= 36 && data.len - wpos >= 32; rem -= 32, d += 32, wpos += 24)
+    {
+        __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d));
+        if( ! base64_dec_translate_avx2<Alphabet>(&str))
+            return csubstr::npos;
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data.buf + wpos), base64_dec_reshuffle_avx2(str));
+    }
+    _mm256_zeroupper();
+    const size_t ret = base64_decode_ssse3_<Alphabet>(csubstr(d, rem), blob(data.buf + wpos, data.len - wpos));
+    return ret != csubstr::npos ? wpos + ret : csubstr::npos;
+}
+
+// the vector kernels above cannot be declared in the header: a
+// template's target attribute must be in its first declaration
+template<class Alphabet> size_t base64_encode_ssse3(substr buf, cblob data) { return base64_encode_ssse3_<Alphabet>(buf, data); }
+template<class Alphabet> size_t base64_decode_ssse3(csubstr encoded, blob data) { return base64_decode_ssse3_<Alphabet>(encoded, data); }
+template<class Alphabet> size_t base64_encode_avx2(substr buf, cblob data) { return base64_encode_avx2_<Alphabet>(buf, data); }
+template<class Alphabet> size_t base64_decode_avx2(csubstr encoded, blob data) { return base64_decode_avx2_<Alphabet>(encoded, data); }
+
+} // namespace detail
+
+#endif // C4_BASE64_X86
+
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+struct base64_impl
+{
+    size_t (*encode)(substr, cblob);
+    size_t (*decode)(csubstr, blob);
+};
+
+template<class Alphabet>
+base64_impl base64_select_impl()
+{
+    const base64_impl scalar = {&detail::base64_encode_scalar<Alphabet>, &detail::base64_decode_scalar<Alphabet>};
+#ifdef C4_BASE64_X86
+    const base64_impl avx2 = {&detail::base64_encode_avx2_<Alphabet>, &detail::base64_decode_avx2_<Alphabet>};
+    const base64_impl ssse3 = {&detail::base64_encode_ssse3_<Alphabet>, &detail::base64_decode_ssse3_<Alphabet>};
+    return cpu_select(CPU_AVX2, avx2, CPU_SSSE3, ssse3, scalar);
+#else
+    return scalar;
+#endif
+}
+
+template<class Alphabet>
+base64_impl const& base64_get_impl()
+{
+    static const base64_impl impl = base64_select_impl<Alphabet>();
+    return impl;
+}
+
+} // anonymous namespace
+
+
+template<class Alphabet>
+bool base64_valid(csubstr encoded)
+{
+    // decoding into an empty buffer only validates
+    return detail::base64_decode_scalar<Alphabet>(encoded, blob()) != csubstr::npos;
+}
+
+template<class Alphabet>
+size_t base64_encode(substr buf, cblob data)
+{
+    return base64_get_impl<Alphabet>().encode(buf, data);
+}
+
+template<class Alphabet>
+size_t base64_decode(csubstr encoded, blob data)
+{
+    return base64_get_impl<Alphabet>().decode(encoded, data);
+}
+
+bool base64_valid(csubstr encoded)
+{
+    return base64_valid<base64_std>(encoded);
+}
+
+size_t base64_encode(substr buf, cblob data)
+{
+    return base64_get_impl<base64_std>().encode(buf, data);
+}
+
+size_t base64_decode(csubstr encoded, blob data)
+{
+    return base64_get_impl<base64_std>().decode(encoded, data);
+}
+
+
+#ifdef C4_BASE64_X86
+#   define _c4_base64_instantiate_x86(Alphabet)                                   \
+    template size_t detail::base64_encode_ssse3<Alphabet>(substr, cblob);        \
+    template size_t detail::base64_decode_ssse3<Alphabet>(csubstr, blob);        \
+    template size_t detail::base64_encode_avx2<Alphabet>(substr, cblob);         \
+    template size_t detail::base64_decode_avx2<Alphabet>(csubstr, blob);
+#else
+#   define _c4_base64_instantiate_x86(Alphabet)
+#endif
+
+#define _c4_base64_instantiate(Alphabet)                                         \
+    template bool base64_valid<Alphabet>(csubstr);                              \
+    template size_t base64_encode<Alphabet>(substr, cblob);                     \
+    template size_t base64_decode<Alphabet>(csubstr, blob);                     \
+    template size_t detail::base64_encode_scalar<Alphabet>(substr, cblob);      \
+    template size_t detail::base64_decode_scalar<Alphabet>(csubstr, blob);      \
+    _c4_base64_instantiate_x86(Alphabet)
+
+_c4_base64_instantiate(base64_std)
+_c4_base64_instantiate(base64_std_nopad)
+_c4_base64_instantiate(base64url)
+_c4_base64_instantiate(base64url_pad)
+
+#undef _c4_base64_instantiate
+#undef _c4_base64_instantiate_x86
+
+
+//-----------------------------------------------------------------------------
+
+template<class Alphabet>
+size_t base64_encoder_<Alphabet>::encode(substr encoded, cblob chunk)
+{
+    const size_t total = m_num_pending + chunk.len;
+    const size_t needed = total / 3 * 4;
+    if(needed > encoded.len)
+        return needed;
+    size_t pos = 0;
+    if(m_num_pending)
+    {
+        const size_t take = 3 - m_num_pending;
+        if(chunk.len < take)
+        {
+            if(chunk.len)
+                memcpy(m_pending + m_num_pending, chunk.buf, chunk.len);
+            m_num_pending += chunk.len;
+            return 0;
+        }
+        memcpy(m_pending + m_num_pending, chunk.buf, take);
+        pos = base64_encode<Alphabet>(encoded, cblob(m_pending, 3));
+        chunk.buf += take;
+        chunk.len -= take;
+        m_num_pending = 0;
+    }
+    const size_t full = chunk.len / 3 * 3;
+    pos += base64_encode<Alphabet>(encoded.sub(pos), cblob(chunk.buf, full));
+    m_num_pending = chunk.len - full;
+    if(m_num_pending)
+        memcpy(m_pending, chunk.buf + full, m_num_pending);
+    C4_ASSERT(pos == needed);
+    return pos;
+}
+
+template<class Alphabet>
+size_t base64_encoder_<Alphabet>::finish(substr encoded)
+{
+    if( ! m_num_pending)
+        return 0;
+    const size_t needed = Alphabet::padded ? 4 : m_num_pending + 1;
+    if(encoded.len < needed)
+        return needed;
+    size_t pos = base64_encode<Alphabet>(encoded, cblob(m_pending, m_num_pending));
+    C4_ASSERT(pos == needed);
+    m_num_pending = 0;
+    return pos;
+}
+
+
+//-----------------------------------------------------------------------------
+
+template<class Alphabet>
+size_t base64_decoder_<Alphabet>::decode(blob data, csubstr chunk)
+{
+    if(m_error)
+        return csubstr::npos;
+    if(m_done && chunk.len)
+    {
+        m_error = true;
+        return csubstr::npos;
+    }
+    const size_t total = m_num_pending + chunk.len;
+    const size_t full = total / 4 * 4;
+    if(full == 0)
+    {
+        if(chunk.len)
+            memcpy(m_pending + m_num_pending, chunk.str, chunk.len);
+        m_num_pending += chunk.len;
+        return 0;
+    }
+    // padding chars in the last complete quartet reduce the output,
+    // and must end the input
+    auto at = [&](size_t i){ return i < m_num_pending ? m_pending[i] : chunk.str[i - m_num_pending]; };
+    const bool padded = Alphabet::padded && at(full - 1) == '=';
+    size_t needed = full / 4 * 3;
+    if(padded)
+        needed -= at(full - 2) == '=' ? 2 : 1;
+    if(needed > data.len)
+        return needed;
+    size_t wpos = 0;
+    if(m_num_pending)
+    {
+        const size_t take = 4 - m_num_pending;
+        memcpy(m_pending + m_num_pending, chunk.str, take);
+        m_num_pending = 0;
+        chunk = chunk.sub(take);
+        wpos = base64_decode<Alphabet>(csubstr(m_pending, 4), data);
+        if(wpos == csubstr::npos || (wpos < 3 && chunk.len)) // padding must be last
+        {
+            m_error = true;
+            return csubstr::npos;
+        }
+    }
+    const size_t len = chunk.len / 4 * 4;
+    const size_t ret = base64_decode<Alphabet>(chunk.first(len), blob(data.buf + wpos, data.len - wpos));
+    if(ret == csubstr::npos)
+    {
+        m_error = true;
+        return csubstr::npos;
+    }
+    wpos += ret;
+    chunk = chunk.sub(len);
+    m_done = padded;
+    if(m_done && chunk.len)
+    {
+        m_error = true;
+        return csubstr::npos;
+    }
+    if(chunk.len)
+        memcpy(m_pending, chunk.str, chunk.len);
+    m_num_pending = chunk.len;
+    C4_ASSERT(wpos == needed);
+    return wpos;
+}
+
+template<class Alphabet>
+bool base64_decoder_<Alphabet>::finish()
+{
+    const bool ok = ! m_error && m_num_pending == 0;
+    reset();
+    return ok;
+}
+
+template<class Alphabet>
+size_t base64_decoder_<Alphabet>::finish(blob data)
+{
+    if(m_error || (m_num_pending && Alphabet::padded) || m_num_pending == 1)
+    {
+        reset();
+        return csubstr::npos;
+    }
+    // 2 chars hold 1 byte, and 3 chars hold 2
+    const size_t needed = m_num_pending ? m_num_pending - 1 : 0;
+    if(needed > data.len)
+        return needed;
+    size_t ret = 0;
+    if(m_num_pending)
+        ret = base64_decode<Alphabet>(csubstr(m_pending, m_num_pending), data);
+    reset();
+    C4_ASSERT(ret == csubstr::npos || ret == needed);
+    return ret;
+}
+
+
+template class base64_encoder_<base64_std>;
+template class base64_encoder_<base64_std_nopad>;
+template class base64_encoder_<base64url>;
+template class base64_encoder_<base64url_pad>;
+template class base64_decoder_<base64_std>;
+template class base64_decoder_<base64_std_nopad>;
+template class base64_decoder_<base64url>;
+template class base64_decoder_<base64url_pad>;
+
+
 } // namespace c4
 
 #ifdef __clang__
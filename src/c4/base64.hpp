@@ -16,7 +16,41 @@ namespace c4 {
  * @see https://en.wikipedia.org/wiki/Base64
  */
 
-/** check that the given buffer is a valid base64 encoding
+/** An alphabet and padding policy for the base64 functions, which
+ * differ in the chars for the sextets 62 and 63. The functions are
+ * instantiated in base64.cpp for the policies below, which share the
+ * same vector kernels.
+ * @see https://www.rfc-editor.org/rfc/rfc4648
+ * @ingroup base64_functions */
+template<char Char62, char Char63, bool Padded>
+struct base64_alphabet
+{
+    static constexpr const char char62 = Char62;
+    static constexpr const char char63 = Char63;
+    /** whether the encoding is padded with '=' to a multiple of 4
+     * chars. Unpadded decoding rejects '='. */
+    static constexpr const bool padded = Padded;
+};
+
+/** the standard alphabet, padded (RFC 4648 section 4). This is used
+ * by the functions without an alphabet argument.
+ * @ingroup base64_functions */
+using base64_std = base64_alphabet<'+', '/', true>;
+/** the standard alphabet, unpadded
+ * @ingroup base64_functions */
+using base64_std_nopad = base64_alphabet<'+', '/', false>;
+/** the url and filename safe alphabet, unpadded, as used eg in JWT
+ * (RFC 4648 section 5, RFC 7515)
+ * @ingroup base64_functions */
+using base64url = base64_alphabet<'-', '_', false>;
+/** the url and filename safe alphabet, padded
+ * @ingroup base64_functions */
+using base64url_pad = base64_alphabet<'-', '_', true>;
+
+
+/** check that the given buffer is a valid base64 encoding, with the
+ * standard padded alphabet: the same as base64_valid<base64_std>(),
+ * so that '=' is accepted only as the final padding
  * @ingroup base64_functions
  * @see https://en.wikipedia.org/wiki/Base64 */
 bool base64_valid(csubstr encoded);
@@ -29,21 +63,186 @@ bool base64_valid(csubstr encoded);
  * @see https://en.wikipedia.org/wiki/Base64 */
 size_t base64_encode(substr encoded, cblob data);
 
-/** check that the given is a valid base64 encoding
- * @param encoded [in] the output buffer
+/** decode base64 into binary data. The encoding is validated
+ * while it is decoded.
+ * @param encoded [in] the input buffer
  * @param data [out] the output buffer
- * @return the number of bytes needed to return the output
+ * @return the number of bytes needed to return the output, or
+ * csubstr::npos if the encoding is not valid
  * @ingroup base64_functions
  * @see https://en.wikipedia.org/wiki/Base64 */
 size_t base64_decode(csubstr encoded, blob data);
 
 
+/** check that the given buffer is a valid encoding with the given
+ * alphabet, including its padding
+ * @ingroup base64_functions */
+template<class Alphabet>
+bool base64_valid(csubstr encoded);
+
+/** encode binary data with the given alphabet
+ * @see base64_encode(substr, cblob)
+ * @ingroup base64_functions */
+template<class Alphabet>
+size_t base64_encode(substr encoded, cblob data);
+
+/** decode binary data with the given alphabet
+ * @see base64_decode(csubstr, blob)
+ * @ingroup base64_functions */
+template<class Alphabet>
+size_t base64_decode(csubstr encoded, blob data);
+
+
+#if (defined(C4_CPU_X86_64) || defined(C4_CPU_X86)) && !defined(C4_BASE64_NO_SIMD)
+#   define C4_BASE64_X86
+#endif
+
+namespace detail {
+/** @cond dev */
+// the implementations selected at runtime by base64_encode() and
+// base64_decode(). The vector ones defer their tail to the scalar ones.
+template<class Alphabet=base64_std> size_t base64_encode_scalar(substr encoded, cblob data);
+template<class Alphabet=base64_std> size_t base64_decode_scalar(csubstr encoded, blob data);
+#ifdef C4_BASE64_X86
+template<class Alphabet=base64_std> size_t base64_encode_ssse3(substr encoded, cblob data);
+template<class Alphabet=base64_std> size_t base64_decode_ssse3(csubstr encoded, blob data);
+template<class Alphabet=base64_std> size_t base64_encode_avx2(substr encoded, cblob data);
+template<class Alphabet=base64_std> size_t base64_decode_avx2(csubstr encoded, blob data);
+#endif
+/** @endcond */
+} // namespace detail
+
+
+/** Incrementally encode binary data into base64 with the given
+ * alphabet, from chunks of any length. The bytes which do not complete
+ * a triplet are kept for the next call, so that the output is the
+ * same as that of base64_encode<Alphabet>() over the whole input.
+ *
+ * @code
+ * c4::base64_encoder enc; // or eg c4::base64url_encoder
+ * while(read_chunk(&chunk))
+ * {
+ *     size_t len = enc.encode(buf, chunk);
+ *     C4_CHECK(len <= buf.len);
+ *     write(buf.first(len));
+ * }
+ * write(buf.first(enc.finish(buf)));
+ * @endcode
+ *
+ * The class is instantiated in base64.cpp for the alphabets declared
+ * above.
+ * @ingroup base64_functions */
+template<class Alphabet=base64_std>
+class base64_encoder_
+{
+public:
+
+    base64_encoder_() : m_pending(), m_num_pending(0) {}
+
+    /** encode a chunk of data.
+     * @return the number of chars written. If this is larger than
+     * the output buffer, nothing was written or consumed, and the
+     * call should be repeated with a buffer of at least that size.
+     * @see max_encoded_size() */
+    size_t encode(substr encoded, cblob chunk);
+
+    /** write the encoding of the pending bytes, padded if the alphabet
+     * is, and reset the encoder.
+     * @return the number of chars written: 0 or 4 when padded, and 0,
+     * 2 or 3 otherwise. If this is larger than the output buffer,
+     * nothing was written. */
+    size_t finish(substr encoded);
+
+    /** drop the pending bytes */
+    void reset() { m_num_pending = 0; }
+
+    /** the number of bytes kept from previous chunks: 0, 1 or 2 */
+    size_t num_pending() const { return m_num_pending; }
+
+    /** the largest output from encode() for a chunk of the given size */
+    static constexpr size_t max_encoded_size(size_t chunk_len) noexcept { return (chunk_len + 2) / 3 * 4; }
+
+private:
+
+    char   m_pending[3];
+    size_t m_num_pending;
+
+};
+
+/** @ingroup base64_functions */
+using base64_encoder = base64_encoder_<base64_std>;
+/** @ingroup base64_functions */
+using base64url_encoder = base64_encoder_<base64url>;
+
+
+/** Incrementally decode base64 with the given alphabet into binary
+ * data, from chunks of any length. The chars which do not complete a
+ * quartet are kept for the next call. The input is validated as it is
+ * decoded.
+ *
+ * With an unpadded alphabet, the input may end with a partial quartet,
+ * which is decoded by finish(blob).
+ * @ingroup base64_functions */
+template<class Alphabet=base64_std>
+class base64_decoder_
+{
+public:
+
+    base64_decoder_() : m_pending(), m_num_pending(0), m_done(false), m_error(false) {}
+
+    /** decode a chunk of base64.
+     * @return the number of bytes written, or csubstr::npos if the
+     * input is not valid, which puts the decoder in an error state
+     * until reset(). If the result is larger than the output buffer,
+     * nothing was written or consumed, and the call should be
+     * repeated with a buffer of at least that size.
+     * @see max_decoded_size() */
+    size_t decode(blob data, csubstr chunk);
+
+    /** reset the decoder.
+     * @return true if the input ended at a quartet boundary, and no
+     * error occurred */
+    bool finish();
+
+    /** decode the pending chars, which with an unpadded alphabet may
+     * be a final partial quartet, and reset the decoder.
+     * @return the number of bytes written (0 to 2), or csubstr::npos
+     * if the input is not valid. If the result is larger than the
+     * output buffer, nothing was written, and the decoder is not
+     * reset. */
+    size_t finish(blob data);
+
+    /** drop the pending chars and clear the error state */
+    void reset() { m_num_pending = 0; m_done = false; m_error = false; }
+
+    /** the number of chars kept from previous chunks: 0 to 3 */
+    size_t num_pending() const { return m_num_pending; }
+    bool error() const { return m_error; }
+
+    /** the largest output from decode() for a chunk of the given size */
+    static constexpr size_t max_decoded_size(size_t chunk_len) noexcept { return (chunk_len + 3) / 4 * 3; }
+
+private:
+
+    char   m_pending[4];
+    size_t m_num_pending;
+    bool   m_done;  ///< a padded quartet was seen, so the input must end
+    bool   m_error;
+
+};
+
+/** @ingroup base64_functions */
+using base64_decoder = base64_decoder_<base64_std>;
+/** @ingroup base64_functions */
+using base64url_decoder = base64_decoder_<base64url>;
+
+
 /** @addtogroup generic_tofrom_chars
  * @{ */
 
 namespace fmt {
 
-template<typename CharOrConstChar>
+template<typename CharOrConstChar, class Alphabet=base64_std>
 struct base64_wrapper_
 {
     template<class ...Args>
@@ -53,6 +252,8 @@ struct base64_wrapper_
 };
 using const_base64_wrapper = base64_wrapper_<cbyte>;
 using base64_wrapper = base64_wrapper_<byte>;
+using const_base64url_wrapper = base64_wrapper_<cbyte, c4::base64url>;
+using base64url_wrapper = base64_wrapper_<byte, c4::base64url>;
 
 
 /** mark a variable to be written in base64 format
@@ -85,21 +286,53 @@ C4_ALWAYS_INLINE base64_wrapper base64(substr s)
     return base64_wrapper(s.str, s.len);
 }
 
+/** mark a variable to be written in unpadded base64url format
+ * @ingroup base64_functions */
+template<class ...Args>
+C4_ALWAYS_INLINE const_base64url_wrapper cbase64url(Args &&... args)
+{
+    return const_base64url_wrapper(std::forward<Args>(args)...);
+}
+/** mark a csubstr to be written in unpadded base64url format
+ * @overload cbase64url
+ * @ingroup base64_functions */
+C4_ALWAYS_INLINE const_base64url_wrapper cbase64url(csubstr s)
+{
+    return const_base64url_wrapper(s.str, s.len);
+}
+
+/** mark a variable to be read in unpadded base64url format
+ * @ingroup base64_functions */
+template<class ...Args>
+C4_ALWAYS_INLINE base64url_wrapper base64url(Args &&... args)
+{
+    return base64url_wrapper(std::forward<Args>(args)...);
+}
+/** mark a variable to be read in unpadded base64url format
+ * @overload base64url
+ * @ingroup base64_functions */
+C4_ALWAYS_INLINE base64url_wrapper base64url(substr s)
+{
+    return base64url_wrapper(s.str, s.len);
+}
+
 } // namespace fmt
 
 
 /** write a variable in base64 format
  * @ingroup base64_functions */
-inline size_t to_chars(substr buf, fmt::const_base64_wrapper b)
+template<class Alphabet>
+inline size_t to_chars(substr buf, fmt::base64_wrapper_<cbyte, Alphabet> b)
 {
-    return base64_encode(buf, b.data);
+    return base64_encode<Alphabet>(buf, b.data);
 }
 
 /** read a variable in base64 format
  * @ingroup base64_functions */
-inline size_t from_chars(csubstr buf, fmt::base64_wrapper *b)
+template<class Alphabet>
+inline size_t from_chars(csubstr buf, fmt::base64_wrapper_<byte, Alphabet> *b)
 {
-    return base64_decode(buf, b->data);
+    return base64_decode<Alphabet>(buf, b->data);
 }
 
 /** @} */
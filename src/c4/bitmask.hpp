@@ -96,21 +96,17 @@ size_t bm2str
     using I = typename std::underlying_type<Enum>::type;
     C4_ASSERT((str == nullptr) == (sz == 0));
 
-    auto syms = esyms<Enum>();
+    EnumIndex<Enum> const& index = eindex<Enum>();
+    auto const& syms = index.symbols();
     size_t pos = 0;
-    typename EnumSymbols<Enum>::Sym const* zero = nullptr;
 
     // do reverse iteration to give preference to composite enum symbols,
     // which are likely to appear later in the enum sequence
-    for(size_t i = syms.size()-1; i != size_t(-1); --i)
+    for(size_t i = syms.size()-1; bits != 0 && i != size_t(-1); --i)
     {
-        auto const p = syms[i];
+        auto const& p = syms.begin()[i];
         I b = static_cast<I>(p.value);
-        if(b == 0)
-        {
-            zero = &p; // save this symbol for later
-        }
-        else if((bits & b) == b)
+        if(b != 0 && (bits & b) == b)
         {
             bits &= ~b;
             // append bit-or character
@@ -128,6 +124,7 @@ size_t bm2str
     C4_CHECK_MSG(bits == 0, "could not find all bits");
     if(pos == 0) // make sure at least something is written
     {
+        auto const* zero = index.find(static_cast<Enum>(0));
         if(zero) // if we have a zero symbol, use that
         {
             const char *pname = zero->name_offs(offst);
@@ -185,10 +182,9 @@ template<class Enum>
 typename std::underlying_type<Enum>::type str2bm_read_one(const char *str, size_t sz, bool alnum)
 {
     using I = typename std::underlying_type<Enum>::type;
-    auto pairs = esyms<Enum>();
     if(alnum)
     {
-        auto *p = pairs.find(str, sz);
+        auto *p = eindex<Enum>().find(str, sz);
         C4_CHECK_MSG(p != nullptr, "no valid enum pair name for '%.*s'", (int)sz, str);
         return static_cast<I>(p->value);
     }
@@ -0,0 +1,517 @@
+#include "c4/bitvector.hpp"
+#include "c4/cpu_features.hpp"
+
+#include <string.h>
+#include <utility>
+
+#if defined(_MSC_VER) && (defined(C4_CPU_X86_64) || defined(C4_CPU_X86))
+#   include <xmmintrin.h>
+#endif
+
+namespace c4 {
+
+namespace {
+
+enum : size_t {
+    block_words = 8,   //!< the words of a rank block
+    block_bits = 512,  //!< the bits of a rank block
+    sample_rate = 512, //!< select samples every this many ones
+    prefetch_distance = 16, //!< the positions prefetched ahead by the bulk operations
+};
+
+C4_ALWAYS_INLINE void bitvector_prefetch(const void *addr) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(addr);
+#elif defined(_MSC_VER) && (defined(C4_CPU_X86_64) || defined(C4_CPU_X86))
+    _mm_prefetch(reinterpret_cast<const char*>(addr), _MM_HINT_T0);
+#else
+    (void)addr;
+#endif
+}
+
+C4_ALWAYS_INLINE uint64_t rank_field(uint64_t rel, size_t word) noexcept
+{
+    return word ? (rel >> (9u * (word - 1u))) & 0x1ffu : 0u;
+}
+
+
+//-----------------------------------------------------------------------------
+// the bodies of the functions selected at runtime: they are inlined
+// in the scalar and in the popcnt versions below, so that the
+// popcounts compile to the popcnt instruction in the latter.
+
+C4_ALWAYS_INLINE size_t count_impl(uint64_t const* words, size_t num_words) noexcept
+{
+    size_t n = 0;
+    for(size_t i = 0; i < num_words; ++i)
+        n += detail::bitvector_popcount64(words[i]);
+    return n;
+}
+
+C4_ALWAYS_INLINE size_t build_rank_impl(uint64_t const* words, size_t num_blocks, uint64_t *rank) noexcept
+{
+    uint64_t total = 0;
+    for(size_t b = 0; b < num_blocks; ++b)
+    {
+        uint64_t const* bw = words + b * block_words;
+        uint64_t cum = 0, rel = 0;
+        for(size_t w = 0; w + 1u < block_words; ++w)
+        {
+            cum += detail::bitvector_popcount64(bw[w]);
+            rel |= cum << (9u * w);
+        }
+        cum += detail::bitvector_popcount64(bw[block_words - 1u]);
+        rank[2u * b] = total;
+        rank[2u * b + 1u] = rel;
+        total += cum;
+    }
+    return static_cast<size_t>(total);
+}
+
+/** the position of the r-th one of a word, with broadword
+ * arithmetic (Vigna, 2008): no branches to mispredict */
+C4_ALWAYS_INLINE size_t select_in_word(uint64_t word, size_t r) noexcept
+{
+    const uint64_t L8 = UINT64_C(0x0101010101010101);
+    const uint64_t H8 = UINT64_C(0x8080808080808080);
+    const uint64_t rr = static_cast<uint64_t>(r);
+    C4_ASSERT(r < detail::bitvector_popcount64(word));
+    // the ones in each byte, summed up to each byte
+    uint64_t s = word - ((word >> 1u) & UINT64_C(0x5555555555555555));
+    s = (s & UINT64_C(0x3333333333333333)) + ((s >> 2u) & UINT64_C(0x3333333333333333));
+    s = ((s + (s >> 4u)) & UINT64_C(0x0f0f0f0f0f0f0f0f)) * L8;
+    // the bytes with at most r ones up to them come before the one
+    // of the r-th one. The sums are less than 128, so the
+    // byte-wise subtraction does not borrow.
+    const unsigned byte = 8u * detail::bitvector_popcount64((((rr * L8) | H8) - s) & H8);
+    const uint64_t rb = rr - (((s << 8u) >> byte) & 0xffu);
+    // the same within the byte, with its bits spread to one per byte
+    const uint64_t spread = ((((word >> byte) & 0xffu) * L8) & UINT64_C(0x8040201008040201)) + UINT64_C(0x7f7f7f7f7f7f7f7f);
+    const uint64_t cum = ((spread >> 7u) & L8) * L8;
+    return byte + detail::bitvector_popcount64((((rb * L8) | H8) - cum) & H8);
+}
+
+C4_ALWAYS_INLINE size_t select1_impl(uint64_t const* words, uint64_t const* rank, size_t num_blocks,
+                                     uint64_t const* samples, size_t k) noexcept
+{
+    (void)num_blocks;
+    // the block of the k-th one is between the blocks of the
+    // neighbouring samples: find the last block starting before it
+    size_t lo = static_cast<size_t>(samples[k / sample_rate]);
+    const size_t hi = static_cast<size_t>(samples[k / sample_rate + 1u]);
+    C4_ASSERT(lo <= hi && hi < num_blocks);
+    for(size_t n = hi - lo + 1u; n > 1u; )
+    {
+        const size_t half = n / 2u;
+        lo = rank[2u * (lo + half)] <= k ? lo + half : lo;
+        n -= half;
+    }
+    // then the word within the block: the number of words with at
+    // most r ones before them, with the 9-bit counts
+    const uint64_t rel = rank[2u * lo + 1u];
+    const uint64_t r = static_cast<uint64_t>(k) - rank[2u * lo];
+    size_t w = 0;
+    for(size_t j = 1; j < block_words; ++j)
+        w += rank_field(rel, j) <= r;
+    return lo * block_bits + w * 64u + select_in_word(words[lo * block_words + w], static_cast<size_t>(r - rank_field(rel, w)));
+}
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+namespace detail {
+
+size_t bitvector_count_scalar(uint64_t const* words, size_t num_words) noexcept
+{
+    return count_impl(words, num_words);
+}
+size_t bitvector_build_rank_scalar(uint64_t const* words, size_t num_blocks, uint64_t *rank) noexcept
+{
+    return build_rank_impl(words, num_blocks, rank);
+}
+size_t bitvector_select1_scalar(uint64_t const* words, uint64_t const* rank, size_t num_blocks,
+                                uint64_t const* samples, size_t k) noexcept
+{
+    return select1_impl(words, rank, num_blocks, samples, k);
+}
+
+#ifdef C4_BITVECTOR_X86
+C4_CPU_TARGET("popcnt") size_t bitvector_count_popcnt(uint64_t const* words, size_t num_words) noexcept
+{
+    return count_impl(words, num_words);
+}
+C4_CPU_TARGET("popcnt") size_t bitvector_build_rank_popcnt(uint64_t const* words, size_t num_blocks, uint64_t *rank) noexcept
+{
+    return build_rank_impl(words, num_blocks, rank);
+}
+C4_CPU_TARGET("popcnt") size_t bitvector_select1_popcnt(uint64_t const* words, uint64_t const* rank, size_t num_blocks,
+                                                        uint64_t const* samples, size_t k) noexcept
+{
+    return select1_impl(words, rank, num_blocks, samples, k);
+}
+#endif
+
+} // namespace detail
+
+
+namespace {
+
+using count_fn = size_t (*)(uint64_t const*, size_t);
+using build_rank_fn = size_t (*)(uint64_t const*, size_t, uint64_t*);
+using select1_fn = size_t (*)(uint64_t const*, uint64_t const*, size_t, uint64_t const*, size_t);
+
+count_fn select_count() noexcept
+{
+    const count_fn scalar = &detail::bitvector_count_scalar;
+#ifdef C4_BITVECTOR_X86
+    const count_fn popcnt = &detail::bitvector_count_popcnt;
+    return cpu_select(CPU_POPCNT, popcnt, scalar);
+#else
+    return scalar;
+#endif
+}
+
+build_rank_fn select_build_rank() noexcept
+{
+    const build_rank_fn scalar = &detail::bitvector_build_rank_scalar;
+#ifdef C4_BITVECTOR_X86
+    const build_rank_fn popcnt = &detail::bitvector_build_rank_popcnt;
+    return cpu_select(CPU_POPCNT, popcnt, scalar);
+#else
+    return scalar;
+#endif
+}
+
+select1_fn select_select1() noexcept
+{
+    const select1_fn scalar = &detail::bitvector_select1_scalar;
+#ifdef C4_BITVECTOR_X86
+    const select1_fn popcnt = &detail::bitvector_select1_popcnt;
+    return cpu_select(CPU_POPCNT, popcnt, scalar);
+#else
+    return scalar;
+#endif
+}
+
+/** set the bits in [first,last[ */
+void set_range(uint64_t *words, size_t first, size_t last) noexcept
+{
+    if(first >= last)
+        return;
+    const size_t fw = first / 64u, lw = (last - 1u) / 64u;
+    const uint64_t fmask = ~uint64_t(0) << (first % 64u);
+    const uint64_t lmask = ~uint64_t(0) >> (63u - (last - 1u) % 64u);
+    if(fw == lw)
+    {
+        words[fw] |= fmask & lmask;
+        return;
+    }
+    words[fw] |= fmask;
+    if(lw > fw + 1u)
+        memset(words + fw + 1u, 0xff, (lw - fw - 1u) * sizeof(uint64_t));
+    words[lw] |= lmask;
+}
+
+/** zero the bits in [first,last[ */
+void reset_range(uint64_t *words, size_t first, size_t last) noexcept
+{
+    if(first >= last)
+        return;
+    const size_t fw = first / 64u, lw = (last - 1u) / 64u;
+    const uint64_t fmask = ~uint64_t(0) << (first % 64u);
+    const uint64_t lmask = ~uint64_t(0) >> (63u - (last - 1u) % 64u);
+    if(fw == lw)
+    {
+        words[fw] &= ~(fmask & lmask);
+        return;
+    }
+    words[fw] &= ~fmask;
+    if(lw > fw + 1u)
+        memset(words + fw + 1u, 0, (lw - fw - 1u) * sizeof(uint64_t));
+    words[lw] &= ~lmask;
+}
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+bitvector::bitvector(MemoryResource *mr) noexcept
+    : m_words(nullptr)
+    , m_num_bits(0)
+    , m_num_blocks(0)
+    , m_rank(nullptr)
+    , m_samples(nullptr)
+    , m_num_samples(0)
+    , m_num_ones(0)
+    , m_has_index(false)
+    , m_mr(mr ? mr : get_memory_resource())
+{
+}
+
+bitvector::bitvector(size_t num_bits, bool value, MemoryResource *mr)
+    : bitvector(mr)
+{
+    resize(num_bits, value);
+}
+
+bitvector::~bitvector()
+{
+    _free();
+}
+
+bitvector::bitvector(bitvector const& that)
+    : bitvector(that.m_mr)
+{
+    *this = that;
+}
+
+bitvector::bitvector(bitvector && that) noexcept
+    : bitvector(that.m_mr)
+{
+    _swap(that);
+}
+
+bitvector& bitvector::operator= (bitvector const& that)
+{
+    if(&that == this)
+        return *this;
+    _free();
+    if(!that.m_words)
+        return *this;
+    _alloc_words(that.m_num_bits);
+    memcpy(m_words, that.m_words, m_num_blocks * block_words * sizeof(uint64_t));
+    m_num_bits = that.m_num_bits;
+    if(that.m_has_index)
+    {
+        m_rank = static_cast<uint64_t*>(m_mr->allocate(2u * m_num_blocks * sizeof(uint64_t), 64));
+        m_samples = static_cast<uint64_t*>(m_mr->allocate(that.m_num_samples * sizeof(uint64_t), 64));
+        memcpy(m_rank, that.m_rank, 2u * m_num_blocks * sizeof(uint64_t));
+        memcpy(m_samples, that.m_samples, that.m_num_samples * sizeof(uint64_t));
+        m_num_samples = that.m_num_samples;
+        m_num_ones = that.m_num_ones;
+        m_has_index = true;
+    }
+    return *this;
+}
+
+bitvector& bitvector::operator= (bitvector && that) noexcept
+{
+    if(&that == this)
+        return *this;
+    _free();
+    _swap(that);
+    return *this;
+}
+
+void bitvector::_swap(bitvector &that) noexcept
+{
+    std::swap(m_words, that.m_words);
+    std::swap(m_num_bits, that.m_num_bits);
+    std::swap(m_num_blocks, that.m_num_blocks);
+    std::swap(m_rank, that.m_rank);
+    std::swap(m_samples, that.m_samples);
+    std::swap(m_num_samples, that.m_num_samples);
+    std::swap(m_num_ones, that.m_num_ones);
+    std::swap(m_has_index, that.m_has_index);
+    std::swap(m_mr, that.m_mr);
+}
+
+void bitvector::_alloc_words(size_t num_bits)
+{
+    C4_ASSERT(m_words == nullptr);
+    const size_t num_blocks = num_bits / block_bits + 1u;
+    m_words = static_cast<uint64_t*>(m_mr->allocate(num_blocks * block_words * sizeof(uint64_t), 64));
+    m_num_blocks = num_blocks;
+}
+
+void bitvector::_free_index() noexcept
+{
+    if(m_rank)
+        m_mr->deallocate(m_rank, 2u * m_num_blocks * sizeof(uint64_t), 64);
+    if(m_samples)
+        m_mr->deallocate(m_samples, m_num_samples * sizeof(uint64_t), 64);
+    m_rank = nullptr;
+    m_samples = nullptr;
+    m_num_samples = 0;
+    m_num_ones = 0;
+    m_has_index = false;
+}
+
+void bitvector::_free() noexcept
+{
+    _free_index();
+    if(m_words)
+        m_mr->deallocate(m_words, m_num_blocks * block_words * sizeof(uint64_t), 64);
+    m_words = nullptr;
+    m_num_bits = 0;
+    m_num_blocks = 0;
+}
+
+void bitvector::clear() noexcept
+{
+    _free();
+}
+
+
+//-----------------------------------------------------------------------------
+
+void bitvector::resize(size_t num_bits, bool value)
+{
+    _free_index();
+    // the bits past the size are kept zero
+    if(num_bits < m_num_bits)
+        reset_range(m_words, num_bits, m_num_bits);
+    const size_t num_blocks = num_bits / block_bits + 1u;
+    if(num_blocks != m_num_blocks)
+    {
+        uint64_t *prev = m_words;
+        const size_t prev_blocks = m_num_blocks;
+        m_words = nullptr;
+        _alloc_words(num_bits);
+        const size_t keep = prev_blocks < num_blocks ? prev_blocks : num_blocks;
+        if(keep)
+            memcpy(m_words, prev, keep * block_words * sizeof(uint64_t));
+        memset(m_words + keep * block_words, 0, (num_blocks - keep) * block_words * sizeof(uint64_t));
+        if(prev)
+            m_mr->deallocate(prev, prev_blocks * block_words * sizeof(uint64_t), 64);
+    }
+    if(value)
+        set_range(m_words, m_num_bits, num_bits);
+    m_num_bits = num_bits;
+}
+
+void bitvector::fill(bool value) noexcept
+{
+    m_has_index = false;
+    if(!m_num_bits)
+        return;
+    memset(m_words, value ? 0xff : 0, ((m_num_bits + 63u) / 64u) * sizeof(uint64_t));
+    if(m_num_bits % 64u)
+        m_words[m_num_bits / 64u] &= ~uint64_t(0) >> (64u - m_num_bits % 64u);
+}
+
+size_t bitvector::count() const noexcept
+{
+    static const count_fn impl = select_count();
+    return impl(m_words, (m_num_bits + 63u) / 64u);
+}
+
+
+//-----------------------------------------------------------------------------
+
+void bitvector::set(cspan<size_t> positions) noexcept
+{
+    m_has_index = false;
+    const size_t n = positions.size();
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(i + prefetch_distance < n)
+            bitvector_prefetch(m_words + positions[i + prefetch_distance] / 64u);
+        const size_t pos = positions[i];
+        C4_ASSERT(pos < m_num_bits);
+        m_words[pos / 64u] |= uint64_t(1) << (pos % 64u);
+    }
+}
+
+void bitvector::reset(cspan<size_t> positions) noexcept
+{
+    m_has_index = false;
+    const size_t n = positions.size();
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(i + prefetch_distance < n)
+            bitvector_prefetch(m_words + positions[i + prefetch_distance] / 64u);
+        const size_t pos = positions[i];
+        C4_ASSERT(pos < m_num_bits);
+        m_words[pos / 64u] &= ~(uint64_t(1) << (pos % 64u));
+    }
+}
+
+void bitvector::test(cspan<size_t> positions, span<bool> results) const noexcept
+{
+    C4_ASSERT(results.size() >= positions.size());
+    const size_t n = positions.size();
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(i + prefetch_distance < n)
+            bitvector_prefetch(m_words + positions[i + prefetch_distance] / 64u);
+        const size_t pos = positions[i];
+        C4_ASSERT(pos < m_num_bits);
+        results[i] = (m_words[pos / 64u] >> (pos % 64u)) & 1u;
+    }
+}
+
+size_t bitvector::count(cspan<size_t> positions) const noexcept
+{
+    size_t num = 0;
+    const size_t n = positions.size();
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(i + prefetch_distance < n)
+            bitvector_prefetch(m_words + positions[i + prefetch_distance] / 64u);
+        const size_t pos = positions[i];
+        C4_ASSERT(pos < m_num_bits);
+        num += (m_words[pos / 64u] >> (pos % 64u)) & 1u;
+    }
+    return num;
+}
+
+void bitvector::rank1(cspan<size_t> positions, span<size_t> ranks) const noexcept
+{
+    C4_ASSERT(m_has_index);
+    C4_ASSERT(ranks.size() >= positions.size());
+    const size_t n = positions.size();
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(i + prefetch_distance < n)
+        {
+            const size_t ahead = positions[i + prefetch_distance];
+            bitvector_prefetch(m_rank + 2u * (ahead / block_bits));
+            bitvector_prefetch(m_words + ahead / 64u);
+        }
+        ranks[i] = rank1(positions[i]);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+void bitvector::build_index()
+{
+    if(!m_words)
+        resize(0);
+    _free_index();
+    static const build_rank_fn impl = select_build_rank();
+    m_rank = static_cast<uint64_t*>(m_mr->allocate(2u * m_num_blocks * sizeof(uint64_t), 64));
+    m_num_ones = impl(m_words, m_num_blocks, m_rank);
+    // the block of every sample_rate-th one, and a sentinel with the
+    // last block, which bounds the search of select1()
+    const size_t num_samples = (m_num_ones + sample_rate - 1u) / sample_rate + 1u;
+    m_samples = static_cast<uint64_t*>(m_mr->allocate(num_samples * sizeof(uint64_t), 64));
+    m_num_samples = num_samples;
+    size_t j = 0;
+    for(size_t b = 0; b < m_num_blocks; ++b)
+    {
+        const size_t end = b + 1u < m_num_blocks ? static_cast<size_t>(m_rank[2u * (b + 1u)]) : m_num_ones;
+        for( ; j * sample_rate < end; ++j)
+            m_samples[j] = b;
+    }
+    C4_ASSERT(j + 1u == num_samples);
+    m_samples[j] = m_num_blocks - 1u;
+    m_has_index = true;
+}
+
+size_t bitvector::select1(size_t k) const noexcept
+{
+    C4_ASSERT(m_has_index);
+    if(k >= m_num_ones)
+        return npos;
+    static const select1_fn impl = select_select1();
+    return impl(m_words, m_rank, m_num_blocks, m_samples, k);
+}
+
+} // namespace c4
@@ -0,0 +1,233 @@
+#ifndef _C4_BITVECTOR_HPP_
+#define _C4_BITVECTOR_HPP_
+
+/** @file bitvector.hpp A vector of bits, with constant-time rank and
+ * fast select. */
+
+#include "c4/config.hpp"
+#include "c4/error.hpp"
+#include "c4/memory_resource.hpp"
+#include "c4/span.hpp"
+
+namespace c4 {
+
+#if defined(C4_CPU_X86_64) && !defined(C4_BITVECTOR_NO_SIMD)
+#   define C4_BITVECTOR_X86
+#endif
+
+namespace detail {
+
+C4_ALWAYS_INLINE unsigned bitvector_popcount64(uint64_t v) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_popcountll(v));
+#else
+    v = v - ((v >> 1) & UINT64_C(0x5555555555555555));
+    v = (v & UINT64_C(0x3333333333333333)) + ((v >> 2) & UINT64_C(0x3333333333333333));
+    v = (v + (v >> 4)) & UINT64_C(0x0f0f0f0f0f0f0f0f);
+    return static_cast<unsigned>((v * UINT64_C(0x0101010101010101)) >> 56);
+#endif
+}
+
+/** @cond dev */
+// the implementations selected at runtime by bitvector. The popcnt
+// ones are the same code, compiled for the popcnt instruction.
+size_t bitvector_count_scalar(uint64_t const* words, size_t num_words) noexcept;
+size_t bitvector_build_rank_scalar(uint64_t const* words, size_t num_blocks, uint64_t *rank) noexcept;
+size_t bitvector_select1_scalar(uint64_t const* words, uint64_t const* rank, size_t num_blocks,
+                                uint64_t const* samples, size_t k) noexcept;
+#ifdef C4_BITVECTOR_X86
+size_t bitvector_count_popcnt(uint64_t const* words, size_t num_words) noexcept;
+size_t bitvector_build_rank_popcnt(uint64_t const* words, size_t num_blocks, uint64_t *rank) noexcept;
+size_t bitvector_select1_popcnt(uint64_t const* words, uint64_t const* rank, size_t num_blocks,
+                                uint64_t const* samples, size_t k) noexcept;
+#endif
+/** @endcond */
+
+} // namespace detail
+
+
+/** A vector of bits, packed in 64-bit words, with memory from a
+ * MemoryResource. Besides the usual bit operations, it answers
+ * rank1(i), the number of ones before position i, in constant time,
+ * and select1(k), the position of the k-th one, in about constant
+ * time for non-pathological inputs: the succinct structures of
+ * compact indexes, eg to map the position of an element in a sparse
+ * universe to its position among the present ones, and back.
+ *
+ * Rank and select need an index, made with build_index() once the
+ * bits are set. Any modification discards the index. The index is
+ * Rank9 (Vigna, "Broadword implementation of rank/select queries",
+ * 2008): for each block of 512 bits, the number of ones before it
+ * and, packed in 9-bit fields, the number of ones before each of its
+ * words within the block, which is 25% of the size of the bits. For
+ * select, the block of every 512th one is sampled, adding up to 12.5%
+ * more for dense vectors; the blocks between two samples are found
+ * with a binary search on the counts of the index.
+ *
+ * The popcounts of count(), build_index() and select1() use the popcnt
+ * instruction when available.
+ *
+ * @code
+ * c4::bitvector present(universe_size);
+ * for(size_t id : ids)
+ *     present.set(id);
+ * present.build_index();
+ * size_t pos = present.rank1(id);   // the position of id among the present
+ * size_t id2 = present.select1(pos); // and back: id2 == id
+ * @endcode
+ *
+ * @ingroup contiguous_containers */
+class bitvector
+{
+public:
+
+    enum : size_t { npos = (size_t)-1 };
+
+public:
+
+    /** @param mr the memory resource, or null for get_memory_resource() */
+    explicit bitvector(MemoryResource *mr=nullptr) noexcept;
+    /** @param mr the memory resource, or null for get_memory_resource() */
+    explicit bitvector(size_t num_bits, bool value=false, MemoryResource *mr=nullptr);
+    ~bitvector();
+
+    /** the copy uses the same memory resource */
+    bitvector(bitvector const& that);
+    bitvector(bitvector && that) noexcept;
+    bitvector& operator= (bitvector const& that);
+    bitvector& operator= (bitvector && that) noexcept;
+
+public:
+
+    MemoryResource* resource() const noexcept { return m_mr; }
+
+    size_t size() const noexcept { return m_num_bits; }
+    bool empty() const noexcept { return m_num_bits == 0; }
+
+    /** change the number of bits; the new ones are set to @p value */
+    void resize(size_t num_bits, bool value=false);
+    /** set all the bits to @p value */
+    void fill(bool value) noexcept;
+    /** set the size to zero, and release the memory */
+    void clear() noexcept;
+
+    /** the bits, 64 per word from the least significant one. The bits
+     * past size() in the last word are zero. */
+    cspan<uint64_t> words() const noexcept { return cspan<uint64_t>(m_words, (m_num_bits + 63u) / 64u); }
+
+public:
+
+    C4_ALWAYS_INLINE bool test(size_t i) const noexcept
+    {
+        C4_ASSERT(i < m_num_bits);
+        return (m_words[i / 64u] >> (i % 64u)) & 1u;
+    }
+    C4_ALWAYS_INLINE bool operator[] (size_t i) const noexcept { return test(i); }
+
+    C4_ALWAYS_INLINE void set(size_t i) noexcept
+    {
+        C4_ASSERT(i < m_num_bits);
+        m_words[i / 64u] |= uint64_t(1) << (i % 64u);
+        m_has_index = false;
+    }
+    C4_ALWAYS_INLINE void reset(size_t i) noexcept
+    {
+        C4_ASSERT(i < m_num_bits);
+        m_words[i / 64u] &= ~(uint64_t(1) << (i % 64u));
+        m_has_index = false;
+    }
+    C4_ALWAYS_INLINE void set(size_t i, bool value) noexcept
+    {
+        C4_ASSERT(i < m_num_bits);
+        const uint64_t bit = uint64_t(1) << (i % 64u);
+        m_words[i / 64u] = (m_words[i / 64u] & ~bit) | ((uint64_t(0) - uint64_t(value)) & bit);
+        m_has_index = false;
+    }
+    C4_ALWAYS_INLINE void flip(size_t i) noexcept
+    {
+        C4_ASSERT(i < m_num_bits);
+        m_words[i / 64u] ^= uint64_t(1) << (i % 64u);
+        m_has_index = false;
+    }
+
+    /** @name bulk operations
+     * These process the positions in order, prefetching the words of
+     * those a few steps ahead: with positions spread over a large
+     * vector, the cache misses of consecutive positions overlap. */
+    /** @{ */
+
+    /** set the bits at the given positions */
+    void set(cspan<size_t> positions) noexcept;
+    /** reset the bits at the given positions */
+    void reset(cspan<size_t> positions) noexcept;
+    /** write the bits at the given positions */
+    void test(cspan<size_t> positions, span<bool> results) const noexcept;
+    /** the number of ones at the given positions */
+    size_t count(cspan<size_t> positions) const noexcept;
+    /** write rank1() of the given positions; needs the index */
+    void rank1(cspan<size_t> positions, span<size_t> ranks) const noexcept;
+
+    /** @} */
+
+    /** the number of ones */
+    size_t count() const noexcept;
+
+public:
+
+    /** make the index of rank1() and select1(), which stays valid
+     * until the bits are modified */
+    void build_index();
+    bool has_index() const noexcept { return m_has_index; }
+
+    /** the number of ones in [0,i[, for i <= size() */
+    C4_ALWAYS_INLINE size_t rank1(size_t i) const noexcept
+    {
+        C4_ASSERT(m_has_index);
+        C4_ASSERT(i <= m_num_bits);
+        const size_t block = i / 512u;
+        const size_t word = (i / 64u) % 8u;
+        const uint64_t rel = m_rank[2u * block + 1u];
+        // the words past size() are zero, and there is always one
+        const uint64_t bits = m_words[i / 64u] & ((uint64_t(1) << (i % 64u)) - 1u);
+        return static_cast<size_t>(m_rank[2u * block]
+                                   + (word ? (rel >> (9u * (word - 1u))) & 0x1ffu : 0u)
+                                   + detail::bitvector_popcount64(bits));
+    }
+    /** the number of zeros in [0,i[, for i <= size() */
+    C4_ALWAYS_INLINE size_t rank0(size_t i) const noexcept
+    {
+        return i - rank1(i);
+    }
+
+    /** the position of the k-th one (from zero), or npos if there are
+     * not as many ones */
+    size_t select1(size_t k) const noexcept;
+
+    /** the number of ones, from the index */
+    size_t num_ones() const noexcept { C4_ASSERT(m_has_index); return m_num_ones; }
+
+private:
+
+    void _alloc_words(size_t num_bits);
+    void _free_index() noexcept;
+    void _free() noexcept;
+    void _swap(bitvector &that) noexcept;
+
+private:
+
+    uint64_t *m_words;       //!< whole blocks of 8 words, with at least one word past size()
+    size_t    m_num_bits;
+    size_t    m_num_blocks;  //!< the number of blocks of 8 words allocated
+    uint64_t *m_rank;        //!< for each block: the ones before it, and 7 9-bit counts
+    uint64_t *m_samples;     //!< the block of every 512th one
+    size_t    m_num_samples;
+    size_t    m_num_ones;
+    bool      m_has_index;
+    MemoryResource *m_mr;
+
+};
+
+} // namespace c4
+
+#endif /* _C4_BITVECTOR_HPP_ */
@@ -0,0 +1,180 @@
+#include "c4/bytes.hpp"
+#include "c4/cpu_features.hpp"
+
+#ifdef C4_BYTES_X86
+#   include <immintrin.h>
+#endif
+
+namespace c4 {
+
+namespace detail {
+
+namespace {
+
+template<class U>
+void bswap_n_scalar_(U *dst, U const* src, size_t num) noexcept
+{
+    for(size_t i = 0; i < num; ++i)
+    {
+        U v;
+        memcpy(&v, src + i, sizeof(U));
+        v = bswap(v);
+        memcpy(dst + i, &v, sizeof(U));
+    }
+}
+
+} // anonymous namespace
+
+void bswap_n_scalar(uint16_t *dst, uint16_t const* src, size_t num) noexcept { bswap_n_scalar_(dst, src, num); }
+void bswap_n_scalar(uint32_t *dst, uint32_t const* src, size_t num) noexcept { bswap_n_scalar_(dst, src, num); }
+void bswap_n_scalar(uint64_t *dst, uint64_t const* src, size_t num) noexcept { bswap_n_scalar_(dst, src, num); }
+
+} // namespace detail
+
+
+//-----------------------------------------------------------------------------
+// x86 kernels: the bytes of each element are reversed with a byte
+// shuffle, over 4 vectors per step. All the vectors of a step are
+// loaded before they are stored, so that the conversion can be done in
+// place. The tail of the input is left to the scalar code.
+
+#ifdef C4_BYTES_X86
+
+namespace detail {
+
+namespace {
+
+/** the shuffles reversing the bytes of the elements of 2, 4 and 8
+ * bytes, for the two lanes of an avx2 vector */
+alignas(32) const uint8_t bswap_shuffles[3][32] = {
+    {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+     1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14},
+    {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+     3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12},
+    {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+     7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8},
+};
+
+template<class U>
+C4_ALWAYS_INLINE const uint8_t* bswap_shuffle() noexcept
+{
+    return bswap_shuffles[sizeof(U) == 2 ? 0 : sizeof(U) == 4 ? 1 : 2];
+}
+
+template<class U>
+C4_CPU_TARGET("ssse3") void bswap_n_ssse3_(U *dst_, U const* src_, size_t num)
+{
+    const __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(bswap_shuffle<U>()));
+    const char *src = reinterpret_cast<const char*>(src_);
+    char *dst = reinterpret_cast<char*>(dst_);
+    const size_t len = num * sizeof(U);
+    size_t pos = 0;
+    for( ; pos + 64 <= len; pos += 64)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos + 16));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos + 32));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos + 48));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + pos), _mm_shuffle_epi8(a, shuffle));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + pos + 16), _mm_shuffle_epi8(b, shuffle));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + pos + 32), _mm_shuffle_epi8(c, shuffle));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + pos + 48), _mm_shuffle_epi8(d, shuffle));
+    }
+    for( ; pos + 16 <= len; pos += 16)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + pos), _mm_shuffle_epi8(a, shuffle));
+    }
+    const size_t done = pos / sizeof(U);
+    bswap_n_scalar_(dst_ + done, src_ + done, num - done);
+}
+
+template<class U>
+C4_CPU_TARGET("avx2") void bswap_n_avx2_(U *dst_, U const* src_, size_t num)
+{
+    const __m256i shuffle = _mm256_load_si256(reinterpret_cast<const __m256i*>(bswap_shuffle<U>()));
+    const char *src = reinterpret_cast<const char*>(src_);
+    char *dst = reinterpret_cast<char*>(dst_);
+    const size_t len = num * sizeof(U);
+    size_t pos = 0;
+    for( ; pos + 128 <= len; pos += 128)
+    {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + pos));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + pos + 32));
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + pos + 64));
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + pos + 96));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + pos), _mm256_shuffle_epi8(a, shuffle));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + pos + 32), _mm256_shuffle_epi8(b, shuffle));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + pos + 64), _mm256_shuffle_epi8(c, shuffle));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + pos + 96), _mm256_shuffle_epi8(d, shuffle));
+    }
+    for( ; pos + 32 <= len; pos += 32)
+    {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + pos));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + pos), _mm256_shuffle_epi8(a, shuffle));
+    }
+    // avoid the penalty of mixing avx and legacy sse instructions
+    _mm256_zeroupper();
+    const size_t done = pos / sizeof(U);
+    bswap_n_ssse3_(dst_ + done, src_ + done, num - done);
+}
+
+} // anonymous namespace
+
+void bswap_n_ssse3(uint16_t *dst, uint16_t const* src, size_t num) noexcept { bswap_n_ssse3_(dst, src, num); }
+void bswap_n_ssse3(uint32_t *dst, uint32_t const* src, size_t num) noexcept { bswap_n_ssse3_(dst, src, num); }
+void bswap_n_ssse3(uint64_t *dst, uint64_t const* src, size_t num) noexcept { bswap_n_ssse3_(dst, src, num); }
+void bswap_n_avx2(uint16_t *dst, uint16_t const* src, size_t num) noexcept { bswap_n_avx2_(dst, src, num); }
+void bswap_n_avx2(uint32_t *dst, uint32_t const* src, size_t num) noexcept { bswap_n_avx2_(dst, src, num); }
+void bswap_n_avx2(uint64_t *dst, uint64_t const* src, size_t num) noexcept { bswap_n_avx2_(dst, src, num); }
+
+} // namespace detail
+
+#endif // C4_BYTES_X86
+
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+template<class U>
+using bswap_n_fn = void (*)(U*, U const*, size_t);
+
+template<class U>
+bswap_n_fn<U> bswap_n_select_impl() noexcept
+{
+    const bswap_n_fn<U> scalar = &detail::bswap_n_scalar;
+#ifdef C4_BYTES_X86
+    const bswap_n_fn<U> avx2 = &detail::bswap_n_avx2;
+    const bswap_n_fn<U> ssse3 = &detail::bswap_n_ssse3;
+    return cpu_select(CPU_AVX2, avx2, CPU_SSSE3, ssse3, scalar);
+#else
+    return scalar;
+#endif
+}
+
+} // anonymous namespace
+
+namespace detail {
+
+void bswap_n(uint16_t *dst, uint16_t const* src, size_t num) noexcept
+{
+    static const bswap_n_fn<uint16_t> impl = bswap_n_select_impl<uint16_t>();
+    impl(dst, src, num);
+}
+
+void bswap_n(uint32_t *dst, uint32_t const* src, size_t num) noexcept
+{
+    static const bswap_n_fn<uint32_t> impl = bswap_n_select_impl<uint32_t>();
+    impl(dst, src, num);
+}
+
+void bswap_n(uint64_t *dst, uint64_t const* src, size_t num) noexcept
+{
+    static const bswap_n_fn<uint64_t> impl = bswap_n_select_impl<uint64_t>();
+    impl(dst, src, num);
+}
+
+} // namespace detail
+
+} // namespace c4
@@ -0,0 +1,570 @@
+#ifndef _C4_BYTES_HPP_
+#define _C4_BYTES_HPP_
+
+/** @file bytes.hpp Serialization of scalars to and from binary buffers,
+ * in the native, little-endian or big-endian byte order. */
+
+#include "c4/config.hpp"
+#include "c4/cpu.hpp"
+#include "c4/blob.hpp"
+#include "c4/span.hpp"
+#include "c4/substr.hpp"
+
+#include <string.h>
+#include <type_traits>
+#include <utility>
+#if defined(_MSC_VER) && !defined(__clang__)
+#   include <stdlib.h>
+#endif
+
+namespace c4 {
+
+/** @defgroup bytes Binary serialization
+ *
+ * to_bytes() and from_bytes() are the binary counterparts of
+ * to_chars() and from_chars(): they write a scalar to a blob as its
+ * bytes, and read it back. Values are written in the native byte
+ * order, unless wrapped with fmt::le() or fmt::be(), which write
+ * little-endian or big-endian whatever the host. cat_bytes() and
+ * uncat_bytes() serialize several values, like cat() and uncat():
+ *
+ * @code
+ * char buf[16];
+ * size_t sz = c4::cat_bytes(buf, c4::fmt::be(uint32_t(0xdeadbeef)), c4::fmt::le(int16_t(-2)));
+ * // sz is 6, and buf starts with de ad be ef fe ff
+ * uint32_t a;
+ * int16_t b;
+ * c4::uncat_bytes(c4::cblob(buf, sz), c4::fmt::be(a), c4::fmt::le(b));
+ * @endcode
+ *
+ * Arrays of scalars are converted in place or copied with
+ * byteswap_n(), to_le_n() and to_be_n().
+ *
+ * The scalars are the integral, floating point and enum types of 1,
+ * 2, 4 or 8 bytes, and bool, which is written as a single 0 or 1 byte.
+ * The buffers need not be aligned. Like to_chars(), to_bytes() returns
+ * the size needed, and writes only if the buffer is large enough.
+ * Other types can be serialized by overloading to_bytes() and
+ * from_bytes() in their namespace.
+ *
+ * All of these also accept a substr (or, for reading, a csubstr) as
+ * the buffer, and use its characters. Without these overloads, the
+ * string would convert to a blob of the string object itself.
+ */
+
+
+//-----------------------------------------------------------------------------
+
+namespace detail {
+
+template<size_t N> struct bytes_uint;
+template<> struct bytes_uint<1> { using type = uint8_t; };
+template<> struct bytes_uint<2> { using type = uint16_t; };
+template<> struct bytes_uint<4> { using type = uint32_t; };
+template<> struct bytes_uint<8> { using type = uint64_t; };
+/** the unsigned integer with the size of T */
+template<class T> using bytes_uint_t = typename bytes_uint<sizeof(T)>::type;
+
+/** true for the types which to_bytes() writes as their bytes */
+template<class T>
+struct is_bytes_scalar : public std::integral_constant<bool,
+    (std::is_arithmetic<T>::value || std::is_enum<T>::value)
+    && ( ! std::is_same<T, bool>::value)
+    && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)>
+{
+};
+
+C4_ALWAYS_INLINE uint8_t bswap(uint8_t v) noexcept
+{
+    return v;
+}
+C4_ALWAYS_INLINE uint16_t bswap(uint16_t v) noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _byteswap_ushort(v);
+#else
+    return __builtin_bswap16(v);
+#endif
+}
+C4_ALWAYS_INLINE uint32_t bswap(uint32_t v) noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _byteswap_ulong(v);
+#else
+    return __builtin_bswap32(v);
+#endif
+}
+C4_ALWAYS_INLINE uint64_t bswap(uint64_t v) noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+template<class U> C4_ALWAYS_INLINE U bswap_if(std::true_type, U v) noexcept { return bswap(v); }
+template<class U> C4_ALWAYS_INLINE U bswap_if(std::false_type, U v) noexcept { return v; }
+
+/** whether values must be swapped to get the given byte order */
+using swap_native = std::false_type;
+using swap_le = std::integral_constant<bool, C4_BIG_ENDIAN>;
+using swap_be = std::integral_constant<bool, C4_LITTLE_ENDIAN>;
+
+template<class Swap, class T>
+C4_ALWAYS_INLINE size_t put_bytes(blob buf, T v) noexcept
+{
+    C4_STATIC_ASSERT(is_bytes_scalar<T>::value);
+    if(C4_LIKELY(sizeof(T) <= buf.len))
+    {
+        bytes_uint_t<T> u;
+        memcpy(&u, &v, sizeof(T));
+        u = bswap_if(Swap(), u);
+        memcpy(buf.buf, &u, sizeof(T));
+    }
+    return sizeof(T);
+}
+template<class Swap>
+C4_ALWAYS_INLINE size_t put_bytes(blob buf, bool v) noexcept
+{
+    if(C4_LIKELY(buf.len))
+        buf.buf[0] = static_cast<byte>(v ? 1 : 0);
+    return 1;
+}
+
+template<class Swap, class T>
+C4_ALWAYS_INLINE size_t get_bytes(cblob buf, T *C4_RESTRICT v) noexcept
+{
+    C4_STATIC_ASSERT(is_bytes_scalar<T>::value);
+    if(C4_UNLIKELY(sizeof(T) > buf.len))
+        return csubstr::npos;
+    bytes_uint_t<T> u;
+    memcpy(&u, buf.buf, sizeof(T));
+    u = bswap_if(Swap(), u);
+    memcpy(v, &u, sizeof(T));
+    return sizeof(T);
+}
+template<class Swap>
+C4_ALWAYS_INLINE size_t get_bytes(cblob buf, bool *C4_RESTRICT v) noexcept
+{
+    if(C4_UNLIKELY( ! buf.len))
+        return csubstr::npos;
+    *v = (buf.buf[0] != 0);
+    return 1;
+}
+
+/** the type of the value held by a wrapper, which may be a reference */
+template<class T>
+using bytes_value_t = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
+
+template<class T>
+using enable_bytes_scalar = typename std::enable_if<is_bytes_scalar<T>::value || std::is_same<T, bool>::value, size_t>::type;
+
+} // namespace detail
+
+
+//-----------------------------------------------------------------------------
+
+/** reverse the bytes of an integer
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE T byteswap(T v) noexcept
+{
+    C4_STATIC_ASSERT(std::is_integral<T>::value);
+    return static_cast<T>(detail::bswap(static_cast<detail::bytes_uint_t<T>>(v)));
+}
+
+
+#if (defined(C4_CPU_X86_64) || defined(C4_CPU_X86)) && !defined(C4_BYTES_NO_SIMD)
+#   define C4_BYTES_X86
+#endif
+
+namespace detail {
+/** @cond dev */
+// reverse the bytes of each of num integers, from src to dst, which
+// may be the same but must not overlap otherwise. bswap_n() selects
+// among the implementations at runtime; the vector ones defer their
+// tail to the scalar ones.
+void bswap_n(uint16_t *dst, uint16_t const* src, size_t num) noexcept;
+void bswap_n(uint32_t *dst, uint32_t const* src, size_t num) noexcept;
+void bswap_n(uint64_t *dst, uint64_t const* src, size_t num) noexcept;
+void bswap_n_scalar(uint16_t *dst, uint16_t const* src, size_t num) noexcept;
+void bswap_n_scalar(uint32_t *dst, uint32_t const* src, size_t num) noexcept;
+void bswap_n_scalar(uint64_t *dst, uint64_t const* src, size_t num) noexcept;
+#ifdef C4_BYTES_X86
+void bswap_n_ssse3(uint16_t *dst, uint16_t const* src, size_t num) noexcept;
+void bswap_n_ssse3(uint32_t *dst, uint32_t const* src, size_t num) noexcept;
+void bswap_n_ssse3(uint64_t *dst, uint64_t const* src, size_t num) noexcept;
+void bswap_n_avx2(uint16_t *dst, uint16_t const* src, size_t num) noexcept;
+void bswap_n_avx2(uint32_t *dst, uint32_t const* src, size_t num) noexcept;
+void bswap_n_avx2(uint64_t *dst, uint64_t const* src, size_t num) noexcept;
+#endif
+/** @endcond */
+
+template<class T>
+C4_ALWAYS_INLINE void bswap_span(T *dst, T const* src, size_t num) noexcept
+{
+    C4_STATIC_ASSERT(is_bytes_scalar<T>::value && sizeof(T) > 1);
+    using U = bytes_uint_t<T>;
+    bswap_n(reinterpret_cast<U*>(dst), reinterpret_cast<U const*>(src), num);
+}
+
+template<class T>
+C4_ALWAYS_INLINE void order_span(std::true_type /*swap*/, T *dst, T const* src, size_t num) noexcept
+{
+    bswap_span(dst, src, num);
+}
+template<class T>
+C4_ALWAYS_INLINE void order_span(std::false_type /*swap*/, T *dst, T const* src, size_t num) noexcept
+{
+    C4_STATIC_ASSERT(is_bytes_scalar<T>::value && sizeof(T) > 1);
+    if(dst != src && num)
+        memcpy(dst, src, num * sizeof(T));
+}
+} // namespace detail
+
+
+/** reverse the bytes of each element of a span, in place. The elements
+ * are integers, reals or enums of 2, 4 or 8 bytes. This is vectorized
+ * with SSSE3 or AVX2 where available.
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE void byteswap_n(span<T> vals) noexcept
+{
+    detail::bswap_span(vals.data(), vals.data(), vals.size());
+}
+/** reverse the bytes of each element of a span, into another span
+ * with room for as many elements. The spans must not overlap.
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE void byteswap_n(cspan<T> src, span<T> dst) noexcept
+{
+    C4_ASSERT(dst.size() >= src.size());
+    detail::bswap_span(dst.data(), src.data(), src.size());
+}
+/** the same, from a mutable source: a span<T> is not converted to a
+ * cspan<T> when deducing T
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE void byteswap_n(span<T> src, span<T> dst) noexcept
+{
+    byteswap_n(cspan<T>(src.data(), src.size()), dst);
+}
+
+/** convert the elements of a span between the native byte order and
+ * little-endian order, in place. This does nothing on a little-endian
+ * host. The conversion is the same in both directions, so this also
+ * reads little-endian data.
+ * @see byteswap_n()
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE void to_le_n(span<T> vals) noexcept
+{
+    detail::order_span(detail::swap_le(), vals.data(), vals.data(), vals.size());
+}
+/** convert the elements of a span between the native byte order and
+ * little-endian order, into another span. This is a copy on a
+ * little-endian host.
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE void to_le_n(cspan<T> src, span<T> dst) noexcept
+{
+    C4_ASSERT(dst.size() >= src.size());
+    detail::order_span(detail::swap_le(), dst.data(), src.data(), src.size());
+}
+/** the same, from a mutable source: a span<T> is not converted to a
+ * cspan<T> when deducing T
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE void to_le_n(span<T> src, span<T> dst) noexcept
+{
+    to_le_n(cspan<T>(src.data(), src.size()), dst);
+}
+
+/** convert the elements of a span between the native byte order and
+ * big-endian (network) order, in place. This does nothing on a
+ * big-endian host. The conversion is the same in both directions, so
+ * this also reads big-endian data.
+ * @see byteswap_n()
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE void to_be_n(span<T> vals) noexcept
+{
+    detail::order_span(detail::swap_be(), vals.data(), vals.data(), vals.size());
+}
+/** convert the elements of a span between the native byte order and
+ * big-endian (network) order, into another span. This is a copy on a
+ * big-endian host.
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE void to_be_n(cspan<T> src, span<T> dst) noexcept
+{
+    C4_ASSERT(dst.size() >= src.size());
+    detail::order_span(detail::swap_be(), dst.data(), src.data(), src.size());
+}
+/** the same, from a mutable source: a span<T> is not converted to a
+ * cspan<T> when deducing T
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE void to_be_n(span<T> src, span<T> dst) noexcept
+{
+    to_be_n(cspan<T>(src.data(), src.size()), dst);
+}
+
+
+//-----------------------------------------------------------------------------
+
+namespace fmt {
+
+/** @see le() */
+template<class T>
+struct le_
+{
+    T val;
+};
+
+/** @see be() */
+template<class T>
+struct be_
+{
+    T val;
+};
+
+/** mark a value to be written to bytes in little-endian order. Wrapping
+ * a mutable variable also marks it to be read in little-endian order.
+ * @ingroup bytes */
+template<class T> C4_ALWAYS_INLINE le_<T&> le(T &v) noexcept { return le_<T&>{v}; }
+/** @ingroup bytes */
+template<class T> C4_ALWAYS_INLINE le_<T> le(T const& v) noexcept { return le_<T>{v}; }
+
+/** mark a value to be written to bytes in big-endian (network) order.
+ * Wrapping a mutable variable also marks it to be read in big-endian
+ * order.
+ * @ingroup bytes */
+template<class T> C4_ALWAYS_INLINE be_<T&> be(T &v) noexcept { return be_<T&>{v}; }
+/** @ingroup bytes */
+template<class T> C4_ALWAYS_INLINE be_<T> be(T const& v) noexcept { return be_<T>{v}; }
+
+} // namespace fmt
+
+
+//-----------------------------------------------------------------------------
+
+/** write a scalar in the native byte order
+ * @return the number of bytes needed. Nothing is written if the buffer
+ * is smaller than that.
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE auto to_bytes(blob buf, T v) noexcept
+    -> detail::enable_bytes_scalar<T>
+{
+    return detail::put_bytes<detail::swap_native>(buf, v);
+}
+/** write a scalar in little-endian order
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE auto to_bytes(blob buf, fmt::le_<T> w) noexcept
+    -> detail::enable_bytes_scalar<detail::bytes_value_t<T>>
+{
+    return detail::put_bytes<detail::swap_le>(buf, static_cast<detail::bytes_value_t<T>>(w.val));
+}
+/** write a scalar in big-endian order
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE auto to_bytes(blob buf, fmt::be_<T> w) noexcept
+    -> detail::enable_bytes_scalar<detail::bytes_value_t<T>>
+{
+    return detail::put_bytes<detail::swap_be>(buf, static_cast<detail::bytes_value_t<T>>(w.val));
+}
+/** write the bytes of a blob as they are
+ * @ingroup bytes */
+inline size_t to_bytes(blob buf, cblob data) noexcept
+{
+    if(C4_LIKELY(data.len <= buf.len) && data.len)
+        memcpy(buf.buf, data.buf, data.len);
+    return data.len;
+}
+/** @ingroup bytes */
+inline size_t to_bytes(blob buf, blob data) noexcept
+{
+    return to_bytes(buf, cblob(data.buf, data.len));
+}
+/** write the characters of a string as they are, without their length
+ * @ingroup bytes */
+inline size_t to_bytes(blob buf, csubstr s) noexcept
+{
+    return to_bytes(buf, cblob(s.str, s.len));
+}
+/** @ingroup bytes */
+inline size_t to_bytes(blob buf, substr s) noexcept
+{
+    return to_bytes(buf, cblob(s.str, s.len));
+}
+/** write into the characters of a substr
+ * @ingroup bytes */
+template<class Buf, class T>
+C4_ALWAYS_INLINE auto to_bytes(Buf buf, T const& v) noexcept
+    -> typename std::enable_if<std::is_same<Buf, substr>::value, size_t>::type
+{
+    return to_bytes(blob(buf.str, buf.len), v);
+}
+/** the characters of a csubstr cannot be written
+ * @ingroup bytes */
+template<class Buf, class T>
+auto to_bytes(Buf buf, T const& v) noexcept
+    -> typename std::enable_if<std::is_same<Buf, csubstr>::value, size_t>::type = delete;
+
+
+/** read a scalar in the native byte order
+ * @return the number of bytes read, or csubstr::npos if the buffer is
+ * too small
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE auto from_bytes(cblob buf, T *C4_RESTRICT v) noexcept
+    -> detail::enable_bytes_scalar<T>
+{
+    return detail::get_bytes<detail::swap_native>(buf, v);
+}
+/** read a scalar in little-endian order
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE auto from_bytes(cblob buf, fmt::le_<T&> w) noexcept
+    -> detail::enable_bytes_scalar<T>
+{
+    return detail::get_bytes<detail::swap_le>(buf, &w.val);
+}
+/** @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE auto from_bytes(cblob buf, fmt::le_<T&> *w) noexcept
+    -> detail::enable_bytes_scalar<T>
+{
+    return detail::get_bytes<detail::swap_le>(buf, &w->val);
+}
+/** read a scalar in big-endian order
+ * @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE auto from_bytes(cblob buf, fmt::be_<T&> w) noexcept
+    -> detail::enable_bytes_scalar<T>
+{
+    return detail::get_bytes<detail::swap_be>(buf, &w.val);
+}
+/** @ingroup bytes */
+template<class T>
+C4_ALWAYS_INLINE auto from_bytes(cblob buf, fmt::be_<T&> *w) noexcept
+    -> detail::enable_bytes_scalar<T>
+{
+    return detail::get_bytes<detail::swap_be>(buf, &w->val);
+}
+/** read as many bytes as the blob has
+ * @ingroup bytes */
+inline size_t from_bytes(cblob buf, blob *data) noexcept
+{
+    if(C4_UNLIKELY(data->len > buf.len))
+        return csubstr::npos;
+    if(data->len)
+        memcpy(data->buf, buf.buf, data->len);
+    return data->len;
+}
+/** read as many characters as the string has
+ * @ingroup bytes */
+inline size_t from_bytes(cblob buf, substr *s) noexcept
+{
+    blob data(s->str, s->len);
+    return from_bytes(buf, &data);
+}
+/** read from the characters of a substr or csubstr
+ * @ingroup bytes */
+template<class Buf, class Out>
+C4_ALWAYS_INLINE auto from_bytes(Buf buf, Out &&out) noexcept
+    -> typename std::enable_if<std::is_same<Buf, substr>::value || std::is_same<Buf, csubstr>::value, size_t>::type
+{
+    return from_bytes(cblob(buf.str, buf.len), std::forward<Out>(out));
+}
+
+
+//-----------------------------------------------------------------------------
+
+namespace detail {
+template<class B>
+C4_ALWAYS_INLINE B advance_blob(B buf, size_t num) noexcept
+{
+    return buf.len >= num ? B(buf.buf + num, buf.len - num) : B();
+}
+} // namespace detail
+
+/** terminates the variadic recursion
+ * @ingroup bytes */
+inline size_t cat_bytes(blob /*buf*/)
+{
+    return 0;
+}
+
+/** serialize the arguments to bytes, concatenating them to the given
+ * buffer. No writes occur beyond the end of the buffer.
+ * @return the number of bytes needed to write all the arguments
+ * @see cat() for the text equivalent
+ * @see uncat_bytes() for the inverse function
+ * @ingroup bytes */
+template<class Arg, class... Args>
+size_t cat_bytes(blob buf, Arg const& C4_RESTRICT a, Args const& C4_RESTRICT ...more)
+{
+    size_t num = to_bytes(buf, a);
+    buf = detail::advance_blob(buf, num);
+    num += cat_bytes(buf, more...);
+    return num;
+}
+
+/** serialize the arguments into the characters of a substr
+ * @ingroup bytes */
+template<class Buf, class... Args>
+auto cat_bytes(Buf buf, Args const& C4_RESTRICT ...args)
+    -> typename std::enable_if<std::is_same<Buf, substr>::value, size_t>::type
+{
+    return cat_bytes(blob(buf.str, buf.len), args...);
+}
+
+/** the characters of a csubstr cannot be written
+ * @ingroup bytes */
+template<class Buf, class... Args>
+auto cat_bytes(Buf buf, Args const& C4_RESTRICT ...args)
+    -> typename std::enable_if<std::is_same<Buf, csubstr>::value, size_t>::type = delete;
+
+
+/** terminates the variadic recursion
+ * @ingroup bytes */
+inline size_t uncat_bytes(cblob /*buf*/)
+{
+    return 0;
+}
+
+/** deserialize the arguments from the given buffer. Unlike uncat(),
+ * the arguments can be temporaries, to accept fmt::le() and fmt::be().
+ * @return the number of bytes read from the buffer, or csubstr::npos
+ * if the buffer is too small
+ * @see uncat() for the text equivalent
+ * @see cat_bytes() for the inverse function
+ * @ingroup bytes */
+template<class Arg, class... Args>
+size_t uncat_bytes(cblob buf, Arg && a, Args && ...more)
+{
+    size_t out = from_bytes(buf, &a);
+    if(C4_UNLIKELY(out == csubstr::npos)) return csubstr::npos;
+    buf = detail::advance_blob(buf, out);
+    size_t num = uncat_bytes(buf, std::forward<Args>(more)...);
+    if(C4_UNLIKELY(num == csubstr::npos)) return csubstr::npos;
+    return out + num;
+}
+
+/** deserialize the arguments from the characters of a substr or
+ * csubstr
+ * @ingroup bytes */
+template<class Buf, class... Args>
+auto uncat_bytes(Buf buf, Args && ...args)
+    -> typename std::enable_if<std::is_same<Buf, substr>::value || std::is_same<Buf, csubstr>::value, size_t>::type
+{
+    return uncat_bytes(cblob(buf.str, buf.len), std::forward<Args>(args)...);
+}
+
+} // namespace c4
+
+#endif /* _C4_BYTES_HPP_ */
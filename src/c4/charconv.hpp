@@ -141,7 +141,7 @@ inline constexpr std::chars_format to_std_fmt(RealFormat_e f)
         std::chars_format::general,     // FTOA_FLEX
         std::chars_format::hex,         // FTOA_HEXA
     };
-    C4_STATIC_ASSERT(sizeof(fmt) == _FTOA_COUNT);
+    C4_STATIC_ASSERT(C4_COUNTOF(fmt) == _FTOA_COUNT);
     C4_ASSERT(f < _FTOA_COUNT);
     return fmt[f];
 }
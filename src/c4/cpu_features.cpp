@@ -0,0 +1,267 @@
+#include "c4/cpu_features.hpp"
+
+#include <string.h>
+
+#if defined(C4_CPU_X86_64) || defined(C4_CPU_X86)
+#   define C4_CPU_FEATURES_X86
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#   else
+#       include <cpuid.h>
+#   endif
+#elif defined(C4_CPU_ARM64) || defined(C4_CPU_ARM)
+#   define C4_CPU_FEATURES_ARM
+#   if defined(__linux__)
+#       include <sys/auxv.h>
+#   elif defined(__APPLE__)
+#       include <sys/sysctl.h>
+#   elif defined(C4_WIN)
+#       include "c4/windows.hpp"
+#   endif
+#endif
+
+namespace c4 {
+
+namespace {
+
+inline cpu_feature_flags if_set(bool cond, cpu_feature_flags features) noexcept
+{
+    return cond ? features : 0;
+}
+
+template<class T>
+inline bool bit(T reg, unsigned pos) noexcept
+{
+    return (reg >> pos) & 1u;
+}
+
+#if defined(C4_CPU_FEATURES_X86)
+
+struct cpuid_regs
+{
+    uint32_t eax, ebx, ecx, edx;
+};
+
+cpuid_regs cpuid(uint32_t leaf, uint32_t subleaf=0) noexcept
+{
+    cpuid_regs r;
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, static_cast<int>(leaf), static_cast<int>(subleaf));
+    r.eax = static_cast<uint32_t>(regs[0]);
+    r.ebx = static_cast<uint32_t>(regs[1]);
+    r.ecx = static_cast<uint32_t>(regs[2]);
+    r.edx = static_cast<uint32_t>(regs[3]);
+#else
+    __cpuid_count(leaf, subleaf, r.eax, r.ebx, r.ecx, r.edx);
+#endif
+    return r;
+}
+
+/** the register state enabled by the OS */
+uint64_t xgetbv0() noexcept
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    // the instruction, so that no target attribute is needed
+    uint32_t lo, hi;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (uint64_t(hi) << 32) | lo;
+#endif
+}
+
+cpu_feature_flags detect_features() noexcept
+{
+    cpu_feature_flags f = 0;
+    const uint32_t max_leaf = cpuid(0).eax;
+    if(max_leaf < 1)
+        return f;
+    const cpuid_regs l1 = cpuid(1);
+    f |= if_set(bit(l1.edx, 26), CPU_SSE2);
+    f |= if_set(bit(l1.ecx,  0), CPU_SSE3);
+    f |= if_set(bit(l1.ecx,  1), CPU_CLMUL);
+    f |= if_set(bit(l1.ecx,  9), CPU_SSSE3);
+    f |= if_set(bit(l1.ecx, 19), CPU_SSE41);
+    f |= if_set(bit(l1.ecx, 20), CPU_SSE42|CPU_CRC32);
+    f |= if_set(bit(l1.ecx, 23), CPU_POPCNT);
+    f |= if_set(bit(l1.ecx, 25), CPU_AES);
+    // the vector registers must be enabled by the OS: xmm and ymm for
+    // AVX, and also the opmask and zmm registers for AVX-512
+    uint64_t xcr0 = 0;
+    if(bit(l1.ecx, 27)) // osxsave
+        xcr0 = xgetbv0();
+    const bool os_avx = (xcr0 & 0x06u) == 0x06u;
+    const bool os_avx512 = (xcr0 & 0xe6u) == 0xe6u;
+    if(os_avx && bit(l1.ecx, 28))
+    {
+        f |= CPU_AVX;
+        f |= if_set(bit(l1.ecx, 12), CPU_FMA);
+    }
+    if(max_leaf >= 7)
+    {
+        const cpuid_regs l7 = cpuid(7, 0);
+        f |= if_set(bit(l7.ebx, 3), CPU_BMI1);
+        f |= if_set(bit(l7.ebx, 8), CPU_BMI2);
+        if(os_avx)
+            f |= if_set(bit(l7.ebx, 5), CPU_AVX2);
+        if(os_avx512 && bit(l7.ebx, 16))
+        {
+            f |= CPU_AVX512F;
+            f |= if_set(bit(l7.ebx, 17), CPU_AVX512DQ);
+            f |= if_set(bit(l7.ebx, 28), CPU_AVX512CD);
+            f |= if_set(bit(l7.ebx, 30), CPU_AVX512BW);
+            f |= if_set(bit(l7.ebx, 31), CPU_AVX512VL);
+            f |= if_set(bit(l7.ecx,  1), CPU_AVX512VBMI);
+        }
+    }
+    const uint32_t max_ext_leaf = cpuid(0x80000000u).eax;
+    if(max_ext_leaf >= 0x80000001u)
+    {
+        const cpuid_regs e1 = cpuid(0x80000001u);
+        f |= if_set(bit(e1.ecx,  5), CPU_LZCNT);
+        f |= if_set(bit(e1.edx, 27), CPU_RDTSCP);
+    }
+    if(max_ext_leaf >= 0x80000007u)
+        f |= if_set(bit(cpuid(0x80000007u).edx, 8), CPU_INVARIANT_TSC);
+    return f;
+}
+
+#elif defined(C4_CPU_FEATURES_ARM)
+
+#if defined(__APPLE__)
+bool sysctl_flag(const char *name) noexcept
+{
+    int value = 0;
+    size_t size = sizeof(value);
+    return sysctlbyname(name, &value, &size, nullptr, 0) == 0 && value != 0;
+}
+#endif
+
+cpu_feature_flags detect_features() noexcept
+{
+    cpu_feature_flags f = 0;
+#if defined(C4_CPU_ARM64)
+    f |= CPU_NEON; // mandatory in AArch64
+#endif
+#if defined(__linux__) && defined(C4_CPU_ARM64)
+    // the bits of AT_HWCAP, from asm/hwcap.h
+    const unsigned long hwcap = getauxval(AT_HWCAP);
+    f |= if_set(bit(hwcap, 3), CPU_AES);
+    f |= if_set(bit(hwcap, 4), CPU_CLMUL);
+    f |= if_set(bit(hwcap, 7), CPU_CRC32);
+    f |= if_set(bit(hwcap, 20), CPU_DOTPROD);
+    f |= if_set(bit(hwcap, 22), CPU_SVE);
+#elif defined(__linux__)
+    // the bits of AT_HWCAP and AT_HWCAP2, from asm/hwcap.h
+    const unsigned long hwcap = getauxval(AT_HWCAP);
+    const unsigned long hwcap2 = getauxval(AT_HWCAP2);
+    f |= if_set(bit(hwcap, 12), CPU_NEON);
+    f |= if_set(bit(hwcap2, 0), CPU_AES);
+    f |= if_set(bit(hwcap2, 1), CPU_CLMUL);
+    f |= if_set(bit(hwcap2, 4), CPU_CRC32);
+#elif defined(__APPLE__)
+    f |= if_set(sysctl_flag("hw.optional.armv8_crc32"), CPU_CRC32);
+    f |= if_set(sysctl_flag("hw.optional.arm.FEAT_AES"), CPU_AES);
+    f |= if_set(sysctl_flag("hw.optional.arm.FEAT_PMULL"), CPU_CLMUL);
+    f |= if_set(sysctl_flag("hw.optional.arm.FEAT_DotProd"), CPU_DOTPROD);
+#elif defined(C4_WIN)
+    f |= if_set(IsProcessorFeaturePresent(30), CPU_AES|CPU_CLMUL); // PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE
+    f |= if_set(IsProcessorFeaturePresent(31), CPU_CRC32); // PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE
+    f |= if_set(IsProcessorFeaturePresent(43), CPU_DOTPROD); // PF_ARM_V82_DP_INSTRUCTIONS_AVAILABLE
+#else
+    // no runtime detection: use what the compiler was told
+#   if defined(__ARM_NEON)
+    f |= CPU_NEON;
+#   endif
+#   if defined(__ARM_FEATURE_CRC32)
+    f |= CPU_CRC32;
+#   endif
+#   if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES)
+    f |= CPU_AES|CPU_CLMUL;
+#   endif
+#   if defined(__ARM_FEATURE_DOTPROD)
+    f |= CPU_DOTPROD;
+#   endif
+#   if defined(__ARM_FEATURE_SVE)
+    f |= CPU_SVE;
+#   endif
+#endif
+    return f;
+}
+
+#else
+
+cpu_feature_flags detect_features() noexcept
+{
+    return 0;
+}
+
+#endif
+
+struct cpu_feature_name
+{
+    cpu_feature_flags flag;
+    const char *name;
+};
+
+const cpu_feature_name cpu_feature_names[] = {
+    {CPU_SSE2, "sse2"},
+    {CPU_SSE3, "sse3"},
+    {CPU_SSSE3, "ssse3"},
+    {CPU_SSE41, "sse4.1"},
+    {CPU_SSE42, "sse4.2"},
+    {CPU_POPCNT, "popcnt"},
+    {CPU_LZCNT, "lzcnt"},
+    {CPU_BMI1, "bmi1"},
+    {CPU_BMI2, "bmi2"},
+    {CPU_AVX, "avx"},
+    {CPU_FMA, "fma"},
+    {CPU_AVX2, "avx2"},
+    {CPU_AVX512F, "avx512f"},
+    {CPU_AVX512DQ, "avx512dq"},
+    {CPU_AVX512CD, "avx512cd"},
+    {CPU_AVX512BW, "avx512bw"},
+    {CPU_AVX512VL, "avx512vl"},
+    {CPU_AVX512VBMI, "avx512vbmi"},
+    {CPU_RDTSCP, "rdtscp"},
+    {CPU_INVARIANT_TSC, "invariant_tsc"},
+    {CPU_NEON, "neon"},
+    {CPU_SVE, "sve"},
+    {CPU_DOTPROD, "dotprod"},
+    {CPU_CRC32, "crc32"},
+    {CPU_AES, "aes"},
+    {CPU_CLMUL, "clmul"},
+};
+
+} // anonymous namespace
+
+
+cpu_feature_flags cpu_features() noexcept
+{
+    static const cpu_feature_flags features = detect_features();
+    return features;
+}
+
+size_t cpu_features_to_chars(substr buf, cpu_feature_flags features) noexcept
+{
+    size_t pos = 0;
+    for(cpu_feature_name const& fn : cpu_feature_names)
+    {
+        if( ! (features & fn.flag))
+            continue;
+        const csubstr name = to_csubstr(fn.name);
+        if(pos)
+        {
+            if(pos < buf.len)
+                buf.str[pos] = ' ';
+            ++pos;
+        }
+        if(pos + name.len <= buf.len)
+            memcpy(buf.str + pos, name.str, name.len);
+        pos += name.len;
+    }
+    return pos;
+}
+
+} // namespace c4
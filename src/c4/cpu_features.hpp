@@ -0,0 +1,134 @@
+#ifndef _C4_CPU_FEATURES_HPP_
+#define _C4_CPU_FEATURES_HPP_
+
+/** @file cpu_features.hpp Detection at runtime of the instruction set
+ * extensions of the processor, to select the fastest implementation of
+ * a function in a portable binary. */
+
+#include "c4/config.hpp"
+#include "c4/substr.hpp"
+
+/** @def C4_CPU_TARGET(isa) compile a function for the given instruction
+ * set extensions (eg "avx2" or "sse4.2,popcnt"), whatever the compiler
+ * flags. Such a function must only be called after checking for the
+ * extensions with cpu_has(). Has no effect with MSVC, which accepts the
+ * intrinsics of any extension.
+ * @ingroup cpu_features */
+#if defined(__GNUC__) || defined(__clang__)
+#   define C4_CPU_TARGET(isa) __attribute__((target(isa)))
+#else
+#   define C4_CPU_TARGET(isa)
+#endif
+
+namespace c4 {
+
+/** @defgroup cpu_features CPU features
+ *
+ * cpu_features() detects the extensions once, with cpuid on x86 and
+ * with the auxiliary vector (or the equivalent system call) on ARM.
+ * cpu_select() uses it to pick among implementations of a function,
+ * which is best done once, in a static variable:
+ *
+ * @code
+ * size_t count_avx2(csubstr s, char c); // compiled with C4_CPU_TARGET("avx2")
+ * size_t count_sse42(csubstr s, char c); // compiled with C4_CPU_TARGET("sse4.2")
+ * size_t count_scalar(csubstr s, char c);
+ *
+ * size_t count(csubstr s, char c)
+ * {
+ *     static const auto impl = c4::cpu_select(c4::CPU_AVX2, &count_avx2,
+ *                                             c4::CPU_SSE42, &count_sse42,
+ *                                             &count_scalar);
+ *     return impl(s, c);
+ * }
+ * @endcode
+ */
+
+/** the extensions detected by cpu_features(). Those which need support
+ * from the OS (the AVX and AVX-512 registers) are reported only if the
+ * OS saves their state. No feature is reported on other architectures.
+ * @ingroup cpu_features */
+typedef enum : uint64_t {
+    CPU_SSE2       = UINT64_C(1) <<  0,
+    CPU_SSE3       = UINT64_C(1) <<  1,
+    CPU_SSSE3      = UINT64_C(1) <<  2,
+    CPU_SSE41      = UINT64_C(1) <<  3,
+    CPU_SSE42      = UINT64_C(1) <<  4,
+    CPU_POPCNT     = UINT64_C(1) <<  5,
+    CPU_LZCNT      = UINT64_C(1) <<  6,
+    CPU_BMI1       = UINT64_C(1) <<  7,
+    CPU_BMI2       = UINT64_C(1) <<  8,
+    CPU_AVX        = UINT64_C(1) <<  9,
+    CPU_FMA        = UINT64_C(1) << 10,
+    CPU_AVX2       = UINT64_C(1) << 11,
+    CPU_AVX512F    = UINT64_C(1) << 12,
+    CPU_AVX512DQ   = UINT64_C(1) << 13,
+    CPU_AVX512CD   = UINT64_C(1) << 14,
+    CPU_AVX512BW   = UINT64_C(1) << 15,
+    CPU_AVX512VL   = UINT64_C(1) << 16,
+    CPU_AVX512VBMI = UINT64_C(1) << 17,
+    /** the rdtscp instruction, which reads the timestamp counter after
+     * the previous instructions complete */
+    CPU_RDTSCP     = UINT64_C(1) << 18,
+    /** a timestamp counter with a constant rate in all the power states
+     * (the invariant TSC) */
+    CPU_INVARIANT_TSC = UINT64_C(1) << 19,
+    /** the ARM advanced SIMD extensions (always present on AArch64) */
+    CPU_NEON       = UINT64_C(1) << 32,
+    /** the ARM scalable vector extensions */
+    CPU_SVE        = UINT64_C(1) << 33,
+    /** the ARM dot product instructions */
+    CPU_DOTPROD    = UINT64_C(1) << 34,
+    /** crc32 instructions computing CRC-32C: SSE4.2 on x86, and the
+     * CRC32 extension on ARM */
+    CPU_CRC32      = UINT64_C(1) << 48,
+    /** the AES round instructions: AES-NI on x86, and the ARM crypto
+     * extensions */
+    CPU_AES        = UINT64_C(1) << 49,
+    /** carry-less multiplication: PCLMULQDQ on x86, and PMULL on ARM */
+    CPU_CLMUL      = UINT64_C(1) << 50,
+} CpuFeature_e;
+using cpu_feature_flags = uint64_t;
+
+
+/** the extensions of the processor, as a combination of CpuFeature_e
+ * flags. They are detected on the first call, which is thread-safe.
+ * @ingroup cpu_features */
+cpu_feature_flags cpu_features() noexcept;
+
+/** @return true if all of the given extensions are available
+ * @ingroup cpu_features */
+inline bool cpu_has(cpu_feature_flags features) noexcept
+{
+    return (cpu_features() & features) == features;
+}
+
+/** write the names of the given extensions, separated by spaces
+ * (eg "sse2 sse3 ssse3 sse4.1").
+ * @return the number of characters needed
+ * @ingroup cpu_features */
+size_t cpu_features_to_chars(substr buf, cpu_feature_flags features) noexcept;
+
+
+/** @ingroup cpu_features */
+template<class Fn>
+C4_ALWAYS_INLINE Fn cpu_select(Fn fallback) noexcept
+{
+    return fallback;
+}
+
+/** select among implementations: returns the first candidate whose
+ * required extensions are all available, or the fallback (the last
+ * argument) when there is none. The candidates are given in order of
+ * preference, each after its required CpuFeature_e flags, eg
+ * cpu_select(CPU_AVX2, &fn_avx2, CPU_SSSE3, &fn_ssse3, &fn_scalar).
+ * @ingroup cpu_features */
+template<class Fn, class... More>
+Fn cpu_select(cpu_feature_flags required, Fn candidate, More... more) noexcept
+{
+    return cpu_has(required) ? candidate : cpu_select<Fn>(more...);
+}
+
+} // namespace c4
+
+#endif /* _C4_CPU_FEATURES_HPP_ */
@@ -0,0 +1,263 @@
+#include "c4/crc32c.hpp"
+#include "c4/cpu_features.hpp"
+
+#include <string.h>
+
+#ifdef C4_CRC32C_SSE42
+#   define C4_CRC32C_TARGET C4_CPU_TARGET("sse4.2")
+#   include <nmmintrin.h>
+#elif defined(C4_CRC32C_ARMV8)
+#   include <arm_acle.h>
+#endif
+
+namespace c4 {
+
+namespace detail {
+
+namespace {
+
+constexpr const uint32_t crc32c_poly = 0x82f63b78u; // reversed 0x1edc6f41
+
+/** The hardware implementations compute three independent crcs, over
+ * three consecutive blocks, to hide the latency of the crc
+ * instruction (3 cycles, for a throughput of 1 per cycle). The crcs
+ * are then combined by shifting the first ones over the length of the
+ * blocks which follow them, which is a linear operation on the crc
+ * bits, done here with tables. @see Mark Adler's crc32c.c,
+ * https://stackoverflow.com/a/17646775 */
+enum : size_t {
+    crc32c_long = 8192,
+    crc32c_short = 256,
+};
+
+struct crc32c_tables
+{
+    uint32_t slice[8][256]; ///< for the slice-by-8 fallback
+    uint32_t shift_long[4][256]; ///< shift a crc over crc32c_long zeros
+    uint32_t shift_short[4][256]; ///< shift a crc over crc32c_short zeros
+
+    crc32c_tables() noexcept
+    {
+        for(uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t crc = n;
+            for(int k = 0; k < 8; ++k)
+                crc = (crc & 1u) ? (crc >> 1) ^ crc32c_poly : crc >> 1;
+            slice[0][n] = crc;
+        }
+        for(uint32_t n = 0; n < 256; ++n)
+            for(size_t k = 1; k < 8; ++k)
+                slice[k][n] = (slice[k - 1][n] >> 8) ^ slice[0][slice[k - 1][n] & 0xffu];
+        _make_shift(shift_long, crc32c_long);
+        _make_shift(shift_short, crc32c_short);
+    }
+
+    static crc32c_tables const& get() noexcept
+    {
+        static const crc32c_tables tables;
+        return tables;
+    }
+
+private:
+
+    static uint32_t _gf2_times(uint32_t const* mat, uint32_t vec) noexcept
+    {
+        uint32_t sum = 0;
+        for( ; vec; vec >>= 1, ++mat)
+            if(vec & 1u)
+                sum ^= *mat;
+        return sum;
+    }
+
+    static void _gf2_square(uint32_t *square, uint32_t const* mat) noexcept
+    {
+        for(size_t n = 0; n < 32; ++n)
+            square[n] = _gf2_times(mat, mat[n]);
+    }
+
+    /** @p len must be a power of two */
+    static void _make_shift(uint32_t (*table)[256], size_t len) noexcept
+    {
+        // the operator for one zero bit, squared into that for len zero bytes
+        uint32_t op[32], tmp[32];
+        op[0] = crc32c_poly;
+        for(uint32_t n = 1; n < 32; ++n)
+            op[n] = uint32_t(1) << (n - 1);
+        for(size_t bits = 1; bits < 8 * len; bits <<= 1)
+        {
+            _gf2_square(tmp, op);
+            memcpy(op, tmp, sizeof(op));
+        }
+        for(uint32_t n = 0; n < 256; ++n)
+        {
+            table[0][n] = _gf2_times(op, n);
+            table[1][n] = _gf2_times(op, n << 8);
+            table[2][n] = _gf2_times(op, n << 16);
+            table[3][n] = _gf2_times(op, n << 24);
+        }
+    }
+};
+
+inline uint32_t crc32c_shift(uint32_t const (*table)[256], uint32_t crc) noexcept
+{
+    return table[0][crc & 0xffu] ^ table[1][(crc >> 8) & 0xffu]
+         ^ table[2][(crc >> 16) & 0xffu] ^ table[3][crc >> 24];
+}
+
+inline uint32_t crc32c_load_le32(const uint8_t *p) noexcept
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if C4_BIG_ENDIAN
+    v = ((v & 0xffu) << 24) | ((v & 0xff00u) << 8) | ((v >> 8) & 0xff00u) | (v >> 24);
+#endif
+    return v;
+}
+
+} // anonymous namespace
+
+
+uint32_t crc32c_update_table(uint32_t crc, const void *data, size_t len) noexcept
+{
+    crc32c_tables const& t = crc32c_tables::get();
+    const uint8_t *C4_RESTRICT p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for( ; len >= 8; len -= 8, p += 8)
+    {
+        const uint32_t lo = crc ^ crc32c_load_le32(p);
+        const uint32_t hi = crc32c_load_le32(p + 4);
+        crc = t.slice[7][lo & 0xffu] ^ t.slice[6][(lo >> 8) & 0xffu]
+            ^ t.slice[5][(lo >> 16) & 0xffu] ^ t.slice[4][lo >> 24]
+            ^ t.slice[3][hi & 0xffu] ^ t.slice[2][(hi >> 8) & 0xffu]
+            ^ t.slice[1][(hi >> 16) & 0xffu] ^ t.slice[0][hi >> 24];
+    }
+    for( ; len; --len, ++p)
+        crc = (crc >> 8) ^ t.slice[0][(crc ^ *p) & 0xffu];
+    return ~crc;
+}
+
+
+//-----------------------------------------------------------------------------
+
+#if defined(C4_CRC32C_SSE42) || defined(C4_CRC32C_ARMV8)
+
+namespace {
+
+#ifdef C4_CRC32C_SSE42
+C4_CRC32C_TARGET inline uint64_t crc32c_u64(uint64_t crc, const uint8_t *p) noexcept
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return _mm_crc32_u64(crc, v);
+}
+C4_CRC32C_TARGET inline uint64_t crc32c_u8(uint64_t crc, uint8_t v) noexcept
+{
+    return _mm_crc32_u8(static_cast<uint32_t>(crc), v);
+}
+#else
+inline uint64_t crc32c_u64(uint64_t crc, const uint8_t *p) noexcept
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return __crc32cd(static_cast<uint32_t>(crc), v);
+}
+inline uint64_t crc32c_u8(uint64_t crc, uint8_t v) noexcept
+{
+    return __crc32cb(static_cast<uint32_t>(crc), v);
+}
+#   define C4_CRC32C_TARGET
+#endif
+
+/** crc three consecutive blocks of the given size at once, as many
+ * times as they fit */
+template<size_t BlockSize>
+C4_CRC32C_TARGET inline uint64_t crc32c_interleaved(uint64_t crc0, const uint8_t *C4_RESTRICT *p, size_t *len,
+                                                   uint32_t const (*shift)[256]) noexcept
+{
+    const uint8_t *C4_RESTRICT next = *p;
+    size_t rem = *len;
+    for( ; rem >= 3 * BlockSize; rem -= 3 * BlockSize)
+    {
+        uint64_t crc1 = 0, crc2 = 0;
+        const uint8_t *end = next + BlockSize;
+        do
+        {
+            crc0 = crc32c_u64(crc0, next);
+            crc1 = crc32c_u64(crc1, next + BlockSize);
+            crc2 = crc32c_u64(crc2, next + 2 * BlockSize);
+            next += 8;
+        } while(next < end);
+        crc0 = crc32c_shift(shift, static_cast<uint32_t>(crc0)) ^ crc1;
+        crc0 = crc32c_shift(shift, static_cast<uint32_t>(crc0)) ^ crc2;
+        next += 2 * BlockSize;
+    }
+    *p = next;
+    *len = rem;
+    return crc0;
+}
+
+C4_CRC32C_TARGET inline uint32_t crc32c_update_hw(uint32_t crc, const void *data, size_t len) noexcept
+{
+    crc32c_tables const& t = crc32c_tables::get();
+    const uint8_t *C4_RESTRICT next = static_cast<const uint8_t*>(data);
+    uint64_t crc0 = ~crc;
+    // bring the pointer to an 8-byte boundary
+    for( ; len && (reinterpret_cast<uintptr_t>(next) & 7u); --len, ++next)
+        crc0 = crc32c_u8(crc0, *next);
+    crc0 = crc32c_interleaved<crc32c_long>(crc0, &next, &len, t.shift_long);
+    crc0 = crc32c_interleaved<crc32c_short>(crc0, &next, &len, t.shift_short);
+    for( ; len >= 8; len -= 8, next += 8)
+        crc0 = crc32c_u64(crc0, next);
+    for( ; len; --len, ++next)
+        crc0 = crc32c_u8(crc0, *next);
+    return ~static_cast<uint32_t>(crc0);
+}
+
+} // anonymous namespace
+
+#endif // C4_CRC32C_SSE42 || C4_CRC32C_ARMV8
+
+
+#ifdef C4_CRC32C_SSE42
+uint32_t crc32c_update_sse42(uint32_t crc, const void *data, size_t len) noexcept
+{
+    return crc32c_update_hw(crc, data, len);
+}
+#endif // C4_CRC32C_SSE42
+
+
+#ifdef C4_CRC32C_ARMV8
+uint32_t crc32c_update_armv8(uint32_t crc, const void *data, size_t len) noexcept
+{
+    return crc32c_update_hw(crc, data, len);
+}
+#endif // C4_CRC32C_ARMV8
+
+} // namespace detail
+
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+typedef uint32_t (*crc32c_fn)(uint32_t, const void*, size_t);
+
+crc32c_fn crc32c_select_impl() noexcept
+{
+#if defined(C4_CRC32C_SSE42)
+    return cpu_select<crc32c_fn>(CPU_CRC32, &detail::crc32c_update_sse42, &detail::crc32c_update_table);
+#elif defined(C4_CRC32C_ARMV8)
+    return &detail::crc32c_update_armv8; // enabled at compile time
+#endif
+    return &detail::crc32c_update_table;
+}
+
+} // anonymous namespace
+
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t len) noexcept
+{
+    static const crc32c_fn impl = crc32c_select_impl();
+    return impl(crc, data, len);
+}
+
+} // namespace c4
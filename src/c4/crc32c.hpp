@@ -0,0 +1,104 @@
+#ifndef _C4_CRC32C_HPP_
+#define _C4_CRC32C_HPP_
+
+/** @file crc32c.hpp CRC-32C (Castagnoli) checksums, accelerated with
+ * the crc32 instructions of SSE4.2 and ARMv8 when available.
+ * @see https://www.rfc-editor.org/rfc/rfc3720#appendix-B.4
+ * */
+
+#include "c4/config.hpp"
+#include "c4/blob.hpp"
+#include "c4/substr.hpp"
+
+#include <type_traits>
+
+namespace c4 {
+
+/** @defgroup crc32c CRC-32C
+ * @brief integrity checksums for binary data
+ * @ingroup hash */
+
+/** continue a checksum with more data. Start with crc=0; the result
+ * of crc32c_update() over consecutive pieces is the same as the
+ * crc32c() of their concatenation.
+ * @ingroup crc32c */
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t len) noexcept;
+
+/** @ingroup crc32c */
+inline uint32_t crc32c(const void *data, size_t len) noexcept
+{
+    return crc32c_update(0u, data, len);
+}
+
+/** @overload crc32c
+ * @ingroup crc32c */
+inline uint32_t crc32c(cblob data) noexcept
+{
+    return crc32c_update(0u, data.buf, data.len);
+}
+/** the checksum of the characters of a substr or csubstr. Without
+ * this overload, the string would convert to a blob of the string
+ * object itself.
+ * @ingroup crc32c */
+template<class Str>
+C4_ALWAYS_INLINE auto crc32c(Str s) noexcept
+    -> typename std::enable_if<std::is_same<Str, substr>::value || std::is_same<Str, csubstr>::value, uint32_t>::type
+{
+    return crc32c_update(0u, s.str, s.len);
+}
+
+
+/** a streaming CRC-32C checksum, with the interface of the hashers
+ * in hash.hpp
+ * @ingroup crc32c */
+class crc32c_hasher
+{
+public:
+
+    using result_type = uint32_t;
+
+    crc32c_hasher() noexcept : m_crc(0) {}
+
+    void update(const void *data, size_t len) noexcept { m_crc = crc32c_update(m_crc, data, len); }
+    void update(cblob data) noexcept { m_crc = crc32c_update(m_crc, data.buf, data.len); }
+    /** the characters of a substr or csubstr */
+    template<class Str>
+    auto update(Str s) noexcept
+        -> typename std::enable_if<std::is_same<Str, substr>::value || std::is_same<Str, csubstr>::value>::type
+    {
+        m_crc = crc32c_update(m_crc, s.str, s.len);
+    }
+
+    result_type digest() const noexcept { return m_crc; }
+
+    void reset() noexcept { m_crc = 0; }
+
+private:
+
+    uint32_t m_crc;
+
+};
+
+
+#if defined(C4_CPU_X86_64) && !defined(C4_CRC32C_NO_HW)
+#   define C4_CRC32C_SSE42
+#elif defined(__ARM_FEATURE_CRC32) && !defined(C4_CRC32C_NO_HW)
+#   define C4_CRC32C_ARMV8
+#endif
+
+namespace detail {
+/** @cond dev */
+// the implementations selected at runtime by crc32c_update()
+uint32_t crc32c_update_table(uint32_t crc, const void *data, size_t len) noexcept;
+#ifdef C4_CRC32C_SSE42
+uint32_t crc32c_update_sse42(uint32_t crc, const void *data, size_t len) noexcept;
+#endif
+#ifdef C4_CRC32C_ARMV8
+uint32_t crc32c_update_armv8(uint32_t crc, const void *data, size_t len) noexcept;
+#endif
+/** @endcond */
+} // namespace detail
+
+} // namespace c4
+
+#endif /* _C4_CRC32C_HPP_ */
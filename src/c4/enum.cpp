@@ -0,0 +1,303 @@
+#include "c4/enum.hpp"
+
+#include <algorithm>
+
+namespace c4 {
+namespace detail {
+
+namespace {
+
+inline uint64_t enum_hash_mix(uint64_t h) noexcept
+{
+    // the splitmix64 finalizer
+    h ^= h >> 30;
+    h *= UINT64_C(0xbf58476d1ce4e5b9);
+    h ^= h >> 27;
+    h *= UINT64_C(0x94d049bb133111eb);
+    h ^= h >> 31;
+    return h;
+}
+
+template<class T>
+T* enum_alloc(size_t num)
+{
+    return static_cast<T*>(aalloc((num ? num : 1) * sizeof(T), alignof(T)));
+}
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+enum_name_index::enum_name_index() noexcept
+    : m_keys(nullptr)
+    , m_slots(nullptr)
+    , m_displacements(nullptr)
+    , m_slot_mask(0)
+    , m_num_buckets(0)
+    , m_seed(0)
+{
+}
+
+enum_name_index::~enum_name_index()
+{
+    _clear();
+}
+
+void enum_name_index::_clear() noexcept
+{
+    if(m_keys)
+        afree(m_keys);
+    if(m_slots)
+        afree(m_slots);
+    if(m_displacements)
+        afree(m_displacements);
+    m_keys = nullptr;
+    m_slots = nullptr;
+    m_displacements = nullptr;
+    m_slot_mask = 0;
+    m_num_buckets = 0;
+}
+
+uint64_t enum_name_index::_hash(const char *str, size_t len) const noexcept
+{
+    // fnv1a, seeded
+    uint64_t h = UINT64_C(14695981039346656037) ^ m_seed;
+    for(size_t i = 0; i < len; ++i)
+        h = (h ^ static_cast<uint8_t>(str[i])) * UINT64_C(1099511628211);
+    return h;
+}
+
+size_t enum_name_index::_bucket(uint64_t h) const noexcept
+{
+    return static_cast<size_t>(enum_hash_mix(h) % m_num_buckets);
+}
+
+size_t enum_name_index::_slot(uint64_t h, uint32_t displacement) const noexcept
+{
+    return static_cast<size_t>(enum_hash_mix(h ^ ((uint64_t(displacement) + 1u) * UINT64_C(0x9e3779b97f4a7c15)))) & m_slot_mask;
+}
+
+void enum_name_index::build(enum_key const* keys, size_t num)
+{
+    _clear();
+    if(num == 0)
+        return;
+    C4_CHECK(num < UINT32_MAX);
+    size_t num_slots = 4;
+    while(num_slots < 2 * num)
+        num_slots <<= 1;
+    m_slot_mask = num_slots - 1;
+    m_num_buckets = (num + 3) / 4;
+    m_keys = enum_alloc<enum_key>(num);
+    m_slots = enum_alloc<uint32_t>(num_slots);
+    m_displacements = enum_alloc<uint32_t>(m_num_buckets);
+    uint64_t *hashes = enum_alloc<uint64_t>(num);
+    uint32_t *order = enum_alloc<uint32_t>(num); // the keys, sorted by bucket
+    uint32_t *bucket_start = enum_alloc<uint32_t>(m_num_buckets + 1);
+    uint32_t *bucket_size = enum_alloc<uint32_t>(m_num_buckets);
+    size_t candidate[64];
+
+    // Try seeds until all the buckets can be placed. With at most
+    // half of the slots filled, this almost always succeeds with the
+    // first seed; another seed is needed only when a bucket gets too
+    // large, or in case of a collision of the full 64 bit hashes.
+    for(uint64_t attempt = 0; ; ++attempt)
+    {
+        C4_CHECK_MSG(attempt < 64, "could not build the enum index");
+        m_seed = enum_hash_mix(attempt + 1);
+        memset(m_slots, 0, num_slots * sizeof(uint32_t));
+        memset(m_displacements, 0, m_num_buckets * sizeof(uint32_t));
+        memset(bucket_start, 0, (m_num_buckets + 1) * sizeof(uint32_t));
+        // stable counting sort of the keys by bucket
+        for(size_t i = 0; i < num; ++i)
+        {
+            hashes[i] = _hash(keys[i].str, keys[i].len);
+            ++bucket_start[_bucket(hashes[i]) + 1];
+        }
+        for(size_t b = 0; b < m_num_buckets; ++b)
+        {
+            bucket_start[b + 1] += bucket_start[b];
+            bucket_size[b] = 0;
+        }
+        for(size_t i = 0; i < num; ++i)
+        {
+            const size_t b = _bucket(hashes[i]);
+            order[bucket_start[b] + bucket_size[b]++] = static_cast<uint32_t>(i);
+        }
+        // drop repeated keys, keeping the first. Equal keys have equal
+        // hashes, so they are always in the same bucket.
+        size_t max_size = 0;
+        for(size_t b = 0; b < m_num_buckets; ++b)
+        {
+            uint32_t *C4_RESTRICT bkeys = order + bucket_start[b];
+            uint32_t n = 0;
+            for(uint32_t i = 0; i < bucket_size[b]; ++i)
+            {
+                enum_key const& k = keys[bkeys[i]];
+                bool repeated = false;
+                for(uint32_t j = 0; j < n && !repeated; ++j)
+                {
+                    enum_key const& prev = keys[bkeys[j]];
+                    repeated = (hashes[bkeys[j]] == hashes[bkeys[i]] && prev.len == k.len && memcmp(prev.str, k.str, k.len) == 0);
+                }
+                if( ! repeated)
+                    bkeys[n++] = bkeys[i];
+            }
+            bucket_size[b] = n;
+            max_size = n > max_size ? n : max_size;
+        }
+        if(max_size > C4_COUNTOF(candidate))
+            continue;
+        // place the largest buckets first, while there is more room
+        bool ok = true;
+        uint32_t num_placed = 0;
+        for(size_t size = max_size; size > 0 && ok; --size)
+        {
+            for(size_t b = 0; b < m_num_buckets && ok; ++b)
+            {
+                if(bucket_size[b] != size)
+                    continue;
+                uint32_t const* C4_RESTRICT bkeys = order + bucket_start[b];
+                ok = false;
+                for(uint32_t d = 0; d < (uint32_t(1) << 16) && !ok; ++d)
+                {
+                    ok = true;
+                    for(size_t i = 0; i < size && ok; ++i)
+                    {
+                        candidate[i] = _slot(hashes[bkeys[i]], d);
+                        ok = (m_slots[candidate[i]] == 0);
+                        for(size_t j = 0; j < i && ok; ++j)
+                            ok = (candidate[j] != candidate[i]);
+                    }
+                    if(ok)
+                    {
+                        m_displacements[b] = d;
+                        for(size_t i = 0; i < size; ++i)
+                        {
+                            m_keys[num_placed] = keys[bkeys[i]];
+                            m_slots[candidate[i]] = ++num_placed;
+                        }
+                    }
+                }
+            }
+        }
+        if(ok)
+            break;
+    }
+
+    afree(bucket_size);
+    afree(bucket_start);
+    afree(order);
+    afree(hashes);
+}
+
+size_t enum_name_index::find(const char *str, size_t len) const noexcept
+{
+    if( ! m_slots)
+        return npos;
+    const uint64_t h = _hash(str, len);
+    const uint32_t s = m_slots[_slot(h, m_displacements[_bucket(h)])];
+    if(s == 0)
+        return npos;
+    enum_key const& k = m_keys[s - 1];
+    if(k.len != len || memcmp(k.str, str, len) != 0)
+        return npos;
+    return k.id;
+}
+
+
+//-----------------------------------------------------------------------------
+
+enum_value_index::enum_value_index() noexcept
+    : m_min(0)
+    , m_num(0)
+    , m_dense(nullptr)
+    , m_sorted_values(nullptr)
+    , m_sorted_ids(nullptr)
+{
+}
+
+enum_value_index::~enum_value_index()
+{
+    _clear();
+}
+
+void enum_value_index::_clear() noexcept
+{
+    if(m_dense)
+        afree(m_dense);
+    if(m_sorted_values)
+        afree(m_sorted_values);
+    if(m_sorted_ids)
+        afree(m_sorted_ids);
+    m_dense = nullptr;
+    m_sorted_values = nullptr;
+    m_sorted_ids = nullptr;
+    m_min = 0;
+    m_num = 0;
+}
+
+void enum_value_index::build(int64_t const* values, size_t num)
+{
+    _clear();
+    if(num == 0)
+        return;
+    C4_CHECK(num < UINT32_MAX);
+    int64_t min = values[0], max = values[0];
+    for(size_t i = 1; i < num; ++i)
+    {
+        min = values[i] < min ? values[i] : min;
+        max = values[i] > max ? values[i] : max;
+    }
+    // use a dense array when at most half of it would be holes
+    const uint64_t range = uint64_t(max) - uint64_t(min);
+    if(range < 2 * uint64_t(num))
+    {
+        m_min = min;
+        m_num = static_cast<size_t>(range) + 1;
+        m_dense = enum_alloc<uint32_t>(m_num);
+        memset(m_dense, 0xff, m_num * sizeof(uint32_t));
+        for(size_t i = num - 1; i != size_t(-1); --i) // backwards, so the first wins
+            m_dense[static_cast<size_t>(uint64_t(values[i]) - uint64_t(min))] = static_cast<uint32_t>(i);
+        return;
+    }
+    // otherwise sort the values, and drop the repeated ones
+    uint32_t *ids = enum_alloc<uint32_t>(num);
+    for(size_t i = 0; i < num; ++i)
+        ids[i] = static_cast<uint32_t>(i);
+    std::stable_sort(ids, ids + num, [values](uint32_t a, uint32_t b){
+        return values[a] < values[b];
+    });
+    m_sorted_values = enum_alloc<int64_t>(num);
+    m_sorted_ids = enum_alloc<uint32_t>(num);
+    for(size_t i = 0; i < num; ++i)
+    {
+        if(m_num && m_sorted_values[m_num - 1] == values[ids[i]])
+            continue;
+        m_sorted_values[m_num] = values[ids[i]];
+        m_sorted_ids[m_num] = ids[i];
+        ++m_num;
+    }
+    afree(ids);
+}
+
+size_t enum_value_index::find(int64_t value) const noexcept
+{
+    if(m_dense)
+    {
+        const uint64_t pos = uint64_t(value) - uint64_t(m_min);
+        if(pos >= m_num || m_dense[pos] == UINT32_MAX)
+            return npos;
+        return m_dense[pos];
+    }
+    int64_t const* first = m_sorted_values;
+    int64_t const* last = m_sorted_values + m_num;
+    int64_t const* it = std::lower_bound(first, last, value);
+    if(it == last || *it != value)
+        return npos;
+    return m_sorted_ids[it - first];
+}
+
+} // namespace detail
+} // namespace c4
@@ -2,6 +2,7 @@
 #define _C4_ENUM_HPP_
 
 #include "c4/error.hpp"
+#include "c4/memory_resource.hpp"
 #include <string.h>
 
 /** @file enum.hpp utilities for enums: convert to/from string
@@ -31,8 +32,8 @@ typedef enum {
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 /** A simple (proxy) container for the value-name pairs of an enum type.
- * Uses linear search for finds; this could be improved for time-critical
- * code. */
+ * Uses linear search for finds; for time-critical code, use the
+ * index returned by eindex(), which is what str2e() and e2str() use. */
 template<class Enum>
 class EnumSymbols
 {
@@ -142,6 +143,141 @@ size_t eoffs(EnumOffsetType which)
 }
 
 
+//-----------------------------------------------------------------------------
+
+namespace detail {
+/** @cond dev */
+
+struct enum_key
+{
+    const char *str;
+    size_t len;
+    size_t id;
+};
+
+/** a perfect hash from names to ids, using hash-and-displace: the keys
+ * are split into small buckets, and each bucket gets the displacement
+ * which sends all its keys to free slots. A lookup is then one hash of
+ * the name, and one comparison against the single candidate slot. */
+class enum_name_index
+{
+public:
+
+    enum_name_index() noexcept;
+    ~enum_name_index();
+
+    enum_name_index(enum_name_index const&) = delete;
+    enum_name_index& operator= (enum_name_index const&) = delete;
+
+    /** when several keys are equal, the first one wins */
+    void build(enum_key const* keys, size_t num);
+
+    /** @return the id of the key, or npos when not found */
+    size_t find(const char *str, size_t len) const noexcept;
+
+    enum : size_t { npos = size_t(-1) };
+
+private:
+
+    uint64_t _hash(const char *str, size_t len) const noexcept;
+    size_t _bucket(uint64_t h) const noexcept;
+    size_t _slot(uint64_t h, uint32_t displacement) const noexcept;
+    void _clear() noexcept;
+
+private:
+
+    enum_key *m_keys;       ///< the unique keys
+    uint32_t *m_slots;      ///< index+1 into m_keys, or 0 when empty
+    uint32_t *m_displacements; ///< one per bucket
+    size_t    m_slot_mask;
+    size_t    m_num_buckets;
+    uint64_t  m_seed;
+
+};
+
+/** maps values to ids, with a dense array when the values are
+ * contiguous (or nearly so), and a binary search otherwise. */
+class enum_value_index
+{
+public:
+
+    enum_value_index() noexcept;
+    ~enum_value_index();
+
+    enum_value_index(enum_value_index const&) = delete;
+    enum_value_index& operator= (enum_value_index const&) = delete;
+
+    /** the id of a value is its position in @p values. When a value
+     * is repeated, the first id wins. */
+    void build(int64_t const* values, size_t num);
+
+    /** @return the id of the value, or npos when not found */
+    size_t find(int64_t value) const noexcept;
+
+    enum : size_t { npos = size_t(-1) };
+
+private:
+
+    void _clear() noexcept;
+
+private:
+
+    int64_t  m_min;
+    size_t   m_num;     ///< the size of the dense array, or of the sorted arrays
+    uint32_t *m_dense;  ///< id for each value in [m_min, m_min+m_num[; UINT32_MAX if none
+    int64_t  *m_sorted_values;
+    uint32_t *m_sorted_ids;
+
+};
+
+/** @endcond */
+} // namespace detail
+
+
+/** An index over the symbols of an enum, for constant-time lookups of
+ * names and values. Names are found also when stripped of the class
+ * or prefix offsets (see eoffs()). Use eindex() to get the index for
+ * esyms<Enum>(), which is built once and then cached.
+ *
+ * When several symbols match a name or value, the result is the first
+ * of them, as with the linear search in EnumSymbols. */
+template<class Enum>
+class EnumIndex
+{
+public:
+
+    using Sym = typename EnumSymbols<Enum>::Sym;
+
+public:
+
+    explicit EnumIndex(EnumSymbols<Enum> const& syms);
+
+    EnumSymbols<Enum> const& symbols() const { return m_syms; }
+
+    Sym const* find(Enum v) const;
+    Sym const* find(const char *s) const;
+    /** @note like EnumSymbols::find(const char*, size_t), this falls
+     * back to accepting some partial names when no name is equal */
+    Sym const* find(const char *s, size_t len) const;
+
+private:
+
+    EnumSymbols<Enum> m_syms;
+    detail::enum_name_index m_names;
+    detail::enum_value_index m_values;
+
+};
+
+/** return the index for the symbols of the enum type, building it on
+ * the first call. Requires a specialization of esyms<Enum>(). */
+template<class Enum>
+EnumIndex<Enum> const& eindex()
+{
+    static const EnumIndex<Enum> idx(esyms<Enum>());
+    return idx;
+}
+
+
 //-----------------------------------------------------------------------------
 /** get the enum value corresponding to a c-string */
 
@@ -157,8 +293,7 @@ size_t eoffs(EnumOffsetType which)
 template<class Enum>
 Enum str2e(const char* str)
 {
-    auto pairs = esyms<Enum>();
-    auto *p = pairs.get(str);
+    auto *p = eindex<Enum>().find(str);
     C4_CHECK_MSG(p != nullptr, "no valid enum pair name for '%s'", str);
     return p->value;
 }
@@ -167,9 +302,8 @@ Enum str2e(const char* str)
 template<class Enum>
 const char* e2str(Enum e)
 {
-    auto es = esyms<Enum>();
-    auto *p = es.get(e);
-    C4_CHECK_MSG(p != nullptr, "no valid enum pair name");
+    auto *p = eindex<Enum>().find(e);
+    C4_CHECK_MSG(p != nullptr, "could not find symbol=%zd", (std::ptrdiff_t)e);
     return p->name;
 }
 
@@ -271,6 +405,64 @@ const char* EnumSymbols<Enum>::Sym::name_offs(EnumOffsetType t) const
     return name + eoffs<Enum>(t);
 }
 
+//-----------------------------------------------------------------------------
+template<class Enum>
+EnumIndex<Enum>::EnumIndex(EnumSymbols<Enum> const& syms)
+    : m_syms(syms)
+    , m_names()
+    , m_values()
+{
+    using I = typename std::underlying_type<Enum>::type;
+    const size_t num = syms.size();
+    const size_t offs[] = {eoffs<Enum>(EOFFS_CLS), eoffs<Enum>(EOFFS_PFX)};
+    detail::enum_key *keys = static_cast<detail::enum_key*>(aalloc(3 * num * sizeof(detail::enum_key), alignof(detail::enum_key)));
+    int64_t *values = static_cast<int64_t*>(aalloc(num * sizeof(int64_t), alignof(int64_t)));
+    size_t num_keys = 0;
+    for(size_t i = 0; i < num; ++i)
+    {
+        Sym const& sym = syms.begin()[i];
+        const size_t len = strlen(sym.name);
+        keys[num_keys++] = {sym.name, len, i};
+        for(size_t j = 0; j < C4_COUNTOF(offs); ++j)
+        {
+            if(offs[j] == 0 || (j > 0 && offs[j] == offs[j - 1]))
+                continue;
+            C4_ASSERT(offs[j] <= len);
+            keys[num_keys++] = {sym.name + offs[j], len - offs[j], i};
+        }
+        values[i] = static_cast<int64_t>(static_cast<I>(sym.value));
+    }
+    m_names.build(keys, num_keys);
+    m_values.build(values, num);
+    afree(values);
+    afree(keys);
+}
+
+template<class Enum>
+typename EnumIndex<Enum>::Sym const* EnumIndex<Enum>::find(Enum v) const
+{
+    using I = typename std::underlying_type<Enum>::type;
+    const size_t id = m_values.find(static_cast<int64_t>(static_cast<I>(v)));
+    return id != detail::enum_value_index::npos ? m_syms.begin() + id : nullptr;
+}
+
+template<class Enum>
+typename EnumIndex<Enum>::Sym const* EnumIndex<Enum>::find(const char *s) const
+{
+    const size_t id = m_names.find(s, strlen(s));
+    return id != detail::enum_name_index::npos ? m_syms.begin() + id : nullptr;
+}
+
+template<class Enum>
+typename EnumIndex<Enum>::Sym const* EnumIndex<Enum>::find(const char *s, size_t len) const
+{
+    const size_t id = m_names.find(s, len);
+    if(id != detail::enum_name_index::npos)
+        return m_syms.begin() + id;
+    // EnumSymbols::find(s, len) also accepts some partial names
+    return m_syms.find(s, len);
+}
+
 } // namespace c4
 
 #endif // _C4_ENUM_HPP_
@@ -0,0 +1,105 @@
+#include "c4/eytzinger.hpp"
+#include "c4/cpu_features.hpp"
+
+#ifdef C4_EYTZINGER_X86
+#   include <immintrin.h>
+#endif
+
+namespace c4 {
+
+//-----------------------------------------------------------------------------
+// x86 kernels: the keys of a node (a cache line) are compared with the
+// searched key in two vectors, and the number of keys less than it,
+// which is the child to descend to, is the popcount of the comparison
+// mask. avx2 has only signed comparisons, so the sign bits of the
+// unsigned keys are flipped first.
+
+#ifdef C4_EYTZINGER_X86
+
+namespace detail {
+
+C4_CPU_TARGET("avx2,popcnt") size_t stree_lower_bound_avx2(uint32_t const* nodes, size_t num_nodes, uint32_t x) noexcept
+{
+    enum : size_t { B = stree_node_size<uint32_t>::value };
+    const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+    const __m256i xv = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int32_t>(x)), sign);
+    size_t k = 0, res = (size_t)-1;
+    while(k < num_nodes)
+    {
+        const __m256i *node = reinterpret_cast<const __m256i*>(nodes + k * B);
+        const __m256i a = _mm256_xor_si256(_mm256_load_si256(node), sign);
+        const __m256i b = _mm256_xor_si256(_mm256_load_si256(node + 1), sign);
+        const unsigned lo = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(xv, a))));
+        const unsigned hi = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(xv, b))));
+        const size_t i = static_cast<size_t>(_mm_popcnt_u32(lo | (hi << 8)));
+        if(i < B)
+            res = k * B + i;
+        k = k * (B + 1u) + i + 1u;
+    }
+    return res;
+}
+
+C4_CPU_TARGET("avx2,popcnt") size_t stree_lower_bound_avx2(uint64_t const* nodes, size_t num_nodes, uint64_t x) noexcept
+{
+    enum : size_t { B = stree_node_size<uint64_t>::value };
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i xv = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(x)), sign);
+    size_t k = 0, res = (size_t)-1;
+    while(k < num_nodes)
+    {
+        const __m256i *node = reinterpret_cast<const __m256i*>(nodes + k * B);
+        const __m256i a = _mm256_xor_si256(_mm256_load_si256(node), sign);
+        const __m256i b = _mm256_xor_si256(_mm256_load_si256(node + 1), sign);
+        const unsigned lo = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(xv, a))));
+        const unsigned hi = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(xv, b))));
+        const size_t i = static_cast<size_t>(_mm_popcnt_u32(lo | (hi << 4)));
+        if(i < B)
+            res = k * B + i;
+        k = k * (B + 1u) + i + 1u;
+    }
+    return res;
+}
+
+} // namespace detail
+
+#endif // C4_EYTZINGER_X86
+
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+template<class U>
+using stree_lower_bound_fn = size_t (*)(U const*, size_t, U);
+
+template<class U>
+stree_lower_bound_fn<U> stree_select_impl() noexcept
+{
+    const stree_lower_bound_fn<U> scalar = &detail::stree_lower_bound_scalar<U>;
+#ifdef C4_EYTZINGER_X86
+    const stree_lower_bound_fn<U> avx2 = &detail::stree_lower_bound_avx2;
+    return cpu_select(CPU_AVX2|CPU_POPCNT, avx2, scalar);
+#else
+    return scalar;
+#endif
+}
+
+} // anonymous namespace
+
+namespace detail {
+
+size_t stree_lower_bound(uint32_t const* nodes, size_t num_nodes, uint32_t x) noexcept
+{
+    static const stree_lower_bound_fn<uint32_t> impl = stree_select_impl<uint32_t>();
+    return impl(nodes, num_nodes, x);
+}
+
+size_t stree_lower_bound(uint64_t const* nodes, size_t num_nodes, uint64_t x) noexcept
+{
+    static const stree_lower_bound_fn<uint64_t> impl = stree_select_impl<uint64_t>();
+    return impl(nodes, num_nodes, x);
+}
+
+} // namespace detail
+
+} // namespace c4
@@ -0,0 +1,202 @@
+#include "c4/histogram.hpp"
+#include "c4/format.hpp"
+
+namespace c4 {
+
+constexpr const uint64_t histogram::default_max_value;
+
+histogram::histogram(uint64_t max_value, unsigned precision_bits)
+    : m_counts(nullptr)
+    , m_num_buckets(0)
+    , m_max_value(max_value)
+    , m_precision_bits(precision_bits)
+    , m_total(0)
+    , m_sum(0)
+    , m_min(UINT64_MAX)
+    , m_max(0)
+{
+    C4_CHECK_MSG(precision_bits >= 1 && precision_bits <= 16, "precision_bits=%u", precision_bits);
+    m_num_buckets = index(max_value) + 1;
+    m_counts = new std::atomic<uint64_t>[m_num_buckets];
+    reset();
+}
+
+histogram::~histogram()
+{
+    _free();
+}
+
+void histogram::_free() noexcept
+{
+    delete[] m_counts;
+    m_counts = nullptr;
+    m_num_buckets = 0;
+}
+
+void histogram::_copy(histogram const& that)
+{
+    m_max_value = that.m_max_value;
+    m_precision_bits = that.m_precision_bits;
+    if(m_num_buckets != that.m_num_buckets)
+    {
+        _free();
+        m_num_buckets = that.m_num_buckets;
+        m_counts = new std::atomic<uint64_t>[m_num_buckets];
+    }
+    reset();
+    merge(that);
+}
+
+histogram::histogram(histogram const& that)
+    : m_counts(nullptr)
+    , m_num_buckets(0)
+    , m_max_value(0)
+    , m_precision_bits(0)
+    , m_total(0)
+    , m_sum(0)
+    , m_min(UINT64_MAX)
+    , m_max(0)
+{
+    _copy(that);
+}
+
+histogram::histogram(histogram && that) noexcept
+    : m_counts(that.m_counts)
+    , m_num_buckets(that.m_num_buckets)
+    , m_max_value(that.m_max_value)
+    , m_precision_bits(that.m_precision_bits)
+    , m_total(that.m_total.load(std::memory_order_relaxed))
+    , m_sum(that.m_sum.load(std::memory_order_relaxed))
+    , m_min(that.m_min.load(std::memory_order_relaxed))
+    , m_max(that.m_max.load(std::memory_order_relaxed))
+{
+    // leave it empty, without buckets
+    that.m_counts = nullptr;
+    that.m_num_buckets = 0;
+    that.reset();
+}
+
+histogram& histogram::operator= (histogram const& that)
+{
+    if(&that != this)
+        _copy(that);
+    return *this;
+}
+
+histogram& histogram::operator= (histogram && that) noexcept
+{
+    if(&that == this)
+        return *this;
+    _free();
+    m_counts = that.m_counts;
+    m_num_buckets = that.m_num_buckets;
+    m_max_value = that.m_max_value;
+    m_precision_bits = that.m_precision_bits;
+    m_total.store(that.m_total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_sum.store(that.m_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_min.store(that.m_min.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_max.store(that.m_max.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    // leave it empty, without buckets
+    that.m_counts = nullptr;
+    that.m_num_buckets = 0;
+    that.reset();
+    return *this;
+}
+
+void histogram::reset() noexcept
+{
+    for(size_t i = 0; i < m_num_buckets; ++i)
+        m_counts[i].store(0, std::memory_order_relaxed);
+    m_total.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(UINT64_MAX, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+void histogram::merge(histogram const& that)
+{
+    // a moved-from histogram has no buckets
+    if(C4_UNLIKELY(that.m_max_value != m_max_value || that.m_precision_bits != m_precision_bits
+                   || that.m_num_buckets != m_num_buckets))
+    {
+        C4_ERROR("cannot merge histograms with different layouts");
+        return;
+    }
+    for(size_t i = 0; i < m_num_buckets; ++i)
+    {
+        const uint64_t n = that.m_counts[i].load(std::memory_order_relaxed);
+        if(n)
+            m_counts[i].store(m_counts[i].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    m_total.store(m_total.load(std::memory_order_relaxed) + that.m_total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_sum.store(m_sum.load(std::memory_order_relaxed) + that.m_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    const uint64_t min = that.m_min.load(std::memory_order_relaxed);
+    const uint64_t max = that.m_max.load(std::memory_order_relaxed);
+    if(min < m_min.load(std::memory_order_relaxed))
+        m_min.store(min, std::memory_order_relaxed);
+    if(max > m_max.load(std::memory_order_relaxed))
+        m_max.store(max, std::memory_order_relaxed);
+}
+
+uint64_t histogram::bucket_lowest(size_t i) const noexcept
+{
+    const unsigned p = m_precision_bits;
+    if(i < (size_t(2) << p))
+        return i;
+    const unsigned shift = static_cast<unsigned>(i >> p) - 1u;
+    return uint64_t(i - (size_t(shift) << p)) << shift;
+}
+
+uint64_t histogram::bucket_highest(size_t i) const noexcept
+{
+    const unsigned p = m_precision_bits;
+    if(i < (size_t(2) << p))
+        return i;
+    const unsigned shift = static_cast<unsigned>(i >> p) - 1u;
+    return bucket_lowest(i) + (uint64_t(1) << shift) - 1u;
+}
+
+double histogram::mean() const noexcept
+{
+    const uint64_t n = count();
+    return n ? static_cast<double>(m_sum.load(std::memory_order_relaxed)) / static_cast<double>(n) : 0.;
+}
+
+uint64_t histogram::percentile(double percent) const noexcept
+{
+    const uint64_t total = count();
+    if( ! total)
+        return 0;
+    const uint64_t lo = min(), hi = max();
+    percent = percent < 0. ? 0. : (percent > 100. ? 100. : percent);
+    // the rank of the value (counting from 1) is the nearest above
+    const double r = percent * 0.01 * static_cast<double>(total);
+    uint64_t rank = static_cast<uint64_t>(r);
+    rank += static_cast<double>(rank) < r;
+    rank = rank < 1 ? 1 : (rank > total ? total : rank);
+    uint64_t seen = 0;
+    for(size_t i = 0; i < m_num_buckets; ++i)
+    {
+        seen += m_counts[i].load(std::memory_order_relaxed);
+        if(seen >= rank)
+        {
+            // report the highest value equivalent to those in the
+            // bucket, but within the recorded range. The last bucket
+            // also holds the values above max_value.
+            const uint64_t v = i + 1 < m_num_buckets ? bucket_highest(i) : hi;
+            return v < lo ? lo : (v > hi ? hi : v);
+        }
+    }
+    return hi; // values are being recorded concurrently
+}
+
+size_t to_chars(substr buf, histogram const& h)
+{
+    double mean = h.mean();
+    return format(buf, "count={} min={} mean={} p50={} p90={} p99={} p99.9={} max={}",
+                  h.count(), h.min(), fmt::fmt(mean, 1),
+                  h.percentile(50.), h.percentile(90.), h.percentile(99.), h.percentile(99.9),
+                  h.max());
+}
+
+} // namespace c4
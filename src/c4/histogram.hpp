@@ -0,0 +1,185 @@
+#ifndef _C4_HISTOGRAM_HPP_
+#define _C4_HISTOGRAM_HPP_
+
+/** @file histogram.hpp A histogram of values with bounded relative
+ * error, for latency percentiles. */
+
+#include "c4/config.hpp"
+#include "c4/error.hpp"
+#include "c4/substr.hpp"
+
+#include <atomic>
+
+#if defined(_MSC_VER) && (defined(C4_CPU_X86_64) || defined(C4_CPU_ARM64))
+#   include <intrin.h>
+#endif
+
+namespace c4 {
+
+/** A histogram with log-linear buckets, like HdrHistogram: values are
+ * exact up to 2^(precision_bits+1), and above that each power of two
+ * is split in 2^precision_bits buckets, so that any recorded value is
+ * known within a relative error of 2^-precision_bits (0.8% with the
+ * default of 7 bits). The buckets are allocated on construction, for
+ * values up to a maximum; larger values count in the last bucket.
+ *
+ * Recording is a few instructions, and never waits nor allocates. A
+ * histogram has a single writer: use one per thread, and merge() them
+ * for reporting. Other threads may read a histogram (merge it, or
+ * query it) while it is written, getting a snapshot which may miss
+ * the values being recorded.
+ *
+ * @code
+ * c4::histogram h; // nanoseconds, up to one hour
+ * for(auto const& req : requests)
+ * {
+ *     auto t0 = c4::tsc_clock::now();
+ *     process(req);
+ *     h.record(c4::tsc_clock::elapsed_ns(t0, c4::tsc_clock::now()));
+ * }
+ * uint64_t p99 = h.percentile(99.);
+ * @endcode */
+class histogram
+{
+public:
+
+    enum : unsigned { default_precision_bits = 7 };
+    static constexpr const uint64_t default_max_value = UINT64_C(3600000000000); // one hour, in ns
+
+public:
+
+    /** @param max_value the largest value to be recorded exactly
+     * @param precision_bits the number of bits of the buckets within a
+     * power of two. Must be between 1 and 16. */
+    explicit histogram(uint64_t max_value=default_max_value, unsigned precision_bits=default_precision_bits);
+    ~histogram();
+
+    histogram(histogram const& that);
+    /** the moved-from histogram is left empty and without buckets: it
+     * may then only be queried, assigned to, or destroyed */
+    histogram(histogram && that) noexcept;
+    histogram& operator= (histogram const& that);
+    histogram& operator= (histogram && that) noexcept;
+
+public:
+
+    /** record a value. Must be called only from one thread at a time. */
+    C4_ALWAYS_INLINE void record(uint64_t value) noexcept
+    {
+        record(value, 1u);
+    }
+
+    /** record a value, @p count times. Must be called only from one
+     * thread at a time. */
+    C4_ALWAYS_INLINE void record(uint64_t value, uint64_t count) noexcept
+    {
+        C4_ASSERT_MSG(m_counts != nullptr, "recording into a moved-from histogram");
+        std::atomic<uint64_t> &bucket = m_counts[index(value < m_max_value ? value : m_max_value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        m_total.store(m_total.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        m_sum.store(m_sum.load(std::memory_order_relaxed) + value * count, std::memory_order_relaxed);
+        if(value < m_min.load(std::memory_order_relaxed))
+            m_min.store(value, std::memory_order_relaxed);
+        if(value > m_max.load(std::memory_order_relaxed))
+            m_max.store(value, std::memory_order_relaxed);
+    }
+
+    /** add the counts of another histogram, which must have the same
+     * max_value and precision_bits */
+    void merge(histogram const& that);
+
+    void reset() noexcept;
+
+public:
+
+    uint64_t count() const noexcept { return m_total.load(std::memory_order_relaxed); }
+    bool empty() const noexcept { return count() == 0; }
+
+    /** the smallest recorded value, or 0 if empty */
+    uint64_t min() const noexcept { return empty() ? 0 : m_min.load(std::memory_order_relaxed); }
+    /** the largest recorded value, or 0 if empty */
+    uint64_t max() const noexcept { return m_max.load(std::memory_order_relaxed); }
+    /** the mean of the recorded values, or 0 if empty */
+    double mean() const noexcept;
+
+    /** the value below which (or at which) the given percentage of the
+     * recorded values is, within the precision of the histogram. Eg
+     * percentile(50.) is the median, and percentile(100.) is max().
+     * Returns 0 if empty. */
+    uint64_t percentile(double percent) const noexcept;
+
+    /** the number of recorded values which fall in the same bucket as
+     * @p value */
+    uint64_t count_at(uint64_t value) const noexcept
+    {
+        if( ! m_counts) // moved-from
+            return 0;
+        return m_counts[index(value < m_max_value ? value : m_max_value)].load(std::memory_order_relaxed);
+    }
+
+public:
+
+    uint64_t max_value() const noexcept { return m_max_value; }
+    unsigned precision_bits() const noexcept { return m_precision_bits; }
+    size_t num_buckets() const noexcept { return m_num_buckets; }
+
+    /** the index of the bucket of a value */
+    C4_ALWAYS_INLINE size_t index(uint64_t value) const noexcept
+    {
+        const unsigned p = m_precision_bits;
+        if(value < (uint64_t(2) << p))
+            return static_cast<size_t>(value);
+        const unsigned shift = _msb(value) - p;
+        return (size_t(shift) << p) + static_cast<size_t>(value >> shift);
+    }
+
+    /** the smallest value of the bucket with the given index */
+    uint64_t bucket_lowest(size_t i) const noexcept;
+    /** the largest value of the bucket with the given index */
+    uint64_t bucket_highest(size_t i) const noexcept;
+
+private:
+
+    C4_ALWAYS_INLINE static unsigned _msb(uint64_t v) noexcept
+    {
+        C4_ASSERT(v != 0);
+#if defined(__GNUC__) || defined(__clang__)
+        return 63u - static_cast<unsigned>(__builtin_clzll(v));
+#elif defined(_MSC_VER) && (defined(C4_CPU_X86_64) || defined(C4_CPU_ARM64))
+        unsigned long pos;
+        _BitScanReverse64(&pos, v);
+        return static_cast<unsigned>(pos);
+#else
+        unsigned pos = 0;
+        while(v >>= 1)
+            ++pos;
+        return pos;
+#endif
+    }
+
+    void _free() noexcept;
+    void _copy(histogram const& that);
+
+private:
+
+    std::atomic<uint64_t> *m_counts;
+    size_t   m_num_buckets;
+    uint64_t m_max_value;
+    unsigned m_precision_bits;
+    std::atomic<uint64_t> m_total;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_min;
+    std::atomic<uint64_t> m_max;
+
+};
+
+
+/** write a summary of the histogram: the count, min, mean, the
+ * 50/90/99/99.9 percentiles and max, eg
+ * "count=1000 min=12 mean=20.5 p50=19 p90=27 p99=45 p99.9=80 max=95"
+ * @return the number of characters needed */
+size_t to_chars(substr buf, histogram const& h);
+
+} // namespace c4
+
+#endif /* _C4_HISTOGRAM_HPP_ */
@@ -0,0 +1,415 @@
+#include "c4/line_reader.hpp"
+#include "c4/memory_resource.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <errno.h>
+#include <string.h>
+
+#if defined(C4_POSIX) || defined(C4_MACOS) || defined(C4_IOS)
+#   define C4_LINE_READER_POSIX
+#   include <fcntl.h>
+#   include <poll.h>
+#   include <unistd.h>
+#elif defined(C4_WIN)
+#   include <atomic>
+#   include <fcntl.h>
+#   include <io.h>
+#   include "c4/windows.hpp"
+#endif
+
+namespace c4 {
+
+namespace {
+
+int open_for_reading(const char *path)
+{
+#if defined(C4_WIN)
+    return ::_open(path, _O_RDONLY|_O_BINARY);
+#else
+    return ::open(path, O_RDONLY|O_CLOEXEC);
+#endif
+}
+
+void close_fd(int fd)
+{
+#if defined(C4_WIN)
+    ::_close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+/** @return the number of bytes read, zero at the end of the input, or
+ * a negative value on error. With a @p wake_fd (POSIX only), the wait
+ * for input is abandoned as soon as that descriptor becomes readable,
+ * failing with ECANCELED. */
+ptrdiff_t read_some(int fd, char *buf, size_t len, int wake_fd=-1)
+{
+    while(true)
+    {
+#if defined(C4_WIN)
+        C4_UNUSED(wake_fd);
+        ptrdiff_t ret = ::_read(fd, buf, static_cast<unsigned>(len < 0x40000000u ? len : 0x40000000u));
+#else
+#   if defined(C4_LINE_READER_POSIX)
+        if(wake_fd >= 0)
+        {
+            struct pollfd fds[2] = {{fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+            if(::poll(fds, 2, -1) < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                return -1;
+            }
+            if(fds[1].revents)
+            {
+                errno = ECANCELED;
+                return -1;
+            }
+        }
+#   else
+        C4_UNUSED(wake_fd);
+#   endif
+        ptrdiff_t ret = ::read(fd, buf, len);
+#endif
+        if(ret >= 0 || errno != EINTR)
+            return ret;
+    }
+}
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+/** the background thread filling the buffers, in alternation. It
+ * finishes once it reads the end of the input (or fails). Stopping it
+ * must not wait for input which may never come, eg from a pipe whose
+ * writer is still open: on POSIX its reads wait on the input and on a
+ * self-pipe written by the destructor; on Windows, the destructor
+ * cancels the thread's pending read. */
+struct line_reader::prefetcher
+{
+    line_reader            *reader;
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable cv;
+    bool                    ready[2]; ///< filled, and not yet taken by the reader
+    bool                    empty[2]; ///< released by the reader, and not yet being filled
+    size_t                  fill_next;
+    bool                    stop;
+#if defined(C4_LINE_READER_POSIX)
+    int                     wake[2];  ///< the self-pipe interrupting a read
+#elif defined(C4_WIN)
+    std::atomic<bool>       done;
+#endif
+
+    prefetcher(line_reader *r) : reader(r), thread(), mutex(), cv(), ready{false, false}, empty{true, true}, fill_next(0), stop(false)
+    {
+#if defined(C4_LINE_READER_POSIX)
+        C4_CHECK_MSG(::pipe(wake) == 0, "could not create a pipe: %s", ::strerror(errno));
+        for(int fd : wake)
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#elif defined(C4_WIN)
+        done = false;
+#endif
+        thread = std::thread(&prefetcher::run, this);
+    }
+
+    ~prefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+#if defined(C4_LINE_READER_POSIX)
+        const char c = 0;
+        while(::write(wake[1], &c, 1) < 0 && errno == EINTR)
+            ;
+        thread.join();
+        ::close(wake[0]);
+        ::close(wake[1]);
+#elif defined(C4_WIN)
+        // retry until the thread is out: the read may start after a
+        // cancellation
+        while( ! done.load())
+        {
+            ::CancelSynchronousIo(thread.native_handle());
+            std::this_thread::yield();
+        }
+        thread.join();
+#else
+        thread.join();
+#endif
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true)
+        {
+            cv.wait(lock, [this]{ return stop || empty[fill_next]; });
+            if(stop)
+                break;
+            size_t i = fill_next;
+            empty[i] = false;
+            lock.unlock();
+#if defined(C4_LINE_READER_POSIX)
+            reader->_fill(i, wake[0]);
+#else
+            reader->_fill(i);
+#endif
+            lock.lock();
+            ready[i] = true;
+            fill_next ^= 1u;
+            cv.notify_all();
+            // nothing more to read after the end of the input
+            if(reader->m_buffers[i].len == 0)
+                break;
+        }
+#if defined(C4_WIN)
+        done.store(true);
+#endif
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+
+line_reader::line_reader()
+    : m_fd(-1)
+    , m_owns_fd(false)
+    , m_buffer_size(0)
+    , m_headroom(0)
+    , m_buffers{{nullptr, 0, 0}, {nullptr, 0, 0}}
+    , m_curr(0)
+    , m_pos(nullptr)
+    , m_end(nullptr)
+    , m_eof(false)
+    , m_error(0)
+    , m_num_lines(0)
+    , m_spill(nullptr)
+    , m_spill_len(0)
+    , m_spill_cap(0)
+    , m_prefetcher(nullptr)
+{
+}
+
+line_reader::~line_reader()
+{
+    close();
+}
+
+bool line_reader::open(const char *path, size_t buffer_size, bool prefetch)
+{
+    close();
+    int fd = open_for_reading(path);
+    if(fd < 0)
+        return false;
+#ifdef POSIX_FADV_SEQUENTIAL
+    // double the read-ahead window; this fails harmlessly on pipes
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    open(fd, buffer_size, prefetch);
+    m_owns_fd = true;
+    return true;
+}
+
+void line_reader::open(int fd, size_t buffer_size, bool prefetch)
+{
+    C4_CHECK(fd >= 0);
+    C4_CHECK(buffer_size > 0);
+    close();
+    m_fd = fd;
+    m_owns_fd = false;
+    m_buffer_size = buffer_size;
+    m_headroom = buffer_size < default_headroom ? buffer_size : default_headroom;
+    for(buffer_type &b : m_buffers)
+    {
+        b.mem = static_cast<char*>(aalloc(m_headroom + m_buffer_size, 64));
+        b.len = 0;
+        b.err = 0;
+    }
+    // start as if the (nonexistent) buffer before the first were
+    // exhausted. @see next()
+    m_curr = 1;
+    m_pos = nullptr;
+    m_end = nullptr;
+    m_eof = false;
+    m_error = 0;
+    m_num_lines = 0;
+    m_spill_len = 0;
+    if(prefetch)
+        m_prefetcher = new prefetcher(this);
+}
+
+void line_reader::close()
+{
+    if(m_prefetcher)
+    {
+        delete m_prefetcher;
+        m_prefetcher = nullptr;
+    }
+    for(buffer_type &b : m_buffers)
+    {
+        if(b.mem)
+            afree(b.mem);
+        b.mem = nullptr;
+        b.len = 0;
+        b.err = 0;
+    }
+    if(m_spill)
+        afree(m_spill);
+    m_spill = nullptr;
+    m_spill_len = 0;
+    m_spill_cap = 0;
+    if(m_owns_fd && m_fd >= 0)
+        close_fd(m_fd);
+    m_fd = -1;
+    m_owns_fd = false;
+    m_pos = nullptr;
+    m_end = nullptr;
+    m_eof = false;
+}
+
+
+//-----------------------------------------------------------------------------
+
+bool line_reader::next(csubstr *line)
+{
+    C4_CHECK(valid());
+    while(true)
+    {
+        if(m_pos < m_end)
+        {
+            const char *nl = static_cast<const char*>(memchr(m_pos, '\n', static_cast<size_t>(m_end - m_pos)));
+            if(nl)
+            {
+                if(m_spill_len)
+                {
+                    _spill(m_pos, static_cast<size_t>(nl - m_pos));
+                    *line = csubstr(m_spill, m_spill_len);
+                    m_spill_len = 0; // the contents stay valid until the next call
+                }
+                else
+                {
+                    *line = csubstr(m_pos, nl);
+                }
+                m_pos = nl + 1;
+                ++m_num_lines;
+                return true;
+            }
+        }
+        size_t tail_len = static_cast<size_t>(m_end - m_pos);
+        if(m_eof)
+        {
+            if(tail_len == 0 && m_spill_len == 0)
+                return false;
+            // the last line has no newline
+            if(m_spill_len)
+            {
+                _spill(m_pos, tail_len);
+                *line = csubstr(m_spill, m_spill_len);
+                m_spill_len = 0;
+            }
+            else
+            {
+                *line = csubstr(m_pos, tail_len);
+            }
+            m_pos = m_end;
+            ++m_num_lines;
+            return true;
+        }
+        // the current buffer is exhausted: carry the partial line over
+        // to the start of the next buffer, and release the current one
+        size_t next = m_curr ^ 1u;
+        _acquire(next);
+        char *data = _data(next);
+        if(m_spill_len || tail_len > m_headroom)
+        {
+            _spill(m_pos, tail_len);
+            m_pos = data;
+        }
+        else
+        {
+            if(tail_len)
+                memcpy(data - tail_len, m_pos, tail_len);
+            m_pos = data - tail_len;
+        }
+        if(m_end != nullptr)
+            _release(m_curr);
+        m_curr = next;
+        m_end = data + m_buffers[next].len;
+        if(m_buffers[next].len == 0)
+        {
+            m_eof = true;
+            m_error = m_buffers[next].err;
+        }
+    }
+}
+
+void line_reader::_fill(size_t i, int wake_fd)
+{
+    buffer_type &b = m_buffers[i];
+    ptrdiff_t ret = read_some(m_fd, b.mem + m_headroom, m_buffer_size, wake_fd);
+    if(ret >= 0)
+    {
+        b.len = static_cast<size_t>(ret);
+        b.err = 0;
+    }
+    else
+    {
+        b.len = 0;
+        b.err = errno;
+    }
+}
+
+void line_reader::_acquire(size_t i)
+{
+    if( ! m_prefetcher)
+    {
+        _fill(i);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_prefetcher->mutex);
+    m_prefetcher->cv.wait(lock, [this, i]{ return m_prefetcher->ready[i]; });
+    m_prefetcher->ready[i] = false;
+}
+
+void line_reader::_release(size_t i)
+{
+    if( ! m_prefetcher)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_prefetcher->mutex);
+        m_prefetcher->empty[i] = true;
+    }
+    m_prefetcher->cv.notify_all();
+}
+
+void line_reader::_spill(const char *str, size_t len)
+{
+    if(m_spill_len + len > m_spill_cap)
+    {
+        size_t cap = 2 * m_spill_cap;
+        if(cap < m_spill_len + len)
+            cap = m_spill_len + len;
+        if(cap < 4096)
+            cap = 4096;
+        char *spill = static_cast<char*>(aalloc(cap, 64));
+        if(m_spill_len)
+            memcpy(spill, m_spill, m_spill_len);
+        if(m_spill)
+            afree(m_spill);
+        m_spill = spill;
+        m_spill_cap = cap;
+    }
+    if(len)
+        memcpy(m_spill + m_spill_len, str, len);
+    m_spill_len += len;
+}
+
+} // namespace c4
@@ -0,0 +1,130 @@
+#ifndef _C4_LINE_READER_HPP_
+#define _C4_LINE_READER_HPP_
+
+/** @file line_reader.hpp Read lines from a file descriptor into
+ * csubstr, without copying them. */
+
+#include "c4/config.hpp"
+#include "c4/error.hpp"
+#include "c4/substr.hpp"
+
+namespace c4 {
+
+/** Reads lines from a file descriptor (a file, pipe or socket), and
+ * yields them as csubstr pointing into its internal buffers.
+ *
+ * Two large buffers are used in turn: while the caller consumes the
+ * lines in one of them, the other is filled, either by a background
+ * thread or, when prefetching is disabled, on demand (regular files
+ * are then read with a sequential access hint). Each buffer has some
+ * headroom before its data: when a line straddles the end of the
+ * current buffer, its start is moved into the headroom of the next
+ * buffer, so that the line is contiguous. Lines longer than the
+ * headroom are assembled in a separate spill buffer.
+ *
+ * @code
+ * c4::line_reader r;
+ * if( ! r.open("server.log"))
+ *     return false;
+ * csubstr line;
+ * while(r.next(&line))
+ *     process(line);
+ * if(r.error())
+ *     return false;
+ * @endcode
+ *
+ * @ingroup files */
+class line_reader
+{
+public:
+
+    struct prefetcher;
+
+    enum : size_t {
+        default_buffer_size = size_t(1) << 20,
+        default_headroom = size_t(1) << 12,
+    };
+
+public:
+
+    line_reader();
+    ~line_reader();
+
+    line_reader(line_reader const&) = delete;
+    line_reader& operator= (line_reader const&) = delete;
+    line_reader(line_reader &&) = delete;
+    line_reader& operator= (line_reader &&) = delete;
+
+public:
+
+    /** open the file at the given path, for reading it line by line.
+     * The file is closed by close() or on destruction.
+     * @param buffer_size the size of each of the two buffers
+     * @param prefetch whether to fill the next buffer in a background thread
+     * @return false if the file could not be opened; errno is then set */
+    bool open(const char *path, size_t buffer_size=default_buffer_size, bool prefetch=true);
+    /** read lines from the given file descriptor, which is not closed by
+     * this object.
+     * @param buffer_size the size of each of the two buffers
+     * @param prefetch whether to fill the next buffer in a background thread */
+    void open(int fd, size_t buffer_size=default_buffer_size, bool prefetch=true);
+    /** stop reading, and release the buffers. This does not wait for
+     * pending input, eg from a pipe whose writer is still open. */
+    void close();
+
+    bool valid() const { return m_fd >= 0; }
+    int fd() const { return m_fd; }
+
+public:
+
+    /** get the next line, without its terminating newline (a final
+     * carriage return is kept). The line remains valid until the next
+     * call to next() or close().
+     * @return false once the input is exhausted, or on a read error
+     * @see error() */
+    bool next(csubstr *line);
+
+    /** the errno value of the read error which ended the input, or zero */
+    int error() const { return m_error; }
+
+    /** the number of lines returned so far */
+    size_t num_lines() const { return m_num_lines; }
+
+private:
+
+    struct buffer_type
+    {
+        char  *mem;  ///< headroom followed by data
+        size_t len;  ///< the number of data bytes
+        int    err;  ///< the errno of a failed read, or zero
+    };
+
+    char* _data(size_t i) const { return m_buffers[i].mem + m_headroom; }
+    void _acquire(size_t i);
+    void _release(size_t i);
+    void _fill(size_t i, int wake_fd=-1);
+    void _spill(const char *str, size_t len);
+
+private:
+
+    int         m_fd;
+    bool        m_owns_fd;
+    size_t      m_buffer_size;
+    size_t      m_headroom;
+    buffer_type m_buffers[2];
+    size_t      m_curr;        ///< the index of the buffer being consumed
+    const char *m_pos;         ///< the start of the unconsumed input
+    const char *m_end;         ///< the end of the current buffer's data
+    bool        m_eof;
+    int         m_error;
+    size_t      m_num_lines;
+    char       *m_spill;
+    size_t      m_spill_len;
+    size_t      m_spill_cap;
+    prefetcher *m_prefetcher;
+
+};
+
+} // namespace c4
+
+#endif /* _C4_LINE_READER_HPP_ */
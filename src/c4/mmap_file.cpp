@@ -0,0 +1,201 @@
+#include "c4/mmap_file.hpp"
+
+#if defined(C4_POSIX) || defined(C4_MACOS) || defined(C4_IOS)
+#   define C4_MMAP_FILE_POSIX
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#elif defined(C4_WIN)
+#   include "c4/windows.hpp"
+#endif
+
+namespace c4 {
+
+void mmap_file::_move(mmap_file *that)
+{
+    m_str = that->m_str;
+    m_mode = that->m_mode;
+    m_open = that->m_open;
+    that->m_str = {};
+    that->m_mode = MMAP_READ;
+    that->m_open = false;
+}
+
+
+#ifdef C4_MMAP_FILE_POSIX
+
+bool mmap_file::open(const char *path, MmapMode_e mode)
+{
+    close();
+    int fd = ::open(path, O_RDONLY|O_CLOEXEC);
+    if(fd < 0)
+        return false;
+    bool ok = open(fd, mode);
+    int err = errno;
+    ::close(fd);
+    errno = err;
+    return ok;
+}
+
+bool mmap_file::open(int fd, MmapMode_e mode)
+{
+    close();
+    struct stat st;
+    if(::fstat(fd, &st) != 0)
+        return false;
+    if( ! S_ISREG(st.st_mode))
+    {
+        errno = ENODEV;
+        return false;
+    }
+    size_t len = static_cast<size_t>(st.st_size);
+    if(len > 0) // zero-length mappings are an error
+    {
+        int prot = mode == MMAP_COPY_ON_WRITE ? PROT_READ|PROT_WRITE : PROT_READ;
+        void *mem = ::mmap(nullptr, len, prot, MAP_PRIVATE, fd, 0);
+        if(mem == MAP_FAILED)
+            return false;
+        m_str.assign(static_cast<char*>(mem), len);
+    }
+    m_mode = mode;
+    m_open = true;
+    return true;
+}
+
+void mmap_file::close()
+{
+    if(m_str.str)
+    {
+        int ret = ::munmap(m_str.str, m_str.len);
+        C4_CHECK(ret == 0);
+        C4_UNUSED(ret);
+    }
+    m_str = {};
+    m_mode = MMAP_READ;
+    m_open = false;
+}
+
+bool mmap_file::advise(uint32_t flags, size_t offset, size_t len)
+{
+    C4_CHECK(m_open);
+    C4_CHECK(offset <= m_str.len);
+    if(len > m_str.len - offset)
+        len = m_str.len - offset;
+    if(len == 0)
+        return true;
+    // madvise() needs a page-aligned start
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    char *beg = m_str.str + offset;
+    char *aligned = m_str.str + (offset & ~(page - 1));
+    len += static_cast<size_t>(beg - aligned);
+    bool ok = true;
+    if(flags & MMAP_SEQUENTIAL)
+        ok &= ::madvise(aligned, len, MADV_SEQUENTIAL) == 0;
+    if(flags & MMAP_RANDOM)
+        ok &= ::madvise(aligned, len, MADV_RANDOM) == 0;
+    if(flags & MMAP_WILLNEED)
+        ok &= ::madvise(aligned, len, MADV_WILLNEED) == 0;
+#ifdef MADV_HUGEPAGE
+    if(flags & MMAP_HUGEPAGE)
+        ok &= ::madvise(aligned, len, MADV_HUGEPAGE) == 0;
+#endif
+    if(flags == MMAP_NORMAL)
+        ok &= ::madvise(aligned, len, MADV_NORMAL) == 0;
+    return ok;
+}
+
+
+#elif defined(C4_WIN)
+
+bool mmap_file::open(const char *path, MmapMode_e mode)
+{
+    close();
+    HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER sz;
+    if( ! ::GetFileSizeEx(file, &sz))
+    {
+        ::CloseHandle(file);
+        return false;
+    }
+    size_t len = static_cast<size_t>(sz.QuadPart);
+    if(len > 0) // zero-length mappings are an error
+    {
+        DWORD prot = mode == MMAP_COPY_ON_WRITE ? PAGE_WRITECOPY : PAGE_READONLY;
+        DWORD access = mode == MMAP_COPY_ON_WRITE ? FILE_MAP_COPY : FILE_MAP_READ;
+        HANDLE mapping = ::CreateFileMappingA(file, nullptr, prot, 0, 0, nullptr);
+        void *mem = mapping ? ::MapViewOfFile(mapping, access, 0, 0, len) : nullptr;
+        // the view keeps the file mapped after these are closed
+        DWORD err = ::GetLastError();
+        if(mapping)
+            ::CloseHandle(mapping);
+        ::CloseHandle(file);
+        ::SetLastError(err);
+        if( ! mem)
+            return false;
+        m_str.assign(static_cast<char*>(mem), len);
+    }
+    else
+    {
+        ::CloseHandle(file);
+    }
+    m_mode = mode;
+    m_open = true;
+    return true;
+}
+
+void mmap_file::close()
+{
+    if(m_str.str)
+    {
+        BOOL ret = ::UnmapViewOfFile(m_str.str);
+        C4_CHECK(ret);
+        C4_UNUSED(ret);
+    }
+    m_str = {};
+    m_mode = MMAP_READ;
+    m_open = false;
+}
+
+bool mmap_file::advise(uint32_t flags, size_t offset, size_t len)
+{
+    C4_CHECK(m_open);
+    C4_CHECK(offset <= m_str.len);
+    // there is no equivalent to madvise(); the system's read-ahead
+    // heuristics apply. PrefetchVirtualMemory() would serve for
+    // MMAP_WILLNEED, but requires Windows 8.
+    C4_UNUSED(flags);
+    C4_UNUSED(len);
+    return true;
+}
+
+
+#else
+
+bool mmap_file::open(const char *path, MmapMode_e mode)
+{
+    C4_UNUSED(path);
+    C4_UNUSED(mode);
+    C4_ERROR("mmap_file is not implemented for this platform");
+    return false;
+}
+
+void mmap_file::close()
+{
+}
+
+bool mmap_file::advise(uint32_t flags, size_t offset, size_t len)
+{
+    C4_UNUSED(flags);
+    C4_UNUSED(offset);
+    C4_UNUSED(len);
+    return false;
+}
+
+#endif
+
+} // namespace c4
@@ -0,0 +1,132 @@
+#ifndef _C4_MMAP_FILE_HPP_
+#define _C4_MMAP_FILE_HPP_
+
+/** @file mmap_file.hpp A memory-mapped view of a file, usable as a
+ * csubstr. */
+
+#include "c4/config.hpp"
+#include "c4/error.hpp"
+#include "c4/blob.hpp"
+#include "c4/substr.hpp"
+
+namespace c4 {
+
+/** @defgroup files File utilities */
+
+/** the access mode of a mmap_file
+ * @ingroup files */
+typedef enum : uint8_t {
+    /** the mapping is read-only */
+    MMAP_READ = 0,
+    /** the mapping is writable, but the writes are private to the
+     * mapping: they do not reach the file, and are not seen by other
+     * mappings of it. Pages are copied only when first written. */
+    MMAP_COPY_ON_WRITE = 1,
+} MmapMode_e;
+
+/** access pattern hints for a mmap_file, which can be OR'ed
+ * together. These are advisory only; unsupported hints are ignored.
+ * @ingroup files */
+typedef enum : uint32_t {
+    /** no special treatment */
+    MMAP_NORMAL = 0,
+    /** the pages will be accessed in sequential order: read ahead
+     * aggressively, and drop pages soon after they are accessed */
+    MMAP_SEQUENTIAL = 1 << 0,
+    /** the pages will be accessed in random order: do not read ahead */
+    MMAP_RANDOM = 1 << 1,
+    /** the pages will be needed soon: start reading them now */
+    MMAP_WILLNEED = 1 << 2,
+    /** back the mapping with huge pages where possible (Linux only;
+     * requires a kernel and filesystem with transparent huge pages for
+     * file mappings) */
+    MMAP_HUGEPAGE = 1 << 3,
+} MmapAdvice_e;
+
+
+/** A file mapped into memory, exposed as a csubstr (or as a substr,
+ * for copy-on-write mappings). The file contents are read on demand
+ * directly from the page cache, so opening it neither reads nor copies
+ * anything. The mapping is released on destruction.
+ *
+ * @code
+ * c4::mmap_file f("data.txt");
+ * if( ! f.valid())
+ *     return false;
+ * f.advise(c4::MMAP_SEQUENTIAL|c4::MMAP_WILLNEED);
+ * csubstr contents = f.str();
+ * @endcode
+ *
+ * @warning if the file is truncated by another process while mapped,
+ * accessing the lost pages raises SIGBUS.
+ * @ingroup files */
+class mmap_file
+{
+public:
+
+    mmap_file() : m_str(), m_mode(MMAP_READ), m_open(false) {}
+    ~mmap_file() { close(); }
+
+    /** map the file at the given path. Check valid() for success. */
+    explicit mmap_file(const char *path, MmapMode_e mode=MMAP_READ) : mmap_file() { open(path, mode); }
+
+    mmap_file(mmap_file const&) = delete;
+    mmap_file& operator= (mmap_file const&) = delete;
+
+    mmap_file(mmap_file && that) : mmap_file() { _move(&that); }
+    mmap_file& operator= (mmap_file && that) { close(); _move(&that); return *this; }
+
+public:
+
+    /** map the file at the given path, closing any previous mapping.
+     * @return false if the file could not be opened or mapped; errno
+     * (or GetLastError() on Windows) is then set accordingly */
+    bool open(const char *path, MmapMode_e mode=MMAP_READ);
+#if defined(C4_POSIX) || defined(C4_MACOS) || defined(C4_IOS)
+    /** map the file with the given descriptor, closing any previous
+     * mapping. The descriptor is not closed by this object, and may be
+     * closed right after this call.
+     * @return false if the file could not be mapped */
+    bool open(int fd, MmapMode_e mode=MMAP_READ);
+#endif
+    /** release the mapping */
+    void close();
+
+    /** give the system a hint about how a range of the mapping will be
+     * accessed. The range is extended to page boundaries.
+     * @param flags a combination of MmapAdvice_e values
+     * @return false if the system rejected the hint */
+    bool advise(uint32_t flags, size_t offset=0, size_t len=csubstr::npos);
+
+public:
+
+    bool valid() const { return m_open; }
+    MmapMode_e mode() const { return m_mode; }
+
+    size_t size() const { return m_str.len; }
+    bool empty() const { return m_str.len == 0; }
+
+    const char* data() const { return m_str.str; }
+    csubstr str() const { return m_str; }
+    cblob blob() const { return cblob(m_str.str, m_str.len); }
+
+    /** get a writable view; only for copy-on-write mappings */
+    substr str_mutable() { C4_CHECK(m_mode == MMAP_COPY_ON_WRITE); return m_str; }
+
+    operator csubstr () const { return m_str; }
+
+private:
+
+    void _move(mmap_file *that);
+
+private:
+
+    substr     m_str;
+    MmapMode_e m_mode;
+    bool       m_open;
+
+};
+
+} // namespace c4
+
+#endif /* _C4_MMAP_FILE_HPP_ */
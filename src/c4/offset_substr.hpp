@@ -0,0 +1,166 @@
+#ifndef _C4_OFFSET_SUBSTR_HPP_
+#define _C4_OFFSET_SUBSTR_HPP_
+
+/** @file offset_substr.hpp A compact substring, stored as an offset and
+ * a length into a base string. */
+
+#include "c4/config.hpp"
+#include "c4/error.hpp"
+#include "c4/substr.hpp"
+
+#include <type_traits>
+
+namespace c4 {
+
+/** A substring of a base string, stored as an offset and a length of
+ * an integer type I, instead of a pointer and a size_t. With the
+ * default uint32_t, it takes 8 bytes instead of the 16 of a csubstr
+ * (on 64-bit platforms), and a uint16_t halves that again; this
+ * matters for large tables of tokens into a few big buffers.
+ *
+ * The base string is not stored: it is given to in(), which rebinds
+ * the offset_substr to a csubstr (or substr) with all the query
+ * methods of basic_substring. from() does the opposite. The slicing
+ * methods, which do not need the characters, are provided directly
+ * and mirror those of basic_substring.
+ *
+ * @code
+ * c4::csubstr text = ...;
+ * std::vector<c4::offset_substr<>> tokens;
+ * for(c4::csubstr tok : tokenize(text))
+ *     tokens.push_back(c4::offset_substr<>::from(text, tok));
+ * ...
+ * for(auto const& tok : tokens)
+ *     if(tok.in(text).begins_with('#'))
+ *         ...
+ * @endcode
+ *
+ * @see basic_substring
+ * @ingroup nonowning_containers */
+template<class I=uint32_t>
+struct offset_substr
+{
+    C4_STATIC_ASSERT(std::is_integral<I>::value && std::is_unsigned<I>::value);
+
+public:
+
+    I offset;
+    I len;
+
+public:
+
+    using size_type = I;
+
+    enum : size_t { npos = (size_t)-1 };
+
+    /** the largest offset or length */
+    static constexpr size_t max_size() noexcept { return static_cast<size_t>(static_cast<I>(-1)); }
+
+public:
+
+    constexpr offset_substr() noexcept : offset(0), len(0) {}
+    constexpr offset_substr(I offset_, I len_) noexcept : offset(offset_), len(len_) {}
+
+    /** the offset_substr of a substring of base. Checks that s is
+     * contained in base, and that the end of s fits in I. */
+    static offset_substr from(csubstr base, csubstr s)
+    {
+        C4_CHECK(s.str == nullptr ? s.len == 0 : (s.str >= base.str && s.str + s.len <= base.str + base.len));
+        const size_t off = s.str ? static_cast<size_t>(s.str - base.str) : 0u;
+        C4_CHECK_MSG(off + s.len <= max_size(), "substring too far into the base: %zu > %zu", off + s.len, max_size());
+        return offset_substr(static_cast<I>(off), static_cast<I>(s.len));
+    }
+
+public:
+
+    /** rebind to the base string */
+    C4_ALWAYS_INLINE csubstr in(csubstr base) const noexcept
+    {
+        C4_ASSERT(end() <= base.len);
+        return csubstr(base.str + offset, len);
+    }
+    /** rebind to a mutable base string */
+    C4_ALWAYS_INLINE substr in(substr base) const noexcept
+    {
+        C4_ASSERT(end() <= base.len);
+        return substr(base.str + offset, len);
+    }
+
+public:
+
+    C4_ALWAYS_INLINE constexpr bool   empty() const noexcept { return len == 0; }
+    C4_ALWAYS_INLINE constexpr size_t size() const noexcept { return len; }
+    /** the offset of the first character */
+    C4_ALWAYS_INLINE constexpr size_t begin() const noexcept { return offset; }
+    /** the offset after the last character */
+    C4_ALWAYS_INLINE constexpr size_t end() const noexcept { return size_t(offset) + size_t(len); }
+
+    /** same offset and length; this does not compare the characters */
+    C4_ALWAYS_INLINE constexpr bool operator== (offset_substr that) const noexcept { return offset == that.offset && len == that.len; }
+    C4_ALWAYS_INLINE constexpr bool operator!= (offset_substr that) const noexcept { return ! (*this == that); }
+
+public:
+
+    /** true if *this is within that (both from the same base) */
+    bool is_contained(offset_substr that) const noexcept
+    {
+        return that.contains(*this);
+    }
+
+    /** true if that is within *this (both from the same base) */
+    bool contains(offset_substr that) const noexcept
+    {
+        return that.begin() >= begin() && that.end() <= end();
+    }
+
+    /** true if there is at least one character in common */
+    bool overlaps(offset_substr that) const noexcept
+    {
+        return that.begin() < end() && begin() < that.end();
+    }
+
+public:
+
+    /** return [first,first+num[ */
+    offset_substr sub(size_t first, size_t num=npos) const noexcept
+    {
+        C4_ASSERT(first <= len);
+        const size_t rnum = num != npos ? num : len - first;
+        C4_ASSERT(first + rnum <= len || num == 0);
+        return offset_substr(static_cast<I>(offset + first), static_cast<I>(rnum));
+    }
+
+    /** return [first,last[ */
+    offset_substr range(size_t first, size_t last=npos) const noexcept
+    {
+        C4_ASSERT(first <= len);
+        last = last != npos ? last : len;
+        C4_ASSERT(first <= last && last <= len);
+        return offset_substr(static_cast<I>(offset + first), static_cast<I>(last - first));
+    }
+
+    /** return [0,num[ */
+    offset_substr first(size_t num) const noexcept
+    {
+        return sub(0, num);
+    }
+
+    /** return [len-num,len[ */
+    offset_substr last(size_t num) const noexcept
+    {
+        C4_ASSERT(num <= len);
+        return sub(len - num);
+    }
+
+    /** return [left,len-right[ */
+    offset_substr offs(size_t left, size_t right) const noexcept
+    {
+        C4_ASSERT(left <= len && right <= len && left + right <= len);
+        return offset_substr(static_cast<I>(offset + left), static_cast<I>(len - right - left));
+    }
+
+};
+
+} // namespace c4
+
+#endif /* _C4_OFFSET_SUBSTR_HPP_ */
@@ -0,0 +1,208 @@
+#ifndef _C4_PARSE_LINES_HPP_
+#define _C4_PARSE_LINES_HPP_
+
+/** @file parse_lines.hpp Read newline-delimited values from a buffer
+ * into an array, optionally in parallel. */
+
+#include "c4/config.hpp"
+#include "c4/substr.hpp"
+#include "c4/span.hpp"
+#include "c4/charconv.hpp"
+#include "c4/thread_pool.hpp"
+
+#include <string.h>
+
+namespace c4 {
+
+/** the result of parse_lines() and parse_lines_parallel()
+ * @ingroup generic_tofrom_chars */
+struct parse_lines_result
+{
+    enum : size_t { npos = (size_t)-1 };
+
+    size_t num_lines;  ///< the number of lines in the buffer
+    size_t num_parsed; ///< the number of values written to the output: zero when the output is too small
+    size_t error_line; ///< the zero-based index of the first line which could not be parsed, or npos
+
+    bool ok() const { return error_line == npos && num_parsed == num_lines; }
+};
+
+
+namespace detail {
+
+inline size_t count_lines(csubstr buf)
+{
+    size_t num = 0;
+    const char *C4_RESTRICT pos = buf.str;
+    const char *C4_RESTRICT end = buf.str + buf.len;
+    while(pos < end)
+    {
+        const char *nl = static_cast<const char*>(memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        if( ! nl)
+            return num + 1; // the last line has no newline
+        ++num;
+        pos = nl + 1;
+    }
+    return num;
+}
+
+/** parse each line into consecutive positions of @p out, which must
+ * have room for all of them. Stops at the first error.
+ * @return the index of the line which failed (counting from
+ * first_line), or npos */
+template<class T>
+size_t parse_lines(csubstr buf, T *C4_RESTRICT out, size_t first_line)
+{
+    size_t line = first_line;
+    const char *pos = buf.str;
+    const char *end = buf.str + buf.len;
+    while(pos < end)
+    {
+        const char *nl = static_cast<const char*>(memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        csubstr val = csubstr(pos, nl ? nl : end).trim(" \t\r");
+        if(C4_UNLIKELY(val.empty() || from_chars_first(val, out) != val.len))
+            return line;
+        ++out;
+        ++line;
+        if( ! nl)
+            break;
+        pos = nl + 1;
+    }
+    return csubstr::npos;
+}
+
+} // namespace detail
+
+
+/** count the lines in a buffer. A final newline does not start a new
+ * line.
+ * @ingroup generic_tofrom_chars */
+inline size_t count_lines(csubstr buf)
+{
+    return detail::count_lines(buf);
+}
+
+
+/** read one value per line with from_chars_first(), storing the
+ * values in consecutive positions of @p out. Leading and trailing
+ * whitespace (including a carriage return) is ignored; a final newline
+ * does not start a new line. Lines which are empty or not fully
+ * consumed by the conversion are an error.
+ *
+ * When @p out is smaller than the number of lines, nothing is written
+ * and num_parsed is zero; the caller can then resize the output to
+ * num_lines and call again.
+ *
+ * @see parse_lines_parallel()
+ * @ingroup generic_tofrom_chars */
+template<class T, class I>
+parse_lines_result parse_lines(csubstr buf, span<T, I> out)
+{
+    parse_lines_result r;
+    r.num_lines = detail::count_lines(buf);
+    r.num_parsed = 0;
+    r.error_line = parse_lines_result::npos;
+    if(r.num_lines > static_cast<size_t>(out.size()))
+        return r;
+    r.error_line = detail::parse_lines(buf, out.data(), 0);
+    r.num_parsed = r.error_line == parse_lines_result::npos ? r.num_lines : r.error_line;
+    return r;
+}
+
+
+/** same as parse_lines(), but using the threads of @p pool. The buffer
+ * is split at newlines into chunks of roughly equal size; the lines in
+ * each chunk are counted in parallel to find where each chunk's values
+ * go in the output, and then the chunks are parsed in parallel.
+ *
+ * When there is an error, num_parsed is the number of values up to the
+ * first failing line, but values after it may also have been written.
+ *
+ * @param min_chunk_size buffers shorter than this are parsed in the
+ * calling thread; larger ones are split in chunks of at least this size
+ * @ingroup generic_tofrom_chars */
+template<class T, class I>
+parse_lines_result parse_lines_parallel(csubstr buf, span<T, I> out, thread_pool &pool=get_thread_pool(), size_t min_chunk_size=size_t(1) << 18)
+{
+    enum : size_t { max_chunks = 256 };
+    struct chunk
+    {
+        csubstr buf;
+        size_t first_line;
+        size_t num_lines;
+        size_t error_line;
+    };
+
+    size_t num_chunks = 4u * pool.num_threads();
+    if(num_chunks > max_chunks)
+        num_chunks = max_chunks;
+    if(min_chunk_size == 0)
+        min_chunk_size = 1;
+    if(num_chunks > buf.len / min_chunk_size)
+        num_chunks = buf.len / min_chunk_size;
+    if(num_chunks <= 1)
+        return parse_lines(buf, out);
+
+    // split at the newline after each nominal boundary
+    chunk chunks[max_chunks];
+    size_t n = 0;
+    const char *pos = buf.str;
+    const char *end = buf.str + buf.len;
+    for(size_t i = 1; i <= num_chunks && pos < end; ++i)
+    {
+        const char *chunk_end = end;
+        if(i < num_chunks)
+        {
+            const char *nominal = buf.str + i * (buf.len / num_chunks);
+            if(nominal < pos)
+                nominal = pos;
+            const char *nl = static_cast<const char*>(memchr(nominal, '\n', static_cast<size_t>(end - nominal)));
+            chunk_end = nl ? nl + 1 : end;
+        }
+        chunks[n].buf = csubstr(pos, chunk_end);
+        chunks[n].first_line = 0;
+        chunks[n].num_lines = 0;
+        chunks[n].error_line = csubstr::npos;
+        ++n;
+        pos = chunk_end;
+    }
+
+    span<chunk> cs(chunks, n);
+    pool.parallel_for(cs, 1, [](span<chunk> s){
+        for(chunk &c : s)
+            c.num_lines = detail::count_lines(c.buf);
+    });
+
+    parse_lines_result r;
+    r.num_lines = 0;
+    for(chunk &c : cs)
+    {
+        c.first_line = r.num_lines;
+        r.num_lines += c.num_lines;
+    }
+    r.num_parsed = 0;
+    r.error_line = parse_lines_result::npos;
+    if(r.num_lines > static_cast<size_t>(out.size()))
+        return r;
+
+    T *data = out.data();
+    pool.parallel_for(cs, 1, [data](span<chunk> s){
+        for(chunk &c : s)
+            c.error_line = detail::parse_lines(c.buf, data + c.first_line, c.first_line);
+    });
+
+    for(chunk const& c : cs)
+    {
+        if(c.error_line != csubstr::npos)
+        {
+            r.error_line = c.error_line;
+            break;
+        }
+    }
+    r.num_parsed = r.error_line == parse_lines_result::npos ? r.num_lines : r.error_line;
+    return r;
+}
+
+} // namespace c4
+
+#endif /* _C4_PARSE_LINES_HPP_ */
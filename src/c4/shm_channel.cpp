@@ -0,0 +1,473 @@
+#include "c4/shm_channel.hpp"
+
+#include <atomic>
+#include <new>
+#include <string.h>
+
+#if defined(C4_POSIX) || defined(C4_MACOS) || defined(C4_IOS)
+#   define C4_SHM_CHANNEL_POSIX
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <sched.h>
+#   include <stdio.h>
+#   include <time.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   if defined(__linux__)
+#       include <sys/syscall.h>
+#       include <linux/futex.h>
+#       define C4_SHM_CHANNEL_FUTEX
+#   endif
+#endif
+
+namespace c4 {
+
+/** the channel state, placed at the start of the shared mapping. The
+ * producer and consumer positions are monotonically increasing byte
+ * counts, kept in separate cache lines. */
+struct shm_channel::header_type
+{
+    uint64_t magic;
+    uint64_t capacity;
+
+    /** bytes committed by the producer */
+    alignas(64) std::atomic<uint64_t> head;
+    /** incremented to wake a consumer waiting for data */
+    std::atomic<uint32_t> data_seq;
+    std::atomic<uint32_t> consumer_waiting;
+
+    /** bytes released by the consumer */
+    alignas(64) std::atomic<uint64_t> tail;
+    /** incremented to wake a producer waiting for space */
+    std::atomic<uint32_t> space_seq;
+    std::atomic<uint32_t> producer_waiting;
+};
+
+namespace {
+
+constexpr const uint64_t shm_channel_magic = UINT64_C(0x6c6e6e6168636334); // "4cchannl"
+constexpr const uint32_t frame_wrap = UINT32_C(0xffffffff);
+constexpr const size_t frame_header_size = 8;
+
+C4_ALWAYS_INLINE size_t frame_size(size_t len)
+{
+    return frame_header_size + ((len + 7u) & ~size_t(7u));
+}
+
+size_t header_map_size()
+{
+#ifdef C4_SHM_CHANNEL_POSIX
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+#else
+    size_t page = 4096;
+#endif
+    return (sizeof(shm_channel::header_type) + page - 1) & ~(page - 1);
+}
+
+/** @return the absolute monotonic deadline, in nanoseconds, or -1 for none */
+int64_t deadline_ns(int64_t timeout_ns)
+{
+    if(timeout_ns < 0) return -1;
+#ifdef C4_SHM_CHANNEL_POSIX
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * INT64_C(1000000000) + int64_t(ts.tv_nsec) + timeout_ns;
+#else
+    return timeout_ns;
+#endif
+}
+
+/** @return the time remaining to the deadline, -1 if there is no
+ * deadline, or 0 if the deadline has passed */
+int64_t remaining_ns(int64_t deadline)
+{
+    if(deadline < 0) return -1;
+#ifdef C4_SHM_CHANNEL_POSIX
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t now = int64_t(ts.tv_sec) * INT64_C(1000000000) + int64_t(ts.tv_nsec);
+    return deadline > now ? deadline - now : 0;
+#else
+    return 0;
+#endif
+}
+
+/** block while the word has the expected value, or until the timeout
+ * expires. Spurious returns are allowed. */
+void wait_on(std::atomic<uint32_t> *word, uint32_t expected, int64_t timeout_ns)
+{
+#if defined(C4_SHM_CHANNEL_FUTEX)
+    struct timespec ts, *pts = nullptr;
+    if(timeout_ns >= 0)
+    {
+        ts.tv_sec = static_cast<time_t>(timeout_ns / INT64_C(1000000000));
+        ts.tv_nsec = static_cast<long>(timeout_ns % INT64_C(1000000000));
+        pts = &ts;
+    }
+    // not FUTEX_PRIVATE_FLAG: the word is shared between processes
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, pts, nullptr, 0);
+#elif defined(C4_SHM_CHANNEL_POSIX)
+    C4_UNUSED(timeout_ns);
+    if(word->load(std::memory_order_acquire) == expected)
+    {
+        ::sched_yield();
+    }
+#else
+    C4_UNUSED(word);
+    C4_UNUSED(expected);
+    C4_UNUSED(timeout_ns);
+#endif
+}
+
+void wake_one(std::atomic<uint32_t> *word)
+{
+    word->fetch_add(1, std::memory_order_release);
+#if defined(C4_SHM_CHANNEL_FUTEX)
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+void shm_channel::create(size_t capacity)
+{
+    C4_CHECK(capacity >= 2 * frame_size(0));
+    size_t cap = 1;
+    while(cap < capacity)
+    {
+        cap <<= 1;
+    }
+    close();
+#ifdef C4_SHM_CHANNEL_POSIX
+    int fd = -1;
+#   if defined(__linux__) && defined(SYS_memfd_create)
+    fd = static_cast<int>(::syscall(SYS_memfd_create, "c4_shm_channel", 0));
+#   endif
+    if(fd < 0)
+    {
+        // no memfd: use a named object, and unlink it right away
+        char name[64];
+        for(int attempt = 0; fd < 0 && attempt < 64; ++attempt)
+        {
+            ::snprintf(name, sizeof(name), "/c4_shm_channel_%d_%d", (int)::getpid(), attempt);
+            fd = ::shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0600);
+        }
+        C4_CHECK_MSG(fd >= 0, "could not create shared memory object: %s", ::strerror(errno));
+        ::shm_unlink(name);
+    }
+    int ret = ::ftruncate(fd, static_cast<off_t>(header_map_size() + cap));
+    C4_CHECK_MSG(ret == 0, "could not size shared memory object: %s", ::strerror(errno));
+    m_owns_fd = true;
+    _map(fd, /*init*/true, cap);
+#else
+    C4_UNUSED(cap);
+    C4_ERROR("shm_channel is not implemented for this platform");
+#endif
+}
+
+void shm_channel::open(int fd)
+{
+    C4_CHECK(fd >= 0);
+    close();
+    m_owns_fd = false;
+    _map(fd, /*init*/false, 0);
+}
+
+void shm_channel::_map(int fd, bool init, size_t capacity)
+{
+#ifdef C4_SHM_CHANNEL_POSIX
+    const size_t hsz = header_map_size();
+    if( ! init)
+    {
+        struct stat st;
+        int ret = ::fstat(fd, &st);
+        C4_CHECK_MSG(ret == 0, "could not stat shared memory object: %s", ::strerror(errno));
+        C4_CHECK_MSG(size_t(st.st_size) > hsz, "not a shm_channel");
+        capacity = size_t(st.st_size) - hsz;
+    }
+    void *mem = ::mmap(nullptr, hsz + capacity, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    C4_CHECK_MSG(mem != MAP_FAILED, "could not map shared memory object: %s", ::strerror(errno));
+    m_fd = fd;
+    m_map_size = hsz + capacity;
+    m_ring = static_cast<char*>(mem) + hsz;
+    if(init)
+    {
+        m_hdr = new (mem) header_type;
+        m_hdr->magic = shm_channel_magic;
+        m_hdr->capacity = capacity;
+        m_hdr->head.store(0, std::memory_order_relaxed);
+        m_hdr->data_seq.store(0, std::memory_order_relaxed);
+        m_hdr->consumer_waiting.store(0, std::memory_order_relaxed);
+        m_hdr->tail.store(0, std::memory_order_relaxed);
+        m_hdr->space_seq.store(0, std::memory_order_relaxed);
+        m_hdr->producer_waiting.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    else
+    {
+        m_hdr = static_cast<header_type*>(mem);
+        C4_CHECK_MSG(m_hdr->magic == shm_channel_magic, "not a shm_channel");
+        C4_CHECK_MSG(m_hdr->capacity == capacity, "inconsistent shm_channel capacity");
+    }
+#else
+    C4_UNUSED(fd);
+    C4_UNUSED(init);
+    C4_UNUSED(capacity);
+    C4_ERROR("shm_channel is not implemented for this platform");
+#endif
+}
+
+void shm_channel::close()
+{
+#ifdef C4_SHM_CHANNEL_POSIX
+    if(m_hdr)
+    {
+        ::munmap(m_hdr, m_map_size);
+    }
+    if(m_owns_fd && m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+#endif
+    m_hdr = nullptr;
+    m_ring = nullptr;
+    m_map_size = 0;
+    m_fd = -1;
+    m_owns_fd = false;
+    m_prepared = no_frame;
+    m_skip = 0;
+    m_received = 0;
+}
+
+void shm_channel::_move(shm_channel *that)
+{
+    m_hdr = that->m_hdr;
+    m_ring = that->m_ring;
+    m_map_size = that->m_map_size;
+    m_fd = that->m_fd;
+    m_owns_fd = that->m_owns_fd;
+    m_prepared = that->m_prepared;
+    m_skip = that->m_skip;
+    m_received = that->m_received;
+    that->m_hdr = nullptr;
+    that->m_ring = nullptr;
+    that->m_map_size = 0;
+    that->m_fd = -1;
+    that->m_owns_fd = false;
+    that->m_prepared = no_frame;
+}
+
+size_t shm_channel::capacity() const
+{
+    C4_ASSERT(m_hdr);
+    return static_cast<size_t>(m_hdr->capacity);
+}
+
+size_t shm_channel::max_frame_size() const
+{
+    // frame_wrap is not a valid length
+    const size_t half = capacity() / 2 - frame_header_size;
+    const size_t limit = static_cast<size_t>(frame_wrap - 1u) & ~size_t(7u);
+    return half < limit ? half : limit;
+}
+
+
+//-----------------------------------------------------------------------------
+
+bool shm_channel::_has_space(size_t len)
+{
+    const uint64_t cap = m_hdr->capacity;
+    const uint64_t head = m_hdr->head.load(std::memory_order_relaxed); // only the producer writes it
+    const uint64_t tail = m_hdr->tail.load(std::memory_order_acquire);
+    const uint64_t contiguous = cap - (head & (cap - 1));
+    const uint64_t need = frame_size(len);
+    const uint64_t skip = contiguous < need ? contiguous : 0;
+    C4_ASSERT(head - tail <= cap);
+    if(cap - (head - tail) < skip + need)
+    {
+        return false;
+    }
+    m_skip = static_cast<size_t>(skip);
+    return true;
+}
+
+substr shm_channel::prepare(size_t len)
+{
+    C4_ASSERT(m_hdr);
+    C4_CHECK_MSG(len <= max_frame_size(), "frame too large: %zu > %zu", len, max_frame_size());
+    if( ! _has_space(len))
+    {
+        m_prepared = no_frame;
+        m_skip = 0;
+        return {};
+    }
+    const uint64_t head = m_hdr->head.load(std::memory_order_relaxed);
+    const size_t pos = m_skip ? 0 : static_cast<size_t>(head & (m_hdr->capacity - 1));
+    m_prepared = len;
+    return substr(m_ring + pos + frame_header_size, len);
+}
+
+void shm_channel::commit(size_t len)
+{
+    C4_ASSERT(m_hdr);
+    if(C4_UNLIKELY(m_prepared == no_frame))
+    {
+        C4_ERROR("commit() without a successful prepare()");
+        return;
+    }
+    C4_CHECK(len <= m_prepared);
+    const uint64_t head = m_hdr->head.load(std::memory_order_relaxed);
+    size_t pos = static_cast<size_t>(head & (m_hdr->capacity - 1));
+    if(m_skip)
+    {
+        uint32_t wrap = frame_wrap;
+        memcpy(m_ring + pos, &wrap, sizeof(wrap));
+        pos = 0;
+    }
+    uint32_t len32 = static_cast<uint32_t>(len);
+    memcpy(m_ring + pos, &len32, sizeof(len32));
+    m_hdr->head.store(head + m_skip + frame_size(len), std::memory_order_release);
+    m_prepared = no_frame;
+    m_skip = 0;
+    // pairs with the fence in _wait_data()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_hdr->consumer_waiting.load(std::memory_order_relaxed))
+    {
+        wake_one(&m_hdr->data_seq);
+    }
+}
+
+bool shm_channel::try_send(cblob frame)
+{
+    substr buf = prepare(frame.len);
+    if(buf.str == nullptr) return false;
+    if(frame.len) memcpy(buf.str, frame.buf, frame.len);
+    commit(frame.len);
+    return true;
+}
+
+bool shm_channel::send(cblob frame, int64_t timeout_ns)
+{
+    const int64_t deadline = deadline_ns(timeout_ns);
+    while( ! try_send(frame))
+    {
+        if( ! _wait_space(frame.len, remaining_ns(deadline)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool shm_channel::_wait_space(size_t len, int64_t timeout_ns)
+{
+    if(timeout_ns == 0) return false;
+    const uint32_t seq = m_hdr->space_seq.load(std::memory_order_acquire);
+    m_hdr->producer_waiting.store(1, std::memory_order_relaxed);
+    // pairs with the fence in pop()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if( ! _has_space(len))
+    {
+        wait_on(&m_hdr->space_seq, seq, timeout_ns);
+    }
+    m_hdr->producer_waiting.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+bool shm_channel::_peek(cblob *frame)
+{
+    C4_ASSERT(m_hdr);
+    const uint64_t cap = m_hdr->capacity;
+    const uint64_t tail = m_hdr->tail.load(std::memory_order_relaxed); // only the consumer writes it
+    const uint64_t head = m_hdr->head.load(std::memory_order_acquire);
+    uint64_t pos = tail;
+    while(pos != head)
+    {
+        C4_ASSERT(head - pos <= cap);
+        const size_t offs = static_cast<size_t>(pos & (cap - 1));
+        uint32_t len;
+        memcpy(&len, m_ring + offs, sizeof(len));
+        if(len == frame_wrap)
+        {
+            pos += cap - offs;
+            continue;
+        }
+        *frame = cblob(m_ring + offs + frame_header_size, size_t(len));
+        m_received = static_cast<size_t>(pos - tail) + frame_size(len);
+        return true;
+    }
+    return false;
+}
+
+bool shm_channel::try_recv(cblob *frame)
+{
+    return _peek(frame);
+}
+
+bool shm_channel::try_recv(csubstr *frame)
+{
+    cblob b;
+    if( ! _peek(&b)) return false;
+    *frame = csubstr(reinterpret_cast<const char*>(b.buf), b.len);
+    return true;
+}
+
+bool shm_channel::recv(cblob *frame, int64_t timeout_ns)
+{
+    const int64_t deadline = deadline_ns(timeout_ns);
+    while( ! _peek(frame))
+    {
+        if( ! _wait_data(remaining_ns(deadline)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool shm_channel::recv(csubstr *frame, int64_t timeout_ns)
+{
+    cblob b;
+    if( ! recv(&b, timeout_ns)) return false;
+    *frame = csubstr(reinterpret_cast<const char*>(b.buf), b.len);
+    return true;
+}
+
+bool shm_channel::_wait_data(int64_t timeout_ns)
+{
+    if(timeout_ns == 0) return false;
+    const uint32_t seq = m_hdr->data_seq.load(std::memory_order_acquire);
+    m_hdr->consumer_waiting.store(1, std::memory_order_relaxed);
+    // pairs with the fence in commit()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_hdr->head.load(std::memory_order_acquire) == m_hdr->tail.load(std::memory_order_relaxed))
+    {
+        wait_on(&m_hdr->data_seq, seq, timeout_ns);
+    }
+    m_hdr->consumer_waiting.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+void shm_channel::pop()
+{
+    C4_ASSERT(m_hdr);
+    C4_CHECK_MSG(m_received > 0, "no frame was received");
+    const uint64_t tail = m_hdr->tail.load(std::memory_order_relaxed);
+    m_hdr->tail.store(tail + m_received, std::memory_order_release);
+    m_received = 0;
+    // pairs with the fence in _wait_space()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_hdr->producer_waiting.load(std::memory_order_relaxed))
+    {
+        wake_one(&m_hdr->space_seq);
+    }
+}
+
+} // namespace c4
@@ -0,0 +1,188 @@
+#ifndef _C4_SHM_CHANNEL_HPP_
+#define _C4_SHM_CHANNEL_HPP_
+
+/** @file shm_channel.hpp A single-producer single-consumer channel for
+ * passing length-prefixed binary frames between processes through shared
+ * memory. */
+
+#include "c4/config.hpp"
+#include "c4/error.hpp"
+#include "c4/blob.hpp"
+#include "c4/substr.hpp"
+#include "c4/format.hpp"
+
+namespace c4 {
+
+/** @defgroup ipc Inter-process communication */
+
+/** A single-producer single-consumer ring of length-prefixed frames,
+ * living in a shared memory mapping (memfd_create() when available,
+ * otherwise an unlinked shm_open() object). The mapping is identified
+ * by a file descriptor, which can be inherited by a forked process or
+ * sent over a unix socket; the other end then calls open() with it.
+ *
+ * Frames are written in place: the producer obtains a writable view of
+ * the ring with prepare(), fills it (eg with cat() or fmt::raw()) and
+ * then calls commit(). The consumer obtains a read-only view of the
+ * oldest committed frame with try_recv()/recv() and releases it
+ * with pop(); no copies are made on either side. When the ring is
+ * empty (or full), recv() (or send()) waits on a futex (Linux) or
+ * yields the processor (other platforms).
+ *
+ * Each frame is stored as a 8-byte header (the 32 bit frame length
+ * plus padding) followed by the payload, and starts at an 8-byte
+ * boundary. A frame never wraps around the end of the ring; when the
+ * contiguous space is insufficient, the producer skips to the ring's
+ * start. For this reason the maximum frame size is half of the ring
+ * capacity, minus the frame header.
+ *
+ * @warning Only one process (or thread) may act as the producer, and
+ * only one as the consumer.
+ * @ingroup ipc */
+class shm_channel
+{
+public:
+
+    struct header_type;
+
+public:
+
+    shm_channel() : m_hdr(nullptr), m_ring(nullptr), m_map_size(0), m_fd(-1), m_owns_fd(false), m_prepared(no_frame), m_skip(0), m_received(0) {}
+    ~shm_channel() { close(); }
+
+    /** create a new channel with the given ring capacity, which is rounded
+     * up to a power of two */
+    explicit shm_channel(size_t capacity) : shm_channel() { create(capacity); }
+
+    shm_channel(shm_channel const&) = delete;
+    shm_channel& operator= (shm_channel const&) = delete;
+
+    shm_channel(shm_channel && that) : shm_channel() { _move(&that); }
+    shm_channel& operator= (shm_channel && that) { close(); _move(&that); return *this; }
+
+public:
+
+    /** create a new shared memory object and map it. The ring
+     * capacity is rounded up to a power of two. */
+    void create(size_t capacity);
+    /** map an existing channel from its file descriptor. The
+     * descriptor is not closed by this object.
+     * @see fd() */
+    void open(int fd);
+    /** unmap the channel, and close its file descriptor if it was
+     * created by this object */
+    void close();
+
+    bool valid() const { return m_hdr != nullptr; }
+    int fd() const { return m_fd; }
+
+    /** the capacity of the ring, in bytes */
+    size_t capacity() const;
+    /** the largest payload accepted by a frame: half the capacity
+     * minus the frame header, and less than 4GiB, as the frame
+     * lengths are stored in 32 bits */
+    size_t max_frame_size() const;
+
+public:
+
+    /** @name producer side */
+    /** @{ */
+
+    /** obtain a writable view of the ring for a frame of up to @p len
+     * bytes, without waiting. The returned view has size @p len, or is
+     * null when there is not enough free space in the ring. After writing
+     * the frame, call commit(). */
+    substr prepare(size_t len);
+    /** publish the frame obtained with prepare(), trimmed to its first
+     * @p len bytes. Wakes a waiting consumer. It is an error to call
+     * this without a successful prepare(). */
+    void commit(size_t len);
+
+    /** copy a frame into the ring and publish it.
+     * @return false if there was not enough free space */
+    bool try_send(cblob frame);
+    /** @overload try_send */
+    bool try_send(csubstr frame) { return try_send(cblob(frame.str, frame.len)); }
+    /** @overload try_send */
+    bool try_send(substr frame) { return try_send(cblob(frame.str, frame.len)); }
+    /** copy a frame into the ring and publish it, waiting for free space
+     * if needed.
+     * @param timeout_ns the maximum waiting time; negative to wait forever
+     * @return false on timeout */
+    bool send(cblob frame, int64_t timeout_ns=-1);
+    /** @overload send */
+    bool send(csubstr frame, int64_t timeout_ns=-1) { return send(cblob(frame.str, frame.len), timeout_ns); }
+    /** @overload send */
+    bool send(substr frame, int64_t timeout_ns=-1) { return send(cblob(frame.str, frame.len), timeout_ns); }
+
+    /** serialize the arguments with cat() directly into the ring,
+     * publishing them as a single frame.
+     * @return false if there was not enough free space */
+    template<class... Args>
+    bool try_send_cat(Args const& C4_RESTRICT ...args)
+    {
+        size_t len = cat(substr{}, args...);
+        substr buf = prepare(len);
+        if(buf.str == nullptr) return false;
+        len = cat(buf, args...);
+        C4_CHECK(len <= buf.len);
+        commit(len);
+        return true;
+    }
+
+    /** @} */
+
+public:
+
+    /** @name consumer side */
+    /** @{ */
+
+    /** get a read-only view of the oldest committed frame, without
+     * waiting. The view remains valid until pop() is called.
+     * @return false if the ring is empty */
+    bool try_recv(cblob *frame);
+    /** @overload try_recv */
+    bool try_recv(csubstr *frame);
+
+    /** get a read-only view of the oldest committed frame, waiting for
+     * one if the ring is empty. The view remains valid until pop() is
+     * called.
+     * @param timeout_ns the maximum waiting time; negative to wait forever
+     * @return false on timeout */
+    bool recv(cblob *frame, int64_t timeout_ns=-1);
+    /** @overload recv */
+    bool recv(csubstr *frame, int64_t timeout_ns=-1);
+
+    /** release the frame obtained with try_recv()/recv(), making its
+     * space available to the producer. Wakes a waiting producer. */
+    void pop();
+
+    /** @} */
+
+private:
+
+    enum : size_t { no_frame = (size_t)-1 };
+
+    void _map(int fd, bool init, size_t capacity);
+    void _move(shm_channel *that);
+    bool _peek(cblob *frame);
+    bool _has_space(size_t len);
+    bool _wait_data(int64_t timeout_ns);
+    bool _wait_space(size_t len, int64_t timeout_ns);
+
+private:
+
+    header_type *m_hdr;
+    char        *m_ring;
+    size_t       m_map_size;
+    int          m_fd;
+    bool         m_owns_fd;
+    size_t       m_prepared; ///< the size of the frame currently prepared by the producer, or no_frame
+    size_t       m_skip;     ///< the bytes skipped at the ring's end by the prepared frame
+    size_t       m_received; ///< the full size (header and padding) of the frame currently held by the consumer
+
+};
+
+} // namespace c4
+
+#endif /* _C4_SHM_CHANNEL_HPP_ */
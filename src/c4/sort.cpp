@@ -0,0 +1,224 @@
+#include "c4/sort.hpp"
+
+#include <utility>
+
+namespace c4 {
+
+namespace {
+
+/** a string with the 8 bytes at the current depth, big-endian, so that
+ * comparing the keys as integers compares those bytes in dictionary
+ * order */
+struct sort_item
+{
+    uint64_t key;
+    const char *str;
+    size_t len;
+};
+
+enum : size_t {
+    string_insertion_threshold = 12,
+    string_parallel_threshold = 1u << 14,
+};
+
+C4_ALWAYS_INLINE uint64_t string_key(const char *str, size_t len, size_t depth) noexcept
+{
+    uint64_t k = 0;
+    if(len >= depth + 8)
+        memcpy(&k, str + depth, 8);
+    else if(len > depth)
+        memcpy(&k, str + depth, len - depth); // zero-padded
+    return detail::bswap_if(detail::swap_be(), k);
+}
+
+/** the number of bytes in the key, where 9 flags the strings
+ * continuing after it. Two strings are ordered by the key and then by
+ * this, eg "ab" < "ab\0", which have the same key. */
+C4_ALWAYS_INLINE size_t key_len(size_t len, size_t depth) noexcept
+{
+    return len <= depth ? 0u : (len - depth < 9u ? len - depth : 9u);
+}
+
+C4_ALWAYS_INLINE int compare_items(sort_item const& a, uint64_t bkey, size_t blc, size_t depth) noexcept
+{
+    if(a.key != bkey)
+        return a.key < bkey ? -1 : 1;
+    const size_t alc = key_len(a.len, depth);
+    return alc < blc ? -1 : (alc > blc ? 1 : 0);
+}
+
+bool item_less(sort_item const& a, sort_item const& b, size_t depth) noexcept
+{
+    if(a.key != b.key)
+        return a.key < b.key;
+    const size_t alc = key_len(a.len, depth);
+    const size_t blc = key_len(b.len, depth);
+    if(alc != 9u || blc != 9u)
+        return alc < blc;
+    // same 8 bytes, and both continue: compare the rest
+    const size_t pos = depth + 8;
+    const size_t num = (a.len < b.len ? a.len : b.len) - pos;
+    const int cmp = memcmp(a.str + pos, b.str + pos, num);
+    return cmp != 0 ? cmp < 0 : a.len < b.len;
+}
+
+void insertion_sort(sort_item *C4_RESTRICT items, size_t num, size_t depth) noexcept
+{
+    for(size_t i = 1; i < num; ++i)
+    {
+        const sort_item v = items[i];
+        size_t j = i;
+        for( ; j > 0 && item_less(v, items[j - 1], depth); --j)
+            items[j] = items[j - 1];
+        items[j] = v;
+    }
+}
+
+void load_keys(sort_item *C4_RESTRICT items, size_t num, size_t depth) noexcept
+{
+    for(size_t i = 0; i < num; ++i)
+        items[i].key = string_key(items[i].str, items[i].len, depth);
+}
+
+/** multikey quicksort of items whose keys were loaded at depth. Of the
+ * three partitions, the two smaller are sorted recursively and the
+ * largest in the loop, so that the recursion is at most log2(num)
+ * deep, even for long common prefixes. */
+void mkqs(sort_item *C4_RESTRICT items, size_t num, size_t depth) noexcept
+{
+    while(num > string_insertion_threshold)
+    {
+        // the median of three
+        sort_item const* C4_RESTRICT a = &items[0];
+        sort_item const* C4_RESTRICT b = &items[num / 2];
+        sort_item const* C4_RESTRICT c = &items[num - 1];
+        const size_t alc = key_len(a->len, depth), blc = key_len(b->len, depth), clc = key_len(c->len, depth);
+        auto lt = [&](sort_item const* x, size_t xlc, sort_item const* y, size_t ylc){
+            return x->key < y->key || (x->key == y->key && xlc < ylc);
+        };
+        sort_item const* p;
+        size_t plc;
+        if(lt(a, alc, b, blc))
+        {
+            if(lt(b, blc, c, clc)) { p = b; plc = blc; }
+            else if(lt(a, alc, c, clc)) { p = c; plc = clc; }
+            else { p = a; plc = alc; }
+        }
+        else
+        {
+            if(lt(a, alc, c, clc)) { p = a; plc = alc; }
+            else if(lt(b, blc, c, clc)) { p = c; plc = clc; }
+            else { p = b; plc = blc; }
+        }
+        const uint64_t pkey = p->key;
+        // three-way partition: [0,l[ < [l,g[ == [g,num[ >
+        size_t l = 0, i = 0, g = num;
+        while(i < g)
+        {
+            const int cmp = compare_items(items[i], pkey, plc, depth);
+            if(cmp < 0)
+                std::swap(items[l++], items[i++]);
+            else if(cmp > 0)
+                std::swap(items[i], items[--g]);
+            else
+                ++i;
+        }
+        struct part { sort_item *items; size_t num, depth; };
+        part parts[3] = {
+            {items, l, depth},
+            {items + l, g - l, depth + 8},
+            {items + g, num - g, depth},
+        };
+        if(plc != 9u) // the equal strings are done
+            parts[1].num = 0;
+        size_t largest = 0;
+        for(size_t k = 1; k < 3; ++k)
+            if(parts[k].num > parts[largest].num)
+                largest = k;
+        for(size_t k = 0; k < 3; ++k)
+        {
+            if(k == largest || parts[k].num < 2)
+                continue;
+            if(k == 1)
+                load_keys(parts[k].items, parts[k].num, parts[k].depth);
+            mkqs(parts[k].items, parts[k].num, parts[k].depth);
+        }
+        if(largest == 1)
+            load_keys(parts[1].items, parts[1].num, parts[1].depth);
+        items = parts[largest].items;
+        num = parts[largest].num;
+        depth = parts[largest].depth;
+    }
+    insertion_sort(items, num, depth);
+}
+
+void load_items(sort_item *C4_RESTRICT items, csubstr const* C4_RESTRICT strs, size_t num) noexcept
+{
+    for(size_t i = 0; i < num; ++i)
+    {
+        items[i].key = string_key(strs[i].str, strs[i].len, 0);
+        items[i].str = strs[i].str;
+        items[i].len = strs[i].len;
+    }
+}
+
+void store_items(csubstr *C4_RESTRICT strs, sort_item const* C4_RESTRICT items, size_t num) noexcept
+{
+    for(size_t i = 0; i < num; ++i)
+        strs[i] = csubstr(items[i].str, items[i].len);
+}
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+void string_sort(span<csubstr> strs)
+{
+    const size_t num = strs.size();
+    if(num < 2)
+        return;
+    detail::sort_buffer<sort_item> items(num);
+    load_items(items.ptr, strs.data(), num);
+    mkqs(items.ptr, num, 0);
+    store_items(strs.data(), items.ptr, num);
+}
+
+void string_sort(thread_pool &pool, span<csubstr> strs)
+{
+    const size_t num = strs.size();
+    if(num < string_parallel_threshold)
+    {
+        string_sort(strs);
+        return;
+    }
+    // distribute the strings to buckets by their first byte, which are
+    // then independent of each other
+    detail::sort_buffer<sort_item> items(num);
+    detail::sort_buffer<sort_item> buckets(num);
+    load_items(items.ptr, strs.data(), num);
+    size_t offsets[257] = {};
+    for(size_t i = 0; i < num; ++i)
+        ++offsets[(items.ptr[i].key >> 56) + 1];
+    for(size_t d = 1; d < 257; ++d)
+        offsets[d] += offsets[d - 1];
+    size_t pos[256];
+    memcpy(pos, offsets, sizeof(pos));
+    for(size_t i = 0; i < num; ++i)
+        buckets.ptr[pos[items.ptr[i].key >> 56]++] = items.ptr[i];
+    size_t ids[256];
+    for(size_t d = 0; d < 256; ++d)
+        ids[d] = d;
+    pool.parallel_for(span<size_t>(ids, 256), 1, [&](span<size_t> s){
+        for(size_t d : s)
+        {
+            sort_item *bucket = buckets.ptr + offsets[d];
+            const size_t bnum = offsets[d + 1] - offsets[d];
+            if(bnum > 1)
+                mkqs(bucket, bnum, 0);
+            store_items(strs.data() + offsets[d], bucket, bnum);
+        }
+    });
+}
+
+} // namespace c4
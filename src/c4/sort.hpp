@@ -0,0 +1,339 @@
+#ifndef _C4_SORT_HPP_
+#define _C4_SORT_HPP_
+
+/** @file sort.hpp Radix sort of numbers, and multikey sort of strings,
+ * over spans, with parallel variants. */
+
+#include "c4/config.hpp"
+#include "c4/bytes.hpp"
+#include "c4/memory_resource.hpp"
+#include "c4/span.hpp"
+#include "c4/substr.hpp"
+#include "c4/thread_pool.hpp"
+
+#include <string.h>
+#include <type_traits>
+#include <vector>
+
+namespace c4 {
+
+/** @defgroup sort Sorting
+ *
+ * radix_sort() sorts integers and reals with a least-significant-digit
+ * radix sort: one pass per byte of the key, each moving all the
+ * elements to a scratch buffer in the order of that byte. It is
+ * stable, makes no comparisons, and skips the bytes which are the same
+ * for all the elements (eg the high bytes of small integers).
+ *
+ * string_sort() sorts strings in dictionary order with a multikey
+ * quicksort (Bentley and Sedgewick, "Fast algorithms for sorting and
+ * searching strings", 1997). Instead of a character, each step
+ * compares the next 8 bytes of the strings, which are loaded once into
+ * an integer cached next to each string; the common prefixes of the
+ * strings are never compared again.
+ *
+ * Both have variants taking a thread_pool, which split the work among
+ * its threads. */
+
+
+//-----------------------------------------------------------------------------
+
+namespace detail {
+
+/** an uninitialized buffer of trivially copyable elements, from aalloc() */
+template<class T>
+struct sort_buffer
+{
+    T *ptr;
+    sort_buffer(size_t num) : ptr(static_cast<T*>(aalloc((num ? num : 1) * sizeof(T), alignof(T)))) {}
+    ~sort_buffer() { afree(ptr); }
+    sort_buffer(sort_buffer const&) = delete;
+    sort_buffer& operator= (sort_buffer const&) = delete;
+};
+
+/** the integers but bool, float and double. long double is excluded,
+ * as it has no unsigned integer of the same size on most platforms. */
+template<class T>
+struct is_radix_key : public std::integral_constant<bool,
+    (std::is_integral<T>::value && ! std::is_same<T, bool>::value)
+    || (std::is_floating_point<T>::value && ! std::is_same<T, long double>::value)>
+{
+};
+
+/** map a key to an unsigned integer with the same order: the sign bit
+ * of signed integers is flipped, and the reals are mapped as in IEEE
+ * 754 totalOrder */
+template<class T>
+C4_ALWAYS_INLINE auto radix_key(T v) noexcept
+    -> typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, bytes_uint_t<T>>::type
+{
+    return static_cast<bytes_uint_t<T>>(v);
+}
+template<class T>
+C4_ALWAYS_INLINE auto radix_key(T v) noexcept
+    -> typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, bytes_uint_t<T>>::type
+{
+    using U = bytes_uint_t<T>;
+    return static_cast<U>(static_cast<U>(v) ^ static_cast<U>(U(1) << (8 * sizeof(T) - 1)));
+}
+template<class T>
+C4_ALWAYS_INLINE auto radix_key(T v) noexcept
+    -> typename std::enable_if<std::is_floating_point<T>::value, bytes_uint_t<T>>::type
+{
+    using U = bytes_uint_t<T>;
+    U u;
+    memcpy(&u, &v, sizeof(T));
+    // negative: flip all the bits; positive: flip the sign bit
+    const U sign = static_cast<U>(U(1) << (8 * sizeof(T) - 1));
+    return static_cast<U>(u ^ (static_cast<U>(U(0) - (u >> (8 * sizeof(T) - 1))) | sign));
+}
+
+/** the inverse of radix_key() */
+template<class T>
+C4_ALWAYS_INLINE auto radix_unkey(bytes_uint_t<T> k) noexcept
+    -> typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, T>::type
+{
+    return static_cast<T>(k);
+}
+template<class T>
+C4_ALWAYS_INLINE auto radix_unkey(bytes_uint_t<T> k) noexcept
+    -> typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, T>::type
+{
+    using U = bytes_uint_t<T>;
+    const U u = static_cast<U>(k ^ static_cast<U>(U(1) << (8 * sizeof(T) - 1)));
+    T v;
+    memcpy(&v, &u, sizeof(T));
+    return v;
+}
+template<class T>
+C4_ALWAYS_INLINE auto radix_unkey(bytes_uint_t<T> k) noexcept
+    -> typename std::enable_if<std::is_floating_point<T>::value, T>::type
+{
+    using U = bytes_uint_t<T>;
+    const U sign = static_cast<U>(U(1) << (8 * sizeof(T) - 1));
+    const U u = static_cast<U>(k ^ ((k & sign) ? sign : static_cast<U>(~U(0))));
+    T v;
+    memcpy(&v, &u, sizeof(T));
+    return v;
+}
+
+template<class T>
+C4_ALWAYS_INLINE size_t radix_digit(T v, size_t pass) noexcept
+{
+    return static_cast<size_t>((radix_key(v) >> (8u * pass)) & 0xffu);
+}
+
+template<class T>
+void radix_insertion_sort(T *C4_RESTRICT vals, size_t num) noexcept
+{
+    for(size_t i = 1; i < num; ++i)
+    {
+        const T v = vals[i];
+        const auto k = radix_key(v);
+        size_t j = i;
+        for( ; j > 0 && radix_key(vals[j - 1]) > k; --j)
+            vals[j] = vals[j - 1];
+        vals[j] = v;
+    }
+}
+
+enum : size_t {
+    radix_insertion_threshold = 64,
+    radix_parallel_threshold = 1u << 16,
+};
+
+template<class T>
+void radix_sort_serial(T *C4_RESTRICT vals, T *C4_RESTRICT scratch, size_t num) noexcept
+{
+    enum : size_t { num_passes = sizeof(T) };
+    if(num < radix_insertion_threshold)
+    {
+        radix_insertion_sort(vals, num);
+        return;
+    }
+    // the histograms of all the passes, in a single read
+    size_t counts[num_passes][256] = {};
+    for(size_t i = 0; i < num; ++i)
+    {
+        const auto k = radix_key(vals[i]);
+        for(size_t p = 0; p < num_passes; ++p)
+            ++counts[p][(k >> (8u * p)) & 0xffu];
+    }
+    T *C4_RESTRICT src = vals;
+    T *C4_RESTRICT dst = scratch;
+    for(size_t p = 0; p < num_passes; ++p)
+    {
+        size_t *C4_RESTRICT offsets = counts[p];
+        if(offsets[radix_digit(src[0], p)] == num) // all the same
+            continue;
+        for(size_t d = 0, sum = 0; d < 256; ++d)
+        {
+            const size_t c = offsets[d];
+            offsets[d] = sum;
+            sum += c;
+        }
+        for(size_t i = 0; i < num; ++i)
+            dst[offsets[radix_digit(src[i], p)]++] = src[i];
+        T *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if(src != vals)
+        memcpy(vals, src, num * sizeof(T));
+}
+
+template<class T>
+void radix_sort_parallel(thread_pool &pool, T *C4_RESTRICT vals, T *C4_RESTRICT scratch, size_t num)
+{
+    enum : size_t { num_passes = sizeof(T) };
+    if(num < radix_parallel_threshold)
+    {
+        radix_sort_serial(vals, scratch, num);
+        return;
+    }
+    // every chunk of the input has its own histogram, and is scattered
+    // to the ranges of the output given by the sums of the histograms
+    // of the digits below, and of the chunks before
+    const size_t num_chunks = 4u * (pool.num_threads() + 1u);
+    const size_t chunk_size = (num + num_chunks - 1) / num_chunks;
+    std::vector<size_t> chunks(num_chunks);
+    for(size_t c = 0; c < num_chunks; ++c)
+        chunks[c] = c;
+    std::vector<size_t> counts(num_chunks * 256);
+    T *src = vals;
+    T *dst = scratch;
+    for(size_t p = 0; p < num_passes; ++p)
+    {
+        pool.parallel_for(span<size_t>(chunks.data(), num_chunks), 1, [&](span<size_t> s){
+            for(size_t c : s)
+            {
+                size_t *C4_RESTRICT cc = &counts[c * 256];
+                memset(cc, 0, 256 * sizeof(size_t));
+                const size_t end = (c + 1) * chunk_size < num ? (c + 1) * chunk_size : num;
+                for(size_t i = c * chunk_size; i < end; ++i)
+                    ++cc[radix_digit(src[i], p)];
+            }
+        });
+        size_t sum = 0;
+        bool same = false;
+        for(size_t d = 0; d < 256; ++d)
+        {
+            const size_t first = sum;
+            for(size_t c = 0; c < num_chunks; ++c)
+            {
+                const size_t cnt = counts[c * 256 + d];
+                counts[c * 256 + d] = sum;
+                sum += cnt;
+            }
+            same = same || (sum - first == num);
+        }
+        if(same)
+            continue;
+        pool.parallel_for(span<size_t>(chunks.data(), num_chunks), 1, [&](span<size_t> s){
+            for(size_t c : s)
+            {
+                size_t *C4_RESTRICT offsets = &counts[c * 256];
+                const size_t end = (c + 1) * chunk_size < num ? (c + 1) * chunk_size : num;
+                for(size_t i = c * chunk_size; i < end; ++i)
+                    dst[offsets[radix_digit(src[i], p)]++] = src[i];
+            }
+        });
+        T *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if(src != vals)
+    {
+        pool.parallel_for(span<size_t>(chunks.data(), num_chunks), 1, [&](span<size_t> s){
+            for(size_t c : s)
+            {
+                const size_t end = (c + 1) * chunk_size < num ? (c + 1) * chunk_size : num;
+                if(c * chunk_size < end)
+                    memcpy(vals + c * chunk_size, src + c * chunk_size, (end - c * chunk_size) * sizeof(T));
+            }
+        });
+    }
+}
+
+} // namespace detail
+
+
+//-----------------------------------------------------------------------------
+
+/** sort integers or reals in ascending order, with a stable radix sort,
+ * using a scratch buffer with room for as many elements. Reals are
+ * sorted as in IEEE 754 totalOrder: -0 before +0, and NaNs at the ends
+ * (according to their sign).
+ * @ingroup sort */
+template<class T>
+void radix_sort(span<T> vals, span<T> scratch) noexcept
+{
+    C4_STATIC_ASSERT_MSG(detail::is_radix_key<T>::value, "radix_sort() needs integers (not bool), float or double");
+    C4_ASSERT(scratch.size() >= vals.size());
+    detail::radix_sort_serial(vals.data(), scratch.data(), vals.size());
+}
+
+/** sort integers or reals in ascending order, allocating the scratch
+ * buffer with aalloc()
+ * @ingroup sort */
+template<class T>
+void radix_sort(span<T> vals)
+{
+    C4_STATIC_ASSERT_MSG(detail::is_radix_key<T>::value, "radix_sort() needs integers (not bool), float or double");
+    if(vals.size() < detail::radix_insertion_threshold)
+    {
+        detail::radix_insertion_sort(vals.data(), vals.size());
+        return;
+    }
+    detail::sort_buffer<T> scratch(vals.size());
+    detail::radix_sort_serial(vals.data(), scratch.ptr, vals.size());
+}
+
+/** sort integers or reals in ascending order, with the threads of a
+ * pool. Each pass is split in chunks, which compute their histograms
+ * and move their elements in parallel.
+ * @ingroup sort */
+template<class T>
+void radix_sort(thread_pool &pool, span<T> vals, span<T> scratch)
+{
+    C4_STATIC_ASSERT_MSG(detail::is_radix_key<T>::value, "radix_sort() needs integers (not bool), float or double");
+    C4_ASSERT(scratch.size() >= vals.size());
+    detail::radix_sort_parallel(pool, vals.data(), scratch.data(), vals.size());
+}
+
+/** @ingroup sort */
+template<class T>
+void radix_sort(thread_pool &pool, span<T> vals)
+{
+    C4_STATIC_ASSERT_MSG(detail::is_radix_key<T>::value, "radix_sort() needs integers (not bool), float or double");
+    if(vals.size() < detail::radix_insertion_threshold)
+    {
+        detail::radix_insertion_sort(vals.data(), vals.size());
+        return;
+    }
+    detail::sort_buffer<T> scratch(vals.size());
+    detail::radix_sort_parallel(pool, vals.data(), scratch.ptr, vals.size());
+}
+
+
+//-----------------------------------------------------------------------------
+
+/** sort strings in dictionary order: the chars are compared as
+ * unsigned bytes, as with memcmp(), and a prefix goes before the longer
+ * strings. This is the order of csubstr::compare() for strings without
+ * zero bytes, which are compared here as any other byte. The sort is
+ * not stable, but equal strings are only distinguishable by their
+ * pointers. A temporary buffer of 24 bytes per string is allocated
+ * with aalloc().
+ * @ingroup sort */
+void string_sort(span<csubstr> strs);
+
+/** sort strings in dictionary order with the threads of a pool: the
+ * strings are first distributed by their first byte, and the resulting
+ * buckets are sorted in parallel.
+ * @ingroup sort */
+void string_sort(thread_pool &pool, span<csubstr> strs);
+
+} // namespace c4
+
+#endif /* _C4_SORT_HPP_ */
@@ -0,0 +1,408 @@
+#include "c4/thread_pool.hpp"
+#include "c4/memory_resource.hpp"
+
+#include <chrono>
+#include <new>
+
+namespace c4 {
+
+namespace {
+thread_local thread_pool const* s_current_pool = nullptr;
+thread_local size_t s_current_worker = thread_pool::npos;
+thread_local uint32_t s_rng = 0;
+
+inline uint32_t _next_random()
+{
+    // xorshift32; seed it from the address of the thread-local
+    uint32_t x = s_rng;
+    if(C4_UNLIKELY(x == 0))
+        x = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&s_rng) >> 4) | 1u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s_rng = x;
+    return x;
+}
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+/** a worker thread and its Chase-Lev deque, with a fixed-size buffer.
+ * @see "Correct and Efficient Work-Stealing for Weak Memory Models",
+ * Lê et al, PPoPP 2013 */
+struct thread_pool::worker
+{
+    alignas(64) std::atomic<int64_t> top;    ///< written by thieves
+    alignas(64) std::atomic<int64_t> bottom; ///< written by the owner
+    std::atomic<task_node*> *buffer;
+    int64_t mask;
+    std::thread thread;
+
+    worker(size_t capacity)
+        : top(0)
+        , bottom(0)
+        , buffer(new std::atomic<task_node*>[capacity])
+        , mask(static_cast<int64_t>(capacity) - 1)
+        , thread()
+    {
+        for(size_t i = 0; i < capacity; ++i)
+            buffer[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~worker()
+    {
+        delete[] buffer;
+    }
+
+    bool has_work() const
+    {
+        return top.load(std::memory_order_relaxed) < bottom.load(std::memory_order_relaxed);
+    }
+
+    /** called only by the owner. Returns false when the deque is full. */
+    bool push(task_node *node)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if(C4_UNLIKELY(b - t > mask))
+            return false;
+        buffer[b & mask].store(node, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** called only by the owner */
+    task_node* pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if(t > b)
+        {
+            // empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        task_node *node = buffer[b & mask].load(std::memory_order_relaxed);
+        if(t == b)
+        {
+            // the last element: race against the thieves
+            if( ! top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                node = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return node;
+    }
+
+    /** called by any thread. May fail spuriously when racing
+     * against other thieves. */
+    task_node* steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if(t >= b)
+            return nullptr;
+        task_node *node = buffer[t & mask].load(std::memory_order_relaxed);
+        if( ! top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return node;
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+
+constexpr const size_t thread_pool::npos;
+
+thread_pool::thread_pool(size_t num_threads, size_t queue_capacity)
+    : m_workers(nullptr)
+    , m_num_workers(num_threads)
+    , m_queue_capacity(2)
+    , m_nodes(nullptr)
+    , m_free_nodes(nullptr)
+    , m_inject_head(nullptr)
+    , m_inject_tail(nullptr)
+    , m_num_injected(0)
+    , m_num_submitted(0)
+    , m_mutex()
+    , m_cv()
+    , m_num_sleeping(0)
+    , m_epoch(0)
+    , m_stop(false)
+{
+    if(m_num_workers == 0)
+    {
+        unsigned hw = std::thread::hardware_concurrency();
+        m_num_workers = hw > 0 ? hw : 1;
+    }
+    while(m_queue_capacity < queue_capacity)
+        m_queue_capacity *= 2;
+
+    m_nodes = new task_node[m_queue_capacity];
+    for(size_t i = 0; i < m_queue_capacity; ++i)
+    {
+        m_nodes[i].pooled = true;
+        m_nodes[i].next = i + 1 < m_queue_capacity ? &m_nodes[i + 1] : nullptr;
+    }
+    m_free_nodes = m_nodes;
+
+    m_workers = static_cast<worker*>(aalloc(m_num_workers * sizeof(worker), alignof(worker)));
+    for(size_t i = 0; i < m_num_workers; ++i)
+        new (m_workers + i) worker(m_queue_capacity);
+    // start the threads only after all the deques are ready
+    for(size_t i = 0; i < m_num_workers; ++i)
+        m_workers[i].thread = std::thread(&thread_pool::_work, this, i);
+}
+
+thread_pool::~thread_pool()
+{
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        ++m_epoch;
+    }
+    m_cv.notify_all();
+    for(size_t i = 0; i < m_num_workers; ++i)
+        m_workers[i].thread.join();
+    for(size_t i = 0; i < m_num_workers; ++i)
+        m_workers[i].~worker();
+    afree(m_workers);
+    delete[] m_nodes;
+}
+
+size_t thread_pool::current_worker() const
+{
+    return s_current_pool == this ? s_current_worker : npos;
+}
+
+
+//-----------------------------------------------------------------------------
+
+void thread_pool::submit(task_type &&fn)
+{
+    C4_CHECK(fn);
+    size_t id = current_worker();
+    unsigned idle = 0;
+    task_node *node = _acquire_node();
+    while(node == nullptr)
+    {
+        // all the nodes are in flight; workers help with them
+        task_node *pending = id != npos ? _find(id) : nullptr;
+        if(pending)
+            _run(pending);
+        else
+            _backoff(&idle);
+        node = _acquire_node();
+    }
+    node->fn = std::move(fn);
+    node->pending = &m_num_submitted;
+    m_num_submitted.fetch_add(1, std::memory_order_relaxed);
+    fork(node);
+}
+
+void thread_pool::wait()
+{
+    join(m_num_submitted);
+}
+
+void thread_pool::fork(task_node *node)
+{
+    size_t id = current_worker();
+    if(id != npos)
+    {
+        if( ! m_workers[id].push(node))
+        {
+            // the deque is full: run the task right away
+            _run(node);
+            return;
+        }
+    }
+    else
+    {
+        _inject(node);
+    }
+    _notify();
+}
+
+void thread_pool::join(std::atomic<size_t> const& pending)
+{
+    size_t id = current_worker();
+    unsigned idle = 0;
+    while(pending.load(std::memory_order_acquire) != 0)
+    {
+        task_node *node = id != npos ? _find(id) : nullptr;
+        if(node)
+            _run(node);
+        else
+            _backoff(&idle);
+    }
+}
+
+void thread_pool::_backoff(unsigned *idle)
+{
+    if(*idle < 1024)
+    {
+        ++*idle;
+        std::this_thread::yield();
+    }
+    else
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+void thread_pool::_work(size_t id)
+{
+    s_current_pool = this;
+    s_current_worker = id;
+    unsigned idle = 0;
+    while(true)
+    {
+        task_node *node = _find(id);
+        if(node)
+        {
+            _run(node);
+            idle = 0;
+            continue;
+        }
+        if(++idle < 64)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        // go to sleep. Announce it before checking for work one last
+        // time, so that either we see new work or the forking thread
+        // sees us sleeping and wakes us up. @see _notify()
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if(m_stop)
+            break;
+        m_num_sleeping.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool has_work = m_num_injected.load(std::memory_order_relaxed) > 0;
+        for(size_t i = 0; i < m_num_workers && !has_work; ++i)
+            has_work = m_workers[i].has_work();
+        if( ! has_work)
+        {
+            uint64_t epoch = m_epoch;
+            m_cv.wait(lock, [this, epoch]{ return m_epoch != epoch || m_stop; });
+        }
+        m_num_sleeping.fetch_sub(1, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
+
+void thread_pool::_notify()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_num_sleeping.load(std::memory_order_relaxed) == 0)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_epoch;
+    }
+    m_cv.notify_one();
+}
+
+thread_pool::task_node* thread_pool::_find(size_t id)
+{
+    task_node *node;
+    if(id != npos)
+    {
+        node = m_workers[id].pop();
+        if(node)
+            return node;
+    }
+    if(m_num_injected.load(std::memory_order_relaxed) > 0)
+    {
+        node = _uninject();
+        if(node)
+            return node;
+    }
+    size_t start = _next_random() % m_num_workers;
+    for(size_t i = 0; i < m_num_workers; ++i)
+    {
+        size_t victim = start + i < m_num_workers ? start + i : start + i - m_num_workers;
+        if(victim == id)
+            continue;
+        node = m_workers[victim].steal();
+        if(node)
+            return node;
+    }
+    return nullptr;
+}
+
+void thread_pool::_run(task_node *node)
+{
+    node->fn();
+    // the node may be gone once the counter is decremented,
+    // so do not touch it afterwards
+    std::atomic<size_t> *pending = node->pending;
+    if(node->pooled)
+        _release_node(node);
+    pending->fetch_sub(1, std::memory_order_release);
+}
+
+void thread_pool::_inject(task_node *node)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    node->next = nullptr;
+    if(m_inject_tail)
+        m_inject_tail->next = node;
+    else
+        m_inject_head = node;
+    m_inject_tail = node;
+    m_num_injected.fetch_add(1, std::memory_order_relaxed);
+}
+
+thread_pool::task_node* thread_pool::_uninject()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    task_node *node = m_inject_head;
+    if(node)
+    {
+        m_inject_head = node->next;
+        if( ! m_inject_head)
+            m_inject_tail = nullptr;
+        node->next = nullptr;
+        m_num_injected.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return node;
+}
+
+thread_pool::task_node* thread_pool::_acquire_node()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    task_node *node = m_free_nodes;
+    if(node)
+    {
+        m_free_nodes = node->next;
+        node->next = nullptr;
+    }
+    return node;
+}
+
+void thread_pool::_release_node(task_node *node)
+{
+    node->fn = nullptr; // destroy the captures outside of the lock
+    std::lock_guard<std::mutex> lock(m_mutex);
+    node->next = m_free_nodes;
+    m_free_nodes = node;
+}
+
+
+//-----------------------------------------------------------------------------
+
+thread_pool& get_thread_pool()
+{
+    static thread_pool pool;
+    return pool;
+}
+
+} // namespace c4
@@ -0,0 +1,272 @@
+#ifndef _C4_THREAD_POOL_HPP_
+#define _C4_THREAD_POOL_HPP_
+
+/** @file thread_pool.hpp A work-stealing thread pool, with fork-join
+ * helpers for data-parallel loops. */
+
+#include "c4/config.hpp"
+#include "c4/error.hpp"
+#include "c4/span.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <sg14/inplace_function.h>
+
+/** @def C4_THREAD_POOL_TASK_SIZE the capacity (in bytes) of the storage
+ * of a thread_pool task. Callables with larger captures fail to compile. */
+#ifndef C4_THREAD_POOL_TASK_SIZE
+#define C4_THREAD_POOL_TASK_SIZE 64
+#endif
+
+namespace c4 {
+
+/** @defgroup threads Multithreading */
+
+/** A pool of worker threads, each owning a Chase-Lev work-stealing
+ * deque. A worker pushes and pops the tasks it spawns at the bottom of
+ * its own deque (LIFO, cache friendly), while idle workers steal from
+ * the top of the deques of other workers (FIFO, which yields the
+ * largest pieces of work when splitting recursively). Tasks spawned
+ * from threads outside the pool go to a shared injection queue.
+ *
+ * Tasks are stored in a stdext::inplace_function, so neither spawning
+ * nor running them allocates memory: the task nodes used by the
+ * fork-join helpers live on the stack of the forking thread, and the
+ * nodes for submit() are drawn from a pool allocated on construction.
+ * All memory is allocated in the constructor.
+ *
+ * A worker waiting for a result (eg in a nested parallel_for()) does
+ * not block: it keeps running pending tasks until its wait is over, so
+ * nested parallel calls do not deadlock. A thread outside of the pool
+ * does not run tasks; it hands its work over to the pool and waits for
+ * it to finish. (Running tasks on the outside thread would let its
+ * stack grow without bounds, as each wait could pick up an unrelated
+ * task.)
+ *
+ * @warning tasks must not throw exceptions.
+ * @ingroup threads */
+class thread_pool
+{
+public:
+
+    using task_type = stdext::inplace_function<void(), C4_THREAD_POOL_TASK_SIZE>;
+
+    struct task_node;
+    struct worker;
+
+    static constexpr const size_t npos = size_t(-1);
+
+public:
+
+    /** create the pool and start its threads.
+     * @param num_threads the number of worker threads. When zero, use
+     * the number of hardware threads.
+     * @param queue_capacity the capacity of each worker's deque, and the
+     * number of tasks which can be submitted with submit() without being
+     * run. Rounded up to a power of two. */
+    explicit thread_pool(size_t num_threads=0, size_t queue_capacity=1024);
+    /** waits for the submitted tasks, then stops and joins the threads */
+    ~thread_pool();
+
+    thread_pool(thread_pool const&) = delete;
+    thread_pool& operator= (thread_pool const&) = delete;
+    thread_pool(thread_pool &&) = delete;
+    thread_pool& operator= (thread_pool &&) = delete;
+
+public:
+
+    /** the number of worker threads */
+    size_t num_threads() const { return m_num_workers; }
+
+    /** the index of the current thread within this pool's workers, or
+     * npos if the current thread is not a worker of this pool */
+    size_t current_worker() const;
+
+    /** the grain size used by parallel_for()/parallel_reduce() when
+     * they are called with a zero grain: split the range in about eight
+     * pieces per thread, to leave room for load balancing */
+    size_t auto_grain(size_t num_elements) const
+    {
+        size_t g = num_elements / (8u * (m_num_workers + 1u));
+        return g ? g : 1u;
+    }
+
+public:
+
+    /** @name asynchronous tasks */
+    /** @{ */
+
+    /** schedule a task for asynchronous execution. If all the task nodes
+     * are in use, wait until one is available.
+     * @see wait() */
+    void submit(task_type &&fn);
+    /** wait until all the tasks given to submit() have finished.
+     * @warning must not be called from a submitted task */
+    void wait();
+
+    /** @} */
+
+public:
+
+    /** @name fork-join */
+    /** @{ */
+
+    /** call fn(span<T>) over a partition of @p s in pieces of at most
+     * @p grain elements, in parallel, and wait for them to finish. The
+     * range is split recursively in halves, and the right half is
+     * offered for stealing while the current thread proceeds with the
+     * left half.
+     * @param grain the maximum size of a piece; when zero, use auto_grain() */
+    template<class T, class I, class Fn>
+    void parallel_for(span<T, I> s, size_t grain, Fn &&fn)
+    {
+        if(s.empty())
+            return;
+        if(grain == 0)
+            grain = auto_grain(static_cast<size_t>(s.size()));
+        if(current_worker() != npos)
+        {
+            _for(s, grain, fn);
+            return;
+        }
+        std::atomic<size_t> pending(1);
+        task_node root([this, s, grain, &fn]{ this->_for(s, grain, fn); }, &pending);
+        fork(&root);
+        join(pending);
+    }
+
+    /** compute op(... op(fn(piece0), fn(piece1)) ...) over a partition of
+     * @p s in pieces of at most @p grain elements, in parallel. @p op must
+     * be associative; the pieces are combined in their order within the
+     * span.
+     * @param identity the result for an empty span
+     * @param fn a callable R(span<T>)
+     * @param op a callable R(R, R)
+     * @param grain the maximum size of a piece; when zero, use auto_grain() */
+    template<class T, class I, class R, class Fn, class Op>
+    R parallel_reduce(span<T, I> s, size_t grain, R identity, Fn &&fn, Op &&op)
+    {
+        if(s.empty())
+            return identity;
+        if(grain == 0)
+            grain = auto_grain(static_cast<size_t>(s.size()));
+        if(current_worker() != npos)
+            return _reduce(s, grain, identity, fn, op);
+        R result = identity;
+        std::atomic<size_t> pending(1);
+        task_node root([this, s, grain, &identity, &fn, &op, &result]{
+            result = this->_reduce(s, grain, identity, fn, op);
+        }, &pending);
+        fork(&root);
+        join(pending);
+        return result;
+    }
+
+    /** low-level fork: schedule @p node, which must stay alive until its
+     * counter reaches zero. The node's counter is decremented once the
+     * task finishes. @see join() */
+    void fork(task_node *node);
+    /** low-level join: wait until @p pending reaches zero. Workers
+     * run pending tasks meanwhile. */
+    void join(std::atomic<size_t> const& pending);
+
+    /** @} */
+
+public:
+
+    /** a schedulable task: the callable, plus the counter which is
+     * decremented once the callable returns */
+    struct task_node
+    {
+        task_type            fn;
+        std::atomic<size_t> *pending;
+        task_node           *next; ///< used in the injection queue and in the free list
+        bool                 pooled;
+
+        task_node() : fn(), pending(nullptr), next(nullptr), pooled(false) {}
+        template<class Fn>
+        task_node(Fn &&fn_, std::atomic<size_t> *pending_) : fn(std::forward<Fn>(fn_)), pending(pending_), next(nullptr), pooled(false) {}
+    };
+
+private:
+
+    template<class T, class I, class Fn>
+    void _for(span<T, I> s, size_t grain, Fn &fn)
+    {
+        if(static_cast<size_t>(s.size()) <= grain)
+        {
+            fn(s);
+            return;
+        }
+        I half = s.size() / 2;
+        span<T, I> right = s.subspan(half);
+        std::atomic<size_t> pending(1);
+        task_node node([this, right, grain, &fn]{ this->_for(right, grain, fn); }, &pending);
+        fork(&node);
+        _for(s.first(half), grain, fn);
+        join(pending);
+    }
+
+    template<class T, class I, class R, class Fn, class Op>
+    R _reduce(span<T, I> s, size_t grain, R const& identity, Fn &fn, Op &op)
+    {
+        if(static_cast<size_t>(s.size()) <= grain)
+            return fn(s);
+        I half = s.size() / 2;
+        span<T, I> right = s.subspan(half);
+        R right_result = identity;
+        std::atomic<size_t> pending(1);
+        task_node node([this, right, grain, &identity, &fn, &op, &right_result]{
+            right_result = this->_reduce(right, grain, identity, fn, op);
+        }, &pending);
+        fork(&node);
+        R left_result = _reduce(s.first(half), grain, identity, fn, op);
+        join(pending);
+        return op(std::move(left_result), std::move(right_result));
+    }
+
+private:
+
+    void _work(size_t id);
+    task_node* _find(size_t id);
+    void _run(task_node *node);
+    void _backoff(unsigned *idle);
+    void _notify();
+    void _inject(task_node *node);
+    task_node* _uninject();
+    task_node* _acquire_node();
+    void _release_node(task_node *node);
+
+private:
+
+    worker   *m_workers;
+    size_t    m_num_workers;
+    size_t    m_queue_capacity;
+
+    task_node *m_nodes;        ///< the pool of nodes for submit()
+    task_node *m_free_nodes;   ///< protected by m_mutex
+    task_node *m_inject_head;  ///< protected by m_mutex
+    task_node *m_inject_tail;  ///< protected by m_mutex
+    std::atomic<size_t> m_num_injected;
+    std::atomic<size_t> m_num_submitted;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    std::atomic<size_t>     m_num_sleeping;
+    uint64_t                m_epoch; ///< protected by m_mutex
+    bool                    m_stop;  ///< protected by m_mutex
+
+};
+
+
+/** get a process-wide thread pool, created on first use with the
+ * default number of threads
+ * @ingroup threads */
+thread_pool& get_thread_pool();
+
+} // namespace c4
+
+#endif /* _C4_THREAD_POOL_HPP_ */
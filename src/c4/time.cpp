@@ -2,6 +2,8 @@
 // PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
 
 #include "c4/time.hpp"
+#include "c4/error.hpp"
+#include "c4/cpu_features.hpp"
 
 #if defined(C4_WIN)
 #   include "c4/windows.hpp"
@@ -30,10 +32,11 @@ C4_BEGIN_NAMESPACE(c4)
 time_type currtime()
 {
 #ifdef C4_WIN
-    time_type ifreq;
-    LARGE_INTEGER freq;
-    QueryPerformanceFrequency(&freq);
-    ifreq = time_type(1.e6) / time_type(freq.QuadPart);
+    static const time_type ifreq = []{
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        return time_type(1.e6) / time_type(freq.QuadPart);
+    }();
     LARGE_INTEGER ts;
     QueryPerformanceCounter(&ts);
     time_type usecs = time_type(ts.QuadPart) * ifreq;
@@ -53,6 +56,87 @@ time_type currtime()
 #endif
 }
 
+
+//-----------------------------------------------------------------------------
+
+namespace detail {
+
+int64_t monotonic_ns()
+{
+#ifdef C4_WIN
+    static const int64_t freq = []{
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return static_cast<int64_t>(f.QuadPart);
+    }();
+    LARGE_INTEGER ts;
+    QueryPerformanceCounter(&ts);
+    const int64_t t = static_cast<int64_t>(ts.QuadPart);
+    return (t / freq) * INT64_C(1000000000) + ((t % freq) * INT64_C(1000000000)) / freq;
+#elif defined(C4_POSIX)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return INT64_C(1000000000) * static_cast<int64_t>(ts.tv_sec) + static_cast<int64_t>(ts.tv_nsec);
+#else
+    auto duration = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+#endif
+}
+
+namespace {
+tsc_calibration tsc_calibration_from_frequency(uint64_t frequency, bool uses_counter)
+{
+    C4_CHECK(frequency > 0);
+    tsc_calibration c;
+    c.frequency = frequency;
+    c.ns_per_tick = (UINT64_C(1000000000) << 32) / frequency;
+    c.uses_counter = uses_counter;
+    return c;
+}
+} // anonymous namespace
+
+tsc_calibration tsc_calibrate()
+{
+#if defined(C4_TSC_CLOCK_X86)
+    // without these, the counter may drift or fault: use the os clock
+    if( ! cpu_has(CPU_RDTSCP|CPU_INVARIANT_TSC))
+        return tsc_calibration_from_frequency(UINT64_C(1000000000), false);
+    // Count the ticks over a few milliseconds of the os clock. Each
+    // tick read is bracketed by two clock reads, and paired with
+    // their midpoint; the error of a few tens of nanoseconds over the
+    // interval gives a frequency accurate to some parts per million.
+    const int64_t interval = 5000000; // 5ms
+    int64_t c0 = monotonic_ns();
+    const uint64_t t0 = rdtscp();
+    int64_t c1 = monotonic_ns();
+    const int64_t start = (c0 + c1) / 2;
+    uint64_t t;
+    int64_t end;
+    do
+    {
+        c0 = monotonic_ns();
+        t = rdtscp();
+        c1 = monotonic_ns();
+        end = (c0 + c1) / 2;
+    } while(end - start < interval);
+    const double freq = double(t - t0) * 1.e9 / double(end - start);
+    return tsc_calibration_from_frequency(static_cast<uint64_t>(freq + 0.5), true);
+#elif defined(C4_TSC_CLOCK_ARM64)
+    // the frequency of the generic timer is given by the system
+    uint64_t freq;
+#   ifdef _MSC_VER
+    freq = static_cast<uint64_t>(_ReadStatusReg(0x5f00)); // CNTFRQ_EL0
+#   else
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(freq));
+#   endif
+    return tsc_calibration_from_frequency(freq, true);
+#else
+    return tsc_calibration_from_frequency(UINT64_C(1000000000), false);
+#endif
+}
+
+} // namespace detail
+
 #ifdef __clang__
 #   pragma clang diagnostic pop
 #elif defined(__GNUC__)
@@ -3,6 +3,10 @@
 
 #include "c4/config.hpp"
 
+#if defined(_MSC_VER) && (defined(C4_CPU_X86_64) || defined(C4_CPU_X86) || defined(C4_CPU_ARM64))
+#   include <intrin.h>
+#endif
+
 #ifdef __clang__
 #   pragma clang diagnostic push
 #elif defined(__GNUC__)
@@ -81,6 +85,169 @@ C4_ALWAYS_INLINE Time  secs(time_type val) { return Time(val * time_type(1.e6));
 C4_ALWAYS_INLINE Time  mins(time_type val) { return Time(val * time_type(60.e6)); }
 C4_ALWAYS_INLINE Time hours(time_type val) { return Time(val * time_type(3600.e6)); }
 
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+#if (defined(C4_CPU_X86_64) || defined(C4_CPU_X86)) && !defined(C4_TSC_CLOCK_NO_HW)
+#   define C4_TSC_CLOCK_X86
+#elif defined(C4_CPU_ARM64) && !defined(C4_TSC_CLOCK_NO_HW)
+#   define C4_TSC_CLOCK_ARM64
+#endif
+
+namespace detail {
+/** @cond dev */
+struct tsc_calibration
+{
+    uint64_t frequency; ///< ticks per second
+    uint64_t ns_per_tick; ///< 32.32 fixed point
+    bool uses_counter; ///< false if the ticks are os clock nanoseconds
+};
+tsc_calibration tsc_calibrate();
+/** the time of the os monotonic clock, in nanoseconds. Used for
+ * calibration, and as tsc_clock when there is no cycle counter. */
+int64_t monotonic_ns();
+inline tsc_calibration const& get_tsc_calibration()
+{
+    static const tsc_calibration c = tsc_calibrate();
+    return c;
+}
+#if defined(C4_TSC_CLOCK_X86)
+C4_ALWAYS_INLINE uint64_t rdtsc() noexcept
+{
+#   ifdef _MSC_VER
+    return __rdtsc();
+#   else
+    return __builtin_ia32_rdtsc();
+#   endif
+}
+/** must only be called when cpu_has(CPU_RDTSCP) */
+C4_ALWAYS_INLINE uint64_t rdtscp() noexcept
+{
+    unsigned aux;
+#   ifdef _MSC_VER
+    return __rdtscp(&aux);
+#   else
+    return __builtin_ia32_rdtscp(&aux);
+#   endif
+}
+#endif
+/** @endcond */
+} // namespace detail
+
+
+/** A clock with very low overhead, reading the cpu timestamp counter:
+ * rdtsc on x86 and cntvct_el0 on arm64. Reading it takes a few
+ * nanoseconds, against the tens of nanoseconds of currtime().
+ *
+ * Timestamps are kept in ticks, and converted to integer nanoseconds
+ * only when needed, with a factor calibrated once on first use
+ * (against the os monotonic clock on x86, where this takes a few
+ * milliseconds, and from cntfrq_el0 on arm64).
+ *
+ * @code
+ * auto t0 = c4::tsc_clock::now();
+ * do_work();
+ * int64_t ns = c4::tsc_clock::elapsed_ns(t0, c4::tsc_clock::now_ordered());
+ * @endcode
+ *
+ * On x86, the counter is used only if cpu_features() reports an
+ * invariant timestamp counter (constant rate, and synchronized across
+ * cores) and the rdtscp instruction, which is the case in current
+ * cpus; this is checked on first use. Otherwise, and also when
+ * C4_TSC_CLOCK_NO_HW is defined or on other architectures, the ticks
+ * are the nanoseconds of the os monotonic clock. @see uses_counter()
+ *
+ * @note Some hypervisors do not report an invariant counter to their
+ * guests, which then get the os clock. */
+class tsc_clock
+{
+public:
+
+    using ticks_type = uint64_t;
+
+    /** read the counter. The read may be reordered with the
+     * instructions around it. */
+    C4_ALWAYS_INLINE static ticks_type now() noexcept
+    {
+#if defined(C4_TSC_CLOCK_X86)
+        if(C4_UNLIKELY( ! detail::get_tsc_calibration().uses_counter))
+            return static_cast<ticks_type>(detail::monotonic_ns());
+        return detail::rdtsc();
+#elif defined(C4_TSC_CLOCK_ARM64)
+#   ifdef _MSC_VER
+        return static_cast<ticks_type>(_ReadStatusReg(0x5f02)); // CNTVCT_EL0
+#   else
+        ticks_type t;
+        __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(t));
+        return t;
+#   endif
+#else
+        return static_cast<ticks_type>(detail::monotonic_ns());
+#endif
+    }
+
+    /** read the counter, after all the previous instructions
+     * complete. Use this to end a measurement. */
+    C4_ALWAYS_INLINE static ticks_type now_ordered() noexcept
+    {
+#if defined(C4_TSC_CLOCK_X86)
+        if(C4_UNLIKELY( ! detail::get_tsc_calibration().uses_counter))
+            return static_cast<ticks_type>(detail::monotonic_ns());
+        return detail::rdtscp();
+#elif defined(C4_TSC_CLOCK_ARM64)
+#   ifdef _MSC_VER
+        __isb(_ARM64_BARRIER_SY);
+        return static_cast<ticks_type>(_ReadStatusReg(0x5f02)); // CNTVCT_EL0
+#   else
+        ticks_type t;
+        __asm__ __volatile__("isb\n\tmrs %0, cntvct_el0" : "=r"(t) : : "memory");
+        return t;
+#   endif
+#else
+        return now();
+#endif
+    }
+
+    /** convert a number of ticks to nanoseconds */
+    C4_ALWAYS_INLINE static int64_t to_ns(ticks_type ticks) noexcept
+    {
+        // 64x64 multiplication with a 32.32 fixed point factor, in
+        // 32 bit pieces to avoid overflow
+        const uint64_t mul = detail::get_tsc_calibration().ns_per_tick;
+        const uint64_t th = ticks >> 32, tl = ticks & 0xffffffffu;
+        const uint64_t mh = mul >> 32, ml = mul & 0xffffffffu;
+        return static_cast<int64_t>(((th * mh) << 32) + th * ml + tl * mh + ((tl * ml) >> 32));
+    }
+
+    /** the nanoseconds from @p start to @p end, which are negative if
+     * @p end is before @p start */
+    C4_ALWAYS_INLINE static int64_t elapsed_ns(ticks_type start, ticks_type end) noexcept
+    {
+        return end >= start ? to_ns(end - start) : -to_ns(start - end);
+    }
+
+    /** the current time, in nanoseconds since an unspecified origin */
+    C4_ALWAYS_INLINE static int64_t now_ns() noexcept
+    {
+        return to_ns(now());
+    }
+
+    /** ticks per second */
+    static uint64_t frequency() noexcept
+    {
+        return detail::get_tsc_calibration().frequency;
+    }
+
+    /** whether the ticks are read from the cpu counter, rather than
+     * from the os monotonic clock */
+    static bool uses_counter() noexcept
+    {
+        return detail::get_tsc_calibration().uses_counter;
+    }
+
+};
+
 C4_END_NAMESPACE(c4)
 
 #ifdef __clang__
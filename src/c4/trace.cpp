@@ -0,0 +1,326 @@
+#include "c4/trace.hpp"
+#include "c4/error.hpp"
+#include "c4/format.hpp"
+
+#include <mutex>
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#   pragma warning(push)
+#   pragma warning(disable : 4996) // fopen: This function or variable may be unsafe
+#endif
+
+namespace c4 {
+
+namespace detail {
+
+std::atomic<bool> trace_is_enabled{false};
+
+namespace {
+
+struct trace_event
+{
+    const char *name;
+    tsc_clock::ticks_type begin;
+    tsc_clock::ticks_type end;
+};
+
+/** a piece of a thread's buffer. Only the owning thread writes the
+ * events, publishing each with the release store of count. A chunk is
+ * full once it has a successor, and the owning thread no longer
+ * touches it. */
+struct trace_chunk
+{
+    enum : size_t { capacity = 1024 };
+    std::atomic<size_t> count{0};
+    std::atomic<trace_chunk*> next{nullptr};
+    trace_event events[capacity];
+};
+
+struct trace_buffer
+{
+    trace_chunk *tail;     ///< written by the owning thread only
+    trace_chunk *head;     ///< read by the flushing thread only
+    size_t       head_pos; ///< events already consumed from head
+    uint64_t     tid;
+    std::atomic<bool> done{false}; ///< the thread has exited
+    char         name[64];
+    trace_buffer *next_buffer;
+
+    trace_buffer(uint64_t tid_) : tail(new trace_chunk), head(tail), head_pos(0), tid(tid_), name(), next_buffer(nullptr) {}
+    ~trace_buffer()
+    {
+        while(head)
+        {
+            trace_chunk *n = head->next.load(std::memory_order_acquire);
+            delete head;
+            head = n;
+        }
+    }
+};
+
+/** the list of buffers of all threads. It is never destroyed, so
+ * that threads may record until the very end of the program. */
+struct trace_registry
+{
+    std::mutex mtx; ///< held to add buffers, and to consume events
+    trace_buffer *buffers = nullptr;
+    uint64_t next_tid = 1;
+    std::atomic<tsc_clock::ticks_type> origin{0};
+
+    static trace_registry& get()
+    {
+        static trace_registry *r = new trace_registry;
+        return *r;
+    }
+};
+
+thread_local trace_buffer *t_buffer = nullptr;
+
+/** marks the buffer as done when its thread exits */
+struct trace_thread_exit
+{
+    trace_buffer *buf;
+    ~trace_thread_exit()
+    {
+        t_buffer = nullptr;
+        buf->done.store(true, std::memory_order_release);
+    }
+};
+
+trace_buffer* trace_register_thread()
+{
+    trace_registry &r = trace_registry::get();
+    trace_buffer *buf;
+    {
+        std::lock_guard<std::mutex> lock(r.mtx);
+        buf = new trace_buffer(r.next_tid++);
+        buf->next_buffer = r.buffers;
+        r.buffers = buf;
+    }
+    static thread_local trace_thread_exit on_exit{nullptr};
+    on_exit.buf = buf;
+    t_buffer = buf;
+    return buf;
+}
+
+} // anonymous namespace
+
+void trace_record(const char *name, tsc_clock::ticks_type begin, tsc_clock::ticks_type end) noexcept
+{
+    trace_buffer *buf = t_buffer;
+    if(C4_UNLIKELY( ! buf))
+        buf = trace_register_thread();
+    trace_chunk *c = buf->tail;
+    size_t n = c->count.load(std::memory_order_relaxed);
+    if(C4_UNLIKELY(n == trace_chunk::capacity))
+    {
+        trace_chunk *next = new trace_chunk;
+        c->next.store(next, std::memory_order_release);
+        buf->tail = c = next;
+        n = 0;
+    }
+    c->events[n] = {name, begin, end};
+    c->count.store(n + 1, std::memory_order_release);
+}
+
+namespace {
+
+/** consume the published events of a buffer, calling fn for each.
+ * Must be called with the registry lock held. */
+template<class Fn>
+void trace_consume(trace_buffer *buf, Fn &&fn)
+{
+    while(true)
+    {
+        trace_chunk *c = buf->head;
+        // load next before count: if next is set, count is final
+        trace_chunk *next = c->next.load(std::memory_order_acquire);
+        const size_t count = c->count.load(std::memory_order_acquire);
+        for( ; buf->head_pos < count; ++buf->head_pos)
+            fn(c->events[buf->head_pos]);
+        if( ! next)
+            break;
+        buf->head = next;
+        buf->head_pos = 0;
+        delete c;
+    }
+}
+
+/** consume the published events of all the buffers, calling
+ * buffer_fn(buf) and then event_fn(buf, event) for each of their
+ * events. The buffers of the threads which exited are removed once
+ * consumed. Must be called with the registry lock held. */
+template<class BufferFn, class EventFn>
+void trace_consume_all(trace_registry &r, BufferFn &&buffer_fn, EventFn &&event_fn)
+{
+    for(trace_buffer **pp = &r.buffers; *pp; )
+    {
+        trace_buffer *buf = *pp;
+        // check before consuming: when done, the thread will write no more
+        const bool done = buf->done.load(std::memory_order_acquire);
+        buffer_fn(*buf);
+        trace_consume(buf, [&](trace_event const& e){ event_fn(*buf, e); });
+        if(done)
+        {
+            *pp = buf->next_buffer;
+            delete buf;
+        }
+        else
+        {
+            pp = &buf->next_buffer;
+        }
+    }
+}
+
+/** formats into a fixed buffer, passing it to the sink when full */
+struct trace_writer
+{
+    trace_sink sink;
+    void *user_data;
+    size_t pos;
+    char buf[4096];
+
+    trace_writer(trace_sink s, void *ud) : sink(s), user_data(ud), pos(0), buf() {}
+
+    void flush()
+    {
+        if(pos)
+            sink(csubstr(buf, pos), user_data);
+        pos = 0;
+    }
+
+    template<class... Args>
+    void format(csubstr fmt, Args const& ...args)
+    {
+        size_t num = c4::format(substr(buf + pos, sizeof(buf) - pos), fmt, args...);
+        if(num > sizeof(buf) - pos)
+        {
+            flush();
+            num = c4::format(substr(buf, sizeof(buf)), fmt, args...);
+            C4_CHECK(num <= sizeof(buf));
+        }
+        pos += num;
+    }
+
+    /** write a string as the contents of a json string */
+    void escaped(const char *s)
+    {
+        for( ; *s; ++s)
+        {
+            if(sizeof(buf) - pos < 6)
+                flush();
+            const char c = *s;
+            if(c == '"' || c == '\\')
+            {
+                buf[pos++] = '\\';
+                buf[pos++] = c;
+            }
+            else if(static_cast<unsigned char>(c) < 0x20)
+            {
+                static const char hexdigits[] = "0123456789abcdef";
+                buf[pos++] = '\\';
+                buf[pos++] = 'u';
+                buf[pos++] = '0';
+                buf[pos++] = '0';
+                buf[pos++] = hexdigits[(c >> 4) & 0xf];
+                buf[pos++] = hexdigits[c & 0xf];
+            }
+            else
+            {
+                buf[pos++] = c;
+            }
+        }
+    }
+};
+
+void trace_file_sink(csubstr piece, void *user_data)
+{
+    FILE *file = static_cast<FILE*>(user_data);
+    fwrite(piece.str, 1, piece.len, file);
+}
+
+} // anonymous namespace
+
+} // namespace detail
+
+
+//-----------------------------------------------------------------------------
+
+void trace_enable(bool yes) noexcept
+{
+    if(yes)
+    {
+        tsc_clock::ticks_type zero = 0;
+        detail::trace_registry::get().origin.compare_exchange_strong(zero, tsc_clock::now());
+    }
+    detail::trace_is_enabled.store(yes, std::memory_order_relaxed);
+}
+
+void trace_set_thread_name(csubstr name)
+{
+    detail::trace_buffer *buf = detail::t_buffer;
+    if( ! buf)
+        buf = detail::trace_register_thread();
+    detail::trace_registry &r = detail::trace_registry::get();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    const size_t len = name.len < sizeof(buf->name) - 1 ? name.len : sizeof(buf->name) - 1;
+    memcpy(buf->name, name.str, len);
+    buf->name[len] = '\0';
+}
+
+size_t trace_flush(trace_sink sink, void *user_data)
+{
+    detail::trace_registry &r = detail::trace_registry::get();
+    detail::trace_writer w(sink, user_data);
+    size_t num_events = 0;
+    const char *sep = "";
+    std::lock_guard<std::mutex> lock(r.mtx);
+    const tsc_clock::ticks_type origin = r.origin.load(std::memory_order_relaxed);
+    w.format("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    detail::trace_consume_all(r, [&](detail::trace_buffer const& buf){
+        if( ! buf.name[0])
+            return;
+        w.format("{}\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{\"name\":\"",
+                 sep, buf.tid);
+        w.escaped(buf.name);
+        w.format("\"}}");
+        sep = ",";
+    }, [&](detail::trace_buffer const& buf, detail::trace_event const& e){
+        // timestamps are in microseconds
+        double ts = static_cast<double>(tsc_clock::elapsed_ns(origin, e.begin)) * 1.e-3;
+        double dur = static_cast<double>(tsc_clock::elapsed_ns(e.begin, e.end)) * 1.e-3;
+        w.format("{}\n{\"name\":\"", sep);
+        w.escaped(e.name);
+        w.format("\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{},\"dur\":{}}",
+                 buf.tid, fmt::fmt(ts, 3), fmt::fmt(dur, 3));
+        sep = ",";
+        ++num_events;
+    });
+    w.format("\n]}\n");
+    w.flush();
+    return num_events;
+}
+
+bool trace_flush(const char *filename)
+{
+    FILE *file = fopen(filename, "wb");
+    if( ! file)
+        return false;
+    trace_flush(&detail::trace_file_sink, file);
+    const bool ok = ! ferror(file);
+    return (fclose(file) == 0) && ok;
+}
+
+void trace_clear()
+{
+    detail::trace_registry &r = detail::trace_registry::get();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    detail::trace_consume_all(r, [](detail::trace_buffer const&){}, [](detail::trace_buffer const&, detail::trace_event const&){});
+}
+
+} // namespace c4
+
+#ifdef _MSC_VER
+#   pragma warning(pop)
+#endif
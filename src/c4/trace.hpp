@@ -0,0 +1,129 @@
+#ifndef _C4_TRACE_HPP_
+#define _C4_TRACE_HPP_
+
+/** @file trace.hpp Scoped-zone tracing, with export to the Chrome
+ * trace format (viewable in chrome://tracing or ui.perfetto.dev). */
+
+#include "c4/config.hpp"
+#include "c4/substr.hpp"
+#include "c4/time.hpp"
+
+#include <atomic>
+
+/** @def C4_USE_TRACE define to 1 to compile the C4_TRACE_ZONE() zones
+ * in. When 0 (the default), the zones are compiled out entirely. The
+ * functions in this header are always available. */
+#ifndef C4_USE_TRACE
+#   define C4_USE_TRACE 0
+#endif
+
+/** @def C4_TRACE_ZONE(name) record a zone named @p name (a string with
+ * static storage, usually a literal) from here to the end of the
+ * enclosing scope. Does nothing unless C4_USE_TRACE is 1, and records
+ * only while trace_enabled().
+ * @ingroup trace */
+#if C4_USE_TRACE
+#   define C4_TRACE_ZONE(name) ::c4::trace_zone C4_XCAT(_c4_trace_zone_, __LINE__)(name)
+#else
+#   define C4_TRACE_ZONE(name)
+#endif
+
+namespace c4 {
+
+/** @defgroup trace Tracing
+ *
+ * Zones record their begin and end timestamps (from tsc_clock) into
+ * buffers owned by each thread. Recording takes no lock: each buffer
+ * is a list of chunks, written only by its thread, and read by
+ * trace_flush(), which consumes the events published so far. A thread
+ * allocates a new chunk when its current one is full, and a buffer is
+ * freed after its thread exits and its events are flushed.
+ *
+ * @code
+ * c4::trace_enable(true);
+ * {
+ *     C4_TRACE_ZONE("parse");
+ *     parse(input);
+ * }
+ * c4::trace_flush("trace.json");
+ * @endcode
+ */
+
+namespace detail {
+/** @cond dev */
+extern std::atomic<bool> trace_is_enabled;
+void trace_record(const char *name, tsc_clock::ticks_type begin, tsc_clock::ticks_type end) noexcept;
+/** @endcond */
+} // namespace detail
+
+
+/** start or stop recording zones, in all threads
+ * @ingroup trace */
+void trace_enable(bool yes) noexcept;
+
+/** @ingroup trace */
+C4_ALWAYS_INLINE bool trace_enabled() noexcept
+{
+    return detail::trace_is_enabled.load(std::memory_order_relaxed);
+}
+
+/** set the name of the calling thread, shown in the trace. The name is
+ * copied, and truncated to 63 characters.
+ * @ingroup trace */
+void trace_set_thread_name(csubstr name);
+
+/** receives the output of trace_flush(), in pieces
+ * @ingroup trace */
+using trace_sink = void (*)(csubstr piece, void *user_data);
+
+/** write the events recorded so far in the Chrome trace format (a
+ * complete JSON object), passing it in pieces to @p sink. The events
+ * are removed from the buffers. Threads may keep recording while this
+ * runs; their new events go to the next flush.
+ * @return the number of zones written
+ * @ingroup trace */
+size_t trace_flush(trace_sink sink, void *user_data);
+
+/** write the events recorded so far to a file, in the Chrome trace
+ * format.
+ * @return false if the file could not be written
+ * @ingroup trace */
+bool trace_flush(const char *filename);
+
+/** discard the events recorded so far
+ * @ingroup trace */
+void trace_clear();
+
+
+/** records a zone from its construction to its destruction. Prefer
+ * C4_TRACE_ZONE(), which compiles out when tracing is disabled.
+ * @ingroup trace */
+class trace_zone
+{
+public:
+
+    C4_ALWAYS_INLINE explicit trace_zone(const char *name) noexcept
+        : m_name(trace_enabled() ? name : nullptr)
+        , m_begin(m_name ? tsc_clock::now() : 0)
+    {
+    }
+
+    C4_ALWAYS_INLINE ~trace_zone()
+    {
+        if(m_name)
+            detail::trace_record(m_name, m_begin, tsc_clock::now());
+    }
+
+    trace_zone(trace_zone const&) = delete;
+    trace_zone& operator= (trace_zone const&) = delete;
+
+private:
+
+    const char *m_name;
+    tsc_clock::ticks_type m_begin;
+
+};
+
+} // namespace c4
+
+#endif /* _C4_TRACE_HPP_ */
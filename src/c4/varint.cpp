@@ -0,0 +1,268 @@
+#include "c4/varint.hpp"
+#include "c4/cpu_features.hpp"
+
+#ifdef C4_VARINT_X86
+#   include <immintrin.h>
+#endif
+
+namespace c4 {
+
+namespace {
+
+template<class U>
+size_t varint_encode_(blob buf, cspan<U> vals) noexcept
+{
+    size_t pos = 0;
+    for(U v : vals)
+        pos += varint_encode(detail::advance_blob(buf, pos), v);
+    return pos;
+}
+
+} // anonymous namespace
+
+size_t varint_encode(blob buf, cspan<uint32_t> vals) noexcept
+{
+    return varint_encode_(buf, vals);
+}
+
+size_t varint_encode(blob buf, cspan<uint64_t> vals) noexcept
+{
+    return varint_encode_(buf, vals);
+}
+
+
+//-----------------------------------------------------------------------------
+
+namespace detail {
+
+namespace {
+
+template<class U>
+size_t varint_decode_scalar_(cblob buf, span<U> vals) noexcept
+{
+    const uint8_t *C4_RESTRICT p = reinterpret_cast<const uint8_t*>(buf.buf);
+    size_t pos = 0;
+    for(U &v : vals)
+    {
+        // most varints in a list are short, so test for one byte first
+        if(C4_LIKELY(pos < buf.len && p[pos] < 0x80u))
+        {
+            v = p[pos++];
+            continue;
+        }
+        const size_t len = varint_decode(cblob(buf.buf + pos, buf.len - pos), &v);
+        if(C4_UNLIKELY(len == csubstr::npos))
+            return csubstr::npos;
+        pos += len;
+    }
+    return pos;
+}
+
+} // anonymous namespace
+
+size_t varint_decode_scalar(cblob buf, span<uint32_t> vals) noexcept
+{
+    return varint_decode_scalar_(buf, vals);
+}
+
+size_t varint_decode_scalar(cblob buf, span<uint64_t> vals) noexcept
+{
+    return varint_decode_scalar_(buf, vals);
+}
+
+} // namespace detail
+
+
+//-----------------------------------------------------------------------------
+// x86 kernel. This is the Masked VByte decoder of Plaisance, Kurz and
+// Lemire, "Vectorized VByte Decoding" (2015), simplified: the high bits
+// of 16 bytes are gathered with a movemask, and the low 12 bits of the
+// mask are looked up to find how many of the first varints end in those
+// 12 bytes, up to 4 varints of up to 4 bytes each. A shuffle moves
+// their bytes to the 32-bit lanes, where shifts and masks join the
+// 7-bit groups. A run of 16 single-byte varints is widened directly.
+// Longer varints and the tail of the input are left to the scalar code.
+
+#ifdef C4_VARINT_X86
+
+namespace detail {
+
+namespace {
+
+struct varint_tables
+{
+    enum : size_t {
+        mask_bits = 12,
+        num_masks = size_t(1) << mask_bits,
+        max_vals = 4, ///< the number of 32-bit lanes
+        max_len = 4, ///< the longest varint decoded in a lane
+        num_shuffles = 625, ///< the lengths of the varints, in base 5
+    };
+
+    struct entry
+    {
+        uint8_t num_vals; ///< the number of varints decoded
+        uint8_t num_bytes; ///< the number of bytes they take
+        uint16_t shuffle; ///< the index of their shuffle
+    };
+
+    entry entries[num_masks];
+    alignas(16) uint8_t shuffles[num_shuffles][16];
+
+    varint_tables() noexcept
+    {
+        for(size_t mask = 0; mask < num_masks; ++mask)
+        {
+            uint8_t lens[max_vals] = {};
+            size_t pos = 0, n = 0, shuffle = 0, scale = 1;
+            for( ; n < max_vals; ++n)
+            {
+                size_t end = pos;
+                while(end < mask_bits && (mask & (size_t(1) << end)))
+                    ++end;
+                if(end >= mask_bits || end - pos + 1 > max_len)
+                    break;
+                lens[n] = static_cast<uint8_t>(end - pos + 1);
+                shuffle += lens[n] * scale;
+                scale *= 5;
+                pos = end + 1;
+            }
+            entries[mask].num_vals = static_cast<uint8_t>(n);
+            entries[mask].num_bytes = static_cast<uint8_t>(pos);
+            entries[mask].shuffle = static_cast<uint16_t>(shuffle);
+            uint8_t *C4_RESTRICT s = shuffles[shuffle];
+            for(size_t i = 0, src = 0; i < max_vals; ++i)
+            {
+                for(size_t j = 0; j < 4; ++j)
+                    s[4 * i + j] = j < lens[i] ? static_cast<uint8_t>(src + j) : uint8_t(0x80); // 0x80 zeroes the byte
+                src += lens[i];
+            }
+        }
+    }
+
+    static varint_tables const& get() noexcept
+    {
+        static const varint_tables tables;
+        return tables;
+    }
+};
+
+C4_CPU_TARGET("ssse3") inline void varint_store_ssse3(uint32_t *out, __m128i v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), v);
+}
+C4_CPU_TARGET("ssse3") inline void varint_store_ssse3(uint64_t *out, __m128i v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi32(v, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2), _mm_unpackhi_epi32(v, zero));
+}
+
+template<class U>
+C4_CPU_TARGET("ssse3") size_t varint_decode_ssse3_(cblob buf, span<U> vals)
+{
+    varint_tables const& t = varint_tables::get();
+    const __m128i zero = _mm_setzero_si128();
+    const char *C4_RESTRICT p = buf.buf;
+    size_t rem = buf.len;
+    U *C4_RESTRICT out = vals.data();
+    size_t num = vals.size();
+    while(rem >= 16 && num >= varint_tables::max_vals)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(in));
+        if(mask == 0 && num >= 16)
+        {
+            const __m128i lo = _mm_unpacklo_epi8(in, zero);
+            const __m128i hi = _mm_unpackhi_epi8(in, zero);
+            varint_store_ssse3(out     , _mm_unpacklo_epi16(lo, zero));
+            varint_store_ssse3(out +  4, _mm_unpackhi_epi16(lo, zero));
+            varint_store_ssse3(out +  8, _mm_unpacklo_epi16(hi, zero));
+            varint_store_ssse3(out + 12, _mm_unpackhi_epi16(hi, zero));
+            p += 16;
+            rem -= 16;
+            out += 16;
+            num -= 16;
+            continue;
+        }
+        varint_tables::entry const& e = t.entries[mask & (varint_tables::num_masks - 1)];
+        if(C4_UNLIKELY(e.num_vals == 0))
+        {
+            // the first varint is longer than 4 bytes
+            const size_t len = varint_decode(cblob(p, rem), out);
+            if(C4_UNLIKELY(len == csubstr::npos))
+                return csubstr::npos;
+            p += len;
+            rem -= len;
+            ++out;
+            --num;
+            continue;
+        }
+        const __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(t.shuffles[e.shuffle]));
+        __m128i v = _mm_shuffle_epi8(in, shuffle);
+        // join the 7-bit groups: in 16-bit lanes, then in 32-bit lanes
+        v = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi16(0x007f)),
+                         _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi16(0x3f80)));
+        v = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(0x00003fff)),
+                         _mm_and_si128(_mm_srli_epi32(v, 2), _mm_set1_epi32(0x0fffc000)));
+        varint_store_ssse3(out, v);
+        p += e.num_bytes;
+        rem -= e.num_bytes;
+        out += e.num_vals;
+        num -= e.num_vals;
+    }
+    const size_t ret = varint_decode_scalar(cblob(p, rem), span<U>(out, num));
+    return ret != csubstr::npos ? static_cast<size_t>(p - buf.buf) + ret : csubstr::npos;
+}
+
+} // anonymous namespace
+
+size_t varint_decode_ssse3(cblob buf, span<uint32_t> vals) noexcept
+{
+    return varint_decode_ssse3_(buf, vals);
+}
+
+size_t varint_decode_ssse3(cblob buf, span<uint64_t> vals) noexcept
+{
+    return varint_decode_ssse3_(buf, vals);
+}
+
+} // namespace detail
+
+#endif // C4_VARINT_X86
+
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+template<class U>
+using varint_decode_fn = size_t (*)(cblob, span<U>);
+
+template<class U>
+varint_decode_fn<U> varint_select_impl() noexcept
+{
+#ifdef C4_VARINT_X86
+    const varint_decode_fn<U> ssse3 = &detail::varint_decode_ssse3;
+    const varint_decode_fn<U> scalar = &detail::varint_decode_scalar;
+    return cpu_select(CPU_SSSE3, ssse3, scalar);
+#else
+    return &detail::varint_decode_scalar;
+#endif
+}
+
+} // anonymous namespace
+
+size_t varint_decode(cblob buf, span<uint32_t> vals) noexcept
+{
+    static const varint_decode_fn<uint32_t> impl = varint_select_impl<uint32_t>();
+    return impl(buf, vals);
+}
+
+size_t varint_decode(cblob buf, span<uint64_t> vals) noexcept
+{
+    static const varint_decode_fn<uint64_t> impl = varint_select_impl<uint64_t>();
+    return impl(buf, vals);
+}
+
+} // namespace c4
@@ -0,0 +1,288 @@
+#ifndef _C4_VARINT_HPP_
+#define _C4_VARINT_HPP_
+
+/** @file varint.hpp Variable-length integers (LEB128, as in protocol
+ * buffers), with zigzag encoding for signed integers.
+ * @see https://en.wikipedia.org/wiki/LEB128
+ * @see https://protobuf.dev/programming-guides/encoding/#varints
+ * */
+
+#include "c4/config.hpp"
+#include "c4/bytes.hpp"
+#include "c4/span.hpp"
+#include "c4/substr.hpp"
+
+#include <type_traits>
+#include <utility>
+
+namespace c4 {
+
+/** @defgroup varint Varints
+ * @brief Variable-length integers
+ *
+ * A varint is written in 7-bit groups, the least significant first,
+ * one per byte; the high bit of each byte is set when more bytes
+ * follow. Small values take few bytes: below 128 a single one, and a
+ * 64-bit integer takes at most 10. Signed integers are first zigzag
+ * encoded (0, -1, 1, -2, ... become 0, 1, 2, 3, ...), so that small
+ * negative values are small too.
+ *
+ * The scalar functions are inline. The functions over spans are
+ * vectorized with SSSE3 where available, after Plaisance, Kurz and
+ * Lemire, "Vectorized VByte Decoding" (2015): the continuation bits of
+ * a block of bytes are gathered into a mask, which is looked up to
+ * shuffle several varints at once into their lanes.
+ *
+ * Varints plug into cat_bytes() and uncat_bytes() when wrapped with
+ * fmt::varint():
+ *
+ * @code
+ * char buf[32];
+ * size_t sz = c4::cat_bytes(buf, c4::fmt::varint(300u), c4::fmt::varint(-2));
+ * // sz is 3, and buf starts with ac 02 03
+ * unsigned a;
+ * int b;
+ * c4::uncat_bytes(c4::cblob(buf, sz), c4::fmt::varint(a), c4::fmt::varint(b));
+ * @endcode
+ *
+ * @ingroup bytes */
+
+
+//-----------------------------------------------------------------------------
+
+/** map a signed integer to an unsigned one, interleaving the negative
+ * and positive values: 0, -1, 1, -2, 2 ... become 0, 1, 2, 3, 4 ...
+ * @ingroup varint */
+template<class I>
+C4_CONSTEXPR14 C4_ALWAYS_INLINE auto zigzag_encode(I v) noexcept
+    -> typename std::make_unsigned<I>::type
+{
+    C4_STATIC_ASSERT(std::is_integral<I>::value && std::is_signed<I>::value);
+    using U = typename std::make_unsigned<I>::type;
+    // the arithmetic shift spreads the sign bit over all the bits
+    return static_cast<U>(static_cast<U>(v) << 1u) ^ static_cast<U>(v >> (8 * sizeof(I) - 1));
+}
+
+/** the inverse of zigzag_encode()
+ * @ingroup varint */
+template<class U>
+C4_CONSTEXPR14 C4_ALWAYS_INLINE auto zigzag_decode(U v) noexcept
+    -> typename std::make_signed<U>::type
+{
+    C4_STATIC_ASSERT(std::is_integral<U>::value && std::is_unsigned<U>::value);
+    using I = typename std::make_signed<U>::type;
+    return static_cast<I>(static_cast<U>(v >> 1u) ^ static_cast<U>(U(0) - (v & 1u)));
+}
+
+
+//-----------------------------------------------------------------------------
+
+namespace detail {
+template<class U>
+using enable_varint = typename std::enable_if<std::is_integral<U>::value && std::is_unsigned<U>::value
+                                              && ! std::is_same<U, bool>::value, size_t>::type;
+} // namespace detail
+
+/** the maximum number of bytes of a varint of the given type
+ * @ingroup varint */
+template<class U>
+constexpr size_t varint_max_size() noexcept
+{
+    return (8 * sizeof(U) + 6) / 7;
+}
+
+/** the number of bytes of the varint of an unsigned integer
+ * @ingroup varint */
+template<class U>
+C4_CONSTEXPR14 C4_ALWAYS_INLINE auto varint_size(U v) noexcept
+    -> detail::enable_varint<U>
+{
+    size_t len = 1;
+    for( ; v >= 0x80u; v = static_cast<U>(v >> 7u))
+        ++len;
+    return len;
+}
+
+/** write the varint of an unsigned integer
+ * @return the number of bytes needed. Nothing is written if the
+ * buffer is smaller than that.
+ * @ingroup varint */
+template<class U>
+C4_ALWAYS_INLINE auto varint_encode(blob buf, U v) noexcept
+    -> detail::enable_varint<U>
+{
+    const size_t len = varint_size(v);
+    if(C4_LIKELY(len <= buf.len))
+    {
+        for(size_t i = 0; i + 1 < len; ++i, v = static_cast<U>(v >> 7u))
+            buf.buf[i] = static_cast<byte>(static_cast<uint8_t>(v | 0x80u));
+        buf.buf[len - 1] = static_cast<byte>(static_cast<uint8_t>(v));
+    }
+    return len;
+}
+
+/** read the varint of an unsigned integer
+ * @return the number of bytes read, or csubstr::npos if the buffer
+ * ends before the varint, or if the varint overflows the integer
+ * @ingroup varint */
+template<class U>
+C4_ALWAYS_INLINE auto varint_decode(cblob buf, U *C4_RESTRICT v) noexcept
+    -> detail::enable_varint<U>
+{
+    enum : size_t { max_len = varint_max_size<U>(), bits = 8 * sizeof(U) };
+    const size_t len = buf.len < max_len ? buf.len : size_t(max_len);
+    U val = 0;
+    for(size_t i = 0; i < len; ++i)
+    {
+        const uint8_t b = static_cast<uint8_t>(buf.buf[i]);
+        val = static_cast<U>(val | static_cast<U>(static_cast<U>(b & 0x7fu) << (7u * i)));
+        if( ! (b & 0x80u))
+        {
+            // the last possible byte must not have bits beyond the integer
+            if(C4_UNLIKELY(i + 1 == max_len && (b >> (bits - 7u * i)) != 0))
+                return csubstr::npos;
+            *v = val;
+            return i + 1;
+        }
+    }
+    return csubstr::npos;
+}
+
+
+//-----------------------------------------------------------------------------
+
+/** write the varints of several integers, one after the other. No
+ * writes occur beyond the end of the buffer.
+ * @return the number of bytes needed
+ * @ingroup varint */
+size_t varint_encode(blob buf, cspan<uint32_t> vals) noexcept;
+/** @ingroup varint */
+size_t varint_encode(blob buf, cspan<uint64_t> vals) noexcept;
+
+/** read as many varints as the span has room for. This is vectorized
+ * where available.
+ * @return the number of bytes read, or csubstr::npos if the buffer
+ * ends before the last varint, or if any varint overflows. The
+ * contents of the span are unspecified on failure.
+ * @ingroup varint */
+size_t varint_decode(cblob buf, span<uint32_t> vals) noexcept;
+/** @ingroup varint */
+size_t varint_decode(cblob buf, span<uint64_t> vals) noexcept;
+
+/** write varints into the characters of a substr. Without this
+ * overload, the substr would convert to a blob of the substr object
+ * itself.
+ * @ingroup varint */
+template<class Buf, class T>
+C4_ALWAYS_INLINE auto varint_encode(Buf buf, T const& v) noexcept
+    -> typename std::enable_if<std::is_same<Buf, substr>::value, size_t>::type
+{
+    return varint_encode(blob(buf.str, buf.len), v);
+}
+/** the characters of a csubstr cannot be written
+ * @ingroup varint */
+template<class Buf, class T>
+auto varint_encode(Buf buf, T const& v) noexcept
+    -> typename std::enable_if<std::is_same<Buf, csubstr>::value, size_t>::type = delete;
+/** read varints from the characters of a substr or csubstr
+ * @ingroup varint */
+template<class Buf, class Out>
+C4_ALWAYS_INLINE auto varint_decode(Buf buf, Out &&out) noexcept
+    -> typename std::enable_if<std::is_same<Buf, substr>::value || std::is_same<Buf, csubstr>::value, size_t>::type
+{
+    return varint_decode(cblob(buf.str, buf.len), std::forward<Out>(out));
+}
+
+
+#if (defined(C4_CPU_X86_64) || defined(C4_CPU_X86)) && !defined(C4_VARINT_NO_SIMD)
+#   define C4_VARINT_X86
+#endif
+
+namespace detail {
+/** @cond dev */
+// the implementations selected at runtime by varint_decode(). The
+// vector ones defer their tail to the scalar ones.
+size_t varint_decode_scalar(cblob buf, span<uint32_t> vals) noexcept;
+size_t varint_decode_scalar(cblob buf, span<uint64_t> vals) noexcept;
+#ifdef C4_VARINT_X86
+size_t varint_decode_ssse3(cblob buf, span<uint32_t> vals) noexcept;
+size_t varint_decode_ssse3(cblob buf, span<uint64_t> vals) noexcept;
+#endif
+/** @endcond */
+} // namespace detail
+
+
+//-----------------------------------------------------------------------------
+
+namespace fmt {
+
+/** @see varint() */
+template<class T>
+struct varint_
+{
+    T val;
+};
+
+/** mark an integer to be written to bytes as a varint, zigzag encoded
+ * if it is signed. Wrapping a mutable variable also marks it to be
+ * read as a varint.
+ * @ingroup varint */
+template<class T> C4_ALWAYS_INLINE varint_<T&> varint(T &v) noexcept { return varint_<T&>{v}; }
+/** @ingroup varint */
+template<class T> C4_ALWAYS_INLINE varint_<T> varint(T const& v) noexcept { return varint_<T>{v}; }
+
+} // namespace fmt
+
+
+namespace detail {
+template<class I>
+C4_ALWAYS_INLINE auto varint_to_unsigned(I v) noexcept
+    -> typename std::enable_if<std::is_signed<I>::value, typename std::make_unsigned<I>::type>::type
+{
+    return zigzag_encode(v);
+}
+template<class U>
+C4_ALWAYS_INLINE auto varint_to_unsigned(U v) noexcept
+    -> typename std::enable_if< ! std::is_signed<U>::value, U>::type
+{
+    return v;
+}
+template<class T>
+using enable_varint_wrapper = typename std::enable_if<std::is_integral<T>::value && ! std::is_same<T, bool>::value, size_t>::type;
+} // namespace detail
+
+/** write an integer as a varint
+ * @see fmt::varint()
+ * @ingroup varint */
+template<class T>
+C4_ALWAYS_INLINE auto to_bytes(blob buf, fmt::varint_<T> w) noexcept
+    -> detail::enable_varint_wrapper<detail::bytes_value_t<T>>
+{
+    return varint_encode(buf, detail::varint_to_unsigned(static_cast<detail::bytes_value_t<T>>(w.val)));
+}
+
+/** read an integer from a varint
+ * @see fmt::varint()
+ * @ingroup varint */
+template<class T>
+C4_ALWAYS_INLINE auto from_bytes(cblob buf, fmt::varint_<T&> w) noexcept
+    -> detail::enable_varint_wrapper<T>
+{
+    using U = typename std::make_unsigned<T>::type;
+    U u;
+    const size_t len = varint_decode(buf, &u);
+    if(C4_LIKELY(len != csubstr::npos))
+        w.val = std::is_signed<T>::value ? static_cast<T>(zigzag_decode(u)) : static_cast<T>(u);
+    return len;
+}
+/** @ingroup varint */
+template<class T>
+C4_ALWAYS_INLINE auto from_bytes(cblob buf, fmt::varint_<T&> *w) noexcept
+    -> detail::enable_varint_wrapper<T>
+{
+    return from_bytes(buf, *w);
+}
+
+} // namespace c4
+
+#endif /* _C4_VARINT_HPP_ */
@@ -0,0 +1,21 @@
+#ifndef _C4_LIBTEST_RNG_HPP_
+#define _C4_LIBTEST_RNG_HPP_
+
+#include "c4/config.hpp"
+
+#include <stdint.h>
+
+C4_BEGIN_NAMESPACE(c4)
+
+/** a small and fast deterministic generator (a 64 bit LCG) for the
+ * inputs of the tests and benchmarks; it returns the 53 high bits of
+ * the state, as the low bits of an LCG are not very random. */
+inline uint64_t next_rand(uint64_t *rng)
+{
+    *rng = *rng * 6364136223846793005u + 1442695040888963407u;
+    return *rng >> 11;
+}
+
+C4_END_NAMESPACE(c4)
+
+#endif /* _C4_LIBTEST_RNG_HPP_ */
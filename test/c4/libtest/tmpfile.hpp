@@ -0,0 +1,39 @@
+#ifndef _C4_LIBTEST_TMPFILE_HPP_
+#define _C4_LIBTEST_TMPFILE_HPP_
+
+#include "c4/error.hpp"
+#include "c4/substr.hpp"
+
+#if defined(C4_POSIX) || defined(C4_MACOS) || defined(C4_IOS)
+#   include <stdio.h>
+#   include <stdlib.h>
+#   include <unistd.h>
+#endif
+
+C4_BEGIN_NAMESPACE(c4)
+
+#if defined(C4_POSIX) || defined(C4_MACOS) || defined(C4_IOS)
+
+/** a temporary file with the given contents, removed on destruction */
+struct ScopedTmpFile
+{
+    char name[64];
+    ScopedTmpFile(csubstr contents, const char *prefix="c4core")
+    {
+        snprintf(name, sizeof(name), "/tmp/%s_XXXXXX", prefix);
+        int fd = ::mkstemp(name);
+        C4_CHECK(fd >= 0);
+        C4_CHECK(::write(fd, contents.str, contents.len) == (ssize_t)contents.len);
+        ::close(fd);
+    }
+    ~ScopedTmpFile()
+    {
+        ::unlink(name);
+    }
+};
+
+#endif // C4_POSIX
+
+C4_END_NAMESPACE(c4)
+
+#endif /* _C4_LIBTEST_TMPFILE_HPP_ */
@@ -3,7 +3,9 @@
 #include "c4/test.hpp"
 #include "c4/format.hpp"
 #include "c4/base64.hpp"
+#include "c4/cpu_features.hpp"
 
+#include "c4/libtest/rng.hpp"
 #include "c4/libtest/supprwarn_push.hpp"
 
 namespace c4 {
@@ -126,6 +128,441 @@ TEST(base64, int)
     }
 }
 
+
+
+//-----------------------------------------------------------------------------
+
+struct base64_impl_case
+{
+    const char *name;
+    size_t (*encode)(substr, cblob);
+    size_t (*decode)(csubstr, blob);
+};
+
+template<class Alphabet=base64_std>
+std::vector<base64_impl_case> base64_impls()
+{
+    std::vector<base64_impl_case> impls;
+    impls.push_back({"public", &base64_encode<Alphabet>, &base64_decode<Alphabet>});
+    impls.push_back({"scalar", &detail::base64_encode_scalar<Alphabet>, &detail::base64_decode_scalar<Alphabet>});
+#ifdef C4_BASE64_X86
+    if(cpu_has(CPU_SSSE3))
+        impls.push_back({"ssse3", &detail::base64_encode_ssse3<Alphabet>, &detail::base64_decode_ssse3<Alphabet>});
+    if(cpu_has(CPU_AVX2))
+        impls.push_back({"avx2", &detail::base64_encode_avx2<Alphabet>, &detail::base64_decode_avx2<Alphabet>});
+#endif
+    return impls;
+}
+
+std::string base64_reference(std::string const& data, char c62='+', char c63='/', bool padded=true)
+{
+    char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    alphabet[62] = c62;
+    alphabet[63] = c63;
+    std::string out;
+    for(size_t i = 0; i < data.size(); i += 3)
+    {
+        uint32_t val = uint32_t(uint8_t(data[i])) << 16;
+        if(i + 1 < data.size()) val |= uint32_t(uint8_t(data[i + 1])) << 8;
+        if(i + 2 < data.size()) val |= uint32_t(uint8_t(data[i + 2]));
+        out += alphabet[(val >> 18) & 63];
+        out += alphabet[(val >> 12) & 63];
+        if(i + 1 < data.size()) out += alphabet[(val >> 6) & 63];
+        else if(padded) out += '=';
+        if(i + 2 < data.size()) out += alphabet[val & 63];
+        else if(padded) out += '=';
+    }
+    return out;
+}
+
+std::string base64_random_data(size_t len, uint64_t seed)
+{
+    std::string data(len, '\0');
+    for(char &c : data)
+        c = static_cast<char>(next_rand(&seed) >> 45);
+    return data;
+}
+
+TEST(base64, long_buffers)
+{
+    std::vector<size_t> lens;
+    for(size_t len = 0; len < 200; ++len)
+        lens.push_back(len);
+    lens.push_back(4096);
+    lens.push_back(100000 + 1);
+    for(auto const& impl : base64_impls())
+    {
+        SCOPED_TRACE(impl.name);
+        for(size_t len : lens)
+        {
+            SCOPED_TRACE(len);
+            std::string data = base64_random_data(len, len);
+            std::string expected = base64_reference(data);
+            std::string encoded(expected.size(), '\0');
+            ASSERT_EQ(impl.encode(to_substr(encoded), cblob(data.data(), data.size())), expected.size());
+            ASSERT_EQ(encoded, expected);
+            std::string decoded(data.size(), '\0');
+            ASSERT_EQ(impl.decode(to_csubstr(encoded), blob(&decoded[0], decoded.size())), data.size());
+            ASSERT_EQ(decoded, data);
+        }
+    }
+}
+
+TEST(base64, short_output_buffer)
+{
+    std::string data = base64_random_data(300, 1u);
+    std::string expected = base64_reference(data);
+    for(auto const& impl : base64_impls())
+    {
+        SCOPED_TRACE(impl.name);
+        for(size_t cap : {size_t(0), size_t(1), size_t(15), size_t(16), size_t(33), size_t(200)})
+        {
+            SCOPED_TRACE(cap);
+            std::string encoded(cap, '\0');
+            ASSERT_EQ(impl.encode(to_substr(encoded), cblob(data.data(), data.size())), expected.size());
+            EXPECT_EQ(encoded, expected.substr(0, cap));
+            std::string decoded(cap, '\0');
+            ASSERT_EQ(impl.decode(to_csubstr(expected), blob(&decoded[0], decoded.size())), data.size());
+            EXPECT_EQ(decoded, data.substr(0, cap));
+        }
+    }
+}
+
+TEST(base64, invalid)
+{
+    std::string data = base64_random_data(150, 2u);
+    const std::string encoded = base64_reference(data);
+    std::string decoded(data.size(), '\0');
+    blob out(&decoded[0], decoded.size());
+    for(auto const& impl : base64_impls())
+    {
+        SCOPED_TRACE(impl.name);
+        EXPECT_EQ(impl.decode(to_csubstr(encoded), out), data.size());
+        // a bad char at every position, including the padding
+        for(size_t pos = 0; pos < encoded.size(); ++pos)
+        {
+            for(char bad : {'-', '_', '=', '\0', '\n', ' ', '\x80', '\xff'})
+            {
+                std::string s = encoded;
+                if(s[pos] == bad)
+                    continue;
+                s[pos] = bad;
+                if(bad == '=' && pos + 1 == encoded.size()) // this is a valid padding
+                    continue;
+                EXPECT_EQ(impl.decode(to_csubstr(s), out), csubstr::npos) << "pos=" << pos << " bad=" << int(bad);
+                EXPECT_FALSE(base64_valid(to_csubstr(s))) << "pos=" << pos << " bad=" << int(bad);
+            }
+        }
+        EXPECT_EQ(impl.decode(to_csubstr(encoded).first(encoded.size() - 1), out), csubstr::npos);
+        EXPECT_EQ(impl.decode(csubstr("TQ==TWFu"), out), csubstr::npos);
+        EXPECT_EQ(impl.decode(csubstr("TQ=u"), out), csubstr::npos);
+        EXPECT_EQ(impl.decode(csubstr("T==="), out), csubstr::npos);
+        EXPECT_FALSE(base64_valid(csubstr("TQ==TWFu")));
+        EXPECT_FALSE(base64_valid(csubstr("TQ=u")));
+        EXPECT_FALSE(base64_valid(csubstr("T===")));
+        EXPECT_FALSE(base64_valid(csubstr("====")));
+    }
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+template<class Alphabet>
+void test_base64_alphabet()
+{
+    const char c62 = Alphabet::char62, c63 = Alphabet::char63;
+    const bool padded = Alphabet::padded;
+    for(auto const& impl : base64_impls<Alphabet>())
+    {
+        SCOPED_TRACE(impl.name);
+        for(size_t len : {size_t(0), size_t(1), size_t(2), size_t(3), size_t(31), size_t(100), size_t(101), size_t(4096), size_t(4097)})
+        {
+            SCOPED_TRACE(len);
+            std::string data = base64_random_data(len, len);
+            std::string expected = base64_reference(data, c62, c63, padded);
+            std::string encoded(expected.size(), '\0');
+            ASSERT_EQ(impl.encode(to_substr(encoded), cblob(data.data(), data.size())), expected.size());
+            ASSERT_EQ(encoded, expected);
+            EXPECT_TRUE(base64_valid<Alphabet>(to_csubstr(encoded)));
+            std::string decoded(data.size(), '\0');
+            ASSERT_EQ(impl.decode(to_csubstr(encoded), blob(&decoded[0], decoded.size())), data.size());
+            ASSERT_EQ(decoded, data);
+        }
+        // chars of the other alphabets are rejected everywhere
+        std::string data = base64_random_data(200, 5u);
+        std::string encoded = base64_reference(data, c62, c63, padded);
+        std::string decoded(data.size(), '\0');
+        blob out(&decoded[0], decoded.size());
+        for(size_t pos = 0; pos < encoded.size(); pos += 7)
+        {
+            for(char bad : {'+', '/', '-', '_', '='})
+            {
+                if(bad == c62 || bad == c63)
+                    continue;
+                if(bad == '=' && padded && pos + 2 >= encoded.size()) // may be valid padding
+                    continue;
+                std::string s = encoded;
+                s[pos] = bad;
+                EXPECT_EQ(impl.decode(to_csubstr(s), out), csubstr::npos) << "pos=" << pos << " bad=" << bad;
+            }
+        }
+        // every byte value, in the vector part of the input
+        std::string alphabet = base64_reference(std::string("\x00\x10\x83\x10\x51\x87\x20\x92\x8b\x30\xd3\x8f"
+                                                            "\x41\x14\x93\x51\x55\x97\x61\x96\x9b\x71\xd7\x9f"
+                                                            "\x82\x18\xa3\x92\x59\xa7\xa2\x9a\xab\xb2\xdb\xaf"
+                                                            "\xc3\x1c\xb3\xd3\x5d\xb7\xe3\x9e\xbb\xf3\xdf\xbf", 48), c62, c63, padded);
+        ASSERT_EQ(alphabet.size(), 64u);
+        for(size_t i = 0; i < 64; ++i)
+        {
+            ASSERT_EQ(alphabet[i], base64_reference(std::string(1, char(i << 2)), c62, c63, false)[0]);
+        }
+        for(int c = 0; c < 256; ++c)
+        {
+            std::string s = alphabet + alphabet;
+            s[39] = static_cast<char>(c);
+            size_t pos = alphabet.find(static_cast<char>(c));
+            size_t ret = impl.decode(to_csubstr(s), out);
+            if(pos == std::string::npos)
+            {
+                EXPECT_EQ(ret, csubstr::npos) << "c=" << c;
+            }
+            else
+            {
+                ASSERT_EQ(ret, 96u) << "c=" << c;
+                // char 39 holds the low sextet of byte 29
+                EXPECT_EQ(uint8_t(decoded[29]) & 63u, pos) << "c=" << c;
+            }
+        }
+        // a lone char in the last group is never valid
+        EXPECT_EQ(impl.decode(csubstr("TWFuT"), out), csubstr::npos);
+        // padding is required, or rejected
+        EXPECT_EQ(impl.decode(csubstr("TWE="), out) == csubstr::npos, !padded);
+        EXPECT_EQ(impl.decode(csubstr("TWE"), out) == csubstr::npos, padded);
+    }
+}
+
+TEST(base64, alphabets)
+{
+    test_base64_alphabet<base64_std>();
+    test_base64_alphabet<base64_std_nopad>();
+    test_base64_alphabet<base64url>();
+    test_base64_alphabet<base64url_pad>();
+}
+
+TEST(base64url, fmt)
+{
+    char buf_[128];
+    substr buf(buf_);
+    // a JWT header
+    csubstr header = R"({"alg":"HS256","typ":"JWT"})";
+    EXPECT_EQ(to_chars_sub(buf, fmt::cbase64url(header)), "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9");
+    // chars 62 and 63
+    const char bytes[] = {'\xfb', '\xff', '\xbf'};
+    EXPECT_EQ(to_chars_sub(buf, fmt::cbase64url(bytes)), "-_-_");
+    EXPECT_EQ(to_chars_sub(buf, fmt::cbase64(bytes)), "+/+/");
+    EXPECT_EQ(to_chars_sub(buf, fmt::cbase64url(csubstr("Ma"))), "TWE");
+    char out_[64] = {};
+    auto req = fmt::base64url(out_);
+    size_t len = from_chars(csubstr("eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9"), &req);
+    ASSERT_EQ(len, header.len);
+    EXPECT_EQ(csubstr(out_, len), header);
+    EXPECT_EQ(from_chars(csubstr("+/+/"), &req), csubstr::npos);
+}
+
+//-----------------------------------------------------------------------------
+
+template<class Alphabet>
+void test_base64_encoder_chunks()
+{
+    for(size_t len : {size_t(0), size_t(1), size_t(2), size_t(3), size_t(100), size_t(1000)})
+    {
+        std::string data = base64_random_data(len, 3u);
+        std::string expected = base64_reference(data, Alphabet::char62, Alphabet::char63, Alphabet::padded);
+        for(size_t chunk_size : {size_t(1), size_t(2), size_t(3), size_t(5), size_t(64), size_t(999)})
+        {
+            SCOPED_TRACE(len);
+            SCOPED_TRACE(chunk_size);
+            base64_encoder_<Alphabet> enc;
+            std::string encoded;
+            char buf_[2048];
+            substr buf(buf_);
+            for(size_t pos = 0; pos < data.size(); pos += chunk_size)
+            {
+                size_t n = data.size() - pos < chunk_size ? data.size() - pos : chunk_size;
+                size_t written = enc.encode(buf, cblob(data.data() + pos, n));
+                ASSERT_LE(written, base64_encoder_<Alphabet>::max_encoded_size(n));
+                ASSERT_LT(enc.num_pending(), 3u);
+                encoded.append(buf.str, written);
+            }
+            size_t written = enc.finish(buf);
+            encoded.append(buf.str, written);
+            EXPECT_EQ(enc.num_pending(), 0u);
+            EXPECT_EQ(encoded, expected);
+        }
+    }
+}
+
+TEST(base64_encoder, chunks)
+{
+    test_base64_encoder_chunks<base64_std>();
+    test_base64_encoder_chunks<base64_std_nopad>();
+    test_base64_encoder_chunks<base64url>();
+    test_base64_encoder_chunks<base64url_pad>();
+}
+
+TEST(base64_encoder, short_output_buffer)
+{
+    base64_encoder enc;
+    char buf_[8];
+    substr buf(buf_, sizeof(buf_));
+    EXPECT_EQ(enc.encode(buf, cblob("Ma", 2)), 0u);
+    EXPECT_EQ(enc.num_pending(), 2u);
+    // needs 12 chars: nothing is consumed
+    EXPECT_EQ(enc.encode(buf, cblob("n carnal", 8)), 12u);
+    EXPECT_EQ(enc.num_pending(), 2u);
+    EXPECT_EQ(enc.encode(buf, cblob("n car", 5)), 8u);
+    EXPECT_EQ(buf, "TWFuIGNh");
+    EXPECT_EQ(enc.num_pending(), 1u);
+    EXPECT_EQ(enc.finish(buf.first(3)), 4u);
+    EXPECT_EQ(enc.num_pending(), 1u);
+    EXPECT_EQ(enc.finish(buf), 4u);
+    EXPECT_EQ(buf.first(4), "cg==");
+    EXPECT_EQ(enc.finish(buf), 0u);
+}
+
+template<class Alphabet>
+void test_base64_decoder_chunks()
+{
+    for(size_t len : {size_t(0), size_t(1), size_t(2), size_t(3), size_t(100), size_t(1000)})
+    {
+        std::string data = base64_random_data(len, 4u);
+        std::string encoded = base64_reference(data, Alphabet::char62, Alphabet::char63, Alphabet::padded);
+        for(size_t chunk_size : {size_t(1), size_t(2), size_t(3), size_t(4), size_t(5), size_t(64), size_t(1337)})
+        {
+            SCOPED_TRACE(len);
+            SCOPED_TRACE(chunk_size);
+            base64_decoder_<Alphabet> dec;
+            std::string decoded;
+            char buf_[2048];
+            blob buf(buf_);
+            for(size_t pos = 0; pos < encoded.size(); pos += chunk_size)
+            {
+                csubstr chunk = to_csubstr(encoded).sub(pos).first(encoded.size() - pos < chunk_size ? encoded.size() - pos : chunk_size);
+                size_t written = dec.decode(buf, chunk);
+                ASSERT_NE(written, csubstr::npos);
+                ASSERT_LE(written, base64_decoder_<Alphabet>::max_decoded_size(chunk.len));
+                ASSERT_LT(dec.num_pending(), 4u);
+                decoded.append(buf.buf, written);
+            }
+            // an unpadded input may end with a partial quartet
+            size_t written = dec.finish(buf);
+            ASSERT_NE(written, csubstr::npos);
+            decoded.append(buf.buf, written);
+            EXPECT_EQ(dec.num_pending(), 0u);
+            EXPECT_EQ(decoded, data);
+        }
+    }
+}
+
+TEST(base64_decoder, chunks)
+{
+    test_base64_decoder_chunks<base64_std>();
+    test_base64_decoder_chunks<base64_std_nopad>();
+    test_base64_decoder_chunks<base64url>();
+    test_base64_decoder_chunks<base64url_pad>();
+}
+
+TEST(base64_decoder, short_output_buffer)
+{
+    base64_decoder dec;
+    char buf_[4];
+    blob buf(buf_);
+    EXPECT_EQ(dec.decode(buf, "TW"), 0u);
+    // needs 6 bytes: nothing is consumed
+    EXPECT_EQ(dec.decode(buf, "FuIGNhcg"), 6u);
+    EXPECT_EQ(dec.num_pending(), 2u);
+    EXPECT_EQ(dec.decode(buf, "Fu"), 3u);
+    EXPECT_EQ(csubstr(buf_, 3), "Man");
+    // the padding reduces the output
+    EXPECT_EQ(dec.decode(blob(buf_, 1), "cg=="), 1u);
+    EXPECT_EQ(buf_[0], 'r');
+    EXPECT_TRUE(dec.finish());
+}
+
+TEST(base64_decoder, invalid)
+{
+    char buf_[64];
+    blob buf(buf_);
+    {
+        base64_decoder dec;
+        EXPECT_EQ(dec.decode(buf, "TW"), 0u);
+        EXPECT_EQ(dec.decode(buf, "F-"), csubstr::npos); // across chunks
+        EXPECT_TRUE(dec.error());
+        EXPECT_EQ(dec.decode(buf, "TWFu"), csubstr::npos); // sticky
+        EXPECT_FALSE(dec.finish());
+        EXPECT_EQ(dec.decode(buf, "TWFu"), 3u); // finish() resets
+        EXPECT_TRUE(dec.finish());
+    }
+    {
+        base64_decoder dec;
+        EXPECT_EQ(dec.decode(buf, "TQ=="), 1u);
+        EXPECT_EQ(dec.decode(buf, "TWFu"), csubstr::npos); // data after padding
+        EXPECT_FALSE(dec.finish());
+    }
+    {
+        base64_decoder dec;
+        EXPECT_EQ(dec.decode(buf, "TQ"), 0u);
+        EXPECT_EQ(dec.decode(buf, "==T"), csubstr::npos); // data after padding
+        EXPECT_FALSE(dec.finish());
+    }
+    {
+        base64_decoder dec;
+        EXPECT_EQ(dec.decode(buf, "TWFuT"), 3u);
+        EXPECT_FALSE(dec.finish()); // a truncated quartet
+    }
+    {
+        base64_decoder dec;
+        EXPECT_EQ(dec.decode(buf, "TWFuTW"), 3u);
+        EXPECT_EQ(dec.finish(buf), csubstr::npos); // padding is required
+    }
+}
+
+TEST(base64url_decoder, partial_quartet)
+{
+    char buf_[8];
+    blob buf(buf_);
+    {
+        base64url_decoder dec;
+        EXPECT_EQ(dec.decode(buf, "TWFuIGN"), 3u);
+        EXPECT_EQ(dec.num_pending(), 3u);
+        EXPECT_EQ(dec.finish(blob(buf_, 1)), 2u); // nothing is written
+        EXPECT_EQ(dec.num_pending(), 3u);
+        EXPECT_EQ(dec.finish(buf), 2u);
+        EXPECT_EQ(csubstr(buf_, 2), " c");
+        EXPECT_EQ(dec.num_pending(), 0u);
+    }
+    {
+        base64url_decoder dec;
+        EXPECT_EQ(dec.decode(buf, "TWFuT"), 3u);
+        EXPECT_EQ(dec.finish(buf), csubstr::npos); // a lone char
+    }
+    {
+        base64url_decoder dec;
+        EXPECT_EQ(dec.decode(buf, "TWE="), csubstr::npos); // no padding
+        EXPECT_EQ(dec.finish(buf), csubstr::npos);
+    }
+    {
+        base64url_encoder enc;
+        char out_[8];
+        substr out(out_);
+        EXPECT_EQ(enc.encode(out, cblob("\xfb\xff\xbf\xfb", 4)), 4u);
+        EXPECT_EQ(out.first(4), "-_-_");
+        EXPECT_EQ(enc.finish(out.first(1)), 2u);
+        EXPECT_EQ(enc.finish(out), 2u);
+        EXPECT_EQ(out.first(2), "-w");
+    }
+}
 } // namespace c4
 
 #include "c4/libtest/supprwarn_pop.hpp"
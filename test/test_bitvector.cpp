@@ -0,0 +1,355 @@
+#include "c4/test.hpp"
+#include "c4/bitvector.hpp"
+#include "c4/cpu_features.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "c4/libtest/rng.hpp"
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+namespace {
+
+/** random bits, with a one every 1/density positions on average */
+std::vector<bool> random_bits(size_t num, double density, uint64_t seed)
+{
+    std::vector<bool> bits(num);
+    const uint64_t threshold = static_cast<uint64_t>(density * double(uint64_t(1) << 32));
+    for(size_t i = 0; i < num; ++i)
+        bits[i] = (next_rand(&seed) & 0xffffffffu) < threshold;
+    return bits;
+}
+
+bitvector make_bitvector(std::vector<bool> const& bits, MemoryResource *mr=nullptr)
+{
+    bitvector bv(bits.size(), false, mr);
+    for(size_t i = 0; i < bits.size(); ++i)
+        if(bits[i])
+            bv.set(i);
+    return bv;
+}
+
+void test_rank_select(std::vector<bool> const& bits)
+{
+    SCOPED_TRACE(bits.size());
+    bitvector bv = make_bitvector(bits);
+    bv.build_index();
+    ASSERT_TRUE(bv.has_index());
+    size_t ones = 0;
+    for(size_t i = 0; i < bits.size(); ++i)
+    {
+        ASSERT_EQ(bv.test(i), bits[i]) << i;
+        ASSERT_EQ(bv.rank1(i), ones) << i;
+        ASSERT_EQ(bv.rank0(i), i - ones) << i;
+        if(bits[i])
+        {
+            ASSERT_EQ(bv.select1(ones), i) << ones;
+            ++ones;
+        }
+    }
+    EXPECT_EQ(bv.rank1(bits.size()), ones);
+    EXPECT_EQ(bv.num_ones(), ones);
+    EXPECT_EQ(bv.count(), ones);
+    EXPECT_EQ(bv.select1(ones), (size_t)bitvector::npos);
+    EXPECT_EQ(bv.select1(ones + 1000u), (size_t)bitvector::npos);
+}
+
+} // anonymous namespace
+
+
+TEST(bitvector, empty)
+{
+    bitvector bv;
+    EXPECT_TRUE(bv.empty());
+    EXPECT_EQ(bv.size(), 0u);
+    EXPECT_EQ(bv.count(), 0u);
+    EXPECT_EQ(bv.words().size(), 0u);
+    bv.build_index();
+    EXPECT_EQ(bv.rank1(0), 0u);
+    EXPECT_EQ(bv.num_ones(), 0u);
+    EXPECT_EQ(bv.select1(0), (size_t)bitvector::npos);
+}
+
+TEST(bitvector, set_reset_flip)
+{
+    bitvector bv(130);
+    EXPECT_EQ(bv.size(), 130u);
+    EXPECT_EQ(bv.words().size(), 3u);
+    EXPECT_EQ(bv.count(), 0u);
+    bv.set(0);
+    bv.set(64);
+    bv.set(129);
+    EXPECT_TRUE(bv[0]);
+    EXPECT_TRUE(bv[64]);
+    EXPECT_TRUE(bv[129]);
+    EXPECT_FALSE(bv[1]);
+    EXPECT_EQ(bv.count(), 3u);
+    bv.reset(64);
+    EXPECT_FALSE(bv[64]);
+    bv.flip(64);
+    bv.flip(0);
+    EXPECT_TRUE(bv[64]);
+    EXPECT_FALSE(bv[0]);
+    bv.set(5, true);
+    bv.set(129, false);
+    EXPECT_TRUE(bv[5]);
+    EXPECT_FALSE(bv[129]);
+    EXPECT_EQ(bv.count(), 2u);
+    EXPECT_EQ(bv.words()[0], uint64_t(1) << 5);
+    EXPECT_EQ(bv.words()[1], uint64_t(1));
+    EXPECT_EQ(bv.words()[2], uint64_t(0));
+}
+
+TEST(bitvector, modification_discards_index)
+{
+    bitvector bv(100);
+    bv.build_index();
+    EXPECT_TRUE(bv.has_index());
+    bv.set(3);
+    EXPECT_FALSE(bv.has_index());
+    bv.build_index();
+    EXPECT_EQ(bv.num_ones(), 1u);
+    EXPECT_EQ(bv.select1(0), 3u);
+    bv.fill(true);
+    EXPECT_FALSE(bv.has_index());
+    bv.build_index();
+    EXPECT_TRUE(bv.has_index());
+    bv.resize(50);
+    EXPECT_FALSE(bv.has_index());
+}
+
+TEST(bitvector, fill)
+{
+    for(size_t num : {1u, 63u, 64u, 65u, 511u, 512u, 513u, 1000u})
+    {
+        SCOPED_TRACE(num);
+        bitvector bv(num);
+        bv.fill(true);
+        EXPECT_EQ(bv.count(), num);
+        // the bits past the size stay zero
+        uint64_t last = bv.words()[bv.words().size() - 1u];
+        EXPECT_EQ((size_t)detail::bitvector_popcount64(last), num % 64u ? num % 64u : 64u);
+        bv.build_index();
+        EXPECT_EQ(bv.rank1(num), num);
+        EXPECT_EQ(bv.select1(num - 1u), num - 1u);
+        bv.fill(false);
+        EXPECT_EQ(bv.count(), 0u);
+    }
+}
+
+TEST(bitvector, resize)
+{
+    std::vector<bool> ref;
+    bitvector bv;
+    uint64_t rng = 7u;
+    for(size_t num : {10u, 64u, 700u, 1024u, 3u, 0u, 2000u, 1500u, 1501u, 5u})
+    {
+        const bool value = next_rand(&rng) & 1u;
+        SCOPED_TRACE(num);
+        SCOPED_TRACE(value);
+        ref.resize(num, value);
+        bv.resize(num, value);
+        ASSERT_EQ(bv.size(), num);
+        size_t ones = 0;
+        for(size_t i = 0; i < num; ++i)
+        {
+            ASSERT_EQ(bv.test(i), ref[i]) << i;
+            ones += ref[i];
+        }
+        EXPECT_EQ(bv.count(), ones);
+        // change some bits for the next round
+        for(size_t i = 0; i < num; i += 7u)
+        {
+            ref[i] = !ref[i];
+            bv.flip(i);
+        }
+    }
+    bv.clear();
+    EXPECT_EQ(bv.size(), 0u);
+    EXPECT_EQ(bv.count(), 0u);
+}
+
+TEST(bitvector, rank_select_boundary_sizes)
+{
+    for(size_t num : {1u, 63u, 64u, 65u, 511u, 512u, 513u, 1023u, 1024u, 4096u})
+    {
+        test_rank_select(std::vector<bool>(num, true));
+        test_rank_select(std::vector<bool>(num, false));
+        test_rank_select(random_bits(num, 0.5, num));
+    }
+}
+
+TEST(bitvector, rank_select_dense)
+{
+    test_rank_select(random_bits(100000u, 0.5, 1u));
+    test_rank_select(random_bits(100000u, 0.99, 2u));
+}
+
+TEST(bitvector, rank_select_sparse)
+{
+    test_rank_select(random_bits(200000u, 0.01, 3u));
+    test_rank_select(random_bits(200000u, 0.0001, 4u));
+    // all the ones at the ends, with empty blocks between them
+    std::vector<bool> bits(100000u);
+    for(size_t i = 0; i < 1000u; ++i)
+    {
+        bits[i] = true;
+        bits[bits.size() - 1u - i] = true;
+    }
+    test_rank_select(bits);
+}
+
+TEST(bitvector, bulk)
+{
+    const std::vector<bool> bits = random_bits(50000u, 0.3, 5u);
+    bitvector bv(bits.size());
+    std::vector<size_t> ones, zeros, all;
+    for(size_t i = 0; i < bits.size(); ++i)
+        (bits[i] ? ones : zeros).push_back(i);
+    uint64_t rng = 9u;
+    for(size_t i = 0; i < 20000u; ++i)
+        all.push_back(next_rand(&rng) % bits.size());
+
+    bv.fill(true);
+    bv.reset(cspan<size_t>(zeros.data(), zeros.size()));
+    EXPECT_EQ(bv.count(), ones.size());
+    bv.fill(false);
+    bv.set(cspan<size_t>(ones.data(), ones.size()));
+    EXPECT_EQ(bv.count(), ones.size());
+
+    std::unique_ptr<bool[]> results(new bool[all.size()]);
+    bv.test(cspan<size_t>(all.data(), all.size()), span<bool>(results.get(), all.size()));
+    size_t expected_count = 0;
+    for(size_t i = 0; i < all.size(); ++i)
+    {
+        ASSERT_EQ(results[i], bits[all[i]]) << i;
+        expected_count += bits[all[i]];
+    }
+    EXPECT_EQ(bv.count(cspan<size_t>(all.data(), all.size())), expected_count);
+
+    bv.build_index();
+    std::vector<size_t> ranks(all.size());
+    bv.rank1(cspan<size_t>(all.data(), all.size()), span<size_t>(ranks.data(), ranks.size()));
+    for(size_t i = 0; i < all.size(); ++i)
+        ASSERT_EQ(ranks[i], bv.rank1(all[i])) << i;
+
+    // no positions
+    bv.set(cspan<size_t>());
+    EXPECT_EQ(bv.count(cspan<size_t>()), 0u);
+}
+
+TEST(bitvector, copy_move)
+{
+    const std::vector<bool> bits = random_bits(3000u, 0.4, 6u);
+    bitvector orig = make_bitvector(bits);
+    orig.build_index();
+    const size_t ones = orig.num_ones();
+
+    bitvector cp(orig);
+    EXPECT_TRUE(cp.has_index());
+    EXPECT_EQ(cp.num_ones(), ones);
+    EXPECT_EQ(cp.select1(ones / 2u), orig.select1(ones / 2u));
+    cp.flip(0);
+    EXPECT_NE(cp.test(0), orig.test(0));
+
+    bitvector cpa(10);
+    cpa = orig;
+    EXPECT_EQ(cpa.size(), orig.size());
+    EXPECT_EQ(cpa.rank1(2000u), orig.rank1(2000u));
+    cpa = bitvector();
+    EXPECT_EQ(cpa.size(), 0u);
+
+    bitvector mv(std::move(cp));
+    EXPECT_EQ(mv.size(), bits.size());
+    EXPECT_EQ(cp.size(), 0u);
+    EXPECT_NE(mv.test(0), orig.test(0));
+
+    bitvector mva;
+    mva = std::move(orig);
+    EXPECT_EQ(mva.size(), bits.size());
+    EXPECT_EQ(orig.size(), 0u);
+    EXPECT_EQ(mva.num_ones(), ones);
+}
+
+TEST(bitvector, memory_resource)
+{
+    MemoryResourceCounts mrc;
+    {
+        bitvector bv(10000u, true, &mrc);
+        EXPECT_EQ(bv.resource(), &mrc);
+        EXPECT_EQ(mrc.counts().curr.allocs, 1);
+        bv.build_index();
+        EXPECT_EQ(mrc.counts().curr.allocs, 3);
+        bitvector cp(bv);
+        EXPECT_EQ(cp.resource(), &mrc);
+        EXPECT_EQ(mrc.counts().curr.allocs, 6);
+        bv.resize(20000u);
+        EXPECT_EQ(mrc.counts().curr.allocs, 4);
+        cp.clear();
+        EXPECT_EQ(mrc.counts().curr.allocs, 1);
+    }
+    EXPECT_EQ(mrc.counts().curr.allocs, 0);
+    EXPECT_EQ(mrc.counts().curr.size, 0);
+    {
+        ScopedMemoryResource smr(&mrc);
+        bitvector bv(100u);
+        EXPECT_EQ(bv.resource(), &mrc);
+    }
+    EXPECT_EQ(mrc.counts().curr.allocs, 0);
+}
+
+TEST(bitvector, impl_scalar_vs_popcnt)
+{
+    const std::vector<bool> bits = random_bits(20000u, 0.2, 8u);
+    const bitvector bv = make_bitvector(bits);
+    cspan<uint64_t> words = bv.words();
+    // whole blocks for the rank
+    const size_t num_blocks = bits.size() / 512u + 1u;
+    std::vector<uint64_t> padded(num_blocks * 8u);
+    std::copy(words.begin(), words.end(), padded.begin());
+    std::vector<uint64_t> rank(2u * num_blocks);
+    const size_t ones = detail::bitvector_build_rank_scalar(padded.data(), num_blocks, rank.data());
+    EXPECT_EQ(ones, detail::bitvector_count_scalar(words.data(), words.size()));
+    EXPECT_EQ(ones, bv.count());
+    // samples of every 512th one, as the bitvector makes them
+    std::vector<uint64_t> samples;
+    for(size_t b = 0; b < num_blocks; ++b)
+    {
+        const size_t end = b + 1u < num_blocks ? (size_t)rank[2u * (b + 1u)] : ones;
+        while(samples.size() * 512u < end)
+            samples.push_back(b);
+    }
+    samples.push_back(num_blocks - 1u);
+#ifdef C4_BITVECTOR_X86
+    if(cpu_has(CPU_POPCNT))
+    {
+        EXPECT_EQ(detail::bitvector_count_popcnt(words.data(), words.size()), ones);
+        std::vector<uint64_t> rank2(rank.size());
+        EXPECT_EQ(detail::bitvector_build_rank_popcnt(padded.data(), num_blocks, rank2.data()), ones);
+        EXPECT_EQ(rank2, rank);
+    }
+#endif
+    std::vector<size_t> positions;
+    for(size_t i = 0; i < bits.size(); ++i)
+        if(bits[i])
+            positions.push_back(i);
+    ASSERT_EQ(positions.size(), ones);
+    for(size_t k = 0; k < ones; ++k)
+    {
+        const size_t pos = detail::bitvector_select1_scalar(padded.data(), rank.data(), num_blocks, samples.data(), k);
+        ASSERT_EQ(pos, positions[k]) << k;
+#ifdef C4_BITVECTOR_X86
+        if(cpu_has(CPU_POPCNT))
+        {
+            ASSERT_EQ(detail::bitvector_select1_popcnt(padded.data(), rank.data(), num_blocks, samples.data(), k), pos);
+        }
+#endif
+    }
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
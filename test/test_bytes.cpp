@@ -0,0 +1,420 @@
+#include "c4/test.hpp"
+#include "c4/bytes.hpp"
+#include "c4/cpu_features.hpp"
+
+#include <limits>
+#include <vector>
+
+#include "c4/libtest/rng.hpp"
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+namespace {
+typedef enum : uint16_t { BYTES_FOO = 0x0102, BYTES_BAR = 0xfffe } BytesEnum_e;
+} // anonymous namespace
+
+template<size_t N>
+void expect_bytes(const char *buf, const unsigned char (&expected)[N])
+{
+    for(size_t i = 0; i < N; ++i)
+        EXPECT_EQ((unsigned char)buf[i], expected[i]) << "i=" << i;
+}
+
+TEST(bytes, byteswap)
+{
+    EXPECT_EQ(byteswap(uint8_t(0x12)), uint8_t(0x12));
+    EXPECT_EQ(byteswap(uint16_t(0x1234)), uint16_t(0x3412));
+    EXPECT_EQ(byteswap(uint32_t(0x12345678)), uint32_t(0x78563412));
+    EXPECT_EQ(byteswap(UINT64_C(0x0123456789abcdef)), UINT64_C(0xefcdab8967452301));
+    EXPECT_EQ(byteswap(int16_t(-2)), int16_t(-257));
+    EXPECT_EQ(byteswap(int32_t(1)), int32_t(0x01000000));
+    EXPECT_EQ(byteswap(byteswap(INT64_C(-1234567890123))), INT64_C(-1234567890123));
+}
+
+TEST(bytes, le_be_layout)
+{
+    char buf[8] = {};
+    EXPECT_EQ(to_bytes(buf, fmt::be(uint32_t(0xdeadbeef))), 4u);
+    expect_bytes(buf, {0xde, 0xad, 0xbe, 0xef});
+    EXPECT_EQ(to_bytes(buf, fmt::le(uint32_t(0xdeadbeef))), 4u);
+    expect_bytes(buf, {0xef, 0xbe, 0xad, 0xde});
+    EXPECT_EQ(to_bytes(buf, fmt::le(int16_t(-2))), 2u);
+    expect_bytes(buf, {0xfe, 0xff});
+    EXPECT_EQ(to_bytes(buf, fmt::be(int16_t(-2))), 2u);
+    expect_bytes(buf, {0xff, 0xfe});
+    EXPECT_EQ(to_bytes(buf, fmt::be(UINT64_C(0x0102030405060708))), 8u);
+    expect_bytes(buf, {1, 2, 3, 4, 5, 6, 7, 8});
+    EXPECT_EQ(to_bytes(buf, fmt::be(1.0f)), 4u);
+    expect_bytes(buf, {0x3f, 0x80, 0, 0});
+    EXPECT_EQ(to_bytes(buf, fmt::le(-2.0)), 8u);
+    expect_bytes(buf, {0, 0, 0, 0, 0, 0, 0, 0xc0});
+    EXPECT_EQ(to_bytes(buf, fmt::be(BYTES_FOO)), 2u);
+    expect_bytes(buf, {1, 2});
+}
+
+TEST(bytes, native)
+{
+    char buf[4] = {};
+    const uint32_t v = 0x01020304;
+    EXPECT_EQ(to_bytes(buf, v), 4u);
+    EXPECT_EQ(memcmp(buf, &v, sizeof(v)), 0);
+    uint32_t w = 0;
+    EXPECT_EQ(from_bytes(cblob(buf, 4), &w), 4u);
+    EXPECT_EQ(w, v);
+}
+
+template<class T>
+void test_roundtrip(T v)
+{
+    char buf[16];
+    for(int i = 0; i < 3; ++i)
+    {
+        memset(buf, 0, sizeof(buf));
+        T w = T();
+        size_t wsz = 0, rsz = 0;
+        switch(i)
+        {
+        case 0:
+            wsz = to_bytes(buf, v);
+            rsz = from_bytes(cblob(buf, wsz), &w);
+            break;
+        case 1:
+            wsz = to_bytes(buf, fmt::le(v));
+            rsz = from_bytes(cblob(buf, wsz), fmt::le(w));
+            break;
+        case 2:
+            wsz = to_bytes(buf, fmt::be(v));
+            rsz = from_bytes(cblob(buf, wsz), fmt::be(w));
+            break;
+        }
+        EXPECT_EQ(wsz, (std::is_same<T, bool>::value ? size_t(1) : sizeof(T))) << "i=" << i;
+        EXPECT_EQ(rsz, wsz) << "i=" << i;
+        EXPECT_EQ(memcmp(&w, &v, sizeof(T)), 0) << "i=" << i;
+    }
+}
+
+TEST(bytes, roundtrip)
+{
+    test_roundtrip(true);
+    test_roundtrip(false);
+    test_roundtrip('a');
+    test_roundtrip(int8_t(-100));
+    test_roundtrip(uint8_t(200));
+    test_roundtrip(int16_t(-12345));
+    test_roundtrip(uint16_t(54321));
+    test_roundtrip(std::numeric_limits<int32_t>::min());
+    test_roundtrip(std::numeric_limits<uint32_t>::max());
+    test_roundtrip(std::numeric_limits<int64_t>::min());
+    test_roundtrip(UINT64_C(0x0123456789abcdef));
+    test_roundtrip(3.14159f);
+    test_roundtrip(-std::numeric_limits<float>::denorm_min());
+    test_roundtrip(2.718281828459045);
+    test_roundtrip(std::numeric_limits<double>::infinity());
+    test_roundtrip(BYTES_BAR);
+}
+
+TEST(bytes, small_buffer)
+{
+    char buf[8] = {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'};
+    EXPECT_EQ(to_bytes(blob(buf, 3), fmt::be(uint32_t(0xdeadbeef))), 4u);
+    EXPECT_EQ(to_bytes(blob(buf, 7), UINT64_C(1)), 8u);
+    EXPECT_EQ(to_bytes(blob(), true), 1u);
+    EXPECT_EQ(to_bytes(blob(buf, 2), csubstr("abc")), 3u);
+    EXPECT_EQ(csubstr(buf, 8), "xxxxxxxx");
+    uint32_t u = 0;
+    EXPECT_EQ(from_bytes(cblob(buf, 3), &u), csubstr::npos);
+    EXPECT_EQ(from_bytes(cblob(buf, 3), fmt::le(u)), csubstr::npos);
+    EXPECT_EQ(u, 0u);
+    bool b = false;
+    EXPECT_EQ(from_bytes(cblob(), &b), csubstr::npos);
+    char s[4];
+    substr ss(s, 4);
+    EXPECT_EQ(from_bytes(cblob(buf, 3), &ss), csubstr::npos);
+}
+
+TEST(bytes, bool_is_one_byte)
+{
+    char buf[2] = {};
+    EXPECT_EQ(to_bytes(buf, true), 1u);
+    EXPECT_EQ(buf[0], 1);
+    buf[0] = 42;
+    bool b = false;
+    EXPECT_EQ(from_bytes(cblob(buf, 1), &b), 1u);
+    EXPECT_TRUE(b);
+}
+
+TEST(bytes, cat_uncat)
+{
+    char buf[64] = {};
+    const char payload[] = {'\x00', '\x01', '\x02'};
+    const size_t sz = cat_bytes(buf, fmt::be(uint32_t(0xdeadbeef)), fmt::le(int16_t(-2)),
+                                uint8_t(7), cblob(payload, 3), csubstr("hello"), fmt::be(0.5), true);
+    EXPECT_EQ(sz, 4u + 2u + 1u + 3u + 5u + 8u + 1u);
+    expect_bytes(buf, {0xde, 0xad, 0xbe, 0xef, 0xfe, 0xff, 7, 0, 1, 2, 'h', 'e', 'l', 'l', 'o',
+                       0x3f, 0xe0, 0, 0, 0, 0, 0, 0, 1});
+
+    uint32_t a = 0;
+    int16_t b = 0;
+    uint8_t c = 0;
+    char pl[3] = {};
+    blob plb(pl, 3);
+    char str[5] = {};
+    substr strs(str, 5);
+    double d = 0;
+    bool e = false;
+    EXPECT_EQ(uncat_bytes(cblob(buf, sz), fmt::be(a), fmt::le(b), c, plb, strs, fmt::be(d), e), sz);
+    EXPECT_EQ(a, 0xdeadbeef);
+    EXPECT_EQ(b, -2);
+    EXPECT_EQ(c, 7);
+    EXPECT_EQ(memcmp(pl, payload, 3), 0);
+    EXPECT_EQ(strs, "hello");
+    EXPECT_EQ(d, 0.5);
+    EXPECT_TRUE(e);
+
+    // a truncated buffer fails
+    EXPECT_EQ(uncat_bytes(cblob(buf, sz - 1), fmt::be(a), fmt::le(b), c, plb, strs, fmt::be(d), e), csubstr::npos);
+}
+
+template<class Buf, class=void> struct can_cat_bytes : std::false_type {};
+template<class Buf> struct can_cat_bytes<Buf, decltype((void)cat_bytes(std::declval<Buf&>(), uint32_t(0)))> : std::true_type {};
+template<class Buf, class=void> struct can_to_bytes : std::false_type {};
+template<class Buf> struct can_to_bytes<Buf, decltype((void)to_bytes(std::declval<Buf&>(), uint32_t(0)))> : std::true_type {};
+
+TEST(bytes, to_from_bytes_substr)
+{
+    // the chars of the string are used, not the string object
+    static_assert(can_to_bytes<substr>::value, "");
+    static_assert( ! can_to_bytes<csubstr>::value, "the chars of a csubstr are read-only");
+    char storage[16] = {};
+    substr s(storage, sizeof(storage));
+    const substr before = s;
+    EXPECT_EQ(to_bytes(s, fmt::be(uint32_t(0xdeadbeef))), 4u);
+    EXPECT_EQ(s.str, before.str);
+    EXPECT_EQ(s.len, before.len);
+    expect_bytes(storage, {0xde, 0xad, 0xbe, 0xef, 0});
+    EXPECT_EQ(to_bytes(s.first(3), uint32_t(0)), 4u); // too small: no writes
+    EXPECT_EQ(storage[0], '\xde');
+    EXPECT_EQ(to_bytes(s.sub(4), csubstr("abc")), 3u);
+    EXPECT_EQ(csubstr(storage + 4, 3), "abc");
+
+    uint32_t v = 0;
+    EXPECT_EQ(from_bytes(s, fmt::be(v)), 4u);
+    EXPECT_EQ(v, 0xdeadbeefu);
+    v = 0;
+    const csubstr cs = s;
+    EXPECT_EQ(from_bytes(cs, fmt::be(v)), 4u);
+    EXPECT_EQ(v, 0xdeadbeefu);
+    uint16_t h = 0;
+    EXPECT_EQ(from_bytes(cs.sub(2), &h), 2u);
+    EXPECT_EQ(memcmp(&h, storage + 2, 2), 0);
+    EXPECT_EQ(from_bytes(cs.first(3), &v), csubstr::npos);
+    char out[3] = {};
+    substr outs(out, 3);
+    EXPECT_EQ(from_bytes(cs.sub(4), &outs), 3u);
+    EXPECT_EQ(csubstr(out, 3), "abc");
+}
+
+
+TEST(bytes, cat_uncat_substr)
+{
+    // the chars of the string are used, not the string object
+    static_assert(can_cat_bytes<substr>::value, "");
+    static_assert( ! can_cat_bytes<csubstr>::value, "the chars of a csubstr are read-only");
+    char storage[16] = {};
+    substr s(storage, sizeof(storage));
+    const substr before = s;
+    const size_t sz = cat_bytes(s, fmt::be(uint32_t(0x01020304)), fmt::le(uint64_t(0x05060708)));
+    EXPECT_EQ(sz, 12u);
+    EXPECT_EQ(s.str, before.str);
+    EXPECT_EQ(s.len, before.len);
+    expect_bytes(storage, {1, 2, 3, 4, 8, 7, 6, 5, 0, 0, 0, 0});
+    EXPECT_EQ(cat_bytes(s.first(3), fmt::be(uint32_t(0xffffffff))), 4u); // too small: no writes
+    EXPECT_EQ(storage[0], '\x01');
+
+    uint32_t a = 0;
+    uint64_t b = 0;
+    EXPECT_EQ(uncat_bytes(s, fmt::be(a), fmt::le(b)), sz);
+    EXPECT_EQ(a, 0x01020304u);
+    EXPECT_EQ(b, 0x05060708u);
+    a = 0;
+    b = 0;
+    const csubstr cs = s;
+    EXPECT_EQ(uncat_bytes(cs, fmt::be(a), fmt::le(b)), sz);
+    EXPECT_EQ(a, 0x01020304u);
+    EXPECT_EQ(b, 0x05060708u);
+    EXPECT_EQ(uncat_bytes(cs.first(11), fmt::be(a), fmt::le(b)), csubstr::npos);
+}
+
+TEST(bytes, cat_small_buffer)
+{
+    char buf[6] = {'x', 'x', 'x', 'x', 'x', 'x'};
+    // the second value does not fit: only the first is written
+    EXPECT_EQ(cat_bytes(blob(buf, 5), fmt::be(uint32_t(0x01020304)), fmt::be(uint16_t(0x0506))), 6u);
+    expect_bytes(buf, {1, 2, 3, 4, 'x', 'x'});
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+template<class U>
+struct bswap_impl_case
+{
+    const char *name;
+    void (*fn)(U*, U const*, size_t);
+};
+
+template<class U>
+std::vector<bswap_impl_case<U>> bswap_impls()
+{
+    std::vector<bswap_impl_case<U>> impls;
+    impls.push_back({"public", [](U *dst, U const* src, size_t num){ detail::bswap_n(dst, src, num); }});
+    impls.push_back({"scalar", [](U *dst, U const* src, size_t num){ detail::bswap_n_scalar(dst, src, num); }});
+#ifdef C4_BYTES_X86
+    if(cpu_has(CPU_SSSE3))
+        impls.push_back({"ssse3", [](U *dst, U const* src, size_t num){ detail::bswap_n_ssse3(dst, src, num); }});
+    if(cpu_has(CPU_AVX2))
+        impls.push_back({"avx2", [](U *dst, U const* src, size_t num){ detail::bswap_n_avx2(dst, src, num); }});
+#endif
+    return impls;
+}
+
+template<class U>
+void test_bswap_n()
+{
+    std::vector<U> src(301), expected(src.size());
+    uint64_t rng = 0x9e3779b97f4a7c15u;
+    for(size_t i = 0; i < src.size(); ++i)
+    {
+        // next_rand() has 53 bits: fill the high ones too
+        const uint64_t hi = next_rand(&rng) << 11;
+        src[i] = static_cast<U>(hi ^ next_rand(&rng));
+        expected[i] = byteswap(src[i]);
+    }
+    for(auto const& impl : bswap_impls<U>())
+    {
+        SCOPED_TRACE(impl.name);
+        for(size_t num = 0; num < src.size(); num += (num < 80 ? 1 : 37))
+        {
+            SCOPED_TRACE(num);
+            // copying, leaving the rest untouched
+            std::vector<U> dst(num + 1, U(42));
+            impl.fn(dst.data(), src.data(), num);
+            EXPECT_EQ(dst.back(), U(42));
+            dst.pop_back();
+            EXPECT_TRUE(std::equal(dst.begin(), dst.end(), expected.begin()));
+            // in place
+            dst.assign(src.begin(), src.begin() + static_cast<std::ptrdiff_t>(num));
+            impl.fn(dst.data(), dst.data(), num);
+            EXPECT_TRUE(std::equal(dst.begin(), dst.end(), expected.begin()));
+        }
+    }
+}
+
+TEST(bytes, bswap_n_16)
+{
+    test_bswap_n<uint16_t>();
+}
+
+TEST(bytes, bswap_n_32)
+{
+    test_bswap_n<uint32_t>();
+}
+
+TEST(bytes, bswap_n_64)
+{
+    test_bswap_n<uint64_t>();
+}
+
+TEST(bytes, byteswap_n)
+{
+    float f[40];
+    double d[40];
+    int16_t s[40];
+    for(int i = 0; i < 40; ++i)
+    {
+        f[i] = float(i) + 0.5f;
+        d[i] = -double(i) / 3;
+        s[i] = int16_t(-2 * i);
+    }
+    float fs[40];
+    byteswap_n(cspan<float>(f, 40), span<float>(fs, 40));
+    for(int i = 0; i < 40; ++i)
+    {
+        // the same bytes as written in the other order
+        char buf[4];
+#if C4_LITTLE_ENDIAN
+        to_bytes(buf, fmt::be(f[i]));
+#else
+        to_bytes(buf, fmt::le(f[i]));
+#endif
+        EXPECT_EQ(memcmp(fs + i, buf, 4), 0) << i;
+    }
+    byteswap_n(span<float>(fs, 40));
+    EXPECT_EQ(memcmp(fs, f, sizeof(f)), 0);
+    double dd[40];
+    memcpy(dd, d, sizeof(d));
+    byteswap_n(span<double>(dd, 40));
+    byteswap_n(span<double>(dd, 40));
+    EXPECT_EQ(memcmp(dd, d, sizeof(d)), 0);
+    byteswap_n(span<int16_t>(s, 40));
+    EXPECT_EQ(s[0], 0);
+    EXPECT_EQ(s[1], int16_t(-257));
+}
+
+TEST(bytes, to_le_be_n)
+{
+    // big-endian values in an unaligned buffer, as read from the network
+    char raw[1 + 33 * 4];
+    uint32_t expected[33];
+    for(uint32_t i = 0; i < 33; ++i)
+    {
+        expected[i] = 0x01020304u * (i + 1);
+        to_bytes(blob(raw + 1 + 4 * i, 4), fmt::be(expected[i]));
+    }
+    uint32_t vals[33];
+    memcpy(vals, raw + 1, sizeof(vals));
+    to_be_n(span<uint32_t>(vals, 33));
+    EXPECT_EQ(memcmp(vals, expected, sizeof(vals)), 0);
+    uint32_t copy[33];
+    to_be_n(cspan<uint32_t>(expected, 33), span<uint32_t>(copy, 33));
+    EXPECT_EQ(memcmp(copy, raw + 1, sizeof(copy)), 0);
+    // little-endian
+    for(uint32_t i = 0; i < 33; ++i)
+        to_bytes(blob(raw + 1 + 4 * i, 4), fmt::le(expected[i]));
+    memcpy(vals, raw + 1, sizeof(vals));
+    to_le_n(span<uint32_t>(vals, 33));
+    EXPECT_EQ(memcmp(vals, expected, sizeof(vals)), 0);
+    to_le_n(cspan<uint32_t>(expected, 33), span<uint32_t>(copy, 33));
+    EXPECT_EQ(memcmp(copy, raw + 1, sizeof(copy)), 0);
+}
+
+TEST(bytes, byteswap_n_from_span)
+{
+    // the source of the copying overloads needs not be a cspan
+    uint32_t vals[5] = {0x01020304u, 0x05060708u, 0u, 0xffffffffu, 0x000000ffu};
+    uint32_t out[5];
+    span<uint32_t> src(vals, 5);
+    byteswap_n(src, span<uint32_t>(out, 5));
+    for(size_t i = 0; i < 5; ++i)
+        EXPECT_EQ(out[i], byteswap(vals[i])) << i;
+    to_le_n(src, span<uint32_t>(out, 5));
+    for(size_t i = 0; i < 5; ++i)
+    {
+        char buf[4];
+        to_bytes(buf, fmt::le(vals[i]));
+        EXPECT_EQ(memcmp(out + i, buf, 4), 0) << i;
+    }
+    to_be_n(src, span<uint32_t>(out, 5));
+    for(size_t i = 0; i < 5; ++i)
+    {
+        char buf[4];
+        to_bytes(buf, fmt::be(vals[i]));
+        EXPECT_EQ(memcmp(out + i, buf, 4), 0) << i;
+    }
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
@@ -0,0 +1,326 @@
+#include "c4/test.hpp"
+#include "c4/charconv.hpp"
+#include "c4/thread_pool.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if C4_CPP >= 17
+#include <charconv>
+#endif
+#if C4_CPP >= 17 && defined(__cpp_lib_to_chars)
+#define C4_TEST_HAVE_TO_CHARS
+#endif
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+/* Round-trip checks of the conversions of real numbers. The floats
+ * are walked with a stride over all their bit patterns, and the
+ * doubles are sampled; set the environment variable
+ * C4_CHARCONV_EXHAUSTIVE=1 to walk all the 2^32 floats and to sample
+ * many more doubles. This takes a long time, so is meant to be run by
+ * hand when changing the conversions:
+ *
+ *     C4_CHARCONV_EXHAUSTIVE=1 ./c4core-test-charconv_real
+ *
+ * The work is split in shards run by a thread_pool. */
+
+namespace c4 {
+
+namespace {
+
+bool exhaustive()
+{
+    const char *e = ::getenv("C4_CHARCONV_EXHAUSTIVE");
+    return e && e[0] && e[0] != '0';
+}
+
+typedef enum {
+    /** the shortest FTOA_FLEX representation (or max_digits10 digits,
+     * when the conversion is not done with std::to_chars) parses back
+     * to the same value */
+    ROUNDTRIP_FLEX,
+    /** FTOA_SCIENT with max_digits10 digits parses back to the same value */
+    ROUNDTRIP_SCIENT,
+    /** the FTOA_FLEX output is the same as that of std::to_chars */
+    SAME_AS_STD_TO_CHARS,
+    /** parsing the FTOA_FLEX output gives the same as std::from_chars */
+    SAME_AS_STD_FROM_CHARS,
+    _NUM_CHECKS
+} RealCheck_e;
+
+const char *const check_names[_NUM_CHECKS] = {
+    "roundtrip_flex",
+    "roundtrip_scient",
+    "same_as_std_to_chars",
+    "same_as_std_from_chars",
+};
+
+inline size_t xtoa(substr buf, float v, int precision, RealFormat_e fmt) { return ftoa(buf, v, precision, fmt); }
+inline size_t xtoa(substr buf, double v, int precision, RealFormat_e fmt) { return dtoa(buf, v, precision, fmt); }
+inline bool atox(csubstr buf, float *v) { return atof(buf, v); }
+inline bool atox(csubstr buf, double *v) { return atod(buf, v); }
+
+template<class T>
+using bits_type = typename detail::real_buf<T>::type;
+
+template<class T>
+T from_bits(bits_type<T> bits)
+{
+    T v;
+    memcpy(&v, &bits, sizeof(T));
+    return v;
+}
+
+template<class T>
+bits_type<T> to_bits(T v)
+{
+    bits_type<T> bits;
+    memcpy(&bits, &v, sizeof(T));
+    return bits;
+}
+
+/** the precision giving a round-trip with FTOA_FLEX. std::to_chars
+ * gives the shortest representation, but printf needs all the
+ * digits. */
+template<class T>
+constexpr int flex_precision()
+{
+    return C4CORE_HAVE_STD_TOCHARS ? -1 : std::numeric_limits<T>::max_digits10;
+}
+
+/** @return a mask of the failed checks */
+template<class T>
+uint32_t check_real(T v)
+{
+    uint32_t failed = 0;
+    T w = T(0);
+    char flex_buf[64];
+    const size_t flex_len = xtoa(flex_buf, v, flex_precision<T>(), FTOA_FLEX);
+    const csubstr flex(flex_buf, flex_len <= sizeof(flex_buf) ? flex_len : 0);
+    if(flex.len != flex_len || !atox(flex, &w) || to_bits(w) != to_bits(v))
+        failed |= uint32_t(1) << ROUNDTRIP_FLEX;
+    char scient_buf[64];
+    const size_t scient_len = xtoa(scient_buf, v, std::numeric_limits<T>::max_digits10 - 1, FTOA_SCIENT);
+    const csubstr scient(scient_buf, scient_len <= sizeof(scient_buf) ? scient_len : 0);
+    w = T(0);
+    if(scient.len != scient_len || !atox(scient, &w) || to_bits(w) != to_bits(v))
+        failed |= uint32_t(1) << ROUNDTRIP_SCIENT;
+#ifdef C4_TEST_HAVE_TO_CHARS
+    if(flex.len == flex_len)
+    {
+        char std_buf[64];
+        std::to_chars_result r = flex_precision<T>() == -1 ?
+            std::to_chars(std_buf, std_buf + sizeof(std_buf), v, std::chars_format::general) :
+            std::to_chars(std_buf, std_buf + sizeof(std_buf), v, std::chars_format::general, flex_precision<T>());
+        if(r.ec != std::errc() || csubstr(std_buf, static_cast<size_t>(r.ptr - std_buf)) != flex)
+            failed |= uint32_t(1) << SAME_AS_STD_TO_CHARS;
+        T s = T(0);
+        w = T(0);
+        if(std::from_chars(flex.begin(), flex.end(), s).ec != std::errc() || !atox(flex, &w) || to_bits(w) != to_bits(s))
+            failed |= uint32_t(1) << SAME_AS_STD_FROM_CHARS;
+    }
+#endif
+    return failed;
+}
+
+/** the results of the checks, accumulated by the shards */
+struct check_results
+{
+    std::atomic<uint64_t> num_checked{0};
+    std::atomic<uint64_t> num_failed[_NUM_CHECKS];
+    std::atomic<uint64_t> first_failed[_NUM_CHECKS]; ///< the bits of a failed value, plus one
+
+    check_results()
+    {
+        for(int i = 0; i < _NUM_CHECKS; ++i)
+        {
+            num_failed[i] = 0;
+            first_failed[i] = 0;
+        }
+    }
+
+    template<class T>
+    void check(T v)
+    {
+        const uint32_t failed = check_real(v);
+        if(C4_LIKELY( ! failed))
+            return;
+        for(int i = 0; i < _NUM_CHECKS; ++i)
+        {
+            if( ! (failed & (uint32_t(1) << i)))
+                continue;
+            ++num_failed[i];
+            uint64_t none = 0;
+            first_failed[i].compare_exchange_strong(none, uint64_t(to_bits(v)) + 1u);
+        }
+    }
+
+    template<class T>
+    void verify() const
+    {
+        EXPECT_GT(num_checked.load(), 0u);
+        for(int i = 0; i < _NUM_CHECKS; ++i)
+        {
+            EXPECT_EQ(num_failed[i].load(), 0u) << check_names[i];
+            if(first_failed[i].load())
+            {
+                const T v = from_bits<T>(static_cast<bits_type<T>>(first_failed[i].load() - 1u));
+                char buf[64];
+                const size_t len = xtoa(buf, v, std::numeric_limits<T>::max_digits10, FTOA_SCIENT);
+                ADD_FAILURE() << check_names[i] << ": first failure for " << std::string(buf, len < sizeof(buf) ? len : 0);
+            }
+        }
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+
+/** some values of interest: the limits and neighbours of the powers
+ * of ten and two */
+template<class T>
+std::vector<T> special_values()
+{
+    using nl = std::numeric_limits<T>;
+    std::vector<T> v = {
+        T(0), T(1), T(0.1), T(0.2), T(0.3), T(0.5), T(2) / T(3), T(100.01),
+        nl::min(), nl::max(), nl::denorm_min(), nl::epsilon(), nl::lowest(),
+        std::nextafter(nl::min(), T(0)), std::nextafter(nl::max(), T(0)),
+        std::ldexp(T(1), nl::digits), std::ldexp(T(1), nl::digits) + T(2),
+    };
+    for(int e = nl::min_exponent10; e <= nl::max_exponent10; ++e)
+    {
+        const T p = static_cast<T>(std::pow(10., e));
+        v.push_back(p);
+        v.push_back(std::nextafter(p, T(0)));
+        v.push_back(std::nextafter(p, nl::infinity()));
+    }
+    const size_t sz = v.size();
+    for(size_t i = 0; i < sz; ++i)
+        v.push_back(-v[i]);
+    return v;
+}
+
+/** doubles of interest: random bit patterns, and numbers as they occur
+ * in practice (prices, integers, and values of any magnitude) */
+std::vector<double> sample_doubles(size_t num)
+{
+    std::vector<double> v;
+    v.reserve(num);
+    uint64_t rng = UINT64_C(0x9e3779b97f4a7c15);
+    auto next = [&rng]{
+        rng ^= rng << 13u;
+        rng ^= rng >> 7u;
+        rng ^= rng << 17u;
+        return rng;
+    };
+    while(v.size() < num)
+    {
+        const uint64_t r = next();
+        switch(r & 3u)
+        {
+        case 0: // any bit pattern
+        {
+            const double d = from_bits<double>(next());
+            if(std::isfinite(d))
+                v.push_back(d);
+            break;
+        }
+        case 1: // prices
+            v.push_back(static_cast<double>((r >> 2) % 100000000u) / 100.);
+            break;
+        case 2: // integers
+            v.push_back(static_cast<double>(static_cast<int64_t>(r) >> (r & 0x3fu)));
+            break;
+        case 3: // any magnitude
+        {
+            const double d = static_cast<double>(r >> 11) * std::pow(10., static_cast<int>((r >> 2) % 600u) - 300);
+            if(std::isfinite(d))
+                v.push_back(d);
+            break;
+        }
+        }
+    }
+    return v;
+}
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+TEST(charconv_real, special_values_float)
+{
+    check_results results;
+    for(float f : special_values<float>())
+    {
+        results.check(f);
+        ++results.num_checked;
+    }
+    results.verify<float>();
+}
+
+TEST(charconv_real, special_values_double)
+{
+    check_results results;
+    for(double d : special_values<double>())
+    {
+        results.check(d);
+        ++results.num_checked;
+    }
+    results.verify<double>();
+}
+
+TEST(charconv_real, all_floats)
+{
+    // with the stride, about a quarter million floats of every
+    // exponent and sign
+    const uint64_t stride = exhaustive() ? 1u : 16381u;
+    const uint64_t shard_size = uint64_t(1) << 20;
+    std::vector<uint32_t> shards(size_t((uint64_t(1) << 32) / shard_size));
+    for(size_t i = 0; i < shards.size(); ++i)
+        shards[i] = static_cast<uint32_t>(i);
+    check_results results;
+    thread_pool pool;
+    pool.parallel_for(span<uint32_t>(shards.data(), shards.size()), 1, [&](span<uint32_t> s){
+        for(uint32_t shard : s)
+        {
+            const uint64_t begin = uint64_t(shard) * shard_size, end = begin + shard_size;
+            uint64_t num_checked = 0;
+            for(uint64_t bits = (begin + stride - 1) / stride * stride; bits < end; bits += stride)
+            {
+                const float f = from_bits<float>(static_cast<uint32_t>(bits));
+                if( ! std::isfinite(f)) // inf and nan are not parsed by atof()
+                    continue;
+                results.check(f);
+                ++num_checked;
+            }
+            results.num_checked += num_checked;
+        }
+    });
+    results.verify<float>();
+}
+
+TEST(charconv_real, sampled_doubles)
+{
+    std::vector<double> samples = sample_doubles(exhaustive() ? size_t(1) << 26 : size_t(1) << 18);
+    check_results results;
+    thread_pool pool;
+    pool.parallel_for(span<double>(samples.data(), samples.size()), 0, [&](span<double> s){
+        for(double d : s)
+            results.check(d);
+        results.num_checked += s.size();
+    });
+    EXPECT_EQ(results.num_checked.load(), samples.size());
+    results.verify<double>();
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
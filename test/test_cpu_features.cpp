@@ -0,0 +1,81 @@
+#include "c4/test.hpp"
+#include "c4/cpu_features.hpp"
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+TEST(cpu_features, consistent)
+{
+    const cpu_feature_flags f = cpu_features();
+    EXPECT_EQ(cpu_features(), f);
+    EXPECT_TRUE(cpu_has(0));
+    EXPECT_FALSE(cpu_has(~f));
+    // each extension implies the previous ones
+    const cpu_feature_flags chain[] = {CPU_SSE2, CPU_SSE3, CPU_SSSE3, CPU_SSE41, CPU_SSE42, CPU_AVX, CPU_AVX2, CPU_AVX512F};
+    for(size_t i = 1; i < C4_COUNTOF(chain); ++i)
+    {
+        if(cpu_has(chain[i]))
+        {
+            EXPECT_TRUE(cpu_has(chain[i - 1])) << i;
+        }
+    }
+    EXPECT_EQ(cpu_has(CPU_SSE42), cpu_has(CPU_SSE42|CPU_CRC32));
+#if defined(C4_CPU_X86_64)
+    EXPECT_TRUE(cpu_has(CPU_SSE2)); // part of x86-64
+#elif defined(C4_CPU_ARM64)
+    EXPECT_TRUE(cpu_has(CPU_NEON));
+#endif
+}
+
+#if (defined(C4_CPU_X86_64) || defined(C4_CPU_X86)) && (defined(__GNUC__) || defined(__clang__))
+TEST(cpu_features, matches_compiler)
+{
+    __builtin_cpu_init();
+    EXPECT_EQ(cpu_has(CPU_SSE2), (bool)__builtin_cpu_supports("sse2"));
+    EXPECT_EQ(cpu_has(CPU_SSSE3), (bool)__builtin_cpu_supports("ssse3"));
+    EXPECT_EQ(cpu_has(CPU_SSE42), (bool)__builtin_cpu_supports("sse4.2"));
+    EXPECT_EQ(cpu_has(CPU_POPCNT), (bool)__builtin_cpu_supports("popcnt"));
+    EXPECT_EQ(cpu_has(CPU_AVX), (bool)__builtin_cpu_supports("avx"));
+    EXPECT_EQ(cpu_has(CPU_AVX2), (bool)__builtin_cpu_supports("avx2"));
+    EXPECT_EQ(cpu_has(CPU_BMI2), (bool)__builtin_cpu_supports("bmi2"));
+    EXPECT_EQ(cpu_has(CPU_AVX512F), (bool)__builtin_cpu_supports("avx512f"));
+}
+#endif
+
+int select_a() { return 1; }
+int select_b() { return 2; }
+int select_c() { return 3; }
+
+TEST(cpu_features, select)
+{
+    typedef int (*fn)();
+    EXPECT_EQ(cpu_select<fn>(&select_c)(), 3);
+    EXPECT_EQ(cpu_select<fn>(0, &select_a, &select_c)(), 1);
+    EXPECT_EQ(cpu_select<fn>(~cpu_features(), &select_a, &select_c)(), 3);
+    EXPECT_EQ(cpu_select<fn>(~cpu_features(), &select_a, 0, &select_b, &select_c)(), 2);
+    EXPECT_EQ(cpu_select<fn>(cpu_features(), &select_a, 0, &select_b, &select_c)(), 1);
+    EXPECT_EQ(cpu_select(CPU_SSE2|CPU_NEON, 10, 20), 20); // never both
+}
+
+TEST(cpu_features, to_chars)
+{
+    char buf_[256];
+    substr buf(buf_, sizeof(buf_));
+    EXPECT_EQ(cpu_features_to_chars(buf, 0), 0u);
+    size_t len = cpu_features_to_chars(buf, CPU_SSE2|CPU_SSE41|CPU_CRC32);
+    EXPECT_EQ(buf.first(len), "sse2 sse4.1 crc32");
+    EXPECT_EQ(cpu_features_to_chars(buf.first(4), CPU_SSE2|CPU_SSE41), 11u);
+    EXPECT_EQ(buf.first(4), "sse2");
+    len = cpu_features_to_chars(buf, cpu_features());
+    ASSERT_LE(len, buf.len);
+    csubstr names = buf.first(len);
+    // the names of this cpu's features are separated by single spaces
+    EXPECT_FALSE(names.begins_with(' ')) << names;
+    EXPECT_FALSE(names.ends_with(' ')) << names;
+    EXPECT_EQ(names.find("  "), csubstr::npos) << names;
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
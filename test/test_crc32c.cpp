@@ -0,0 +1,167 @@
+#include "c4/test.hpp"
+#include "c4/crc32c.hpp"
+#include "c4/cpu_features.hpp"
+#include "c4/substr.hpp"
+
+#include <vector>
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+namespace {
+
+typedef uint32_t (*crc32c_fn)(uint32_t, const void*, size_t);
+
+struct crc32c_impl
+{
+    const char *name;
+    crc32c_fn fn;
+};
+
+std::vector<crc32c_impl> crc32c_impls()
+{
+    std::vector<crc32c_impl> impls;
+    impls.push_back({"public", &crc32c_update});
+    impls.push_back({"table", &detail::crc32c_update_table});
+#ifdef C4_CRC32C_SSE42
+    if(cpu_has(CPU_SSE42))
+        impls.push_back({"sse42", &detail::crc32c_update_sse42});
+#endif
+#ifdef C4_CRC32C_ARMV8
+    impls.push_back({"armv8", &detail::crc32c_update_armv8});
+#endif
+    return impls;
+}
+
+/** a bitwise reference implementation */
+uint32_t crc32c_reference(const void *data, size_t len)
+{
+    const uint8_t *p = static_cast<const uint8_t*>(data);
+    uint32_t crc = 0xffffffffu;
+    for(size_t i = 0; i < len; ++i)
+    {
+        crc ^= p[i];
+        for(int k = 0; k < 8; ++k)
+            crc = (crc & 1u) ? (crc >> 1) ^ 0x82f63b78u : crc >> 1;
+    }
+    return ~crc;
+}
+
+std::vector<uint8_t> crc32c_data(size_t len)
+{
+    std::vector<uint8_t> data(len);
+    uint32_t x = 0x12345678u;
+    for(uint8_t &c : data)
+    {
+        x = x * 1103515245u + 12345u;
+        c = static_cast<uint8_t>(x >> 16);
+    }
+    return data;
+}
+
+} // anonymous namespace
+
+
+TEST(crc32c, known_vectors)
+{
+    // from RFC 3720, B.4
+    uint8_t zeros[32] = {}, ones[32], incr[32], decr[32];
+    for(uint8_t i = 0; i < 32; ++i)
+    {
+        ones[i] = 0xff;
+        incr[i] = i;
+        decr[i] = static_cast<uint8_t>(31 - i);
+    }
+    for(crc32c_impl const& impl : crc32c_impls())
+    {
+        SCOPED_TRACE(impl.name);
+        EXPECT_EQ(impl.fn(0, "", 0), 0u);
+        EXPECT_EQ(impl.fn(0, "123456789", 9), 0xe3069283u);
+        EXPECT_EQ(impl.fn(0, zeros, sizeof(zeros)), 0x8a9136aau);
+        EXPECT_EQ(impl.fn(0, ones, sizeof(ones)), 0x62a8ab43u);
+        EXPECT_EQ(impl.fn(0, incr, sizeof(incr)), 0x46dd794eu);
+        EXPECT_EQ(impl.fn(0, decr, sizeof(decr)), 0x113fdb5cu);
+    }
+    csubstr s = "123456789";
+    EXPECT_EQ(crc32c(cblob(s.str, s.len)), 0xe3069283u);
+    EXPECT_EQ(crc32c(s.str, s.len), 0xe3069283u);
+}
+
+TEST(crc32c, lengths_and_alignments)
+{
+    // large enough to go through the interleaved blocks of the
+    // hardware implementations
+    const std::vector<uint8_t> data = crc32c_data(3 * 8192 + 3 * 256 + 100);
+    const size_t lengths[] = {0, 1, 7, 8, 9, 63, 64, 767, 768, 769, 1000, 3 * 8192 - 1, 3 * 8192, 3 * 8192 + 3 * 256 + 17};
+    for(crc32c_impl const& impl : crc32c_impls())
+    {
+        SCOPED_TRACE(impl.name);
+        for(size_t offset = 0; offset < 9; ++offset)
+        {
+            for(size_t len : lengths)
+            {
+                if(offset + len > data.size())
+                    continue;
+                const uint8_t *p = data.data() + offset;
+                EXPECT_EQ(impl.fn(0, p, len), crc32c_reference(p, len)) << "offset=" << offset << " len=" << len;
+            }
+        }
+    }
+}
+
+TEST(crc32c, update_in_pieces)
+{
+    const std::vector<uint8_t> data = crc32c_data(30000);
+    const uint32_t expected = crc32c(data.data(), data.size());
+    for(crc32c_impl const& impl : crc32c_impls())
+    {
+        SCOPED_TRACE(impl.name);
+        for(size_t split : {size_t(1), size_t(5), size_t(8), size_t(1001), size_t(25000)})
+        {
+            uint32_t crc = impl.fn(0, data.data(), split);
+            crc = impl.fn(crc, data.data() + split, data.size() - split);
+            EXPECT_EQ(crc, expected) << "split=" << split;
+        }
+    }
+}
+
+TEST(crc32c_hasher, chunks)
+{
+    const std::vector<uint8_t> data = crc32c_data(5000);
+    const uint32_t expected = crc32c(cblob(data.data(), data.size()));
+    for(size_t chunk : {size_t(1), size_t(3), size_t(64), size_t(1000), size_t(5000)})
+    {
+        crc32c_hasher h;
+        EXPECT_EQ(h.digest(), 0u);
+        for(size_t pos = 0; pos < data.size(); pos += chunk)
+        {
+            size_t n = data.size() - pos < chunk ? data.size() - pos : chunk;
+            h.update(cblob(data.data() + pos, n));
+        }
+        EXPECT_EQ(h.digest(), expected) << "chunk=" << chunk;
+        h.reset();
+        EXPECT_EQ(h.digest(), 0u);
+        h.update("123456789", 9);
+        EXPECT_EQ(h.digest(), 0xe3069283u);
+    }
+}
+
+TEST(crc32c, substr)
+{
+    // the chars of the string are hashed, not the string object
+    char buf[] = "hello world";
+    substr s(buf, 11);
+    csubstr cs = s;
+    EXPECT_EQ(crc32c(s), crc32c(s.str, s.len));
+    EXPECT_EQ(crc32c(cs), crc32c(cs.str, cs.len));
+    EXPECT_EQ(crc32c(cs), 0xc99465aau);
+    crc32c_hasher h;
+    h.update(cs.first(5));
+    h.update(s.sub(5));
+    EXPECT_EQ(h.digest(), crc32c(cs));
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
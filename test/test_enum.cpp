@@ -1,3 +1,4 @@
+#include <string>
 #include <vector>
 
 #include <c4/enum.hpp>
@@ -151,4 +152,111 @@ TEST(e2str, scoped_bitmask)
     cmp_enum(c4::str2e<MyBitmaskClass>("FOO"), MyBitmaskClass::BM_FOO);
 }
 
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+// large enums to exercise the index: one with contiguous values, and
+// one with sparse values. Both have an alias for a value.
+enum class ManySyms : int32_t {};
+enum class SparseSyms : int64_t {};
+
+namespace c4 {
+template<class Enum, size_t N>
+struct LargeEnumSyms
+{
+    enum : size_t { num_names = N - 1 };
+    char names[N][32];
+    typename EnumSymbols<Enum>::Sym syms[N];
+    LargeEnumSyms(const char *pfx, int64_t (*value)(size_t))
+    {
+        for(size_t i = 0; i < num_names; ++i)
+        {
+            snprintf(names[i], sizeof(names[i]), "%sSYM_%zu", pfx, i);
+            syms[i] = {static_cast<Enum>(value(i)), names[i]};
+        }
+        // an alias, which must not be found from its value
+        snprintf(names[N - 1], sizeof(names[N - 1]), "%sALIAS_7", pfx);
+        syms[N - 1] = {static_cast<Enum>(value(7)), names[N - 1]};
+    }
+};
+
+template<>
+inline const EnumSymbols<ManySyms> esyms<ManySyms>()
+{
+    static const LargeEnumSyms<ManySyms, 301> s("ManySyms::", [](size_t i){ return int64_t(i) + 10; });
+    return EnumSymbols<ManySyms>(s.syms);
+}
+template<> inline size_t eoffs_cls<ManySyms>() { return 10; } // strlen("ManySyms::")
+template<> inline size_t eoffs_pfx<ManySyms>() { return 14; } // strlen("ManySyms::SYM_")
+
+template<>
+inline const EnumSymbols<SparseSyms> esyms<SparseSyms>()
+{
+    static const LargeEnumSyms<SparseSyms, 301> s("", [](size_t i){ return int64_t(i * i * 37) - 5000; });
+    return EnumSymbols<SparseSyms>(s.syms);
+}
+} // namespace c4
+
+template<class Enum>
+void test_eindex()
+{
+    using namespace c4;
+    using I = typename std::underlying_type<Enum>::type;
+    auto ss = esyms<Enum>();
+    EnumIndex<Enum> const& idx = eindex<Enum>();
+    EXPECT_EQ(&idx, &eindex<Enum>());
+    EXPECT_EQ(idx.symbols().begin(), ss.begin());
+    for(auto const& p : ss)
+    {
+        EXPECT_EQ(idx.find(p.name), ss.find(p.name)) << p.name;
+        EXPECT_EQ(idx.find(p.value), ss.find(p.value)) << p.name;
+        EXPECT_EQ(idx.find(p.name, strlen(p.name)), ss.find(p.name, strlen(p.name))) << p.name;
+        for(EnumOffsetType ot : {EOFFS_CLS, EOFFS_PFX})
+        {
+            const char *name = p.name_offs(ot);
+            EXPECT_EQ(idx.find(name), ss.find(name)) << name;
+            EXPECT_NE(idx.find(name), nullptr) << name;
+        }
+        // values and names which are not in the enum
+        EXPECT_EQ(idx.find(static_cast<Enum>(static_cast<I>(p.value) + 1)), ss.find(static_cast<Enum>(static_cast<I>(p.value) + 1)));
+        std::string longer = std::string(p.name) + "_";
+        EXPECT_EQ(idx.find(longer.c_str()), nullptr) << longer;
+    }
+    EXPECT_EQ(idx.find(""), nullptr);
+    EXPECT_EQ(idx.find("nope"), nullptr);
+}
+
+TEST(eindex, small_enums)
+{
+    test_eindex<MyEnum>();
+    test_eindex<MyEnumClass>();
+    test_eindex<MyBitmask>();
+    test_eindex<MyBitmaskClass>();
+}
+
+TEST(eindex, large_contiguous_enum)
+{
+    test_eindex<ManySyms>();
+    auto const& idx = c4::eindex<ManySyms>();
+    EXPECT_STREQ(c4::e2str(static_cast<ManySyms>(17)), "ManySyms::SYM_7");
+    EXPECT_STREQ(idx.find("ALIAS_7")->name, "ManySyms::ALIAS_7");
+    EXPECT_STREQ(idx.find("299")->name, "ManySyms::SYM_299");
+    cmp_enum(c4::str2e<ManySyms>("ManySyms::SYM_299"), static_cast<ManySyms>(309));
+    cmp_enum(c4::str2e<ManySyms>("SYM_42"), static_cast<ManySyms>(52));
+    EXPECT_EQ(idx.find(static_cast<ManySyms>(9)), nullptr);
+    EXPECT_EQ(idx.find(static_cast<ManySyms>(310)), nullptr);
+}
+
+TEST(eindex, large_sparse_enum)
+{
+    test_eindex<SparseSyms>();
+    EXPECT_STREQ(c4::e2str(static_cast<SparseSyms>(-5000)), "SYM_0");
+    EXPECT_STREQ(c4::e2str(static_cast<SparseSyms>(7 * 7 * 37 - 5000)), "SYM_7");
+    cmp_enum(c4::str2e<SparseSyms>("SYM_299"), static_cast<SparseSyms>(299 * 299 * 37 - 5000));
+    EXPECT_EQ(c4::eindex<SparseSyms>().find(static_cast<SparseSyms>(-4999)), nullptr);
+}
+
 #include "c4/libtest/supprwarn_pop.hpp"
@@ -0,0 +1,403 @@
+#include "c4/test.hpp"
+#include "c4/eytzinger.hpp"
+#include "c4/cpu_features.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "c4/libtest/rng.hpp"
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+namespace {
+
+/** sorted keys, with duplicates, and with gaps to search for */
+template<class T>
+std::vector<T> sorted_keys(size_t num, uint64_t seed)
+{
+    std::vector<T> keys(num);
+    T v = std::is_signed<T>::value ? T(-5) : T(3);
+    for(T &k : keys)
+    {
+        v = static_cast<T>(v + T(next_rand(&seed) % 3u));
+        k = v;
+    }
+    return keys;
+}
+
+template<class T>
+void test_set_vs_lower_bound(std::vector<T> const& keys)
+{
+    eytzinger_set<T> set(cspan<T>(keys.data(), keys.size()));
+    stree_set<T> stree(cspan<T>(keys.data(), keys.size()));
+    ASSERT_EQ(set.size(), keys.size());
+    ASSERT_EQ(stree.size(), keys.size());
+    // the keys in ascending order
+    size_t i = 0;
+    for(size_t slot = set.first(); slot != set.npos; slot = set.next(slot), ++i)
+        ASSERT_EQ(set.key(slot), keys[i]);
+    ASSERT_EQ(i, keys.size());
+    const T lo = keys.empty() ? T(0) : keys.front();
+    const T hi = keys.empty() ? T(0) : keys.back();
+    for(T x = static_cast<T>(lo - T(2)); x <= static_cast<T>(hi + T(2)); x = static_cast<T>(x + T(1)))
+    {
+        const auto it = std::lower_bound(keys.begin(), keys.end(), x);
+        const size_t slot = set.lower_bound(x);
+        const size_t sslot = stree.lower_bound(x);
+        if(it == keys.end())
+        {
+            EXPECT_EQ(slot, set.npos) << x;
+            EXPECT_EQ(sslot, stree.npos) << x;
+            EXPECT_FALSE(set.contains(x));
+            EXPECT_FALSE(stree.contains(x));
+            continue;
+        }
+        ASSERT_NE(slot, set.npos) << x;
+        ASSERT_NE(sslot, stree.npos) << x;
+        EXPECT_EQ(set.key(slot), *it) << x;
+        EXPECT_EQ(stree.key(sslot), *it) << x;
+        // the first of the duplicates: all the following are in order
+        size_t rank = 0;
+        for(size_t s = slot; s != set.npos; s = set.next(s))
+            ++rank;
+        EXPECT_EQ(rank, static_cast<size_t>(keys.end() - it)) << x;
+        EXPECT_EQ(set.contains(x), *it == x) << x;
+        EXPECT_EQ(stree.contains(x), *it == x) << x;
+        EXPECT_EQ(set.find(x) == set.npos, *it != x) << x;
+    }
+}
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+TEST(eytzinger_set, empty)
+{
+    eytzinger_set<int> set;
+    EXPECT_TRUE(set.empty());
+    EXPECT_EQ(set.first(), set.npos);
+    EXPECT_EQ(set.lower_bound(0), set.npos);
+    EXPECT_FALSE(set.contains(0));
+    stree_set<int> stree;
+    EXPECT_TRUE(stree.empty());
+    EXPECT_EQ(stree.lower_bound(0), stree.npos);
+    EXPECT_FALSE(stree.contains(0));
+}
+
+TEST(eytzinger_set, all_sizes)
+{
+    for(size_t num = 0; num < 300; ++num)
+    {
+        SCOPED_TRACE(num);
+        test_set_vs_lower_bound(sorted_keys<int32_t>(num, num));
+    }
+}
+
+TEST(eytzinger_set, types)
+{
+    for(size_t num : {1u, 17u, 100u, 1000u, 5000u})
+    {
+        SCOPED_TRACE(num);
+        test_set_vs_lower_bound(sorted_keys<uint8_t>(num < 100 ? num : 100, num));
+        test_set_vs_lower_bound(sorted_keys<int16_t>(num, num));
+        test_set_vs_lower_bound(sorted_keys<uint32_t>(num, num));
+        test_set_vs_lower_bound(sorted_keys<int64_t>(num, num));
+        test_set_vs_lower_bound(sorted_keys<uint64_t>(num, num));
+        test_set_vs_lower_bound(sorted_keys<double>(num, num));
+    }
+}
+
+TEST(eytzinger_set, reals)
+{
+    const std::vector<float> keys = {-1e30f, -2.5f, -1.f, -0.f, 0.5f, 1.f, 1.f, 3.f, 1e30f};
+    eytzinger_set<float> set(cspan<float>(keys.data(), keys.size()));
+    stree_set<float> stree(cspan<float>(keys.data(), keys.size()));
+    EXPECT_EQ(set.key(set.lower_bound(-2.f)), -1.f);
+    EXPECT_EQ(stree.key(stree.lower_bound(-2.f)), -1.f);
+    EXPECT_EQ(set.key(set.lower_bound(0.75f)), 1.f);
+    EXPECT_EQ(stree.key(stree.lower_bound(0.75f)), 1.f);
+    EXPECT_EQ(stree.key(stree.lower_bound(-1e31f)), -1e30f);
+    EXPECT_EQ(stree.lower_bound(2e30f), stree.npos);
+    EXPECT_TRUE(stree.contains(-0.f));
+    EXPECT_TRUE(std::signbit(stree.key(stree.find(-0.f))));
+}
+
+TEST(eytzinger_set, large)
+{
+    uint64_t rng = 1;
+    std::vector<uint32_t> keys(200000);
+    for(uint32_t &k : keys)
+        k = static_cast<uint32_t>(next_rand(&rng));
+    std::sort(keys.begin(), keys.end());
+    eytzinger_set<uint32_t> set(cspan<uint32_t>(keys.data(), keys.size()));
+    stree_set<uint32_t> stree(cspan<uint32_t>(keys.data(), keys.size()));
+    for(size_t i = 0; i < 20000; ++i)
+    {
+        const uint32_t x = static_cast<uint32_t>(next_rand(&rng));
+        const auto it = std::lower_bound(keys.begin(), keys.end(), x);
+        const size_t slot = set.lower_bound(x);
+        const size_t sslot = stree.lower_bound(x);
+        if(it == keys.end())
+        {
+            EXPECT_EQ(slot, set.npos);
+            EXPECT_EQ(sslot, stree.npos);
+        }
+        else
+        {
+            ASSERT_NE(slot, set.npos);
+            ASSERT_NE(sslot, stree.npos);
+            EXPECT_EQ(set.key(slot), *it);
+            EXPECT_EQ(stree.key(sslot), *it);
+        }
+        EXPECT_TRUE(set.contains(keys[i]));
+        EXPECT_TRUE(stree.contains(keys[i]));
+    }
+}
+
+TEST(eytzinger_set, unsorted)
+{
+    const std::vector<int> keys = {1, 3, 2};
+    {
+        C4_EXPECT_ERROR_OCCURS(1);
+        eytzinger_set<int> set(cspan<int>(keys.data(), keys.size()));
+    }
+    {
+        C4_EXPECT_ERROR_OCCURS(1);
+        stree_set<int> set(cspan<int>(keys.data(), keys.size()));
+    }
+}
+
+TEST(eytzinger_set, copy_and_move)
+{
+    const std::vector<int> keys = sorted_keys<int>(100, 1);
+    eytzinger_set<int> a(cspan<int>(keys.data(), keys.size()));
+    eytzinger_set<int> b(a);
+    eytzinger_set<int> c;
+    c = b;
+    eytzinger_set<int> d(std::move(b));
+    EXPECT_TRUE(b.empty());
+    for(int k : keys)
+    {
+        EXPECT_TRUE(c.contains(k));
+        EXPECT_TRUE(d.contains(k));
+    }
+    // copies of empty sets: default-constructed, moved-from, cleared
+    eytzinger_set<int> e;
+    eytzinger_set<int> e_copy(e);
+    EXPECT_TRUE(e_copy.empty());
+    EXPECT_FALSE(e_copy.contains(1));
+    eytzinger_set<int> b_copy(b);
+    EXPECT_TRUE(b_copy.empty());
+    c.clear();
+    eytzinger_set<int> c_copy(c);
+    EXPECT_TRUE(c_copy.empty());
+    c_copy = d;
+    EXPECT_TRUE(c_copy.contains(keys[0]));
+    c_copy = c;
+    EXPECT_TRUE(c_copy.empty());
+    EXPECT_EQ(c_copy.lower_bound(keys[0]), c_copy.npos);
+    // the same for the map, which copies its set
+    eytzinger_map<int, int> m(cspan<int>(keys.data(), keys.size()), cspan<int>(keys.data(), keys.size()));
+    eytzinger_map<int, int> em;
+    eytzinger_map<int, int> em_copy(em);
+    EXPECT_TRUE(em_copy.empty());
+    EXPECT_EQ(em_copy.find(keys[0]), nullptr);
+    eytzinger_map<int, int> m_moved(std::move(m));
+    eytzinger_map<int, int> m_copy(m);
+    EXPECT_TRUE(m_copy.empty());
+    m_moved.clear();
+    eytzinger_map<int, int> cleared_copy(m_moved);
+    EXPECT_TRUE(cleared_copy.empty());
+    cleared_copy = em;
+    EXPECT_TRUE(cleared_copy.empty());
+    stree_set<int> s(cspan<int>(keys.data(), keys.size()));
+    stree_set<int> t(s);
+    stree_set<int> u(std::move(s));
+    for(int k : keys)
+    {
+        EXPECT_TRUE(t.contains(k));
+        EXPECT_TRUE(u.contains(k));
+    }
+}
+
+TEST(eytzinger_set, strings)
+{
+    std::vector<std::string> strs = {
+        "", "a", "abcdefg", "abcdefgh", "abcdefghi", "abcdefghij", "abcdefgi",
+        "b", "ba", "foo", "foobar0", "foobar01", "foobar012", "foobar013", "z", "\xff",
+    };
+    strs.push_back(std::string("abcdefgh\0", 9));
+    std::sort(strs.begin(), strs.end());
+    std::vector<csubstr> keys;
+    for(std::string const& s : strs)
+        keys.push_back(csubstr(s.data(), s.size()));
+    eytzinger_set<csubstr> set(cspan<csubstr>(keys.data(), keys.size()));
+    for(size_t i = 0; i < strs.size(); ++i)
+    {
+        const size_t slot = set.find(keys[i]);
+        ASSERT_NE(slot, set.npos) << i;
+        EXPECT_EQ(set.key(slot).str, keys[i].str);
+        // with a copy of the string, ie by the contents
+        const std::string copy = strs[i];
+        EXPECT_EQ(set.key(set.lower_bound(csubstr(copy.data(), copy.size()))).str, keys[i].str);
+    }
+    EXPECT_EQ(set.key(set.lower_bound("abcdefgh0")), "abcdefghi");
+    EXPECT_EQ(set.key(set.lower_bound("foobar00")), "foobar01");
+    EXPECT_EQ(set.key(set.lower_bound("foobar0120")), "foobar013");
+    EXPECT_EQ(set.key(set.lower_bound("c")), "foo");
+    EXPECT_EQ(set.lower_bound("\xff\xff"), set.npos);
+    EXPECT_FALSE(set.contains("abcdefgh "));
+    EXPECT_FALSE(set.contains("foobar"));
+}
+
+TEST(eytzinger_set, strings_with_prefixes)
+{
+    // a small alphabet, and long shared prefixes
+    uint64_t rng = 5;
+    auto random_string = [&rng]{
+        std::string s(static_cast<size_t>(next_rand(&rng) % 4u) * 6u, 'p');
+        const size_t len = next_rand(&rng) % 14u;
+        for(size_t i = 0; i < len; ++i)
+            s += "ab\0\xff"[next_rand(&rng) % 4u];
+        return s;
+    };
+    for(size_t num : {1u, 2u, 10u, 100u, 3000u})
+    {
+        SCOPED_TRACE(num);
+        std::vector<std::string> strs;
+        for(size_t i = 0; i < num; ++i)
+            strs.push_back(random_string());
+        std::sort(strs.begin(), strs.end());
+        std::vector<csubstr> keys;
+        for(std::string const& s : strs)
+            keys.push_back(csubstr(s.data(), s.size()));
+        eytzinger_set<csubstr> set(cspan<csubstr>(keys.data(), keys.size()));
+        for(size_t i = 0; i < 3000; ++i)
+        {
+            const std::string x = i % 2 ? random_string() : strs[i % num];
+            const auto it = std::lower_bound(strs.begin(), strs.end(), x);
+            const size_t slot = set.lower_bound(csubstr(x.data(), x.size()));
+            if(it == strs.end())
+            {
+                EXPECT_EQ(slot, set.npos);
+                continue;
+            }
+            ASSERT_NE(slot, set.npos);
+            // the first of the duplicates
+            EXPECT_EQ(set.key(slot).str, keys[static_cast<size_t>(it - strs.begin())].str);
+            EXPECT_EQ(set.contains(csubstr(x.data(), x.size())), *it == x);
+        }
+    }
+}
+
+TEST(eytzinger_map, basic)
+{
+    const std::vector<csubstr> keys = {"apple", "banana", "cherry", "date", "elderberry", "fig"};
+    const std::vector<int> vals = {1, 2, 3, 4, 5, 6};
+    eytzinger_map<csubstr, int> map(cspan<csubstr>(keys.data(), keys.size()), cspan<int>(vals.data(), vals.size()));
+    ASSERT_EQ(map.size(), 6u);
+    for(size_t i = 0; i < keys.size(); ++i)
+    {
+        int const* v = map.find(keys[i]);
+        ASSERT_NE(v, nullptr);
+        EXPECT_EQ(*v, vals[i]);
+    }
+    EXPECT_EQ(map.find("grape"), nullptr);
+    EXPECT_EQ(map.value(map.lower_bound("coconut")), 4);
+    *map.find("fig") = 60;
+    eytzinger_map<csubstr, int> copy(map);
+    EXPECT_EQ(*copy.find("fig"), 60);
+    int i = 0;
+    for(size_t slot = copy.first(); slot != copy.npos; slot = copy.next(slot))
+        EXPECT_EQ(copy.key(slot), keys[static_cast<size_t>(i++)]);
+    {
+        C4_EXPECT_ERROR_OCCURS(1);
+        map.assign(cspan<csubstr>(keys.data(), keys.size()), cspan<int>(vals.data(), 3));
+    }
+}
+
+TEST(stree_set, impls)
+{
+    uint64_t rng = 7;
+    for(size_t num : {1u, 16u, 17u, 300u, 5000u})
+    {
+        std::vector<uint32_t> k32(num);
+        std::vector<uint64_t> k64(num);
+        for(size_t i = 0; i < num; ++i)
+        {
+            k32[i] = static_cast<uint32_t>(next_rand(&rng) << 8);
+            k64[i] = next_rand(&rng) << 12;
+        }
+        std::sort(k32.begin(), k32.end());
+        std::sort(k64.begin(), k64.end());
+        stree_set<uint32_t> s32(cspan<uint32_t>(k32.data(), k32.size()));
+        stree_set<uint64_t> s64(cspan<uint64_t>(k64.data(), k64.size()));
+        // through the dispatched implementation
+        for(size_t i = 0; i < 2000; ++i)
+        {
+            const uint32_t x32 = static_cast<uint32_t>(next_rand(&rng) << 8);
+            const uint64_t x64 = next_rand(&rng) << 12;
+            const auto it32 = std::lower_bound(k32.begin(), k32.end(), x32);
+            const auto it64 = std::lower_bound(k64.begin(), k64.end(), x64);
+            const size_t s = s32.lower_bound(x32);
+            const size_t t = s64.lower_bound(x64);
+            EXPECT_EQ(s == s32.npos, it32 == k32.end());
+            EXPECT_EQ(t == s64.npos, it64 == k64.end());
+            if(s != s32.npos && it32 != k32.end())
+            {
+                EXPECT_EQ(s32.key(s), *it32);
+            }
+            if(t != s64.npos && it64 != k64.end())
+            {
+                EXPECT_EQ(s64.key(t), *it64);
+            }
+        }
+    }
+}
+
+#ifdef C4_EYTZINGER_X86
+TEST(stree_set, avx2_vs_scalar)
+{
+    if( ! cpu_has(CPU_AVX2|CPU_POPCNT))
+        return;
+    // a complete tree of 3 levels, nodes of 16 keys
+    const size_t B = 16, num_nodes = 1 + 17 + 17 * 17;
+    std::vector<uint32_t> nodes_v(num_nodes * B + 16);
+    uint32_t *nodes = nodes_v.data();
+    while(reinterpret_cast<uintptr_t>(nodes) % 64)
+        ++nodes;
+    uint64_t rng = 3;
+    for(size_t i = 0; i < num_nodes * B; ++i)
+        nodes[i] = static_cast<uint32_t>(next_rand(&rng));
+    for(size_t k = 0; k < num_nodes; ++k)
+        std::sort(nodes + k * B, nodes + k * B + B);
+    for(size_t i = 0; i < 10000; ++i)
+    {
+        const uint32_t x = i < 5000 ? static_cast<uint32_t>(next_rand(&rng)) : nodes[i % (num_nodes * B)];
+        EXPECT_EQ(detail::stree_lower_bound_avx2(nodes, num_nodes, x),
+                  detail::stree_lower_bound_scalar(nodes, num_nodes, x)) << x;
+    }
+    std::vector<uint64_t> nodes64_v(num_nodes * 8 + 8);
+    uint64_t *nodes64 = nodes64_v.data();
+    while(reinterpret_cast<uintptr_t>(nodes64) % 64)
+        ++nodes64;
+    for(size_t i = 0; i < num_nodes * 8; ++i)
+        nodes64[i] = next_rand(&rng) << (i % 2 ? 11 : 0);
+    for(size_t k = 0; k < num_nodes; ++k)
+        std::sort(nodes64 + k * 8, nodes64 + k * 8 + 8);
+    for(size_t i = 0; i < 10000; ++i)
+    {
+        const uint64_t x = i < 5000 ? (next_rand(&rng) << (i % 2 ? 11 : 0)) : nodes64[i % (num_nodes * 8)];
+        EXPECT_EQ(detail::stree_lower_bound_avx2(nodes64, num_nodes, x),
+                  detail::stree_lower_bound_scalar(nodes64, num_nodes, x)) << x;
+    }
+}
+#endif
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
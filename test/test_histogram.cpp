@@ -0,0 +1,172 @@
+#include "c4/test.hpp"
+#include "c4/histogram.hpp"
+#include "c4/format.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+TEST(histogram, buckets)
+{
+    for(unsigned p : {1u, 3u, 7u, 10u})
+    {
+        histogram h(UINT64_C(1) << 40, p);
+        EXPECT_EQ(h.num_buckets(), h.index(UINT64_C(1) << 40) + 1);
+        // small values are exact
+        for(uint64_t v = 0; v < (uint64_t(2) << p); ++v)
+        {
+            EXPECT_EQ(h.bucket_lowest(h.index(v)), v);
+            EXPECT_EQ(h.bucket_highest(h.index(v)), v);
+        }
+        // the buckets are contiguous
+        for(size_t i = 1; i < h.num_buckets(); ++i)
+            ASSERT_EQ(h.bucket_lowest(i), h.bucket_highest(i - 1) + 1) << "p=" << p << " i=" << i;
+        // and their relative width is bounded
+        uint64_t v = 1;
+        for(int i = 0; i < 1000; ++i)
+        {
+            v = v * 3 / 2 + 7;
+            if(v > h.max_value())
+                break;
+            const size_t b = h.index(v);
+            ASSERT_LE(h.bucket_lowest(b), v);
+            ASSERT_GE(h.bucket_highest(b), v);
+            const double error = static_cast<double>(h.bucket_highest(b) - h.bucket_lowest(b));
+            EXPECT_LE(error / static_cast<double>(v), 1. / static_cast<double>(1u << p)) << "v=" << v;
+        }
+    }
+}
+
+TEST(histogram, empty)
+{
+    histogram h;
+    EXPECT_TRUE(h.empty());
+    EXPECT_EQ(h.count(), 0u);
+    EXPECT_EQ(h.min(), 0u);
+    EXPECT_EQ(h.max(), 0u);
+    EXPECT_EQ(h.mean(), 0.);
+    EXPECT_EQ(h.percentile(50.), 0u);
+}
+
+TEST(histogram, percentiles)
+{
+    histogram h;
+    for(uint64_t v = 1; v <= 100000; ++v)
+        h.record(v);
+    EXPECT_EQ(h.count(), 100000u);
+    EXPECT_EQ(h.min(), 1u);
+    EXPECT_EQ(h.max(), 100000u);
+    EXPECT_DOUBLE_EQ(h.mean(), 50000.5);
+    EXPECT_EQ(h.percentile(0.), 1u);
+    EXPECT_EQ(h.percentile(100.), 100000u);
+    for(double p : {1., 10., 50., 90., 99., 99.9, 99.99})
+    {
+        const double expected = p * 1000.;
+        EXPECT_NEAR(static_cast<double>(h.percentile(p)), expected, expected / 128.) << "p=" << p;
+    }
+    EXPECT_EQ(h.count_at(50000), h.bucket_highest(h.index(50000)) - h.bucket_lowest(h.index(50000)) + 1);
+    h.reset();
+    EXPECT_TRUE(h.empty());
+    EXPECT_EQ(h.count_at(50000), 0u);
+}
+
+TEST(histogram, record_count)
+{
+    histogram h(1000);
+    h.record(10, 99);
+    h.record(1000000); // beyond max_value: counted in the last bucket
+    EXPECT_EQ(h.count(), 100u);
+    EXPECT_EQ(h.percentile(99.), 10u);
+    EXPECT_EQ(h.percentile(100.), 1000000u);
+    EXPECT_EQ(h.count_at(1000), 1u);
+    EXPECT_EQ(h.max(), 1000000u);
+}
+
+TEST(histogram, merge_threads)
+{
+    const size_t num_threads = 4, num_values = 10000;
+    std::vector<histogram> hs(num_threads);
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&hs, t, num_values]{
+            for(uint64_t v = 0; v < num_values; ++v)
+                hs[t].record(v * num_threads + t);
+        });
+    }
+    histogram total;
+    for(size_t t = 0; t < num_threads; ++t)
+    {
+        threads[t].join();
+        total.merge(hs[t]);
+    }
+    histogram expected;
+    for(uint64_t v = 0; v < num_values * num_threads; ++v)
+        expected.record(v);
+    EXPECT_EQ(total.count(), expected.count());
+    EXPECT_EQ(total.min(), expected.min());
+    EXPECT_EQ(total.max(), expected.max());
+    EXPECT_EQ(total.mean(), expected.mean());
+    for(size_t i = 0; i < total.num_buckets(); ++i)
+        ASSERT_EQ(total.count_at(total.bucket_lowest(i)), expected.count_at(expected.bucket_lowest(i)));
+}
+
+TEST(histogram, copy_move)
+{
+    histogram h(1 << 20, 5);
+    for(uint64_t v = 0; v < 1000; ++v)
+        h.record(v * v);
+    histogram cp(h);
+    EXPECT_EQ(cp.count(), h.count());
+    EXPECT_EQ(cp.percentile(90.), h.percentile(90.));
+    EXPECT_EQ(cp.precision_bits(), 5u);
+    histogram mv(std::move(cp));
+    EXPECT_EQ(mv.count(), h.count());
+    EXPECT_EQ(mv.percentile(90.), h.percentile(90.));
+    histogram as;
+    as = h;
+    EXPECT_EQ(as.num_buckets(), h.num_buckets());
+    EXPECT_EQ(as.percentile(99.), h.percentile(99.));
+    as = std::move(mv);
+    EXPECT_EQ(as.percentile(99.), h.percentile(99.));
+    // the moved-from ones are empty, and can be assigned to again
+    for(histogram *moved : {&cp, &mv})
+    {
+        EXPECT_TRUE(moved->empty());
+        EXPECT_EQ(moved->num_buckets(), 0u);
+        EXPECT_EQ(moved->min(), 0u);
+        EXPECT_EQ(moved->max(), 0u);
+        EXPECT_EQ(moved->mean(), 0.);
+        EXPECT_EQ(moved->percentile(50.), 0u);
+        EXPECT_EQ(moved->count_at(10u), 0u);
+    }
+    {
+        C4_EXPECT_ERROR_OCCURS(1);
+        h.merge(cp);
+    }
+    cp = h;
+    cp.record(7);
+    EXPECT_EQ(cp.count(), h.count() + 1u);
+}
+
+TEST(histogram, to_chars)
+{
+    histogram h;
+    for(uint64_t v = 1; v <= 1000; ++v)
+        h.record(v);
+    char buf_[128];
+    substr buf(buf_, sizeof(buf_));
+    size_t len = to_chars(buf, h);
+    ASSERT_LE(len, buf.len);
+    EXPECT_EQ(buf.first(len), "count=1000 min=1 mean=500.5 p50=501 p90=903 p99=991 p99.9=1000 max=1000");
+    EXPECT_GT(to_chars(buf.first(10), h), 10u);
+    char out_[128];
+    EXPECT_EQ(cat_sub(substr(out_, sizeof(out_)), h), buf.first(len));
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
@@ -0,0 +1,180 @@
+#include "c4/test.hpp"
+#include "c4/line_reader.hpp"
+#include "c4/libtest/tmpfile.hpp"
+#include "c4/std/string.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(C4_POSIX) || defined(C4_MACOS) || defined(C4_IOS)
+#   include <stdio.h>
+#   include <stdlib.h>
+#   include <unistd.h>
+#endif
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+#if defined(C4_POSIX) || defined(C4_MACOS) || defined(C4_IOS)
+
+std::vector<std::string> make_lines(size_t num, size_t max_len)
+{
+    std::vector<std::string> lines;
+    uint32_t rng = 12345u;
+    for(size_t i = 0; i < num; ++i)
+    {
+        rng = rng * 1664525u + 1013904223u;
+        size_t len = (rng >> 8) % (max_len + 1);
+        if(i % 97 == 0)
+            len = 0; // some empty lines
+        std::string line;
+        for(size_t j = 0; j < len; ++j)
+            line += static_cast<char>('a' + (i + j) % 26);
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+std::string join_lines(std::vector<std::string> const& lines, bool final_newline)
+{
+    std::string s;
+    for(size_t i = 0; i < lines.size(); ++i)
+    {
+        s += lines[i];
+        if(i + 1 < lines.size() || final_newline)
+            s += '\n';
+    }
+    return s;
+}
+
+void check_lines(line_reader &r, std::vector<std::string> const& expected)
+{
+    csubstr line;
+    for(size_t i = 0; i < expected.size(); ++i)
+    {
+        ASSERT_TRUE(r.next(&line)) << "i=" << i;
+        ASSERT_EQ(line, to_csubstr(expected[i])) << "i=" << i;
+    }
+    EXPECT_FALSE(r.next(&line));
+    EXPECT_FALSE(r.next(&line));
+    EXPECT_EQ(r.error(), 0);
+    EXPECT_EQ(r.num_lines(), expected.size());
+}
+
+TEST(line_reader, basic)
+{
+    ScopedTmpFile tmp("first\nsecond\r\n\nlast", "c4core_line_reader");
+    for(bool prefetch : {false, true})
+    {
+        line_reader r;
+        ASSERT_TRUE(r.open(tmp.name, line_reader::default_buffer_size, prefetch));
+        check_lines(r, {"first", "second\r", "", "last"});
+    }
+}
+
+TEST(line_reader, empty)
+{
+    ScopedTmpFile tmp("", "c4core_line_reader");
+    line_reader r;
+    ASSERT_TRUE(r.open(tmp.name));
+    csubstr line;
+    EXPECT_FALSE(r.next(&line));
+    EXPECT_EQ(r.num_lines(), 0u);
+}
+
+TEST(line_reader, missing_file)
+{
+    line_reader r;
+    EXPECT_FALSE(r.open("/this/file/does/not/exist"));
+    EXPECT_FALSE(r.valid());
+}
+
+TEST(line_reader, buffer_boundaries)
+{
+    // lines shorter and longer than the headroom and the buffers
+    struct { size_t num_lines, max_len, min_buffer_size; } cases[] = {
+        {2000, 10, 1},
+        {2000, 100, 7},
+        {200, 10000, 64},
+    };
+    for(auto const& c : cases)
+    {
+        std::vector<std::string> lines = make_lines(c.num_lines, c.max_len);
+        for(bool final_newline : {false, true})
+        {
+            std::string contents = join_lines(lines, final_newline);
+            ScopedTmpFile tmp(to_csubstr(contents), "c4core_line_reader");
+            for(size_t buffer_size : {size_t(1), size_t(7), size_t(64), size_t(4096), size_t(1) << 20})
+            {
+                if(buffer_size < c.min_buffer_size)
+                    continue;
+                for(bool prefetch : {false, true})
+                {
+                    line_reader r;
+                    ASSERT_TRUE(r.open(tmp.name, buffer_size, prefetch));
+                    check_lines(r, lines);
+                }
+            }
+        }
+    }
+}
+
+TEST(line_reader, pipe)
+{
+    std::vector<std::string> lines = make_lines(5000, 300);
+    std::string contents = join_lines(lines, true);
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    // write in small pieces, so that the reads return partial buffers
+    std::thread writer([&]{
+        for(size_t pos = 0; pos < contents.size(); pos += 1000)
+        {
+            size_t len = contents.size() - pos < 1000 ? contents.size() - pos : 1000;
+            C4_CHECK(::write(fds[1], contents.data() + pos, len) == (ssize_t)len);
+        }
+        ::close(fds[1]);
+    });
+    line_reader r;
+    r.open(fds[0], 4096);
+    check_lines(r, lines);
+    writer.join();
+    r.close();
+    ::close(fds[0]);
+}
+
+TEST(line_reader, close_with_writer_open)
+{
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    const char data[] = "first\nsecond";
+    ASSERT_EQ(::write(fds[1], data, sizeof(data) - 1), (ssize_t)(sizeof(data) - 1));
+    for(bool prefetch : {false, true})
+    {
+        line_reader r;
+        r.open(fds[0], 64, prefetch);
+        // with the writer open, the prefetcher is now waiting for input
+        // which will not come
+        csubstr line;
+        if(prefetch)
+        {
+            ASSERT_TRUE(r.next(&line));
+            EXPECT_EQ(line, "first");
+        }
+        r.close(); // must not hang
+        EXPECT_FALSE(r.valid());
+    }
+    {
+        line_reader r;
+        r.open(fds[0], 64, /*prefetch*/true);
+    } // the destructor must not hang either
+    ::close(fds[1]);
+    ::close(fds[0]);
+}
+
+#endif // C4_POSIX
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
@@ -0,0 +1,110 @@
+#include "c4/test.hpp"
+#include "c4/mmap_file.hpp"
+#include "c4/libtest/tmpfile.hpp"
+
+#if defined(C4_POSIX) || defined(C4_MACOS) || defined(C4_IOS)
+#   include <fcntl.h>
+#   include <stdio.h>
+#   include <stdlib.h>
+#   include <unistd.h>
+#endif
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+#if defined(C4_POSIX) || defined(C4_MACOS) || defined(C4_IOS)
+
+csubstr read_file(const char *name, substr buf)
+{
+    FILE *f = ::fopen(name, "rb");
+    C4_CHECK(f != nullptr);
+    size_t len = ::fread(buf.str, 1, buf.len, f);
+    ::fclose(f);
+    return buf.first(len);
+}
+
+TEST(mmap_file, read)
+{
+    ScopedTmpFile tmp("hello\nworld\n", "c4core_mmap_file");
+    mmap_file f(tmp.name);
+    ASSERT_TRUE(f.valid());
+    EXPECT_EQ(f.mode(), MMAP_READ);
+    EXPECT_EQ(f.size(), 12u);
+    EXPECT_EQ(f.str(), "hello\nworld\n");
+    csubstr s = f;
+    EXPECT_EQ(s.first(5), "hello");
+    EXPECT_EQ(f.blob().len, 12u);
+    EXPECT_TRUE(f.advise(MMAP_SEQUENTIAL|MMAP_WILLNEED));
+    EXPECT_TRUE(f.advise(MMAP_RANDOM, 6, 3));
+    EXPECT_TRUE(f.advise(MMAP_NORMAL));
+    f.advise(MMAP_HUGEPAGE); // may be rejected; must not crash
+    f.close();
+    EXPECT_FALSE(f.valid());
+    EXPECT_EQ(f.size(), 0u);
+}
+
+TEST(mmap_file, copy_on_write)
+{
+    ScopedTmpFile tmp("0123456789", "c4core_mmap_file");
+    mmap_file f(tmp.name, MMAP_COPY_ON_WRITE);
+    ASSERT_TRUE(f.valid());
+    substr s = f.str_mutable();
+    s[0] = 'x';
+    s[9] = 'y';
+    EXPECT_EQ(f.str(), "x12345678y");
+    // the file is unchanged
+    char buf[32];
+    EXPECT_EQ(read_file(tmp.name, buf), "0123456789");
+    mmap_file g(tmp.name);
+    EXPECT_EQ(g.str(), "0123456789");
+}
+
+TEST(mmap_file, empty_file)
+{
+    ScopedTmpFile tmp("", "c4core_mmap_file");
+    mmap_file f(tmp.name);
+    EXPECT_TRUE(f.valid());
+    EXPECT_TRUE(f.empty());
+    EXPECT_EQ(f.str(), "");
+    EXPECT_TRUE(f.advise(MMAP_SEQUENTIAL));
+}
+
+TEST(mmap_file, missing_file)
+{
+    mmap_file f("/this/file/does/not/exist");
+    EXPECT_FALSE(f.valid());
+    EXPECT_FALSE(f.open("/this/file/does/not/exist"));
+    EXPECT_FALSE(f.open("/tmp")); // not a regular file
+}
+
+TEST(mmap_file, open_fd)
+{
+    ScopedTmpFile tmp("abc", "c4core_mmap_file");
+    int fd = ::open(tmp.name, O_RDONLY);
+    ASSERT_GE(fd, 0);
+    mmap_file f;
+    ASSERT_TRUE(f.open(fd));
+    ::close(fd);
+    EXPECT_EQ(f.str(), "abc");
+}
+
+TEST(mmap_file, move)
+{
+    ScopedTmpFile tmp("abc", "c4core_mmap_file");
+    mmap_file f(tmp.name);
+    mmap_file g(std::move(f));
+    EXPECT_FALSE(f.valid());
+    EXPECT_TRUE(g.valid());
+    EXPECT_EQ(g.str(), "abc");
+    f = std::move(g);
+    EXPECT_TRUE(f.valid());
+    EXPECT_FALSE(g.valid());
+    EXPECT_EQ(f.str(), "abc");
+}
+
+#endif // C4_POSIX
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
@@ -0,0 +1,100 @@
+#include "c4/test.hpp"
+#include "c4/offset_substr.hpp"
+
+#include <vector>
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+C4_STATIC_ASSERT(sizeof(offset_substr<>) == 8);
+C4_STATIC_ASSERT(sizeof(offset_substr<uint16_t>) == 4);
+C4_STATIC_ASSERT(std::is_trivially_copyable<offset_substr<>>::value);
+
+TEST(offset_substr, from_and_in)
+{
+    const csubstr text = "foo bar, baz";
+    const offset_substr<> bar = offset_substr<>::from(text, text.sub(4, 3));
+    EXPECT_EQ(bar.offset, 4u);
+    EXPECT_EQ(bar.len, 3u);
+    EXPECT_EQ(bar.begin(), 4u);
+    EXPECT_EQ(bar.end(), 7u);
+    EXPECT_EQ(bar.size(), 3u);
+    EXPECT_FALSE(bar.empty());
+    EXPECT_EQ(bar.in(text), "bar");
+    EXPECT_EQ(bar.in(text).str, text.str + 4);
+    // the whole base, and empty substrings at its ends
+    EXPECT_EQ(offset_substr<>::from(text, text).in(text), text);
+    EXPECT_TRUE(offset_substr<>::from(text, text.first(0)).empty());
+    EXPECT_EQ(offset_substr<>::from(text, text.last(0)).offset, text.len);
+    EXPECT_EQ(offset_substr<>::from(text, csubstr{}), offset_substr<>());
+    // the same offsets rebind to another base
+    EXPECT_EQ(bar.in(csubstr("abcdefghijk")), "efg");
+}
+
+TEST(offset_substr, in_substr)
+{
+    char buf[] = "hello world";
+    substr s(buf, 11);
+    offset_substr<uint16_t> w = offset_substr<uint16_t>::from(s, s.sub(6));
+    substr ws = w.in(s);
+    ws.toupper();
+    EXPECT_EQ(s, "hello WORLD");
+}
+
+TEST(offset_substr, slicing)
+{
+    const csubstr text = "0123456789abcdef";
+    const offset_substr<> s(3, 10); // 3456789abc
+    EXPECT_EQ(s.sub(2).in(text), text.sub(3, 10).sub(2));
+    EXPECT_EQ(s.sub(2, 3).in(text), "567");
+    EXPECT_EQ(s.sub(10).in(text), "");
+    EXPECT_EQ(s.range(1, 4).in(text), "456");
+    EXPECT_EQ(s.range(7).in(text), "abc");
+    EXPECT_EQ(s.first(2).in(text), "34");
+    EXPECT_EQ(s.last(2).in(text), "bc");
+    EXPECT_EQ(s.offs(1, 2).in(text), "456789a");
+    EXPECT_EQ(s.offs(5, 5).in(text), "");
+}
+
+TEST(offset_substr, relations)
+{
+    const offset_substr<> a(10, 10), b(12, 3), c(15, 10), d(20, 5);
+    EXPECT_TRUE(a.contains(b));
+    EXPECT_TRUE(b.is_contained(a));
+    EXPECT_FALSE(a.contains(c));
+    EXPECT_TRUE(a.overlaps(b));
+    EXPECT_TRUE(a.overlaps(c));
+    EXPECT_TRUE(c.overlaps(a));
+    EXPECT_FALSE(a.overlaps(d)); // adjacent
+    EXPECT_FALSE(d.overlaps(a));
+    EXPECT_EQ(a, (offset_substr<>(10, 10)));
+    EXPECT_NE(a, b);
+}
+
+TEST(offset_substr, token_table)
+{
+    const csubstr text = "  the quick  brown fox ";
+    std::vector<offset_substr<>> tokens;
+    csubstr rem = text;
+    while( ! (rem = rem.triml(' ')).empty())
+    {
+        const size_t pos = rem.find(' ');
+        const csubstr tok = rem.first(pos != csubstr::npos ? pos : rem.len);
+        tokens.push_back(offset_substr<>::from(text, tok));
+        rem = rem.sub(tok.len);
+    }
+    ASSERT_EQ(tokens.size(), 4u);
+    EXPECT_EQ(tokens[0].in(text), "the");
+    EXPECT_EQ(tokens[1].in(text), "quick");
+    EXPECT_EQ(tokens[2].in(text), "brown");
+    EXPECT_EQ(tokens[3].in(text), "fox");
+    EXPECT_TRUE(tokens[1].in(text).begins_with("qu"));
+    EXPECT_EQ(tokens[2].in(text).find('o'), 2u);
+    // the queries of basic_substring map back to offsets
+    EXPECT_EQ(offset_substr<>::from(text, tokens[1].in(text).trimr('k')), tokens[1].first(4));
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
@@ -0,0 +1,151 @@
+#include "c4/test.hpp"
+#include "c4/parse_lines.hpp"
+#include "c4/format.hpp"
+#include "c4/std/string.hpp"
+
+#include <string>
+#include <vector>
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+TEST(count_lines, basic)
+{
+    EXPECT_EQ(count_lines(""), 0u);
+    EXPECT_EQ(count_lines("1"), 1u);
+    EXPECT_EQ(count_lines("1\n"), 1u);
+    EXPECT_EQ(count_lines("1\n2"), 2u);
+    EXPECT_EQ(count_lines("1\n2\n"), 2u);
+    EXPECT_EQ(count_lines("\n"), 1u);
+    EXPECT_EQ(count_lines("\n\n"), 2u);
+}
+
+TEST(parse_lines, basic)
+{
+    int out[8] = {};
+    parse_lines_result r = parse_lines(csubstr("1\n-2\r\n  3 \n40"), span<int>(out));
+    EXPECT_TRUE(r.ok());
+    EXPECT_EQ(r.num_lines, 4u);
+    EXPECT_EQ(r.num_parsed, 4u);
+    EXPECT_EQ(out[0], 1);
+    EXPECT_EQ(out[1], -2);
+    EXPECT_EQ(out[2], 3);
+    EXPECT_EQ(out[3], 40);
+
+    double d[2] = {};
+    r = parse_lines(csubstr("1.5\n-2.25\n"), span<double>(d));
+    EXPECT_TRUE(r.ok());
+    EXPECT_EQ(r.num_lines, 2u);
+    EXPECT_EQ(d[0], 1.5);
+    EXPECT_EQ(d[1], -2.25);
+}
+
+TEST(parse_lines, errors)
+{
+    int out[8] = {};
+    parse_lines_result r = parse_lines(csubstr("1\n2\nx\n4"), span<int>(out));
+    EXPECT_FALSE(r.ok());
+    EXPECT_EQ(r.num_lines, 4u);
+    EXPECT_EQ(r.error_line, 2u);
+    EXPECT_EQ(r.num_parsed, 2u);
+
+    r = parse_lines(csubstr("1\n\n3"), span<int>(out));
+    EXPECT_FALSE(r.ok());
+    EXPECT_EQ(r.error_line, 1u);
+
+    r = parse_lines(csubstr("1\n2 3\n"), span<int>(out));
+    EXPECT_FALSE(r.ok());
+    EXPECT_EQ(r.error_line, 1u);
+}
+
+TEST(parse_lines, output_too_small)
+{
+    int out[2] = {};
+    parse_lines_result r = parse_lines(csubstr("1\n2\n3\n"), span<int>(out));
+    EXPECT_FALSE(r.ok());
+    EXPECT_EQ(r.num_lines, 3u);
+    EXPECT_EQ(r.num_parsed, 0u);
+    EXPECT_EQ(r.error_line, parse_lines_result::npos);
+    EXPECT_EQ(out[0], 0);
+}
+
+template<class T>
+void test_parse_lines_parallel(std::vector<T> const& expected, size_t min_chunk_size)
+{
+    std::string buf;
+    char tmp[64];
+    for(size_t i = 0; i < expected.size(); ++i)
+    {
+        substr s = cat_sub(tmp, expected[i], (i % 7) ? "\n" : "\r\n");
+        buf.append(s.str, s.len);
+    }
+    thread_pool pool(4);
+    std::vector<T> out(expected.size());
+    parse_lines_result r = parse_lines_parallel(to_csubstr(buf), span<T>(out.data(), out.size()), pool, min_chunk_size);
+    EXPECT_TRUE(r.ok());
+    EXPECT_EQ(r.num_lines, expected.size());
+    EXPECT_EQ(r.num_parsed, expected.size());
+    for(size_t i = 0; i < expected.size(); ++i)
+    {
+        ASSERT_EQ(out[i], expected[i]) << "i=" << i;
+    }
+}
+
+TEST(parse_lines_parallel, ints)
+{
+    std::vector<int64_t> expected(100000);
+    for(size_t i = 0; i < expected.size(); ++i)
+    {
+        expected[i] = (int64_t)(i * 2654435761u % 1000003u) * ((i & 1) ? -1 : 1);
+    }
+    for(size_t min_chunk_size : {size_t(1), size_t(17), size_t(4096), size_t(1) << 18, size_t(1) << 30})
+    {
+        test_parse_lines_parallel(expected, min_chunk_size);
+    }
+}
+
+TEST(parse_lines_parallel, reals)
+{
+    std::vector<double> expected(20000);
+    for(size_t i = 0; i < expected.size(); ++i)
+    {
+        expected[i] = double(i) * 0.25 - 100.0;
+    }
+    test_parse_lines_parallel(expected, 1024);
+}
+
+TEST(parse_lines_parallel, errors)
+{
+    std::string buf;
+    char tmp[64];
+    for(size_t i = 0; i < 10000; ++i)
+    {
+        if(i == 4321 || i == 8765)
+            buf += "oops\n";
+        else
+        {
+            substr s = cat_sub(tmp, i, '\n');
+            buf.append(s.str, s.len);
+        }
+    }
+    thread_pool pool(4);
+    std::vector<uint32_t> out(10000);
+    parse_lines_result r = parse_lines_parallel(to_csubstr(buf), span<uint32_t>(out.data(), out.size()), pool, 256);
+    EXPECT_FALSE(r.ok());
+    EXPECT_EQ(r.num_lines, 10000u);
+    EXPECT_EQ(r.error_line, 4321u);
+    EXPECT_EQ(r.num_parsed, 4321u);
+    for(size_t i = 0; i < 4321u; ++i)
+    {
+        ASSERT_EQ(out[i], i);
+    }
+    // too small
+    r = parse_lines_parallel(to_csubstr(buf), span<uint32_t>(out.data(), 9999), pool, 256);
+    EXPECT_EQ(r.num_lines, 10000u);
+    EXPECT_EQ(r.num_parsed, 0u);
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
@@ -0,0 +1,187 @@
+#include "c4/test.hpp"
+#include "c4/shm_channel.hpp"
+
+#include <deque>
+
+#if defined(C4_POSIX) || defined(C4_MACOS)
+#   include <sys/types.h>
+#   include <sys/wait.h>
+#   include <unistd.h>
+#endif
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+#if defined(C4_POSIX) || defined(C4_MACOS)
+
+TEST(shm_channel, basic)
+{
+    shm_channel ch(1000);
+    ASSERT_TRUE(ch.valid());
+    EXPECT_EQ(ch.capacity(), 1024u);
+    EXPECT_EQ(ch.max_frame_size(), 504u);
+
+    csubstr frame;
+    EXPECT_FALSE(ch.try_recv(&frame));
+    EXPECT_FALSE(ch.recv(&frame, /*timeout_ns*/1000));
+
+    EXPECT_TRUE(ch.try_send(csubstr("hello")));
+    EXPECT_TRUE(ch.try_send(csubstr("")));
+    EXPECT_TRUE(ch.try_send_cat("world ", 42, ' ', 1.5));
+
+    ASSERT_TRUE(ch.try_recv(&frame));
+    EXPECT_EQ(frame, "hello");
+    ch.pop();
+    ASSERT_TRUE(ch.try_recv(&frame));
+    EXPECT_EQ(frame, "");
+    ch.pop();
+    ASSERT_TRUE(ch.recv(&frame));
+    EXPECT_EQ(frame, "world 42 1.5");
+    ch.pop();
+    EXPECT_FALSE(ch.try_recv(&frame));
+}
+
+TEST(shm_channel, prepare_commit)
+{
+    shm_channel ch(256);
+    substr buf = ch.prepare(64);
+    ASSERT_EQ(buf.len, 64u);
+    size_t len = cat(buf, fmt::craw(uint32_t(0xdeadbeef)), "abc");
+    ASSERT_LE(len, buf.len);
+    ch.commit(len);
+
+    cblob frame;
+    ASSERT_TRUE(ch.try_recv(&frame));
+    EXPECT_EQ(frame.len, len);
+    uint32_t val = 0;
+    size_t pos = from_chars(csubstr((const char*)frame.buf, frame.len), fmt::raw(val));
+    EXPECT_EQ(val, 0xdeadbeef);
+    EXPECT_EQ(csubstr((const char*)frame.buf, frame.len).sub(pos), "abc");
+    ch.pop();
+}
+
+TEST(shm_channel, full_and_wrap)
+{
+    shm_channel ch(256);
+    char data[100];
+    for(size_t i = 0; i < sizeof(data); ++i)
+    {
+        data[i] = static_cast<char>('a' + i % 26);
+    }
+    csubstr payload(data, sizeof(data));
+    // each frame takes 8+104=112 bytes, so only two fit
+    EXPECT_TRUE(ch.try_send(payload));
+    EXPECT_TRUE(ch.try_send(payload));
+    EXPECT_FALSE(ch.try_send(payload));
+    EXPECT_FALSE(ch.send(payload, /*timeout_ns*/1000));
+    EXPECT_EQ(ch.prepare(30).str, nullptr); // needs 40 bytes, but only 32 are free
+    EXPECT_NE(ch.prepare(24).str, nullptr);
+    // go around the ring many times, with frames of varying sizes
+    csubstr frame;
+    std::deque<size_t> sent = {payload.len, payload.len};
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        csubstr next = payload.first(i % payload.len);
+        while( ! ch.try_send(next))
+        {
+            ASSERT_FALSE(sent.empty());
+            ASSERT_TRUE(ch.try_recv(&frame));
+            EXPECT_EQ(frame, payload.first(sent.front()));
+            sent.pop_front();
+            ch.pop();
+        }
+        sent.push_back(next.len);
+    }
+    while( ! sent.empty())
+    {
+        ASSERT_TRUE(ch.try_recv(&frame));
+        EXPECT_EQ(frame, payload.first(sent.front()));
+        sent.pop_front();
+        ch.pop();
+    }
+    EXPECT_FALSE(ch.try_recv(&frame));
+}
+
+TEST(shm_channel, commit_without_prepare)
+{
+    shm_channel ch(256);
+    {
+        C4_EXPECT_ERROR_OCCURS(1);
+        ch.commit(0);
+    }
+    // a failed prepare() leaves nothing to commit, even when it
+    // would have skipped to the start of the ring
+    char data[100] = {};
+    csubstr payload(data, sizeof(data));
+    ASSERT_TRUE(ch.try_send(payload));
+    ASSERT_TRUE(ch.try_send(payload));
+    csubstr frame;
+    ASSERT_TRUE(ch.try_recv(&frame));
+    ch.pop();
+    EXPECT_NE(ch.prepare(payload.len).str, nullptr); // skips to the start
+    EXPECT_EQ(ch.prepare(payload.len + 20u).str, nullptr);
+    {
+        C4_EXPECT_ERROR_OCCURS(1);
+        ch.commit(0);
+    }
+    ASSERT_TRUE(ch.try_recv(&frame));
+    EXPECT_EQ(frame.len, payload.len);
+    ch.pop();
+    EXPECT_FALSE(ch.try_recv(&frame));
+}
+
+TEST(shm_channel, move)
+{
+    shm_channel ch(128);
+    int fd = ch.fd();
+    EXPECT_GE(fd, 0);
+    shm_channel ch2(std::move(ch));
+    EXPECT_FALSE(ch.valid());
+    EXPECT_TRUE(ch2.valid());
+    EXPECT_EQ(ch2.fd(), fd);
+    EXPECT_TRUE(ch2.try_send(csubstr("x")));
+}
+
+TEST(shm_channel, two_processes)
+{
+    const int num_frames = 20000;
+    shm_channel ch(4096);
+    pid_t pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if(pid == 0)
+    {
+        // child: the producer. Open the channel through its file descriptor.
+        shm_channel producer;
+        producer.open(ch.fd());
+        char buf[128];
+        for(int i = 0; i < num_frames; ++i)
+        {
+            substr frame = cat_sub(buf, "frame ", i, " of ", num_frames);
+            if( ! producer.send(frame, /*timeout_ns*/INT64_C(10000000000)))
+            {
+                ::_exit(1);
+            }
+        }
+        ::_exit(0);
+    }
+    // parent: the consumer
+    char buf[128];
+    for(int i = 0; i < num_frames; ++i)
+    {
+        csubstr frame;
+        ASSERT_TRUE(ch.recv(&frame, /*timeout_ns*/INT64_C(10000000000)));
+        EXPECT_EQ(frame, cat_sub(buf, "frame ", i, " of ", num_frames));
+        ch.pop();
+    }
+    int status = 0;
+    ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+#endif // C4_POSIX
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
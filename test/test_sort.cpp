@@ -0,0 +1,265 @@
+#include "c4/test.hpp"
+#include "c4/sort.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "c4/libtest/rng.hpp"
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+namespace {
+
+template<class T>
+std::vector<T> random_vals(size_t num, uint64_t seed, unsigned bits=64)
+{
+    std::vector<T> v(num);
+    for(T &x : v)
+    {
+        uint64_t r = next_rand(&seed);
+        if(bits < 64)
+            r &= (uint64_t(1) << bits) - 1u;
+        memcpy(&x, &r, sizeof(T));
+    }
+    return v;
+}
+
+template<class T>
+std::vector<T> random_reals(size_t num, uint64_t seed)
+{
+    std::vector<T> v(num);
+    for(T &x : v)
+    {
+        const uint64_t r = next_rand(&seed);
+        x = static_cast<T>(static_cast<int64_t>(r % 2000001u) - 1000000) / T(64);
+    }
+    return v;
+}
+
+template<class T>
+void test_radix(std::vector<T> v)
+{
+    std::vector<T> expected = v;
+    std::sort(expected.begin(), expected.end());
+    std::vector<T> a = v;
+    radix_sort(span<T>(a.data(), a.size()));
+    EXPECT_EQ(a, expected);
+    std::vector<T> b = v;
+    std::vector<T> scratch(b.size());
+    radix_sort(span<T>(b.data(), b.size()), span<T>(scratch.data(), scratch.size()));
+    EXPECT_EQ(b, expected);
+}
+
+template<class T>
+void test_radix_sizes()
+{
+    for(size_t num : {0u, 1u, 2u, 3u, 63u, 64u, 65u, 100u, 257u, 1000u, 5000u})
+    {
+        SCOPED_TRACE(num);
+        test_radix(random_vals<T>(num, num + 1u));
+        test_radix(random_vals<T>(num, num + 2u, 8)); // most passes skipped
+    }
+}
+
+/** the reference order: csubstr::compare() stops at zero bytes */
+bool bytes_less(csubstr a, csubstr b)
+{
+    return std::string(a.str, a.len) < std::string(b.str, b.len);
+}
+
+std::vector<csubstr> to_substrs(std::vector<std::string> const& strs)
+{
+    std::vector<csubstr> out;
+    out.reserve(strs.size());
+    for(std::string const& s : strs)
+        out.push_back(csubstr(s.data(), s.size()));
+    return out;
+}
+
+void test_strings(std::vector<std::string> const& strs)
+{
+    std::vector<csubstr> expected = to_substrs(strs);
+    std::sort(expected.begin(), expected.end(), &bytes_less);
+    std::vector<csubstr> s = to_substrs(strs);
+    string_sort(span<csubstr>(s.data(), s.size()));
+    ASSERT_EQ(s.size(), expected.size());
+    for(size_t i = 0; i < s.size(); ++i)
+        EXPECT_EQ(std::string(s[i].str, s[i].len), std::string(expected[i].str, expected[i].len)) << i;
+}
+
+/** strings from a small alphabet, with long common prefixes */
+std::vector<std::string> random_strings(size_t num, uint64_t seed, size_t maxlen)
+{
+    std::vector<std::string> strs(num);
+    for(std::string &s : strs)
+    {
+        const size_t len = next_rand(&seed) % (maxlen + 1u);
+        const uint64_t prefix = next_rand(&seed) % 4u;
+        s.assign(len, 'a');
+        for(size_t i = prefix * 4u; i < len; ++i)
+            s[i] = "ab\0\xff"[next_rand(&seed) % 4u];
+    }
+    return strs;
+}
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+TEST(radix_sort, key_types)
+{
+    EXPECT_TRUE(detail::is_radix_key<uint8_t>::value);
+    EXPECT_TRUE(detail::is_radix_key<int64_t>::value);
+    EXPECT_TRUE(detail::is_radix_key<char>::value);
+    EXPECT_TRUE(detail::is_radix_key<float>::value);
+    EXPECT_TRUE(detail::is_radix_key<double>::value);
+    EXPECT_FALSE(detail::is_radix_key<bool>::value);
+    EXPECT_FALSE(detail::is_radix_key<long double>::value);
+    EXPECT_FALSE(detail::is_radix_key<csubstr>::value);
+}
+
+TEST(radix_sort, unsigned)
+{
+    test_radix_sizes<uint8_t>();
+    test_radix_sizes<uint16_t>();
+    test_radix_sizes<uint32_t>();
+    test_radix_sizes<uint64_t>();
+}
+
+TEST(radix_sort, signed)
+{
+    test_radix_sizes<int8_t>();
+    test_radix_sizes<int16_t>();
+    test_radix_sizes<int32_t>();
+    test_radix_sizes<int64_t>();
+    test_radix(std::vector<int32_t>{0, -1, 1, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max(), -2, 2});
+}
+
+TEST(radix_sort, real)
+{
+    for(size_t num : {0u, 5u, 64u, 100u, 1000u})
+    {
+        SCOPED_TRACE(num);
+        test_radix(random_reals<float>(num, num + 1u));
+        test_radix(random_reals<double>(num, num + 1u));
+    }
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> v = {1.5, -inf, 0.0, -2.25, inf, 1e-300, -1e-300, 3.0, -0.5};
+    for(size_t i = 0; i < 100; ++i)
+        v.push_back(double(i % 7) - 3.5);
+    test_radix(v);
+}
+
+TEST(radix_sort, negative_zero)
+{
+    std::vector<float> v(100, 0.f);
+    for(size_t i = 0; i < v.size(); i += 2)
+        v[i] = -0.f;
+    radix_sort(span<float>(v.data(), v.size()));
+    for(size_t i = 0; i < 50; ++i)
+        EXPECT_TRUE(std::signbit(v[i])) << i;
+    for(size_t i = 50; i < 100; ++i)
+        EXPECT_FALSE(std::signbit(v[i])) << i;
+}
+
+TEST(radix_sort, parallel)
+{
+    thread_pool pool(3);
+    for(size_t num : {100u, 100000u, 300001u})
+    {
+        SCOPED_TRACE(num);
+        std::vector<int64_t> v = random_vals<int64_t>(num, num);
+        std::vector<int64_t> expected = v;
+        std::sort(expected.begin(), expected.end());
+        std::vector<int64_t> a = v;
+        radix_sort(pool, span<int64_t>(a.data(), a.size()));
+        EXPECT_EQ(a, expected);
+        std::vector<uint32_t> u = random_vals<uint32_t>(num, num, 20);
+        std::vector<uint32_t> uexpected = u;
+        std::sort(uexpected.begin(), uexpected.end());
+        std::vector<uint32_t> scratch(num);
+        radix_sort(pool, span<uint32_t>(u.data(), u.size()), span<uint32_t>(scratch.data(), scratch.size()));
+        EXPECT_EQ(u, uexpected);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+TEST(string_sort, basic)
+{
+    test_strings({});
+    test_strings({"b"});
+    test_strings({"b", "a"});
+    test_strings({"foo", "bar", "baz", "", "foobar", "fo", "foo", "ba", "", "zz", "a"});
+}
+
+TEST(string_sort, prefixes_and_bytes)
+{
+    std::vector<std::string> strs = {
+        "abcdefgh", "abcdefg", "abcdefghi", "abcdefgh\0", "abcdefgh\0\0",
+        "abcdefghabcdefgh", "abcdefghabcdefg", "abcdefghabcdefgha",
+        "\xff", "\x80", "\x7f", "a\xff", "a\x01", "",
+    };
+    strs[3].assign("abcdefgh\0", 9);
+    strs[4].assign("abcdefgh\0\0", 10);
+    strs.push_back(std::string("\0", 1));
+    strs.push_back(std::string("\0\0", 2));
+    strs.push_back(std::string("abcdefgh\0a", 10));
+    // many copies, to go over the insertion sort
+    std::vector<std::string> many;
+    for(size_t i = 0; i < 20; ++i)
+        many.insert(many.end(), strs.begin(), strs.end());
+    test_strings(strs);
+    test_strings(many);
+}
+
+TEST(string_sort, long_common_prefix)
+{
+    const std::string prefix(1000, 'x');
+    std::vector<std::string> strs;
+    for(size_t i = 0; i < 500; ++i)
+        strs.push_back(prefix + std::to_string((i * 7919u) % 500u));
+    strs.push_back(prefix);
+    strs.push_back(prefix);
+    test_strings(strs);
+}
+
+TEST(string_sort, random)
+{
+    for(size_t num : {13u, 50u, 300u, 3000u})
+    {
+        for(size_t maxlen : {3u, 10u, 40u})
+        {
+            SCOPED_TRACE(num);
+            SCOPED_TRACE(maxlen);
+            test_strings(random_strings(num, num * maxlen, maxlen));
+        }
+    }
+}
+
+TEST(string_sort, parallel)
+{
+    thread_pool pool(3);
+    for(size_t num : {100u, 50000u})
+    {
+        SCOPED_TRACE(num);
+        std::vector<std::string> strs = random_strings(num, num, 30);
+        std::vector<csubstr> expected = to_substrs(strs);
+        std::sort(expected.begin(), expected.end(), &bytes_less);
+        std::vector<csubstr> s = to_substrs(strs);
+        string_sort(pool, span<csubstr>(s.data(), s.size()));
+        ASSERT_EQ(s.size(), expected.size());
+        for(size_t i = 0; i < s.size(); ++i)
+            ASSERT_EQ(std::string(s[i].str, s[i].len), std::string(expected[i].str, expected[i].len)) << i;
+    }
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
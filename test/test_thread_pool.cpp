@@ -0,0 +1,154 @@
+#include "c4/test.hpp"
+#include "c4/thread_pool.hpp"
+
+#include <vector>
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+TEST(thread_pool, ctor)
+{
+    {
+        thread_pool pool(3);
+        EXPECT_EQ(pool.num_threads(), 3u);
+        EXPECT_EQ(pool.current_worker(), thread_pool::npos);
+    }
+    {
+        thread_pool pool;
+        EXPECT_GE(pool.num_threads(), 1u);
+    }
+}
+
+TEST(thread_pool, submit_wait)
+{
+    thread_pool pool(4, /*queue_capacity*/16);
+    std::atomic<size_t> count(0);
+    std::atomic<size_t> bad_worker(0);
+    // submit more tasks than there are nodes, so that submit() has to help
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        pool.submit([&pool, &count, &bad_worker, i]{
+            size_t w = pool.current_worker();
+            if(w != thread_pool::npos && w >= pool.num_threads())
+                ++bad_worker;
+            count += i;
+        });
+    }
+    pool.wait();
+    EXPECT_EQ(count.load(), 999u * 1000u / 2u);
+    EXPECT_EQ(bad_worker.load(), 0u);
+}
+
+TEST(thread_pool, submit_from_tasks)
+{
+    thread_pool pool(2);
+    std::atomic<size_t> count(0);
+    for(size_t i = 0; i < 50; ++i)
+    {
+        pool.submit([&pool, &count]{
+            for(size_t j = 0; j < 10; ++j)
+                pool.submit([&count]{ ++count; });
+        });
+    }
+    pool.wait();
+    EXPECT_EQ(count.load(), 500u);
+}
+
+TEST(thread_pool, parallel_for)
+{
+    thread_pool pool(4);
+    std::vector<int> v(100000, 1);
+    for(size_t grain : {size_t(0), size_t(1), size_t(7), size_t(1000), size_t(200000)})
+    {
+        std::atomic<size_t> num_calls(0);
+        std::atomic<size_t> too_large(0);
+        pool.parallel_for(span<int>(v.data(), v.size()), grain, [&](span<int> s){
+            ++num_calls;
+            if(grain && s.size() > grain)
+                ++too_large;
+            for(int &i : s)
+                i += 1;
+        });
+        EXPECT_GE(num_calls.load(), 1u);
+        EXPECT_EQ(too_large.load(), 0u);
+    }
+    for(int i : v)
+    {
+        ASSERT_EQ(i, 6);
+    }
+    // empty spans do not call the function
+    bool called = false;
+    pool.parallel_for(span<int>(), 1, [&](span<int>){ called = true; });
+    EXPECT_FALSE(called);
+}
+
+TEST(thread_pool, parallel_for_nested)
+{
+    thread_pool pool(3);
+    std::vector<int> rows(64, 0);
+    pool.parallel_for(span<int>(rows.data(), rows.size()), 4, [&pool](span<int> s){
+        for(int &r : s)
+        {
+            std::vector<int> cols(1000, 1);
+            std::atomic<int> sum(0);
+            pool.parallel_for(span<int>(cols.data(), cols.size()), 100, [&sum](span<int> c){
+                int local = 0;
+                for(int i : c)
+                    local += i;
+                sum += local;
+            });
+            r = sum;
+        }
+    });
+    for(int r : rows)
+    {
+        EXPECT_EQ(r, 1000);
+    }
+}
+
+TEST(thread_pool, parallel_reduce)
+{
+    thread_pool pool(4);
+    std::vector<uint64_t> v(123457);
+    for(size_t i = 0; i < v.size(); ++i)
+        v[i] = i;
+    const uint64_t expected = uint64_t(v.size()) * uint64_t(v.size() - 1u) / 2u;
+    auto sum = [](cspan<uint64_t> s){
+        uint64_t r = 0;
+        for(uint64_t i : s)
+            r += i;
+        return r;
+    };
+    auto add = [](uint64_t a, uint64_t b){ return a + b; };
+    for(size_t grain : {size_t(0), size_t(1), size_t(100), size_t(1000000)})
+    {
+        uint64_t r = pool.parallel_reduce(cspan<uint64_t>(v.data(), v.size()), grain, uint64_t(0), sum, add);
+        EXPECT_EQ(r, expected);
+    }
+    EXPECT_EQ(pool.parallel_reduce(cspan<uint64_t>(), 10, uint64_t(42), sum, add), 42u);
+    // the pieces are combined in order
+    auto first = [](cspan<uint64_t> s){ return std::vector<uint64_t>(1, s[0]); };
+    auto concat = [](std::vector<uint64_t> a, std::vector<uint64_t> const& b){ a.insert(a.end(), b.begin(), b.end()); return a; };
+    std::vector<uint64_t> firsts = pool.parallel_reduce(cspan<uint64_t>(v.data(), 64), 1, std::vector<uint64_t>(), first, concat);
+    ASSERT_EQ(firsts.size(), 64u);
+    for(size_t i = 0; i < firsts.size(); ++i)
+    {
+        EXPECT_EQ(firsts[i], i);
+    }
+}
+
+TEST(thread_pool, get_thread_pool)
+{
+    thread_pool &pool = get_thread_pool();
+    EXPECT_EQ(&pool, &get_thread_pool());
+    std::vector<int> v(1000, 2);
+    int sum = pool.parallel_reduce(span<int>(v.data(), v.size()), 0, 0,
+                                   [](span<int> s){ int r = 0; for(int i : s) r += i; return r; },
+                                   [](int a, int b){ return a + b; });
+    EXPECT_EQ(sum, 2000);
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
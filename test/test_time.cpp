@@ -0,0 +1,83 @@
+#include "c4/test.hpp"
+#include "c4/time.hpp"
+#include "c4/cpu_features.hpp"
+
+#include <chrono>
+#include <thread>
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+TEST(tsc_clock, monotonic)
+{
+    tsc_clock::ticks_type prev = tsc_clock::now();
+    int64_t prev_ns = tsc_clock::now_ns();
+    for(int i = 0; i < 10000; ++i)
+    {
+        tsc_clock::ticks_type t = tsc_clock::now_ordered();
+        int64_t ns = tsc_clock::now_ns();
+        EXPECT_GE(t, prev);
+        EXPECT_GE(ns, prev_ns);
+        prev = t;
+        prev_ns = ns;
+    }
+}
+
+TEST(tsc_clock, uses_counter)
+{
+#if defined(C4_TSC_CLOCK_X86)
+    // never the counter without the instructions to read it reliably
+    EXPECT_EQ(tsc_clock::uses_counter(), cpu_has(CPU_RDTSCP|CPU_INVARIANT_TSC));
+#elif defined(C4_TSC_CLOCK_ARM64)
+    EXPECT_TRUE(tsc_clock::uses_counter());
+#else
+    EXPECT_FALSE(tsc_clock::uses_counter());
+#endif
+    if( ! tsc_clock::uses_counter())
+    {
+        EXPECT_EQ(tsc_clock::frequency(), UINT64_C(1000000000));
+    }
+}
+
+TEST(tsc_clock, to_ns)
+{
+    const uint64_t freq = tsc_clock::frequency();
+    EXPECT_GT(freq, 0u);
+    EXPECT_EQ(tsc_clock::to_ns(0), 0);
+    // one second worth of ticks, give or take the rounding of the factor
+    EXPECT_NEAR(static_cast<double>(tsc_clock::to_ns(freq)), 1.e9, 1.);
+    // large values do not overflow
+    EXPECT_NEAR(static_cast<double>(tsc_clock::to_ns(freq * 86400)), 86400.e9, 86400.);
+    EXPECT_EQ(tsc_clock::elapsed_ns(100, 100), 0);
+    EXPECT_EQ(tsc_clock::elapsed_ns(freq, 0), -tsc_clock::elapsed_ns(0, freq));
+}
+
+TEST(tsc_clock, matches_os_clock)
+{
+    const int64_t c0 = detail::monotonic_ns();
+    const tsc_clock::ticks_type t0 = tsc_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const int64_t c1 = detail::monotonic_ns();
+    const tsc_clock::ticks_type t1 = tsc_clock::now();
+    const int64_t os_ns = c1 - c0;
+    const int64_t tsc_ns = tsc_clock::elapsed_ns(t0, t1);
+    EXPECT_GE(os_ns, 50000000);
+    // allow for the calibration error, and for preemption between
+    // the clock reads
+    EXPECT_NEAR(static_cast<double>(tsc_ns), static_cast<double>(os_ns), 0.01 * static_cast<double>(os_ns) + 200000.);
+}
+
+TEST(currtime, matches_tsc_clock)
+{
+    const time_type us0 = currtime();
+    const int64_t ns0 = tsc_clock::now_ns();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const time_type us1 = currtime();
+    const int64_t ns1 = tsc_clock::now_ns();
+    EXPECT_NEAR(static_cast<double>(us1 - us0), static_cast<double>(ns1 - ns0) * 1.e-3, 0.01 * static_cast<double>(us1 - us0) + 200.);
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
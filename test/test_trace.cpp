@@ -0,0 +1,134 @@
+#define C4_USE_TRACE 1
+#include "c4/test.hpp"
+#include "c4/trace.hpp"
+#include "c4/format.hpp"
+#include "c4/std/string.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+namespace {
+
+void append_to_string(csubstr piece, void *user_data)
+{
+    static_cast<std::string*>(user_data)->append(piece.str, piece.len);
+}
+
+size_t flush_to_string(std::string *out)
+{
+    out->clear();
+    return trace_flush(&append_to_string, out);
+}
+
+size_t count(std::string const& s, csubstr needle)
+{
+    size_t n = 0;
+    for(size_t pos = to_csubstr(s).find(needle); pos != csubstr::npos; pos = to_csubstr(s).find(needle, pos + needle.len))
+        ++n;
+    return n;
+}
+
+struct trace_test : public ::testing::Test
+{
+    void SetUp() override { trace_clear(); }
+    void TearDown() override { trace_enable(false); trace_clear(); }
+};
+
+} // anonymous namespace
+
+
+TEST_F(trace_test, disabled)
+{
+    trace_enable(false);
+    EXPECT_FALSE(trace_enabled());
+    {
+        C4_TRACE_ZONE("nope");
+    }
+    std::string out;
+    EXPECT_EQ(flush_to_string(&out), 0u);
+    EXPECT_EQ(count(out, "nope"), 0u);
+    EXPECT_TRUE(to_csubstr(out).begins_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    EXPECT_TRUE(to_csubstr(out).ends_with("]}\n"));
+}
+
+TEST_F(trace_test, nested_zones)
+{
+    trace_enable(true);
+    EXPECT_TRUE(trace_enabled());
+    {
+        C4_TRACE_ZONE("outer");
+        for(int i = 0; i < 3; ++i)
+        {
+            C4_TRACE_ZONE("inner");
+        }
+    }
+    std::string out;
+    EXPECT_EQ(flush_to_string(&out), 4u);
+    EXPECT_EQ(count(out, "\"name\":\"outer\",\"ph\":\"X\""), 1u);
+    EXPECT_EQ(count(out, "\"name\":\"inner\",\"ph\":\"X\""), 3u);
+    // the inner zones end before the outer zone, so they come first
+    EXPECT_LT(to_csubstr(out).find("inner"), to_csubstr(out).find("outer"));
+    // flushing consumes the events
+    EXPECT_EQ(flush_to_string(&out), 0u);
+    EXPECT_EQ(count(out, "inner"), 0u);
+}
+
+TEST_F(trace_test, escaped_names)
+{
+    trace_enable(true);
+    {
+        C4_TRACE_ZONE("a \"quoted\" \\ name\n");
+    }
+    std::string out;
+    EXPECT_EQ(flush_to_string(&out), 1u);
+    EXPECT_EQ(count(out, "\"name\":\"a \\\"quoted\\\" \\\\ name\\u000a\""), 1u);
+}
+
+TEST_F(trace_test, threads)
+{
+    const size_t num_threads = 4, num_zones = 3000; // more than a chunk
+    trace_enable(true);
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([t, num_zones]{
+            char name[32];
+            trace_set_thread_name(cat_sub(name, "worker ", t));
+            for(size_t i = 0; i < num_zones; ++i)
+            {
+                C4_TRACE_ZONE("work");
+            }
+        });
+    }
+    // flush while the threads are recording; nothing is lost
+    std::string out, all;
+    size_t total = 0;
+    while(total < num_threads * num_zones)
+    {
+        total += flush_to_string(&out);
+        all += out;
+    }
+    for(std::thread &th : threads)
+        th.join();
+    total += flush_to_string(&out);
+    all += out;
+    EXPECT_EQ(total, num_threads * num_zones);
+    EXPECT_EQ(count(all, "\"name\":\"work\""), num_threads * num_zones);
+    for(size_t t = 0; t < num_threads; ++t)
+    {
+        char name[32];
+        EXPECT_GE(count(all, cat_sub(name, "\"args\":{\"name\":\"worker ", t, "\"}")), 1u);
+    }
+    // the buffers of the exited threads are gone
+    EXPECT_EQ(flush_to_string(&out), 0u);
+    EXPECT_EQ(count(out, "worker"), 0u);
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"
@@ -0,0 +1,293 @@
+#include "c4/test.hpp"
+#include "c4/varint.hpp"
+#include "c4/cpu_features.hpp"
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "c4/libtest/supprwarn_push.hpp"
+
+namespace c4 {
+
+template<class U>
+std::string varint_str(U v)
+{
+    char buf[16];
+    const size_t len = varint_encode(buf, v);
+    EXPECT_EQ(len, varint_size(v));
+    return std::string(buf, len);
+}
+
+TEST(varint, zigzag)
+{
+    EXPECT_EQ(zigzag_encode(int32_t(0)), 0u);
+    EXPECT_EQ(zigzag_encode(int32_t(-1)), 1u);
+    EXPECT_EQ(zigzag_encode(int32_t(1)), 2u);
+    EXPECT_EQ(zigzag_encode(int32_t(-2)), 3u);
+    EXPECT_EQ(zigzag_encode(std::numeric_limits<int32_t>::max()), UINT32_C(0xfffffffe));
+    EXPECT_EQ(zigzag_encode(std::numeric_limits<int32_t>::min()), UINT32_C(0xffffffff));
+    EXPECT_EQ(zigzag_encode(std::numeric_limits<int64_t>::min()), UINT64_C(0xffffffffffffffff));
+    EXPECT_EQ(zigzag_encode(int8_t(-64)), uint8_t(127));
+    for(int64_t v : {INT64_C(0), INT64_C(1), INT64_C(-1), INT64_C(12345), INT64_C(-12345),
+                     std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max()})
+    {
+        EXPECT_EQ(zigzag_decode(zigzag_encode(v)), v);
+        EXPECT_EQ(zigzag_decode(zigzag_encode(static_cast<int16_t>(v))), static_cast<int16_t>(v));
+    }
+}
+
+TEST(varint, encode)
+{
+    EXPECT_EQ(varint_str(0u), std::string("\x00", 1));
+    EXPECT_EQ(varint_str(1u), "\x01");
+    EXPECT_EQ(varint_str(127u), "\x7f");
+    EXPECT_EQ(varint_str(128u), "\x80\x01");
+    EXPECT_EQ(varint_str(300u), "\xac\x02");
+    EXPECT_EQ(varint_str(uint16_t(65535)), "\xff\xff\x03");
+    EXPECT_EQ(varint_str(UINT32_C(0xffffffff)), "\xff\xff\xff\xff\x0f");
+    EXPECT_EQ(varint_str(UINT64_C(0xffffffffffffffff)), "\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01");
+    EXPECT_EQ(varint_max_size<uint8_t>(), 2u);
+    EXPECT_EQ(varint_max_size<uint32_t>(), 5u);
+    EXPECT_EQ(varint_max_size<uint64_t>(), 10u);
+}
+
+TEST(varint, encode_small_buffer)
+{
+    char buf[4] = {'x', 'x', 'x', 'x'};
+    EXPECT_EQ(varint_encode(blob(buf, 2), 1u << 14), 3u);
+    EXPECT_EQ(varint_encode(blob(), 0u), 1u);
+    EXPECT_EQ(csubstr(buf, 4), "xxxx");
+}
+
+TEST(varint, decode_errors)
+{
+    uint32_t v32 = 7;
+    uint64_t v64 = 7;
+    uint8_t v8 = 7;
+    // truncated
+    EXPECT_EQ(varint_decode(cblob(), &v32), csubstr::npos);
+    EXPECT_EQ(varint_decode(cblob("\x80", 1), &v32), csubstr::npos);
+    EXPECT_EQ(varint_decode(cblob("\xff\xff\xff\xff", 4), &v32), csubstr::npos);
+    // overflow
+    EXPECT_EQ(varint_decode(cblob("\xff\xff\xff\xff\x1f", 5), &v32), csubstr::npos);
+    EXPECT_EQ(varint_decode(cblob("\x80\x80\x80\x80\x80\x00", 6), &v32), csubstr::npos);
+    EXPECT_EQ(varint_decode(cblob("\xff\xff\xff\xff\xff\xff\xff\xff\xff\x02", 10), &v64), csubstr::npos);
+    EXPECT_EQ(varint_decode(cblob("\x80\x02", 2), &v8), csubstr::npos);
+    EXPECT_EQ(v32, 7u);
+    EXPECT_EQ(v64, 7u);
+    EXPECT_EQ(v8, 7u);
+    // the largest values
+    EXPECT_EQ(varint_decode(cblob("\xff\xff\xff\xff\x0f", 5), &v32), 5u);
+    EXPECT_EQ(v32, UINT32_C(0xffffffff));
+    EXPECT_EQ(varint_decode(cblob("\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01", 10), &v64), 10u);
+    EXPECT_EQ(v64, UINT64_C(0xffffffffffffffff));
+    EXPECT_EQ(varint_decode(cblob("\xff\x01", 2), &v8), 2u);
+    EXPECT_EQ(v8, 255u);
+    // a non-minimal encoding is accepted
+    EXPECT_EQ(varint_decode(cblob("\x81\x00", 2), &v32), 2u);
+    EXPECT_EQ(v32, 1u);
+}
+
+template<class U>
+void test_roundtrip()
+{
+    for(unsigned bits = 0; bits <= 8 * sizeof(U); ++bits)
+    {
+        const U top = bits ? static_cast<U>(U(1) << (bits - 1)) : U(0);
+        for(U v : {top, static_cast<U>(top - 1u), static_cast<U>(top + 1u), static_cast<U>(top | (top >> 1))})
+        {
+            char buf[16];
+            const size_t len = varint_encode(buf, v);
+            ASSERT_LE(len, varint_max_size<U>());
+            U w = 0;
+            EXPECT_EQ(varint_decode(cblob(buf, len), &w), len);
+            EXPECT_EQ(w, v);
+            // the buffer may continue after the varint
+            buf[len] = '\x80';
+            w = 0;
+            EXPECT_EQ(varint_decode(cblob(buf, len + 1), &w), len);
+            EXPECT_EQ(w, v);
+        }
+    }
+}
+
+TEST(varint, roundtrip)
+{
+    test_roundtrip<uint8_t>();
+    test_roundtrip<uint16_t>();
+    test_roundtrip<uint32_t>();
+    test_roundtrip<uint64_t>();
+}
+
+
+//-----------------------------------------------------------------------------
+
+template<class U>
+struct varint_impl_case
+{
+    const char *name;
+    size_t (*decode)(cblob, span<U>);
+};
+
+template<class U>
+std::vector<varint_impl_case<U>> varint_impls()
+{
+    std::vector<varint_impl_case<U>> impls;
+    impls.push_back({"public", [](cblob buf, span<U> vals){ return varint_decode(buf, vals); }});
+    impls.push_back({"scalar", [](cblob buf, span<U> vals){ return detail::varint_decode_scalar(buf, vals); }});
+#ifdef C4_VARINT_X86
+    if(cpu_has(CPU_SSSE3))
+        impls.push_back({"ssse3", [](cblob buf, span<U> vals){ return detail::varint_decode_ssse3(buf, vals); }});
+#endif
+    return impls;
+}
+
+/** random values, with a number of bits up to max_bits, so that the
+ * varints have all the lengths */
+template<class U>
+std::vector<U> varint_random_values(size_t num, unsigned max_bits, uint64_t seed)
+{
+    std::vector<U> vals(num);
+    for(U &v : vals)
+    {
+        seed ^= seed << 13u;
+        seed ^= seed >> 7u;
+        seed ^= seed << 17u;
+        const unsigned bits = static_cast<unsigned>(seed % (max_bits + 1u));
+        v = bits ? static_cast<U>((seed >> 8u) & (UINT64_C(0xffffffffffffffff) >> (64u - bits))) : U(0);
+    }
+    return vals;
+}
+
+template<class U>
+void test_bulk()
+{
+    std::vector<size_t> nums;
+    for(size_t num = 0; num < 70; ++num)
+        nums.push_back(num);
+    nums.push_back(10000);
+    for(unsigned max_bits : {7u, 14u, 28u, 8u * unsigned(sizeof(U))})
+    {
+        SCOPED_TRACE(max_bits);
+        for(size_t num : nums)
+        {
+            SCOPED_TRACE(num);
+            const std::vector<U> vals = varint_random_values<U>(num, max_bits, 0x9e3779b97f4a7c15u + num);
+            std::string expected;
+            for(U v : vals)
+                expected += varint_str(v);
+            std::string encoded(expected.size() + 1, 'x');
+            EXPECT_EQ(varint_encode(blob(&encoded[0], encoded.size()), cspan<U>(vals.data(), vals.size())), expected.size());
+            encoded.resize(expected.size());
+            ASSERT_EQ(encoded, expected);
+            // padding after the varints must not be read
+            encoded += std::string(20, '\x80');
+            for(auto const& impl : varint_impls<U>())
+            {
+                SCOPED_TRACE(impl.name);
+                std::vector<U> decoded(num + 1, U(42));
+                EXPECT_EQ(impl.decode(cblob(encoded.data(), encoded.size()), span<U>(decoded.data(), num)), expected.size());
+                EXPECT_EQ(decoded.back(), U(42));
+                decoded.pop_back();
+                EXPECT_EQ(decoded, vals);
+                if(num)
+                {
+                    // truncated
+                    EXPECT_EQ(impl.decode(cblob(encoded.data(), expected.size() - 1), span<U>(decoded.data(), num)), csubstr::npos);
+                }
+                if(num > 1)
+                {
+                    // an overflowing varint in the middle
+                    std::string bad = expected;
+                    bad.insert(varint_str(vals[0]).size(), std::string(varint_max_size<U>(), '\xff'));
+                    EXPECT_EQ(impl.decode(cblob(bad.data(), bad.size()), span<U>(decoded.data(), num)), csubstr::npos);
+                }
+            }
+        }
+    }
+}
+
+TEST(varint, bulk_u32)
+{
+    test_bulk<uint32_t>();
+}
+
+TEST(varint, bulk_u64)
+{
+    test_bulk<uint64_t>();
+}
+
+TEST(varint, bulk_encode_small_buffer)
+{
+    const uint32_t vals[] = {1u, 300u, 2u};
+    char buf[4] = {'x', 'x', 'x', 'x'};
+    EXPECT_EQ(varint_encode(blob(buf, 2), cspan<uint32_t>(vals, 3)), 4u);
+    EXPECT_EQ(csubstr(buf, 4), "\x01xxx");
+}
+
+template<class Buf, class=void> struct can_varint_encode : std::false_type {};
+template<class Buf> struct can_varint_encode<Buf, decltype((void)varint_encode(std::declval<Buf&>(), 1u))> : std::true_type {};
+
+TEST(varint, substr)
+{
+    // the chars of the string are used, not the string object
+    static_assert(can_varint_encode<substr>::value, "");
+    static_assert( ! can_varint_encode<csubstr>::value, "the chars of a csubstr are read-only");
+    char storage[16] = {};
+    substr s(storage, sizeof(storage));
+    const substr before = s;
+    EXPECT_EQ(varint_encode(s, 300u), 2u);
+    EXPECT_EQ(s.str, before.str);
+    EXPECT_EQ(s.len, before.len);
+    EXPECT_EQ(csubstr(storage, 2), "\xac\x02");
+    EXPECT_EQ(varint_encode(s.first(1), 300u), 2u); // too small: no writes
+    EXPECT_EQ(storage[0], '\xac');
+    const uint32_t vals[] = {1u, 300u, 2u};
+    EXPECT_EQ(varint_encode(s.sub(2), cspan<uint32_t>(vals, 3)), 4u);
+    EXPECT_EQ(csubstr(storage + 2, 4), "\x01\xac\x02\x02");
+    unsigned v = 0;
+    EXPECT_EQ(varint_decode(s, &v), 2u);
+    EXPECT_EQ(v, 300u);
+    const csubstr cs = s;
+    v = 0;
+    EXPECT_EQ(varint_decode(cs, &v), 2u);
+    EXPECT_EQ(v, 300u);
+    EXPECT_EQ(varint_decode(cs.first(1), &v), csubstr::npos);
+    uint32_t out[3] = {};
+    EXPECT_EQ(varint_decode(cs.sub(2), span<uint32_t>(out, 3)), 4u);
+    EXPECT_EQ(out[0], 1u);
+    EXPECT_EQ(out[1], 300u);
+    EXPECT_EQ(out[2], 2u);
+}
+
+
+//-----------------------------------------------------------------------------
+
+TEST(varint, cat_uncat)
+{
+    char buf[64];
+    const size_t sz = cat_bytes(buf, fmt::varint(300u), fmt::varint(-2), fmt::be(uint16_t(0x0102)),
+                                fmt::varint(-(INT64_C(1) << 40)), fmt::varint(uint8_t(255)));
+    EXPECT_EQ(sz, 2u + 1u + 2u + 6u + 2u);
+    EXPECT_EQ(csubstr(buf, 5), "\xac\x02\x03\x01\x02");
+    unsigned a = 0;
+    int b = 0;
+    uint16_t c = 0;
+    int64_t d = 0;
+    uint8_t e = 0;
+    EXPECT_EQ(uncat_bytes(cblob(buf, sz), fmt::varint(a), fmt::varint(b), fmt::be(c), fmt::varint(d), fmt::varint(e)), sz);
+    EXPECT_EQ(a, 300u);
+    EXPECT_EQ(b, -2);
+    EXPECT_EQ(c, 0x0102u);
+    EXPECT_EQ(d, -(INT64_C(1) << 40));
+    EXPECT_EQ(e, 255u);
+    EXPECT_EQ(uncat_bytes(cblob(buf, sz - 1), fmt::varint(a), fmt::varint(b), fmt::be(c), fmt::varint(d), fmt::varint(e)), csubstr::npos);
+    // a value too large for the variable is an error
+    int8_t f = 0;
+    EXPECT_EQ(uncat_bytes(cblob(buf, sz), fmt::varint(f)), csubstr::npos);
+}
+
+} // namespace c4
+
+#include "c4/libtest/supprwarn_pop.hpp"